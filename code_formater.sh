@@ -5,9 +5,22 @@ dirs=(
     ./source/utl/
     ./source/port/mac/
     ./source/port/stm32/
+    ./source/port/unix/
+    ./test/common/
     ./test/utl/dbg/
+    ./test/utl/kvs/
+    ./test/utl/tlog/
     ./test/hal/cpu/
+    ./test/hal/cpu_stm32/
+    ./test/hal/adc/
+    ./test/hal/bus/
+    ./test/hal/gpio/
+    ./test/hal/flash/
+    ./test/hal/timer/
     ./test/hal/uart/
+    ./test/hal/uart_loopback/
+    ./test/hal/uart_replay/
+    ./test/hal/uart_bench/
 )
 
 for dir in "${dirs[@]}"; do
@@ -1,18 +1,139 @@
 #include "hal.h"
 
+static hal_init_stage_t hal_init_stages[HAL_INIT_MAX_STAGES];
+static uint32_t hal_init_num_stages = 0;
+static bool hal_init_stage_running = false;
+static uint32_t hal_init_cycles;
+static uint32_t hal_init_stage_cycles;
+
+// the cycle counter may only start with hal_cpu_init(), earlier stages then show up as 0us
+static uint32_t hal_init_us_get(uint32_t cycles)
+{
+    return (uint32_t) ((uint64_t) (hal_cpu_cycles_get() - cycles) * 1000000 / hal_cpu_cycles_freq_get());
+}
+
+void hal_init_stage_begin(const char* name)
+{
+    hal_init_stage_end();
+
+    if(hal_init_num_stages == 0)
+        hal_init_cycles = hal_cpu_cycles_get();
+
+    if(hal_init_num_stages >= HAL_INIT_MAX_STAGES)
+        return;
+
+    hal_init_stage_cycles = hal_cpu_cycles_get();
+    hal_init_stages[hal_init_num_stages].name = name;
+    hal_init_stages[hal_init_num_stages].start_us = hal_init_us_get(hal_init_cycles);
+    hal_init_stages[hal_init_num_stages].duration_us = 0;
+    hal_init_stage_running = true;
+}
+
+void hal_init_stage_end(void)
+{
+    if(!hal_init_stage_running)
+        return;
+
+    hal_init_stages[hal_init_num_stages++].duration_us = hal_init_us_get(hal_init_stage_cycles);
+    hal_init_stage_running = false;
+}
+
+uint32_t hal_init_stages_get(hal_init_stage_t* stages, uint32_t max)
+{
+    uint32_t num_stages = hal_init_num_stages < max ? hal_init_num_stages : max;
+
+    memcpy(stages, hal_init_stages, num_stages * sizeof(hal_init_stage_t));
+
+    return num_stages;
+}
+
+void hal_init_report(void)
+{
+    uint32_t total_us = 0;
+
+    for(uint32_t pos = 0; pos < hal_init_num_stages; pos++)
+    {
+        hal_init_stage_t* stage = &hal_init_stages[pos];
+
+        UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "Init stage %-8s at %7u us: %7u us\n", stage->name, stage->start_us,
+                       stage->duration_us);
+        total_us = stage->start_us + stage->duration_us;
+    }
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "Init done in %u us\n", total_us);
+}
+
 void hal_deinit(void)
 {
+#if HAL_ADC_ENABLED == 1
+    hal_adc_deinit();
+#endif
+#if HAL_I2C_ENABLED == 1
+    hal_i2c_deinit();
+#endif
+#if HAL_SPI_ENABLED == 1
+    hal_spi_deinit();
+#endif
+#if HAL_TIMER_ENABLED == 1
+    hal_timer_deinit();
+#endif
+#if HAL_FLASH_ENABLED == 1
+    hal_flash_deinit();
+#endif
+#if HAL_GPIO_ENABLED == 1
+    hal_gpio_deinit();
+#endif
     hal_uart_deinit();
     hal_cpu_deinit();
 }
 
 void hal_init(void)
 {
+    hal_init_stage_begin("dbg");
     utl_dbg_init();
     utl_dbg_mod_enable(UTL_DBG_MOD_PORT);
+
+    hal_init_stage_begin("cpu");
     hal_cpu_init();
+
+#if HAL_UART_LAZY_INIT == 0
+    hal_init_stage_begin("uart");
     hal_uart_init();
+#endif
+
+#if HAL_GPIO_ENABLED == 1
+    hal_init_stage_begin("gpio");
+    hal_gpio_init();
+#endif
+
+#if HAL_FLASH_ENABLED == 1
+    hal_init_stage_begin("flash");
+    hal_flash_init();
+#endif
+
+#if HAL_TIMER_ENABLED == 1
+    hal_init_stage_begin("timer");
+    hal_timer_init();
+#endif
+
+#if HAL_SPI_ENABLED == 1
+    hal_init_stage_begin("spi");
+    hal_spi_init();
+#endif
+
+#if HAL_I2C_ENABLED == 1
+    hal_init_stage_begin("i2c");
+    hal_i2c_init();
+#endif
+
+#if HAL_ADC_ENABLED == 1
+    hal_init_stage_begin("adc");
+    hal_adc_init();
+#endif
 
     // init C random seed
+    hal_init_stage_begin("seed");
     srand(hal_cpu_random_seed_get());
+
+    hal_init_stage_end();
 }
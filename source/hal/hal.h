@@ -21,6 +21,79 @@ extern "C"
 #define HAL_DEBUG_IN_SLEEP_MODE 1
 #define HAL_WDG_ENABLED 0
 
+// 1: UART traffic capture to pcapng files, see hal_uart_capture_start(). Host builds only: it
+// writes files with stdio from the port RX paths.
+#ifndef HAL_UART_CAPTURE_ENABLED
+#define HAL_UART_CAPTURE_ENABLED 0
+#endif
+
+// 1: hal_init() also initializes the GPIO driver, the port must provide HAL_GPIO_DRIVER
+#ifndef HAL_GPIO_ENABLED
+#define HAL_GPIO_ENABLED 0
+#endif
+
+// 1: hal_init() also initializes the flash driver, the port must provide HAL_FLASH_DRIVER
+#ifndef HAL_FLASH_ENABLED
+#define HAL_FLASH_ENABLED 0
+#endif
+
+// 1: hal_init() also initializes the timer driver, the port must provide HAL_TIMER_DRIVER
+#ifndef HAL_TIMER_ENABLED
+#define HAL_TIMER_ENABLED 0
+#endif
+
+// 1: hal_init() also initializes the SPI / I2C drivers, the port must provide HAL_SPI_DRIVER /
+// HAL_I2C_DRIVER
+#ifndef HAL_SPI_ENABLED
+#define HAL_SPI_ENABLED 0
+#endif
+
+#ifndef HAL_I2C_ENABLED
+#define HAL_I2C_ENABLED 0
+#endif
+
+// 1: hal_init() also initializes the ADC driver, the port must provide HAL_ADC_DRIVER
+#ifndef HAL_ADC_ENABLED
+#define HAL_ADC_ENABLED 0
+#endif
+
+// 1: the UART driver is initialized by the first hal_uart_open() instead of hal_init(), applications
+// that do not use the UART (or open it later) start faster
+#ifndef HAL_UART_LAZY_INIT
+#define HAL_UART_LAZY_INIT 1
+#endif
+
+// 1: critical sections and hal_cpu_time_get_ms() call the port_cpu_inline.h of the port directly
+// (inlined, no driver table), the port directory must be in the include path. Other calls still
+// go through HAL_CPU_DRIVER.
+#ifndef HAL_CPU_STATIC_DRIVER
+#define HAL_CPU_STATIC_DRIVER 0
+#endif
+
+// 1: every critical section is timed per call site (hold time, wait for the lock, nesting), see
+// hal_cpu_cs_profile_report(). Adds a table lookup and three cycle counter reads to each section.
+#ifndef HAL_CPU_CS_PROFILE
+#define HAL_CPU_CS_PROFILE 0
+#endif
+
+// host ports (unix, mac): longest sleep of hal_cpu_low_power_enter() without a wake up, in ms. Plays
+// the SysTick interrupt that ends WFI on the target, so a missed wake up costs at most one tick.
+#ifndef HAL_CPU_LOW_POWER_MAX_MS
+#define HAL_CPU_LOW_POWER_MAX_MS 1
+#endif
+
+// 1: main loop iterations are timed (histogram, max, idle time spent in hal_cpu_low_power_enter()
+// and hal_cpu_sleep_ms(), CPU load), see hal_cpu_loop_stats_get(). Each iteration takes a processor
+// level critical section. The statistics are printed every HAL_CPU_LOOP_REPORT_MS with
+// UTL_DBG_MOD_PORT, 0 disables the periodic report.
+#ifndef HAL_CPU_LOOP_MONITOR
+#define HAL_CPU_LOOP_MONITOR 0
+#endif
+
+#ifndef HAL_CPU_LOOP_REPORT_MS
+#define HAL_CPU_LOOP_REPORT_MS 10000
+#endif
+
 #if defined(__GNUC__)
 #define __WEAK __attribute__((weak))
 #define __UNUSED __attribute__((unused))
@@ -31,14 +104,47 @@ extern "C"
 
 #include "utl_printf.h"
 #include "utl_dbg.h"
+#include "utl_frame.h"
 #include "hal_cpu.h"
 #include "hal_uart.h"
+#include "hal_gpio.h"
+#include "hal_flash.h"
+#include "hal_timer.h"
+#include "hal_spi.h"
+#include "hal_i2c.h"
+#include "hal_adc.h"
+
+#define HAL_INIT_MAX_STAGES 16
+
+// boot profiling, one entry per initialization stage
+typedef struct hal_init_stage_s
+{
+    const char* name;
+    // from the beginning of the first stage
+    uint32_t start_us;
+    uint32_t duration_us;
+} hal_init_stage_t;
 
 extern hal_cpu_driver_t HAL_CPU_DRIVER;
 extern hal_uart_driver_t HAL_UART_DRIVER;
+extern hal_gpio_driver_t HAL_GPIO_DRIVER;
+extern hal_flash_driver_t HAL_FLASH_DRIVER;
+extern hal_timer_driver_t HAL_TIMER_DRIVER;
+extern hal_spi_driver_t HAL_SPI_DRIVER;
+extern hal_i2c_driver_t HAL_I2C_DRIVER;
+extern hal_adc_driver_t HAL_ADC_DRIVER;
 
 void hal_init(void);
 void hal_deinit(void);
+// start timing a new initialization stage (@p name must be a static string), the running one ends
+void hal_init_stage_begin(const char* name);
+void hal_init_stage_end(void);
+/** Copy up to @p max stages
+    @return Number of stages copied
+*/
+uint32_t hal_init_stages_get(hal_init_stage_t* stages, uint32_t max);
+// print the stages with UTL_DBG_MOD_PORT
+void hal_init_report(void);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,51 @@
+#include "hal.h"
+
+static hal_adc_driver_t* const drv = &HAL_ADC_DRIVER;
+
+void hal_adc_init(void)
+{
+    drv->init();
+}
+
+void hal_adc_deinit(void)
+{
+    drv->deinit();
+}
+
+bool hal_adc_config(hal_adc_id_t adc, hal_adc_config_t* cfg)
+{
+    if(adc >= HAL_ADC_NUM_ADCS || cfg->sample_rate_hz == 0 || cfg->num_channels == 0 ||
+       cfg->num_channels > HAL_ADC_MAX_CHANNELS || cfg->buffer == 0 || cfg->frames_per_half == 0 ||
+       cfg->callback == 0)
+        return false;
+
+    for(uint32_t channel = 0; channel < cfg->num_channels; channel++)
+    {
+        if(cfg->inputs[channel] >= HAL_ADC_NUM_INPUTS)
+            return false;
+    }
+
+    drv->stop(adc);
+
+    return drv->config(adc, cfg);
+}
+
+bool hal_adc_start(hal_adc_id_t adc)
+{
+    if(adc >= HAL_ADC_NUM_ADCS)
+        return false;
+
+    return drv->start(adc);
+}
+
+void hal_adc_stop(hal_adc_id_t adc)
+{
+    if(adc < HAL_ADC_NUM_ADCS)
+        drv->stop(adc);
+}
+
+void hal_adc_stats_get(hal_adc_id_t adc, hal_adc_stats_t* stats)
+{
+    if(adc < HAL_ADC_NUM_ADCS)
+        drv->stats_get(adc, stats);
+}
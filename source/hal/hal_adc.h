@@ -0,0 +1,82 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Continuous ADC sampling into a ping-pong buffer. A frame holds one sample of each configured
+// channel (interleaved), frames are converted at the sample rate into the two halves of the buffer
+// in turn and each filled half is given to the callback while the other one is being filled: the
+// callback has the duration of a half buffer to process it.
+
+typedef enum hal_adc_id_e
+{
+    HAL_ADC_0 = 0,
+    HAL_ADC_NUM_ADCS,
+} hal_adc_id_t;
+
+#define HAL_ADC_MAX_CHANNELS 8
+#define HAL_ADC_NUM_INPUTS 16
+// samples are right aligned codes, 0 to 4095
+#define HAL_ADC_RESOLUTION_BITS 12
+
+/** Called in interrupt context when a half of the buffer is filled
+    @param samples First frame of the half, @p num_frames frames of interleaved channels
+    @param timestamp When the last frame was converted, in hal_cpu_cycles_get() units
+*/
+typedef void (*hal_adc_callback_t)(hal_adc_id_t adc, const uint16_t* samples, uint32_t num_frames,
+                                   uint32_t timestamp);
+
+typedef struct hal_adc_config_s
+{
+    // frames per second
+    uint32_t sample_rate_hz;
+    uint32_t num_channels;
+    // input converted at each position of a frame
+    uint8_t inputs[HAL_ADC_MAX_CHANNELS];
+    // 2 * frames_per_half * num_channels samples, valid until hal_adc_stop()
+    uint16_t* buffer;
+    uint32_t frames_per_half;
+    hal_adc_callback_t callback;
+} hal_adc_config_t;
+
+typedef struct hal_adc_stats_s
+{
+    // halves given to the callback
+    uint32_t halves;
+    // halves completed while the callback of the previous one was still running: the conversions
+    // went on over the half being read
+    uint32_t overruns;
+    // halves overwritten before their interrupt was handled, not because of a long callback
+    uint32_t late;
+    // time spent in the callback, in hal_cpu_cycles_get() units
+    uint32_t busy_cycles_max;
+    uint64_t busy_cycles;
+} hal_adc_stats_t;
+
+typedef struct hal_adc_driver_s
+{
+    void (*init)(void);
+    void (*deinit)(void);
+    // stopped, configuration already checked
+    bool (*config)(hal_adc_id_t adc, hal_adc_config_t* cfg);
+    bool (*start)(hal_adc_id_t adc);
+    void (*stop)(hal_adc_id_t adc);
+    void (*stats_get)(hal_adc_id_t adc, hal_adc_stats_t* stats);
+} hal_adc_driver_t;
+
+void hal_adc_init(void);
+void hal_adc_deinit(void);
+/** Configure an ADC, stopping it
+    @return false for an invalid configuration or a sample rate the port cannot do
+*/
+bool hal_adc_config(hal_adc_id_t adc, hal_adc_config_t* cfg);
+// start converting from the first half of the buffer, the statistics are cleared
+bool hal_adc_start(hal_adc_id_t adc);
+void hal_adc_stop(hal_adc_id_t adc);
+void hal_adc_stats_get(hal_adc_id_t adc, hal_adc_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
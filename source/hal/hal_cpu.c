@@ -1,10 +1,61 @@
 #include "hal.h"
 
-static hal_cpu_driver_t* drv = &HAL_CPU_DRIVER;
+static hal_cpu_driver_t* const drv = &HAL_CPU_DRIVER;
+
+#if HAL_CPU_LOOP_MONITOR == 1
+// cycle counter for precision, milliseconds for periods longer than its wrap around
+typedef struct hal_cpu_stamp_s
+{
+    uint32_t cycles;
+    uint32_t ms;
+} hal_cpu_stamp_t;
+
+typedef struct hal_cpu_load_slot_s
+{
+    uint32_t busy_us;
+    uint32_t idle_us;
+} hal_cpu_load_slot_t;
+
+static hal_cpu_loop_stats_t hal_cpu_loop_stats;
+// iterations are accounted in the slot where they end, hal_cpu_load_slot_time is the newest one
+static hal_cpu_load_slot_t hal_cpu_load_slots[HAL_CPU_LOAD_SLOTS];
+static uint32_t hal_cpu_load_slot_time = 0;
+// current iteration, only used by the main context
+static hal_cpu_stamp_t hal_cpu_loop_start;
+static uint32_t hal_cpu_loop_idle_us = 0;
+static bool hal_cpu_loop_running = false;
+static uint32_t hal_cpu_loop_report_ms = 0;
+
+static void hal_cpu_stamp_get(hal_cpu_stamp_t* stamp)
+{
+    stamp->cycles = hal_cpu_cycles_get();
+    stamp->ms = hal_cpu_time_get_ms();
+}
+
+static uint32_t hal_cpu_stamp_elapsed_us(hal_cpu_stamp_t* stamp)
+{
+    uint32_t cycles = hal_cpu_cycles_get() - stamp->cycles;
+    uint32_t ms = hal_cpu_time_elapsed_get_ms(stamp->ms);
+
+    // the cycle counter may have wrapped (4.29s for the host ports)
+    if(ms >= 1000)
+        return ms < UINT32_MAX / 1000 ? ms * 1000 : UINT32_MAX;
+
+    return (uint32_t) ((uint64_t) cycles * 1000000 / hal_cpu_cycles_freq_get());
+}
+
+static void hal_cpu_loop_idle_add(hal_cpu_stamp_t* stamp)
+{
+    // idle time outside of the main loop (initialization) is not accounted
+    if(hal_cpu_loop_running)
+        hal_cpu_loop_idle_us += hal_cpu_stamp_elapsed_us(stamp);
+}
+#endif
 
 void hal_cpu_init(void)
 {
     drv->init();
+    hal_cpu_loop_stats_reset();
 }
 
 void hal_cpu_deinit(void)
@@ -32,30 +83,67 @@ uint32_t hal_cpu_random_seed_get(void)
     return drv->random_seed_get();
 }
 
-uint32_t hal_cpu_critical_section_enter(hal_cpu_cs_level_t level)
+#if HAL_CPU_STATIC_DRIVER == 0
+// parenthesized names: not replaced by the profiler macros of hal_cpu.h
+uint32_t(hal_cpu_critical_section_enter)(hal_cpu_cs_level_t level)
 {
     return drv->critical_section_enter(level);
 }
 
-void hal_cpu_critical_section_leave(uint32_t last_level)
+void(hal_cpu_critical_section_leave)(uint32_t last_level)
 {
     drv->critical_section_leave(last_level);
 }
+#endif
 
 void hal_cpu_low_power_enter(void)
 {
+#if HAL_CPU_LOOP_MONITOR == 1
+    hal_cpu_stamp_t stamp;
+
+    hal_cpu_stamp_get(&stamp);
     drv->low_power_enter();
+    hal_cpu_loop_idle_add(&stamp);
+#else
+    drv->low_power_enter();
+#endif
+}
+
+void hal_cpu_wakeup(void)
+{
+    if(drv->wakeup)
+        drv->wakeup();
 }
 
 void hal_cpu_sleep_ms(uint32_t tmr_ms)
 {
+#if HAL_CPU_LOOP_MONITOR == 1
+    hal_cpu_stamp_t stamp;
+
+    hal_cpu_stamp_get(&stamp);
     drv->sleep_ms(tmr_ms);
+    hal_cpu_loop_idle_add(&stamp);
+#else
+    drv->sleep_ms(tmr_ms);
+#endif
 }
 
+#if HAL_CPU_STATIC_DRIVER == 0
 uint32_t hal_cpu_time_get_ms(void)
 {
     return drv->time_get_ms();
 }
+#endif
+
+uint32_t hal_cpu_cycles_get(void)
+{
+    return drv->cycles_get ? drv->cycles_get() : hal_cpu_time_get_ms();
+}
+
+uint32_t hal_cpu_cycles_freq_get(void)
+{
+    return drv->cycles_get && drv->cycles_freq_get ? drv->cycles_freq_get() : 1000;
+}
 
 uint32_t hal_cpu_time_elapsed_get_ms(uint32_t tmr_old_ms)
 {
@@ -69,3 +157,337 @@ uint32_t hal_cpu_time_elapsed_get_ms(uint32_t tmr_old_ms)
 
     return elapsed_ms;
 }
+
+#if HAL_CPU_CS_PROFILE == 1
+typedef struct hal_cpu_cs_active_s
+{
+    hal_cpu_cs_site_t* site;
+    uint32_t start;
+} hal_cpu_cs_active_t;
+
+static hal_cpu_cs_site_t hal_cpu_cs_sites[HAL_CPU_CS_PROFILE_MAX_SITES];
+static uint32_t hal_cpu_cs_num_sites = 0;
+// sections being held: nested calls and interrupts preempting them are both LIFO, a single stack
+// is enough. Only changed while holding a critical section.
+static hal_cpu_cs_active_t hal_cpu_cs_stack[HAL_CPU_CS_PROFILE_MAX_DEPTH];
+static uint32_t hal_cpu_cs_depth = 0;
+
+static hal_cpu_cs_site_t* hal_cpu_cs_site_find(const char* file, uint32_t line, hal_cpu_cs_level_t level)
+{
+    // __FILE__ of a translation unit is a single string, comparing pointers is enough
+    for(uint32_t pos = 0; pos < hal_cpu_cs_num_sites; pos++)
+    {
+        if(hal_cpu_cs_sites[pos].line == line && hal_cpu_cs_sites[pos].file == file)
+            return &hal_cpu_cs_sites[pos];
+    }
+
+    if(hal_cpu_cs_num_sites >= HAL_CPU_CS_PROFILE_MAX_SITES)
+        return 0;
+
+    hal_cpu_cs_site_t* site = &hal_cpu_cs_sites[hal_cpu_cs_num_sites++];
+    memset(site, 0, sizeof(hal_cpu_cs_site_t));
+    site->file = file;
+    site->line = line;
+    site->level = level;
+
+    return site;
+}
+
+uint32_t hal_cpu_cs_profile_enter(hal_cpu_cs_level_t level, const char* file, uint32_t line)
+{
+    uint32_t wait_start = hal_cpu_cycles_get();
+    uint32_t last_level = (hal_cpu_critical_section_enter)(level);
+    uint32_t start = hal_cpu_cycles_get();
+    uint32_t wait = start - wait_start;
+
+    hal_cpu_cs_site_t* site = hal_cpu_cs_site_find(file, line, level);
+    uint32_t depth = ++hal_cpu_cs_depth;
+
+    if(site)
+    {
+        site->count++;
+        site->wait_total += wait;
+        if(wait > site->wait_max)
+            site->wait_max = wait;
+        if(depth > site->depth_max)
+            site->depth_max = depth;
+    }
+
+    if(depth <= HAL_CPU_CS_PROFILE_MAX_DEPTH)
+    {
+        hal_cpu_cs_stack[depth - 1].site = site;
+        hal_cpu_cs_stack[depth - 1].start = start;
+    }
+
+    return last_level;
+}
+
+void hal_cpu_cs_profile_leave(uint32_t last_level)
+{
+    uint32_t end = hal_cpu_cycles_get();
+
+    if(hal_cpu_cs_depth > 0)
+    {
+        if(hal_cpu_cs_depth <= HAL_CPU_CS_PROFILE_MAX_DEPTH)
+        {
+            hal_cpu_cs_active_t* active = &hal_cpu_cs_stack[hal_cpu_cs_depth - 1];
+
+            if(active->site)
+            {
+                uint32_t hold = end - active->start;
+
+                active->site->hold_total += hold;
+                if(hold > active->site->hold_max)
+                    active->site->hold_max = hold;
+            }
+        }
+
+        hal_cpu_cs_depth--;
+    }
+
+    (hal_cpu_critical_section_leave)(last_level);
+}
+
+uint32_t hal_cpu_cs_profile_get(hal_cpu_cs_site_t* sites, uint32_t max)
+{
+    uint32_t state = (hal_cpu_critical_section_enter)(HAL_CPU_CS_PROCESSOR_LEVEL);
+
+    uint32_t num_sites = hal_cpu_cs_num_sites < max ? hal_cpu_cs_num_sites : max;
+    memcpy(sites, hal_cpu_cs_sites, num_sites * sizeof(hal_cpu_cs_site_t));
+
+    (hal_cpu_critical_section_leave)(state);
+
+    return num_sites;
+}
+
+void hal_cpu_cs_profile_reset(void)
+{
+    uint32_t state = (hal_cpu_critical_section_enter)(HAL_CPU_CS_PROCESSOR_LEVEL);
+
+    // sections being held keep their slot, they are counted again from their next call
+    for(uint32_t pos = 0; pos < hal_cpu_cs_num_sites; pos++)
+    {
+        hal_cpu_cs_site_t* site = &hal_cpu_cs_sites[pos];
+
+        site->count = 0;
+        site->hold_total = 0;
+        site->hold_max = 0;
+        site->wait_total = 0;
+        site->wait_max = 0;
+        site->depth_max = 0;
+    }
+
+    (hal_cpu_critical_section_leave)(state);
+}
+#else
+uint32_t hal_cpu_cs_profile_get(hal_cpu_cs_site_t* sites, uint32_t max)
+{
+    return 0;
+}
+
+void hal_cpu_cs_profile_reset(void)
+{
+}
+#endif
+
+void hal_cpu_cs_profile_report(void)
+{
+    hal_cpu_cs_site_t sites[HAL_CPU_CS_PROFILE_MAX_SITES];
+    uint32_t num_sites = hal_cpu_cs_profile_get(sites, HAL_CPU_CS_PROFILE_MAX_SITES);
+    uint64_t freq = hal_cpu_cycles_freq_get();
+    uint32_t printed = 0;
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "Critical sections: %u call sites, times in us (max hold/mean hold/max wait)\n",
+                   num_sites);
+
+    for(uint32_t n = 0; n < num_sites; n++)
+    {
+        uint32_t worst = num_sites;
+
+        for(uint32_t pos = 0; pos < num_sites; pos++)
+        {
+            if(printed & (1UL << pos))
+                continue;
+
+            if(worst == num_sites || sites[pos].hold_max > sites[worst].hold_max)
+                worst = pos;
+        }
+
+        printed |= 1UL << worst;
+
+        hal_cpu_cs_site_t* site = &sites[worst];
+        uint64_t mean = site->count ? site->hold_total / site->count : 0;
+
+        UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "  %s:%u level %u: %u calls, hold %" PRIu64 "/%" PRIu64 ", wait %" PRIu64
+                       ", depth %u\n", utl_dbg_base_name_get(site->file), site->line, site->level, site->count,
+                       (uint64_t) site->hold_max * 1000000 / freq, mean * 1000000 / freq,
+                       (uint64_t) site->wait_max * 1000000 / freq,
+                       site->depth_max);
+    }
+}
+
+#if HAL_CPU_LOOP_MONITOR == 1
+// called with the lock held, clears the slots without any iteration since the last call
+static hal_cpu_load_slot_t* hal_cpu_load_slot_get(void)
+{
+    uint32_t now = hal_cpu_time_get_ms() / HAL_CPU_LOAD_SLOT_MS;
+    uint32_t age = now - hal_cpu_load_slot_time;
+
+    for(uint32_t n = 0; n < age && n < HAL_CPU_LOAD_SLOTS; n++)
+        memset(&hal_cpu_load_slots[(now - n) % HAL_CPU_LOAD_SLOTS], 0, sizeof(hal_cpu_load_slot_t));
+
+    hal_cpu_load_slot_time = now;
+
+    return &hal_cpu_load_slots[now % HAL_CPU_LOAD_SLOTS];
+}
+
+static uint32_t hal_cpu_load_calc(uint32_t window_ms)
+{
+    uint32_t num_slots = window_ms / HAL_CPU_LOAD_SLOT_MS;
+    uint64_t busy_us = 0;
+    uint64_t total_us = 0;
+
+    if(num_slots == 0)
+        num_slots = 1;
+    else if(num_slots > HAL_CPU_LOAD_SLOTS)
+        num_slots = HAL_CPU_LOAD_SLOTS;
+
+    hal_cpu_load_slot_get();
+
+    for(uint32_t n = 0; n < num_slots; n++)
+    {
+        hal_cpu_load_slot_t* slot = &hal_cpu_load_slots[(hal_cpu_load_slot_time - n) % HAL_CPU_LOAD_SLOTS];
+
+        busy_us += slot->busy_us;
+        total_us += (uint64_t) slot->busy_us + slot->idle_us;
+    }
+
+    return total_us ? (uint32_t) (busy_us * 1000 / total_us) : 0;
+}
+
+void hal_cpu_loop_begin(void)
+{
+    hal_cpu_stamp_get(&hal_cpu_loop_start);
+    hal_cpu_loop_idle_us = 0;
+    hal_cpu_loop_running = true;
+}
+
+void hal_cpu_loop_end(void)
+{
+    uint32_t loop_us = hal_cpu_stamp_elapsed_us(&hal_cpu_loop_start);
+    uint32_t idle_us = hal_cpu_loop_idle_us < loop_us ? hal_cpu_loop_idle_us : loop_us;
+    uint32_t bin = 0;
+
+    hal_cpu_loop_running = false;
+
+    while(bin < HAL_CPU_LOOP_HIST_BINS - 1 && (loop_us >> bin) != 0)
+        bin++;
+
+    uint32_t state = (hal_cpu_critical_section_enter)(HAL_CPU_CS_PROCESSOR_LEVEL);
+
+    hal_cpu_loop_stats.iterations++;
+    hal_cpu_loop_stats.hist[bin]++;
+    hal_cpu_loop_stats.busy_us += loop_us - idle_us;
+    hal_cpu_loop_stats.idle_us += idle_us;
+    if(loop_us > hal_cpu_loop_stats.loop_max_us)
+        hal_cpu_loop_stats.loop_max_us = loop_us;
+
+    hal_cpu_load_slot_t* slot = hal_cpu_load_slot_get();
+    slot->busy_us += loop_us - idle_us;
+    slot->idle_us += idle_us;
+
+    (hal_cpu_critical_section_leave)(state);
+
+#if HAL_CPU_LOOP_REPORT_MS > 0
+    if(hal_cpu_time_elapsed_get_ms(hal_cpu_loop_report_ms) >= HAL_CPU_LOOP_REPORT_MS)
+    {
+        hal_cpu_loop_report_ms = hal_cpu_time_get_ms();
+        hal_cpu_loop_report();
+    }
+#endif
+}
+
+void hal_cpu_loop_stats_get(hal_cpu_loop_stats_t* stats)
+{
+    uint32_t state = (hal_cpu_critical_section_enter)(HAL_CPU_CS_PROCESSOR_LEVEL);
+
+    *stats = hal_cpu_loop_stats;
+    stats->load_1s = (uint16_t) hal_cpu_load_calc(1000);
+    stats->load_10s = (uint16_t) hal_cpu_load_calc(10000);
+
+    (hal_cpu_critical_section_leave)(state);
+}
+
+void hal_cpu_loop_stats_reset(void)
+{
+    uint32_t state = (hal_cpu_critical_section_enter)(HAL_CPU_CS_PROCESSOR_LEVEL);
+
+    memset(&hal_cpu_loop_stats, 0, sizeof(hal_cpu_loop_stats));
+    memset(hal_cpu_load_slots, 0, sizeof(hal_cpu_load_slots));
+    hal_cpu_load_slot_time = hal_cpu_time_get_ms() / HAL_CPU_LOAD_SLOT_MS;
+    hal_cpu_loop_report_ms = hal_cpu_time_get_ms();
+
+    (hal_cpu_critical_section_leave)(state);
+}
+
+uint32_t hal_cpu_load_get(uint32_t window_ms)
+{
+    uint32_t state = (hal_cpu_critical_section_enter)(HAL_CPU_CS_PROCESSOR_LEVEL);
+    uint32_t load = hal_cpu_load_calc(window_ms);
+    (hal_cpu_critical_section_leave)(state);
+
+    return load;
+}
+
+void hal_cpu_loop_report(void)
+{
+    hal_cpu_loop_stats_t stats;
+
+    hal_cpu_loop_stats_get(&stats);
+
+    uint64_t total_us = stats.busy_us + stats.idle_us;
+    uint32_t idle = total_us ? (uint32_t) (stats.idle_us * 1000 / total_us) : 0;
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_PORT,
+                   "Main loop: %u iterations, max %u us, load %u.%u%% (1s) %u.%u%% (10s), idle %u.%u%%\n",
+                   stats.iterations, stats.loop_max_us, stats.load_1s / 10, stats.load_1s % 10, stats.load_10s / 10,
+                   stats.load_10s % 10, idle / 10, idle % 10);
+
+    for(uint32_t bin = 0; bin < HAL_CPU_LOOP_HIST_BINS; bin++)
+    {
+        if(stats.hist[bin] == 0)
+            continue;
+
+        if(bin == HAL_CPU_LOOP_HIST_BINS - 1)
+            UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "  >= %u us: %u\n", 1U << (bin - 1), stats.hist[bin]);
+        else
+            UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "  <  %u us: %u\n", 1U << bin, stats.hist[bin]);
+    }
+}
+#else
+void hal_cpu_loop_begin(void)
+{
+}
+
+void hal_cpu_loop_end(void)
+{
+}
+
+void hal_cpu_loop_stats_get(hal_cpu_loop_stats_t* stats)
+{
+    memset(stats, 0, sizeof(hal_cpu_loop_stats_t));
+}
+
+void hal_cpu_loop_stats_reset(void)
+{
+}
+
+uint32_t hal_cpu_load_get(uint32_t window_ms)
+{
+    return 0;
+}
+
+void hal_cpu_loop_report(void)
+{
+}
+#endif
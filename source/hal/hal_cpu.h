@@ -31,20 +31,120 @@ typedef struct hal_cpu_driver_s
     void (*sleep_ms)(uint32_t tmr_ms);
     uint32_t (*time_get_ms)(void);
     uint32_t (*time_elapsed_get_ms)(uint32_t tmr_old_ms);
+    // optional, ends low_power_enter() from interrupt context (simulated ports, on targets any
+    // interrupt already wakes the core)
+    void (*wakeup)(void);
+    // optional, free running cycle counter and its frequency, see hal_cpu_cycles_get()
+    uint32_t (*cycles_get)(void);
+    uint32_t (*cycles_freq_get)(void);
 } hal_cpu_driver_t;
 
+#define HAL_CPU_CS_PROFILE_MAX_SITES 32
+#define HAL_CPU_CS_PROFILE_MAX_DEPTH 16
+
+// statistics of one hal_cpu_critical_section_enter() call site, times in cycle counter units
+typedef struct hal_cpu_cs_site_s
+{
+    const char* file;
+    uint32_t line;
+    hal_cpu_cs_level_t level;
+    uint32_t count;
+    uint64_t hold_total;
+    uint32_t hold_max;
+    // time spent waiting for the lock (host ports, where critical sections are mutexes)
+    uint64_t wait_total;
+    uint32_t wait_max;
+    // nesting depth when entered, 1 for an outer critical section
+    uint32_t depth_max;
+} hal_cpu_cs_site_t;
+
 void hal_cpu_init(void);
 void hal_cpu_deinit(void);
 void hal_cpu_reset(void);
 void hal_cpu_watchdog_refresh(void);
 void hal_cpu_id_get(uint8_t id[HAL_CPU_ID_SIZE]);
 uint32_t hal_cpu_random_seed_get(void);
-uint32_t hal_cpu_critical_section_enter(hal_cpu_cs_level_t level);
-void hal_cpu_critical_section_leave(uint32_t last_level);
+// sleep until an interrupt happens (data received, timer, ...) or hal_cpu_wakeup() is called
 void hal_cpu_low_power_enter(void);
+// wake up the main context from hal_cpu_low_power_enter(), a call made before it is not lost
+void hal_cpu_wakeup(void);
 void hal_cpu_sleep_ms(uint32_t tmr_ms);
-uint32_t hal_cpu_time_get_ms(void);
 uint32_t hal_cpu_time_elapsed_get_ms(uint32_t tmr_old_ms);
+// free running cycle counter for short measurements (it may wrap after a few seconds), it counts
+// milliseconds on ports without one. hal_cpu_cycles_freq_get() gives its frequency in Hz.
+uint32_t hal_cpu_cycles_get(void);
+uint32_t hal_cpu_cycles_freq_get(void);
+
+// bin 0: iterations shorter than 1us, bin n: [2^(n-1), 2^n) us, the last one also counts longer ones
+#define HAL_CPU_LOOP_HIST_BINS 20
+// CPU load is kept per slot of HAL_CPU_LOAD_SLOT_MS, windows up to HAL_CPU_LOAD_SLOTS slots (10s)
+#define HAL_CPU_LOAD_SLOT_MS 100
+#define HAL_CPU_LOAD_SLOTS 100
+
+typedef struct hal_cpu_loop_stats_s
+{
+    uint32_t iterations;
+    uint32_t loop_max_us;
+    uint32_t hist[HAL_CPU_LOOP_HIST_BINS];
+    // time in and out of hal_cpu_low_power_enter()/hal_cpu_sleep_ms(), since the last reset
+    uint64_t busy_us;
+    uint64_t idle_us;
+    // CPU load over the last second and the last 10 seconds, in 0.1%
+    uint16_t load_1s;
+    uint16_t load_10s;
+} hal_cpu_loop_stats_t;
+
+#if HAL_CPU_STATIC_DRIVER == 1
+// provides port_cpu_critical_section_enter/leave() and port_cpu_time_get_ms() as static inline
+#include "port_cpu_inline.h"
+
+static inline uint32_t hal_cpu_critical_section_enter(hal_cpu_cs_level_t level)
+{
+    return port_cpu_critical_section_enter(level);
+}
+
+static inline void hal_cpu_critical_section_leave(uint32_t last_level)
+{
+    port_cpu_critical_section_leave(last_level);
+}
+
+static inline uint32_t hal_cpu_time_get_ms(void)
+{
+    return port_cpu_time_get_ms();
+}
+#else
+uint32_t hal_cpu_critical_section_enter(hal_cpu_cs_level_t level);
+void hal_cpu_critical_section_leave(uint32_t last_level);
+uint32_t hal_cpu_time_get_ms(void);
+#endif
+
+#if HAL_CPU_CS_PROFILE == 1
+uint32_t hal_cpu_cs_profile_enter(hal_cpu_cs_level_t level, const char* file, uint32_t line);
+void hal_cpu_cs_profile_leave(uint32_t last_level);
+// call sites are recorded by replacing the calls, hal_cpu.c defines the real ones as (name)(...)
+#define hal_cpu_critical_section_enter(level) hal_cpu_cs_profile_enter(level, __FILE__, __LINE__)
+#define hal_cpu_critical_section_leave(last_level) hal_cpu_cs_profile_leave(last_level)
+#endif
+
+// main loop monitor (HAL_CPU_LOOP_MONITOR), begin/end surround each iteration of the main loop
+void hal_cpu_loop_begin(void);
+void hal_cpu_loop_end(void);
+void hal_cpu_loop_stats_get(hal_cpu_loop_stats_t* stats);
+void hal_cpu_loop_stats_reset(void);
+/** CPU load of the main loop, in 0.1%
+    @param window_ms Window ending now, rounded to HAL_CPU_LOAD_SLOT_MS, up to 10s
+*/
+uint32_t hal_cpu_load_get(uint32_t window_ms);
+// print the loop statistics with UTL_DBG_MOD_PORT
+void hal_cpu_loop_report(void);
+
+/** Copy the statistics of up to @p max call sites (empty when HAL_CPU_CS_PROFILE is 0)
+    @return Number of call sites copied
+*/
+uint32_t hal_cpu_cs_profile_get(hal_cpu_cs_site_t* sites, uint32_t max);
+void hal_cpu_cs_profile_reset(void);
+// print all call sites with UTL_DBG_MOD_PORT, the worst hold time first
+void hal_cpu_cs_profile_report(void);
 
 #ifdef __cplusplus
 }
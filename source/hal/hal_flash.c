@@ -0,0 +1,75 @@
+#include "hal.h"
+
+static hal_flash_driver_t* const drv = &HAL_FLASH_DRIVER;
+static hal_flash_info_t hal_flash_info;
+
+static bool hal_flash_range_check(uint32_t offset, uint32_t size)
+{
+    return offset <= hal_flash_info.size && size <= hal_flash_info.size - offset;
+}
+
+void hal_flash_init(void)
+{
+    drv->init();
+    drv->info_get(&hal_flash_info);
+}
+
+void hal_flash_deinit(void)
+{
+    drv->deinit();
+}
+
+void hal_flash_info_get(hal_flash_info_t* info)
+{
+    *info = hal_flash_info;
+}
+
+bool hal_flash_page_erase(uint32_t page)
+{
+    if(page >= hal_flash_info.size / hal_flash_info.page_size)
+        return false;
+
+    return drv->page_erase(page);
+}
+
+bool hal_flash_program(uint32_t offset, const uint8_t* data, uint32_t size)
+{
+    if(!hal_flash_range_check(offset, size))
+        return false;
+
+    if((offset % hal_flash_info.write_size) != 0 || (size % hal_flash_info.write_size) != 0)
+    {
+        UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "Flash program at 0x%08X (%u bytes) not aligned to %u bytes\n", offset, size,
+                       hal_flash_info.write_size);
+        return false;
+    }
+
+    return size == 0 || drv->program(offset, data, size);
+}
+
+bool hal_flash_read(uint32_t offset, uint8_t* data, uint32_t size)
+{
+    if(!hal_flash_range_check(offset, size))
+        return false;
+
+    if(size)
+        memcpy(data, drv->ptr_get(offset), size);
+
+    return true;
+}
+
+const uint8_t* hal_flash_ptr_get(uint32_t offset)
+{
+    if(offset >= hal_flash_info.size)
+        return 0;
+
+    return drv->ptr_get(offset);
+}
+
+uint32_t hal_flash_erase_count_get(uint32_t page)
+{
+    if(drv->erase_count_get == 0 || page >= hal_flash_info.size / hal_flash_info.page_size)
+        return 0;
+
+    return drv->erase_count_get(page);
+}
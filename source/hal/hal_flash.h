@@ -0,0 +1,51 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Storage area of the internal flash, addressed by offsets from its beginning. Pages are the erase
+// unit; programming is done in aligned units of write_size bytes that must be erased before.
+
+typedef struct hal_flash_info_s
+{
+    uint32_t size;
+    uint32_t page_size;
+    uint32_t write_size;
+    uint8_t erased_value;
+} hal_flash_info_t;
+
+typedef struct hal_flash_driver_s
+{
+    void (*init)(void);
+    void (*deinit)(void);
+    void (*info_get)(hal_flash_info_t* info);
+    bool (*page_erase)(uint32_t page);
+    // offset and size already checked against the range and write_size alignment
+    bool (*program)(uint32_t offset, const uint8_t* data, uint32_t size);
+    // the storage area is memory mapped on every port, reads use this pointer
+    const uint8_t* (*ptr_get)(uint32_t offset);
+    // optional, simulated ports: erase cycles of a page since the image was created
+    uint32_t (*erase_count_get)(uint32_t page);
+} hal_flash_driver_t;
+
+void hal_flash_init(void);
+void hal_flash_deinit(void);
+void hal_flash_info_get(hal_flash_info_t* info);
+bool hal_flash_page_erase(uint32_t page);
+/** Program @p size bytes at @p offset, both multiple of write_size
+    @return false when out of range, misaligned or (simulated ports) not erased
+*/
+bool hal_flash_program(uint32_t offset, const uint8_t* data, uint32_t size);
+bool hal_flash_read(uint32_t offset, uint8_t* data, uint32_t size);
+/** Direct read access, valid up to the end of the storage area. Writing through it is an error
+    (bus fault on targets, segmentation fault on the host).
+    @return 0 when out of range
+*/
+const uint8_t* hal_flash_ptr_get(uint32_t offset);
+uint32_t hal_flash_erase_count_get(uint32_t page);
+
+#ifdef __cplusplus
+}
+#endif
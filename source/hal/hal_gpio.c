@@ -0,0 +1,41 @@
+#include "hal.h"
+
+static hal_gpio_driver_t* const drv = &HAL_GPIO_DRIVER;
+
+void hal_gpio_init(void)
+{
+    drv->init();
+}
+
+void hal_gpio_deinit(void)
+{
+    drv->deinit();
+}
+
+bool hal_gpio_config(hal_gpio_pin_t pin, hal_gpio_config_t* cfg)
+{
+    if(pin >= HAL_GPIO_NUM_PINS)
+        return false;
+
+    return drv->config(pin, cfg);
+}
+
+void hal_gpio_set(hal_gpio_pin_t pin, bool state)
+{
+    if(pin < HAL_GPIO_NUM_PINS)
+        drv->set(pin, state);
+}
+
+bool hal_gpio_get(hal_gpio_pin_t pin)
+{
+    if(pin >= HAL_GPIO_NUM_PINS)
+        return false;
+
+    return drv->get(pin);
+}
+
+void hal_gpio_toggle(hal_gpio_pin_t pin)
+{
+    if(pin < HAL_GPIO_NUM_PINS)
+        drv->toggle(pin);
+}
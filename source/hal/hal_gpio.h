@@ -0,0 +1,71 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef enum hal_gpio_pin_e
+{
+    HAL_GPIO_PIN_0 = 0,
+    HAL_GPIO_PIN_1,
+    HAL_GPIO_PIN_2,
+    HAL_GPIO_PIN_3,
+    HAL_GPIO_PIN_4,
+    HAL_GPIO_PIN_5,
+    HAL_GPIO_PIN_6,
+    HAL_GPIO_PIN_7,
+    HAL_GPIO_NUM_PINS,
+} hal_gpio_pin_t;
+
+typedef enum hal_gpio_dir_e
+{
+    HAL_GPIO_DIR_INPUT = 0,
+    HAL_GPIO_DIR_OUTPUT,
+} hal_gpio_dir_t;
+
+typedef enum hal_gpio_edge_e
+{
+    HAL_GPIO_EDGE_NONE = 0,
+    HAL_GPIO_EDGE_RISING,
+    HAL_GPIO_EDGE_FALLING,
+    HAL_GPIO_EDGE_BOTH,
+} hal_gpio_edge_t;
+
+/** Called in interrupt context when an input changes
+    @param state Pin level after the edge
+    @param timestamp When the edge happened, in hal_cpu_cycles_get() units. Edges of the same
+           direction merged before the call (see the port) give the time of the last one.
+*/
+typedef void (*hal_gpio_interrupt_t)(hal_gpio_pin_t pin, bool state, uint32_t timestamp);
+
+typedef struct hal_gpio_config_s
+{
+    hal_gpio_dir_t dir;
+    // outputs: initial level
+    bool state;
+    // inputs: edges that call interrupt_callback
+    hal_gpio_edge_t edge;
+    hal_gpio_interrupt_t interrupt_callback;
+} hal_gpio_config_t;
+
+typedef struct hal_gpio_driver_s
+{
+    void (*init)(void);
+    void (*deinit)(void);
+    bool (*config)(hal_gpio_pin_t pin, hal_gpio_config_t* cfg);
+    void (*set)(hal_gpio_pin_t pin, bool state);
+    bool (*get)(hal_gpio_pin_t pin);
+    void (*toggle)(hal_gpio_pin_t pin);
+} hal_gpio_driver_t;
+
+void hal_gpio_init(void);
+void hal_gpio_deinit(void);
+bool hal_gpio_config(hal_gpio_pin_t pin, hal_gpio_config_t* cfg);
+void hal_gpio_set(hal_gpio_pin_t pin, bool state);
+bool hal_gpio_get(hal_gpio_pin_t pin);
+void hal_gpio_toggle(hal_gpio_pin_t pin);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,59 @@
+#include "hal.h"
+
+static hal_i2c_driver_t* const drv = &HAL_I2C_DRIVER;
+
+static bool hal_i2c_xfers_check(hal_i2c_bus_t bus, hal_i2c_xfer_t* xfers, uint32_t count)
+{
+    if(bus >= HAL_I2C_NUM_BUSES || xfers == 0 || count == 0)
+        return false;
+
+    for(uint32_t n = 0; n < count; n++)
+    {
+        if(xfers[n].addr > 0x7F || (xfers[n].tx_size == 0 && xfers[n].rx_size == 0))
+            return false;
+    }
+
+    return true;
+}
+
+void hal_i2c_init(void)
+{
+    drv->init();
+}
+
+void hal_i2c_deinit(void)
+{
+    drv->deinit();
+}
+
+bool hal_i2c_config(hal_i2c_bus_t bus, hal_i2c_config_t* cfg)
+{
+    if(bus >= HAL_I2C_NUM_BUSES || cfg->clock_hz == 0)
+        return false;
+
+    return drv->config(bus, cfg);
+}
+
+bool hal_i2c_transfer(hal_i2c_bus_t bus, hal_i2c_xfer_t* xfers, uint32_t count)
+{
+    if(!hal_i2c_xfers_check(bus, xfers, count))
+        return false;
+
+    return drv->transfer(bus, xfers, count);
+}
+
+bool hal_i2c_transfer_async(hal_i2c_bus_t bus, hal_i2c_xfer_t* xfers, uint32_t count, hal_i2c_done_t done, void* ctx)
+{
+    if(!hal_i2c_xfers_check(bus, xfers, count) || done == 0)
+        return false;
+
+    return drv->transfer_async(bus, xfers, count, done, ctx);
+}
+
+bool hal_i2c_transfer_dma(hal_i2c_bus_t bus, hal_i2c_xfer_t* xfers, uint32_t count, hal_i2c_done_t done, void* ctx)
+{
+    if(!hal_i2c_xfers_check(bus, xfers, count) || done == 0)
+        return false;
+
+    return drv->transfer_dma(bus, xfers, count, done, ctx);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// I2C masters. A transfer writes tx_size bytes to a device then, after a repeated start, reads
+// rx_size bytes (either part may be empty): a register read is tx = register address and rx = data.
+// Transfers are given in batches, executed in order with a single completion for the whole batch.
+
+typedef enum hal_i2c_bus_e
+{
+    HAL_I2C_BUS_0 = 0,
+    HAL_I2C_BUS_1,
+    HAL_I2C_NUM_BUSES,
+} hal_i2c_bus_t;
+
+typedef struct hal_i2c_config_s
+{
+    // 100000 or 400000
+    uint32_t clock_hz;
+} hal_i2c_config_t;
+
+typedef struct hal_i2c_xfer_s
+{
+    // 7 bits address
+    uint8_t addr;
+    const uint8_t* tx;
+    uint32_t tx_size;
+    uint8_t* rx;
+    uint32_t rx_size;
+} hal_i2c_xfer_t;
+
+/** Called in interrupt context when a batch ends
+    @param ok false if a transfer failed (no acknowledge, bus error), the following ones were not done
+*/
+typedef void (*hal_i2c_done_t)(hal_i2c_bus_t bus, bool ok, void* ctx);
+
+typedef struct hal_i2c_driver_s
+{
+    void (*init)(void);
+    void (*deinit)(void);
+    bool (*config)(hal_i2c_bus_t bus, hal_i2c_config_t* cfg);
+    // arguments already checked
+    bool (*transfer)(hal_i2c_bus_t bus, hal_i2c_xfer_t* xfers, uint32_t count);
+    bool (*transfer_async)(hal_i2c_bus_t bus, hal_i2c_xfer_t* xfers, uint32_t count, hal_i2c_done_t done, void* ctx);
+    bool (*transfer_dma)(hal_i2c_bus_t bus, hal_i2c_xfer_t* xfers, uint32_t count, hal_i2c_done_t done, void* ctx);
+} hal_i2c_driver_t;
+
+void hal_i2c_init(void);
+void hal_i2c_deinit(void);
+bool hal_i2c_config(hal_i2c_bus_t bus, hal_i2c_config_t* cfg);
+/** Blocking transfers
+    @return false on error (no acknowledge included) or when the bus is busy with an asynchronous batch
+*/
+bool hal_i2c_transfer(hal_i2c_bus_t bus, hal_i2c_xfer_t* xfers, uint32_t count);
+/** Interrupt driven transfers, @p xfers and their buffers must stay valid until @p done is called
+    @return false when the bus is busy, @p done is not called
+*/
+bool hal_i2c_transfer_async(hal_i2c_bus_t bus, hal_i2c_xfer_t* xfers, uint32_t count, hal_i2c_done_t done, void* ctx);
+// DMA driven transfers, same rules as hal_i2c_transfer_async()
+bool hal_i2c_transfer_dma(hal_i2c_bus_t bus, hal_i2c_xfer_t* xfers, uint32_t count, hal_i2c_done_t done, void* ctx);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,59 @@
+#include "hal.h"
+
+static hal_spi_driver_t* const drv = &HAL_SPI_DRIVER;
+
+static bool hal_spi_xfers_check(hal_spi_bus_t bus, hal_spi_xfer_t* xfers, uint32_t count)
+{
+    if(bus >= HAL_SPI_NUM_BUSES || xfers == 0 || count == 0)
+        return false;
+
+    for(uint32_t n = 0; n < count; n++)
+    {
+        if(xfers[n].cs >= HAL_SPI_MAX_CS || xfers[n].size == 0)
+            return false;
+    }
+
+    return true;
+}
+
+void hal_spi_init(void)
+{
+    drv->init();
+}
+
+void hal_spi_deinit(void)
+{
+    drv->deinit();
+}
+
+bool hal_spi_config(hal_spi_bus_t bus, hal_spi_config_t* cfg)
+{
+    if(bus >= HAL_SPI_NUM_BUSES || cfg->clock_hz == 0 || cfg->mode > HAL_SPI_MODE_3)
+        return false;
+
+    return drv->config(bus, cfg);
+}
+
+bool hal_spi_transfer(hal_spi_bus_t bus, hal_spi_xfer_t* xfers, uint32_t count)
+{
+    if(!hal_spi_xfers_check(bus, xfers, count))
+        return false;
+
+    return drv->transfer(bus, xfers, count);
+}
+
+bool hal_spi_transfer_async(hal_spi_bus_t bus, hal_spi_xfer_t* xfers, uint32_t count, hal_spi_done_t done, void* ctx)
+{
+    if(!hal_spi_xfers_check(bus, xfers, count) || done == 0)
+        return false;
+
+    return drv->transfer_async(bus, xfers, count, done, ctx);
+}
+
+bool hal_spi_transfer_dma(hal_spi_bus_t bus, hal_spi_xfer_t* xfers, uint32_t count, hal_spi_done_t done, void* ctx)
+{
+    if(!hal_spi_xfers_check(bus, xfers, count) || done == 0)
+        return false;
+
+    return drv->transfer_dma(bus, xfers, count, done, ctx);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// SPI masters. A transfer is one chip select framed transaction, full duplex: @p tx and @p rx have
+// @p size bytes, tx = 0 sends 0xFF and rx = 0 drops the received bytes. Transfers are given in
+// batches, executed in order with a single completion for the whole batch.
+
+typedef enum hal_spi_bus_e
+{
+    HAL_SPI_BUS_0 = 0,
+    HAL_SPI_BUS_1,
+    HAL_SPI_NUM_BUSES,
+} hal_spi_bus_t;
+
+#define HAL_SPI_MAX_CS 4
+
+typedef enum hal_spi_mode_e
+{
+    // clock polarity and phase
+    HAL_SPI_MODE_0 = 0,
+    HAL_SPI_MODE_1,
+    HAL_SPI_MODE_2,
+    HAL_SPI_MODE_3,
+} hal_spi_mode_t;
+
+typedef struct hal_spi_config_s
+{
+    uint32_t clock_hz;
+    hal_spi_mode_t mode;
+} hal_spi_config_t;
+
+typedef struct hal_spi_xfer_s
+{
+    uint8_t cs;
+    const uint8_t* tx;
+    uint8_t* rx;
+    uint32_t size;
+} hal_spi_xfer_t;
+
+/** Called in interrupt context when a batch ends
+    @param ok false if a transfer failed, the following ones were not done
+*/
+typedef void (*hal_spi_done_t)(hal_spi_bus_t bus, bool ok, void* ctx);
+
+typedef struct hal_spi_driver_s
+{
+    void (*init)(void);
+    void (*deinit)(void);
+    bool (*config)(hal_spi_bus_t bus, hal_spi_config_t* cfg);
+    // arguments already checked
+    bool (*transfer)(hal_spi_bus_t bus, hal_spi_xfer_t* xfers, uint32_t count);
+    bool (*transfer_async)(hal_spi_bus_t bus, hal_spi_xfer_t* xfers, uint32_t count, hal_spi_done_t done, void* ctx);
+    bool (*transfer_dma)(hal_spi_bus_t bus, hal_spi_xfer_t* xfers, uint32_t count, hal_spi_done_t done, void* ctx);
+} hal_spi_driver_t;
+
+void hal_spi_init(void);
+void hal_spi_deinit(void);
+bool hal_spi_config(hal_spi_bus_t bus, hal_spi_config_t* cfg);
+/** Blocking transfers
+    @return false on error or when the bus is busy with an asynchronous batch
+*/
+bool hal_spi_transfer(hal_spi_bus_t bus, hal_spi_xfer_t* xfers, uint32_t count);
+/** Interrupt driven transfers (one interrupt per byte or FIFO level), @p xfers and their buffers
+    must stay valid until @p done is called
+    @return false when the bus is busy, @p done is not called
+*/
+bool hal_spi_transfer_async(hal_spi_bus_t bus, hal_spi_xfer_t* xfers, uint32_t count, hal_spi_done_t done, void* ctx);
+// DMA driven transfers, one interrupt per transfer, same rules as hal_spi_transfer_async()
+bool hal_spi_transfer_dma(hal_spi_bus_t bus, hal_spi_xfer_t* xfers, uint32_t count, hal_spi_done_t done, void* ctx);
+
+#ifdef __cplusplus
+}
+#endif
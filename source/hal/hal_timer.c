@@ -0,0 +1,62 @@
+#include "hal.h"
+
+static hal_timer_driver_t* const drv = &HAL_TIMER_DRIVER;
+
+void hal_timer_init(void)
+{
+    drv->init();
+}
+
+void hal_timer_deinit(void)
+{
+    drv->deinit();
+}
+
+bool hal_timer_config(hal_timer_id_t tmr, hal_timer_config_t* cfg)
+{
+    bool compare = false;
+
+    if(tmr >= HAL_TIMER_NUM_TIMERS || cfg->period_us == 0)
+        return false;
+
+    for(uint32_t channel = 0; channel < HAL_TIMER_NUM_CHANNELS; channel++)
+    {
+        if(cfg->compare_us[channel] >= cfg->period_us)
+            return false;
+
+        compare |= cfg->compare_us[channel] != 0;
+    }
+
+    if(compare && cfg->compare_callback == 0)
+        return false;
+
+    drv->stop(tmr);
+
+    return drv->config(tmr, cfg);
+}
+
+void hal_timer_start(hal_timer_id_t tmr)
+{
+    if(tmr < HAL_TIMER_NUM_TIMERS)
+        drv->start(tmr);
+}
+
+void hal_timer_stop(hal_timer_id_t tmr)
+{
+    if(tmr < HAL_TIMER_NUM_TIMERS)
+        drv->stop(tmr);
+}
+
+uint32_t hal_timer_count_get(hal_timer_id_t tmr)
+{
+    if(tmr >= HAL_TIMER_NUM_TIMERS)
+        return 0;
+
+    return drv->count_get(tmr);
+}
+
+void hal_timer_stats_get(hal_timer_id_t tmr, hal_timer_stats_t* stats)
+{
+    if(tmr < HAL_TIMER_NUM_TIMERS)
+        drv->stats_get(tmr, stats);
+}
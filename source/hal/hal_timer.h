@@ -0,0 +1,84 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Hardware timers counting in microseconds. Each timer has an update event at the end of its
+// period and compare channels firing at an offset inside the period; one-shot timers stop after
+// their first period.
+
+typedef enum hal_timer_id_e
+{
+    HAL_TIMER_0 = 0,
+    HAL_TIMER_1,
+    HAL_TIMER_2,
+    HAL_TIMER_3,
+    HAL_TIMER_NUM_TIMERS,
+} hal_timer_id_t;
+
+#define HAL_TIMER_NUM_CHANNELS 2
+
+typedef enum hal_timer_mode_e
+{
+    HAL_TIMER_MODE_ONE_SHOT = 0,
+    HAL_TIMER_MODE_PERIODIC,
+} hal_timer_mode_t;
+
+/** Called in interrupt context at the end of a period
+    @param timestamp When the event happened, in hal_cpu_cycles_get() units
+*/
+typedef void (*hal_timer_update_t)(hal_timer_id_t tmr, uint32_t timestamp);
+
+/** Called in interrupt context when a compare channel matches */
+typedef void (*hal_timer_compare_t)(hal_timer_id_t tmr, uint32_t channel, uint32_t timestamp);
+
+typedef struct hal_timer_config_s
+{
+    hal_timer_mode_t mode;
+    uint32_t period_us;
+    hal_timer_update_t update_callback;
+    // offsets from the start of the period, 0 disables the channel
+    uint32_t compare_us[HAL_TIMER_NUM_CHANNELS];
+    hal_timer_compare_t compare_callback;
+} hal_timer_config_t;
+
+typedef struct hal_timer_stats_s
+{
+    // callbacks called
+    uint32_t updates;
+    uint32_t compares[HAL_TIMER_NUM_CHANNELS];
+    // events that happened while the previous one was still pending, merged into its callback
+    uint32_t updates_merged;
+    uint32_t compares_merged[HAL_TIMER_NUM_CHANNELS];
+} hal_timer_stats_t;
+
+typedef struct hal_timer_driver_s
+{
+    void (*init)(void);
+    void (*deinit)(void);
+    // timer stopped, configuration already checked
+    bool (*config)(hal_timer_id_t tmr, hal_timer_config_t* cfg);
+    void (*start)(hal_timer_id_t tmr);
+    void (*stop)(hal_timer_id_t tmr);
+    uint32_t (*count_get)(hal_timer_id_t tmr);
+    void (*stats_get)(hal_timer_id_t tmr, hal_timer_stats_t* stats);
+} hal_timer_driver_t;
+
+void hal_timer_init(void);
+void hal_timer_deinit(void);
+/** Configure a timer, stopping it
+    @return false for a period of 0, compare offsets not inside the period or a missing callback
+*/
+bool hal_timer_config(hal_timer_id_t tmr, hal_timer_config_t* cfg);
+// (re)start counting from 0, the statistics are cleared
+void hal_timer_start(hal_timer_id_t tmr);
+void hal_timer_stop(hal_timer_id_t tmr);
+// microseconds since the start of the current period
+uint32_t hal_timer_count_get(hal_timer_id_t tmr);
+void hal_timer_stats_get(hal_timer_id_t tmr, hal_timer_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
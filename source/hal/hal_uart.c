@@ -1,24 +1,129 @@
 #include "hal.h"
 
-static hal_uart_driver_t* drv = &HAL_UART_DRIVER;
+#if HAL_UART_CAPTURE_ENABLED == 1
+#include <stdatomic.h>
+#include "utl_pcapng.h"
+#endif
+
+// largest frame assembled by hal_uart_frame_read() for ports without frame support
+#ifndef HAL_UART_FRAME_MAX_SIZE
+#define HAL_UART_FRAME_MAX_SIZE 256
+#endif
+
+typedef struct hal_uart_frame_fb_s
+{
+    utl_frame_t frame;
+    uint8_t buffer[HAL_UART_FRAME_MAX_SIZE];
+    uint8_t* dst;
+    size_t dst_size;
+    size_t dst_len;
+    bool done;
+} hal_uart_frame_fb_t;
+
+static hal_uart_driver_t* const drv = &HAL_UART_DRIVER;
+// opened devices, indexed by port
+static hal_uart_dev_t hal_uart_devs[HAL_UART_NUM_PORTS];
+static hal_uart_frame_fb_t hal_uart_frame_fb[HAL_UART_NUM_PORTS];
+static bool hal_uart_initialized = false;
+
+#if HAL_UART_CAPTURE_ENABLED == 1
+static utl_pcapng_t hal_uart_cap;
+static volatile uint32_t hal_uart_cap_mask = 0;
+// records come from port threads too, which do not take the critical section
+static atomic_flag hal_uart_cap_lock = ATOMIC_FLAG_INIT;
+
+static uint64_t hal_uart_capture_time_get(void)
+{
+    struct timespec ts;
+
+    timespec_get(&ts, TIME_UTC);
+
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+static void hal_uart_capture(uint32_t port, utl_pcapng_dir_t dir, const uint8_t* buffer, ssize_t size, uint64_t ts_ns)
+{
+    if(size <= 0 || port >= HAL_UART_NUM_PORTS || (hal_uart_cap_mask & (1UL << port)) == 0)
+        return;
+
+    while(atomic_flag_test_and_set_explicit(&hal_uart_cap_lock, memory_order_acquire))
+        ;
+
+    // checked again, the capture may have been stopped meanwhile
+    if(hal_uart_cap_mask & (1UL << port))
+        utl_pcapng_packet_write(&hal_uart_cap, port, ts_ns, dir, buffer, (uint32_t) size);
+
+    atomic_flag_clear_explicit(&hal_uart_cap_lock, memory_order_release);
+}
+
+static uint32_t hal_uart_port_get(hal_uart_dev_t dev)
+{
+    for(uint32_t port = HAL_UART_PORT0; port < HAL_UART_NUM_PORTS; port++)
+    {
+        if(hal_uart_devs[port] == dev)
+            return port;
+    }
+
+    return HAL_UART_NUM_PORTS;
+}
+#endif
+
+static void hal_uart_frame_fb_handler(void* ctx, uint8_t* frame, uint32_t size)
+{
+    hal_uart_frame_fb_t* fb = (hal_uart_frame_fb_t*) ctx;
+
+    fb->dst_len = size < fb->dst_size ? size : fb->dst_size;
+    memcpy(fb->dst, frame, fb->dst_len);
+    fb->done = true;
+}
 
 void hal_uart_init(void)
 {
+    // called by hal_init() or, with HAL_UART_LAZY_INIT, by the first hal_uart_open()
+    if(hal_uart_initialized)
+        return;
+
     drv->init();
+    hal_uart_initialized = true;
 }
 
 void hal_uart_deinit(void)
 {
-    drv->deinit();
+    hal_uart_capture_stop();
+
+    if(hal_uart_initialized)
+        drv->deinit();
+
+    hal_uart_initialized = false;
 }
 
 hal_uart_dev_t hal_uart_open(hal_uart_port_t dev, hal_uart_config_t* cfg)
 {
-    return drv->open(dev, cfg);
+    hal_uart_init();
+
+    hal_uart_dev_t pdev = drv->open(dev, cfg);
+
+    if(pdev && dev < HAL_UART_NUM_PORTS)
+    {
+        hal_uart_devs[dev] = pdev;
+
+        // frame callbacks need the driver, here frames are only assembled on hal_uart_frame_read()
+        if(drv->frame_read == 0)
+            utl_frame_init(&hal_uart_frame_fb[dev].frame, &cfg->frame, hal_uart_frame_fb[dev].buffer,
+                           HAL_UART_FRAME_MAX_SIZE, hal_uart_frame_fb_handler, &hal_uart_frame_fb[dev]);
+    }
+
+    return pdev;
 }
 
 void hal_uart_close(hal_uart_dev_t dev)
 {
+    for(uint32_t port = HAL_UART_PORT0; port < HAL_UART_NUM_PORTS; port++)
+    {
+        if(hal_uart_devs[port] == dev)
+            hal_uart_devs[port] = 0;
+    }
+
     drv->close(dev);
 }
 
@@ -34,7 +139,93 @@ ssize_t hal_uart_read(hal_uart_dev_t dev, uint8_t* buffer, size_t size)
 
 ssize_t hal_uart_write(hal_uart_dev_t dev, uint8_t* buffer, size_t size)
 {
-    return drv->write(dev, buffer, size);
+#if HAL_UART_CAPTURE_ENABLED == 1
+    // taken before the write: the peer of an in-process port receives the bytes inside it
+    uint64_t ts_ns = hal_uart_capture_time_get();
+#endif
+
+    ssize_t ret = drv->write(dev, buffer, size);
+
+#if HAL_UART_CAPTURE_ENABLED == 1
+    hal_uart_capture(hal_uart_port_get(dev), UTL_PCAPNG_DIR_OUTBOUND, buffer, ret, ts_ns);
+#endif
+
+    return ret;
+}
+
+ssize_t hal_uart_writev(hal_uart_dev_t dev, const hal_uart_iov_t* iov, size_t cnt)
+{
+    ssize_t ret = 0;
+
+#if HAL_UART_CAPTURE_ENABLED == 1
+    uint64_t ts_ns = hal_uart_capture_time_get();
+#endif
+
+    if(drv->writev)
+    {
+        ret = drv->writev(dev, iov, cnt);
+    }
+    else
+    {
+        // stop at the first piece not fully written, as the line would leave a gap otherwise
+        for(size_t n = 0; n < cnt; n++)
+        {
+            ssize_t written = drv->write(dev, (uint8_t*) iov[n].data, iov[n].size);
+            if(written > 0)
+                ret += written;
+
+            if(written < (ssize_t) iov[n].size)
+                break;
+        }
+    }
+
+#if HAL_UART_CAPTURE_ENABLED == 1
+    ssize_t left = ret;
+    for(size_t n = 0; n < cnt && left > 0; n++)
+    {
+        ssize_t size = (ssize_t) iov[n].size < left ? (ssize_t) iov[n].size : left;
+        hal_uart_capture(hal_uart_port_get(dev), UTL_PCAPNG_DIR_OUTBOUND, iov[n].data, size, ts_ns);
+        left -= size;
+    }
+#endif
+
+    return ret;
+}
+
+ssize_t hal_uart_read_timeout(hal_uart_dev_t dev, uint8_t* buffer, size_t min, size_t max, uint32_t timeout_ms)
+{
+    ssize_t ret;
+
+    if(min > max)
+        min = max;
+
+    if(drv->read_timeout)
+    {
+        ret = drv->read_timeout(dev, buffer, min, max, timeout_ms);
+    }
+    else
+    {
+        // port can not block: poll it with 1 ms granularity
+        size_t pos = 0;
+        uint32_t elapsed_ms = 0;
+
+        while(true)
+        {
+            ssize_t n = drv->read(dev, buffer + pos, max - pos);
+            if(n > 0)
+                pos += (size_t) n;
+
+            if(pos >= min || elapsed_ms >= timeout_ms)
+                break;
+
+            hal_cpu_sleep_ms(1);
+            elapsed_ms++;
+        }
+
+        ret = (ssize_t) pos;
+    }
+
+    return ret;
 }
 
 void hal_uart_flush(hal_uart_dev_t dev)
@@ -42,12 +233,116 @@ void hal_uart_flush(hal_uart_dev_t dev)
     drv->flush(dev);
 }
 
+ssize_t hal_uart_frame_read(hal_uart_dev_t dev, uint8_t* buffer, size_t size)
+{
+    ssize_t ret = 0;
+
+    if(drv->frame_read)
+    {
+        ret = drv->frame_read(dev, buffer, size);
+    }
+    else
+    {
+        for(uint32_t port = HAL_UART_PORT0; port < HAL_UART_NUM_PORTS; port++)
+        {
+            hal_uart_frame_fb_t* fb = &hal_uart_frame_fb[port];
+            uint8_t c;
+
+            if(hal_uart_devs[port] != dev || fb->frame.cfg.mode == UTL_FRAME_MODE_NONE)
+                continue;
+
+            fb->dst = buffer;
+            fb->dst_size = size;
+            fb->done = false;
+
+            // byte by byte, so bytes after the frame stay in the driver for the next call
+            while(!fb->done && drv->read(dev, &c, 1) == 1)
+                utl_frame_feed(&fb->frame, &c, 1);
+
+            ret = fb->done ? (ssize_t) fb->dst_len : 0;
+            break;
+        }
+    }
+
+    return ret;
+}
+
 ssize_t hal_uart_byte_read(hal_uart_dev_t dev, uint8_t* c)
 {
-    return drv->read(dev, c, 1);
+    return hal_uart_read(dev, c, 1);
 }
 
 ssize_t hal_uart_byte_write(hal_uart_dev_t dev, uint8_t c)
 {
-    return drv->write(dev, &c, 1);
+    return hal_uart_write(dev, &c, 1);
+}
+
+const char* hal_uart_peer_name_get(hal_uart_dev_t dev)
+{
+    if(drv->peer_name_get)
+        return drv->peer_name_get(dev);
+
+    return 0;
+}
+
+bool hal_uart_stats_get(hal_uart_dev_t dev, hal_uart_stats_t* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    if(drv->stats_get == 0)
+        return false;
+
+    drv->stats_get(dev, stats);
+
+    return true;
+}
+
+bool hal_uart_capture_start(const char* file_name, uint32_t port_mask)
+{
+#if HAL_UART_CAPTURE_ENABLED == 1
+    char name[16];
+
+    hal_uart_capture_stop();
+
+    if(!utl_pcapng_create(&hal_uart_cap, file_name))
+        return false;
+
+    // one interface per port, so the interface ID is the port number
+    for(uint32_t port = HAL_UART_PORT0; port < HAL_UART_NUM_PORTS; port++)
+    {
+        snprintf(name, sizeof(name), "uart%u", (unsigned int) port);
+        if(!utl_pcapng_iface_add(&hal_uart_cap, UTL_PCAPNG_LINKTYPE_USER0, name))
+        {
+            utl_pcapng_close(&hal_uart_cap);
+            return false;
+        }
+    }
+
+    hal_uart_cap_mask = port_mask;
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+void hal_uart_capture_stop(void)
+{
+#if HAL_UART_CAPTURE_ENABLED == 1
+    while(atomic_flag_test_and_set_explicit(&hal_uart_cap_lock, memory_order_acquire))
+        ;
+
+    hal_uart_cap_mask = 0;
+    utl_pcapng_close(&hal_uart_cap);
+
+    atomic_flag_clear_explicit(&hal_uart_cap_lock, memory_order_release);
+#endif
+}
+
+void hal_uart_capture_rx(hal_uart_port_t port, const uint8_t* data, size_t size)
+{
+#if HAL_UART_CAPTURE_ENABLED == 1
+    if(hal_uart_cap_mask & (1UL << port))
+        hal_uart_capture(port, UTL_PCAPNG_DIR_INBOUND, data, (ssize_t) size, hal_uart_capture_time_get());
+#endif
 }
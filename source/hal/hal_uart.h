@@ -43,6 +43,8 @@ typedef enum hal_uart_flow_control_e
 typedef struct hal_uart_dev_s* hal_uart_dev_t;
 
 typedef void (*hal_uart_interrupt_t)(uint8_t c);
+typedef void (*hal_uart_frame_callback_t)(uint8_t* frame, size_t size);
+typedef void (*hal_uart_data_ready_callback_t)(hal_uart_dev_t dev);
 
 typedef struct hal_uart_config_s
 {
@@ -51,8 +53,47 @@ typedef struct hal_uart_config_s
     hal_uart_stop_bits_t stop_bits;
     hal_uart_flow_control_t flow_control;
     hal_uart_interrupt_t interrupt_callback;
+    // frame mode (frame.mode != UTL_FRAME_MODE_NONE): the driver splits received bytes into frames,
+    // delivered to frame_callback (interrupt context) or queued for hal_uart_frame_read()
+    utl_frame_cfg_t frame;
+    hal_uart_frame_callback_t frame_callback;
+    // optional, called in interrupt context after received data were stored (or passed to the
+    // callbacks above), e.g. to flag the port as ready. Reception also ends hal_cpu_low_power_enter(),
+    // so the main context can sleep until data arrive instead of polling. Shared memory ports in
+    // polling mode only watch for data (and wake the CPU up) when this callback is set.
+    hal_uart_data_ready_callback_t data_ready_callback;
+    // optional buffer memory (4 bytes aligned), port defaults are used when NULL. It must stay valid
+    // while the port is opened. rx_buffer holds the bytes (or frames) not read yet; tx_buffer queues
+    // what the line can not take at once, so hal_uart_write() does not wait for the transmitter.
+    // Ports without such a buffer (e.g. shared memory rings) ignore them.
+    uint8_t* rx_buffer;
+    uint32_t rx_buffer_size;
+    uint8_t* tx_buffer;
+    uint32_t tx_buffer_size;
 } hal_uart_config_t;
 
+// one piece of a gathered write (header, payload, trailer, ...)
+typedef struct hal_uart_iov_s
+{
+    const uint8_t* data;
+    size_t size;
+} hal_uart_iov_t;
+
+typedef struct hal_uart_stats_s
+{
+    uint32_t rx_bytes;
+    uint32_t tx_bytes;
+    // bytes lost because the receive buffer (or the hardware) was full
+    uint32_t rx_overflows;
+    uint32_t framing_errors;
+    uint32_t parity_errors;
+    // writes repeated after an error, writes accepted only in part
+    uint32_t tx_retries;
+    uint32_t tx_partial_writes;
+    // highest number of bytes waiting to be read in the receive buffer
+    uint32_t rx_peak_occupancy;
+} hal_uart_stats_t;
+
 typedef struct hal_uart_driver_s
 {
     void (*init)(void);
@@ -63,6 +104,16 @@ typedef struct hal_uart_driver_s
     ssize_t (*read)(hal_uart_dev_t dev, uint8_t* buffer, size_t size);
     ssize_t (*write)(hal_uart_dev_t dev, uint8_t* buffer, size_t size);
     void (*flush)(hal_uart_dev_t dev);
+    // optional, blocks until min bytes are received (hal_uart.c polls when not provided)
+    ssize_t (*read_timeout)(hal_uart_dev_t dev, uint8_t* buffer, size_t min, size_t max, uint32_t timeout_ms);
+    // optional, next received frame in frame mode (hal_uart.c assembles frames when not provided)
+    ssize_t (*frame_read)(hal_uart_dev_t dev, uint8_t* buffer, size_t size);
+    // optional, counters since the port was opened
+    void (*stats_get)(hal_uart_dev_t dev, hal_uart_stats_t* stats);
+    // optional, simulated ports only: path used by external tools to reach this port
+    const char* (*peer_name_get)(hal_uart_dev_t dev);
+    // optional, pieces sent in one operation (hal_uart.c writes them one by one when not provided)
+    ssize_t (*writev)(hal_uart_dev_t dev, const hal_uart_iov_t* iov, size_t cnt);
 } hal_uart_driver_t;
 
 void hal_uart_init(void);
@@ -72,9 +123,24 @@ void hal_uart_close(hal_uart_dev_t dev);
 size_t hal_uart_bytes_available(hal_uart_dev_t dev);
 ssize_t hal_uart_read(hal_uart_dev_t dev, uint8_t* buffer, size_t size);
 ssize_t hal_uart_write(hal_uart_dev_t dev, uint8_t* buffer, size_t size);
+// gathered write of cnt pieces, without copying them to a single buffer; returns the bytes written
+ssize_t hal_uart_writev(hal_uart_dev_t dev, const hal_uart_iov_t* iov, size_t cnt);
+// wait until at least min bytes are read (up to max) or timeout_ms expires, returns the bytes read
+ssize_t hal_uart_read_timeout(hal_uart_dev_t dev, uint8_t* buffer, size_t min, size_t max, uint32_t timeout_ms);
 void hal_uart_flush(hal_uart_dev_t dev);
+// frame mode: copy the next complete frame (truncated to size), returns its size or 0 if none
+ssize_t hal_uart_frame_read(hal_uart_dev_t dev, uint8_t* buffer, size_t size);
 ssize_t hal_uart_byte_read(hal_uart_dev_t dev, uint8_t* c);
 ssize_t hal_uart_byte_write(hal_uart_dev_t dev, uint8_t c);
+const char* hal_uart_peer_name_get(hal_uart_dev_t dev);
+// false (and all counters zeroed) when the port does not keep statistics
+bool hal_uart_stats_get(hal_uart_dev_t dev, hal_uart_stats_t* stats);
+// record RX/TX chunks of the ports in port_mask (bit n = HAL_UART_PORTn) into a pcapng file
+bool hal_uart_capture_start(const char* file_name, uint32_t port_mask);
+void hal_uart_capture_stop(void);
+// for ports: bytes received by @p port, called where they arrive (reactor, RX thread, peer write) so
+// the capture keeps their timing, callback modes included
+void hal_uart_capture_rx(hal_uart_port_t port, const uint8_t* data, size_t size);
 
 #ifdef __cplusplus
 }
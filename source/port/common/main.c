@@ -14,17 +14,28 @@ int main(int argc, char *argv[])
     strcpy(app_name, argv[0]);
 
     hal_init();
+    hal_init_stage_begin("app");
     app_init();
+    hal_init_stage_end();
+    hal_init_report();
     
     while(app_terminate_get() == false)
     {
         // protect against from any other running threads and 
         // simulates a better behavior of code running from main (non interrupt context)
+        hal_cpu_loop_begin();
         uint32_t state = hal_cpu_critical_section_enter(HAL_CPU_CS_USER_LEVEL);
         app_loop();
         hal_cpu_critical_section_leave(state);
+        hal_cpu_loop_end();
     }
 
+#if HAL_CPU_CS_PROFILE == 1
+    // the profile was asked for at build time, print it even if the app silenced the port module
+    utl_dbg_mod_enable(UTL_DBG_MOD_PORT);
+    hal_cpu_cs_profile_report();
+#endif
+
     app_deinit();
     hal_deinit();
 
@@ -0,0 +1,344 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <time.h>
+
+#include "hal.h"
+#include "utl_dbg.h"
+#include "utl_ring.h"
+
+// In-process UART pair: HAL_UART_PORT0 and HAL_UART_PORT1 are cross connected, so everything
+// written on one port is received by the other one. No thread, file or external process is used.
+
+#ifndef PORT_UART_LOOPBACK_BUFFER_SIZE
+#define PORT_UART_LOOPBACK_BUFFER_SIZE 4096
+#endif
+
+// frame mode: largest frame
+#ifndef PORT_UART_LOOPBACK_FRAME_MAX_SIZE
+#define PORT_UART_LOOPBACK_FRAME_MAX_SIZE 1024
+#endif
+
+// 1: writes take the time the configured baud rate would need (10 bits per byte)
+#ifndef PORT_UART_LOOPBACK_PACING
+#define PORT_UART_LOOPBACK_PACING 0
+#endif
+
+struct hal_uart_dev_s
+{
+    utl_ring_t* rx;
+    hal_uart_config_t cfg;
+    // hal_uart_read_timeout() sleeps here until the peer writes
+    pthread_mutex_t rx_lock;
+    pthread_cond_t rx_cond;
+    atomic_bool rx_waiting;
+    hal_uart_stats_t stats;
+    // frame mode: frames are queued in rx instead of bytes
+    utl_frame_t frame;
+    uint8_t frame_buffer[PORT_UART_LOOPBACK_FRAME_MAX_SIZE];
+    bool in_use;
+    hal_uart_port_t dev;
+    hal_uart_port_t peer;
+};
+
+static _Alignas(uint32_t) uint8_t port_uart_area[HAL_UART_NUM_PORTS][UTL_RING_AREA_SIZE(PORT_UART_LOOPBACK_BUFFER_SIZE)];
+
+static struct hal_uart_dev_s port_uart_ctrl[] = {
+    {.dev = HAL_UART_PORT0, .peer = HAL_UART_PORT1},
+    {.dev = HAL_UART_PORT1, .peer = HAL_UART_PORT0},
+};
+
+#if PORT_UART_LOOPBACK_PACING == 1
+static uint32_t port_uart_baud_rate_translate(hal_uart_baud_rate_t baud_rate)
+{
+    switch(baud_rate)
+    {
+    case HAL_UART_BAUD_RATE_9600:
+        return 9600;
+    case HAL_UART_BAUD_RATE_19200:
+        return 19200;
+    case HAL_UART_BAUD_RATE_38400:
+        return 38400;
+    case HAL_UART_BAUD_RATE_57600:
+        return 57600;
+    case HAL_UART_BAUD_RATE_115200:
+        return 115200;
+    default:
+        return 9600;
+    }
+}
+
+static void port_uart_pacing(hal_uart_dev_t pdev, size_t size)
+{
+    // start bit + 8 data bits + stop bit
+    uint64_t ns = (uint64_t) size * 10 * 1000000000ULL / port_uart_baud_rate_translate(pdev->cfg.baud_rate);
+    struct timespec ts = {.tv_sec = ns / 1000000000ULL, .tv_nsec = ns % 1000000000ULL};
+
+    nanosleep(&ts, NULL);
+}
+#endif
+
+static void port_uart_rx_notify(hal_uart_dev_t pdev)
+{
+    if(pdev->cfg.data_ready_callback)
+        pdev->cfg.data_ready_callback(pdev);
+
+    hal_cpu_wakeup();
+
+    // bytes must be visible before the flag is checked, the reader does the opposite
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if(atomic_load(&pdev->rx_waiting))
+    {
+        pthread_mutex_lock(&pdev->rx_lock);
+        pthread_cond_signal(&pdev->rx_cond);
+        pthread_mutex_unlock(&pdev->rx_lock);
+    }
+}
+
+static void port_uart_frame_handler(void* ctx, uint8_t* frame, uint32_t size)
+{
+    hal_uart_dev_t pdev = (hal_uart_dev_t) ctx;
+
+    if(pdev->cfg.frame_callback)
+        pdev->cfg.frame_callback(frame, size);
+    else if(!utl_frame_queue_put(pdev->rx, frame, size))
+        pdev->stats.rx_overflows += size;
+}
+
+static void port_uart_init(void)
+{
+    pthread_condattr_t cond_attr;
+
+    pthread_condattr_init(&cond_attr);
+#if !defined(__APPLE__)
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+#endif
+
+    for(size_t dev = HAL_UART_PORT0; dev < HAL_UART_NUM_PORTS; dev++)
+    {
+        port_uart_ctrl[dev].rx = utl_ring_init(port_uart_area[dev], sizeof(port_uart_area[dev]));
+        pthread_mutex_init(&port_uart_ctrl[dev].rx_lock, NULL);
+        pthread_cond_init(&port_uart_ctrl[dev].rx_cond, &cond_attr);
+        atomic_store(&port_uart_ctrl[dev].rx_waiting, false);
+        port_uart_ctrl[dev].in_use = false;
+    }
+
+    pthread_condattr_destroy(&cond_attr);
+}
+
+static void port_uart_deinit(void)
+{
+    for(size_t dev = HAL_UART_PORT0; dev < HAL_UART_NUM_PORTS; dev++)
+    {
+        port_uart_ctrl[dev].in_use = false;
+        pthread_cond_destroy(&port_uart_ctrl[dev].rx_cond);
+        pthread_mutex_destroy(&port_uart_ctrl[dev].rx_lock);
+    }
+}
+
+static hal_uart_dev_t port_uart_open(hal_uart_port_t dev, hal_uart_config_t* cfg)
+{
+    hal_uart_dev_t pdev = 0;
+
+    if(dev >= HAL_UART_NUM_PORTS)
+    {
+        UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Invalid UART port %d\n", dev);
+        return 0;
+    }
+
+    if(port_uart_ctrl[dev].in_use)
+    {
+        UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "UART port %d in use\n", dev);
+        return 0;
+    }
+
+    pdev = &(port_uart_ctrl[dev]);
+    pdev->cfg = *cfg;
+    pdev->rx = cfg->rx_buffer ? utl_ring_init(cfg->rx_buffer, cfg->rx_buffer_size) : 0;
+    if(pdev->rx == 0)
+        pdev->rx = utl_ring_init(port_uart_area[dev], sizeof(port_uart_area[dev]));
+    memset(&pdev->stats, 0, sizeof(pdev->stats));
+    utl_frame_init(&pdev->frame, &cfg->frame, pdev->frame_buffer, sizeof(pdev->frame_buffer), port_uart_frame_handler,
+                   pdev);
+    pdev->in_use = true;
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Loopback port %d opened (peer %d)\n", pdev->dev, pdev->peer);
+
+    return pdev;
+}
+
+static void port_uart_close(hal_uart_dev_t pdev)
+{
+    pdev->in_use = false;
+}
+
+static size_t port_uart_bytes_available(hal_uart_dev_t pdev)
+{
+    if(pdev->cfg.interrupt_callback || pdev->cfg.frame.mode != UTL_FRAME_MODE_NONE)
+        return 0;
+
+    return utl_ring_bytes_available(pdev->rx);
+}
+
+static ssize_t port_uart_read(hal_uart_dev_t pdev, uint8_t* buffer, size_t size)
+{
+    // data are not stored on buffers when using interrupt, frame mode queues whole frames
+    if(pdev->cfg.interrupt_callback || pdev->cfg.frame.mode != UTL_FRAME_MODE_NONE)
+        return 0;
+
+    return (ssize_t) utl_ring_read(pdev->rx, buffer, (uint32_t) size);
+}
+
+static ssize_t port_uart_read_timeout(hal_uart_dev_t pdev, uint8_t* buffer, size_t min, size_t max,
+                                      uint32_t timeout_ms)
+{
+    struct timespec deadline;
+    size_t pos = 0;
+
+    if(pdev->cfg.interrupt_callback || pdev->cfg.frame.mode != UTL_FRAME_MODE_NONE)
+        return 0;
+
+    // macOS has no monotonic clock for condition variables
+#if defined(__APPLE__)
+    clock_gettime(CLOCK_REALTIME, &deadline);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+#endif
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long) (timeout_ms % 1000) * 1000000L;
+    if(deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pos += utl_ring_read(pdev->rx, buffer, (uint32_t) max);
+
+    if(pos < min)
+    {
+        pthread_mutex_lock(&pdev->rx_lock);
+        atomic_store(&pdev->rx_waiting, true);
+
+        while(pos < min && pdev->in_use)
+        {
+            // check again after announcing the wait, so no notification is lost
+            pos += utl_ring_read(pdev->rx, buffer + pos, (uint32_t) (max - pos));
+            if(pos >= min)
+                break;
+
+            if(pthread_cond_timedwait(&pdev->rx_cond, &pdev->rx_lock, &deadline) == ETIMEDOUT)
+            {
+                pos += utl_ring_read(pdev->rx, buffer + pos, (uint32_t) (max - pos));
+                break;
+            }
+        }
+
+        atomic_store(&pdev->rx_waiting, false);
+        pthread_mutex_unlock(&pdev->rx_lock);
+    }
+
+    return (ssize_t) pos;
+}
+
+static ssize_t port_uart_write(hal_uart_dev_t pdev, uint8_t* buffer, size_t size)
+{
+    hal_uart_dev_t peer = &port_uart_ctrl[pdev->peer];
+    size_t written = size;
+
+    if(!pdev->in_use)
+        return 0;
+
+    if(peer->in_use)
+    {
+        // on the wire even if the receiver overruns, held back by flow control
+        size_t received = size;
+
+        if(peer->cfg.frame.mode != UTL_FRAME_MODE_NONE)
+        {
+            // frames are assembled as bytes arrive, in the writer context
+            utl_frame_feed(&peer->frame, buffer, (uint32_t) size);
+            port_uart_rx_notify(peer);
+            peer->stats.rx_bytes += (uint32_t) size;
+        }
+        else if(peer->cfg.interrupt_callback)
+        {
+            // bytes are delivered in the writer context, as soon as they are "received"
+            for(size_t pos = 0; pos < size; pos++)
+                peer->cfg.interrupt_callback(buffer[pos]);
+
+            port_uart_rx_notify(peer);
+            peer->stats.rx_bytes += (uint32_t) size;
+        }
+        else
+        {
+            uint32_t n = utl_ring_write(peer->rx, buffer, (uint32_t) size);
+            port_uart_rx_notify(peer);
+
+            peer->stats.rx_bytes += n;
+            uint32_t occupancy = utl_ring_bytes_available(peer->rx);
+            if(occupancy > peer->stats.rx_peak_occupancy)
+                peer->stats.rx_peak_occupancy = occupancy;
+
+            // with flow control the writer is held back when the receiver is full,
+            // otherwise exceeding bytes are lost as in a real receiver overrun
+            if(pdev->cfg.flow_control == HAL_UART_FLOW_CONTROL_CTS_RTS)
+            {
+                written = n;
+                received = n;
+                if(n < size)
+                    pdev->stats.tx_partial_writes++;
+            }
+            else
+            {
+                peer->stats.rx_overflows += (uint32_t) size - n;
+            }
+        }
+
+        hal_uart_capture_rx(peer->dev, buffer, received);
+    }
+    // else: nobody listening, bytes are sent to the void
+
+    pdev->stats.tx_bytes += (uint32_t) written;
+
+#if PORT_UART_LOOPBACK_PACING == 1
+    port_uart_pacing(pdev, written);
+#endif
+
+    return (ssize_t) written;
+}
+
+static void port_uart_flush(hal_uart_dev_t pdev)
+{
+    if(pdev->cfg.interrupt_callback)
+        return;
+
+    utl_ring_flush(pdev->rx);
+}
+
+static ssize_t port_uart_frame_read(hal_uart_dev_t pdev, uint8_t* buffer, size_t size)
+{
+    if(pdev->cfg.frame.mode == UTL_FRAME_MODE_NONE || pdev->cfg.frame_callback)
+        return 0;
+
+    return (ssize_t) utl_frame_queue_get(pdev->rx, buffer, (uint32_t) size);
+}
+
+static void port_uart_stats_get(hal_uart_dev_t pdev, hal_uart_stats_t* stats)
+{
+    *stats = pdev->stats;
+}
+
+hal_uart_driver_t HAL_UART_DRIVER = {
+    .init = port_uart_init,
+    .deinit = port_uart_deinit,
+    .open = port_uart_open,
+    .close = port_uart_close,
+    .bytes_available = port_uart_bytes_available,
+    .read = port_uart_read,
+    .write = port_uart_write,
+    .flush = port_uart_flush,
+    .read_timeout = port_uart_read_timeout,
+    .frame_read = port_uart_frame_read,
+    .stats_get = port_uart_stats_get,
+};
@@ -0,0 +1,243 @@
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hal.h"
+#include "utl_dbg.h"
+#include "utl_ring.h"
+#include "utl_pcapng.h"
+
+// Replays a capture made with hal_uart_capture_start(): bytes received by port N in the capture
+// (interface N, inbound packets) are received again by port N. Bytes written are discarded.
+//
+// PORT_UART_REPLAY_FILE: capture file name (default uart.pcapng)
+// PORT_UART_REPLAY_MAX_SPEED: if set, packets are delivered as fast as the application reads them,
+//                             otherwise the original timing is reproduced
+
+#ifndef PORT_UART_REPLAY_BUFFER_SIZE
+#define PORT_UART_REPLAY_BUFFER_SIZE (64 * 1024)
+#endif
+
+#define PORT_UART_REPLAY_DEFAULT_FILE "uart.pcapng"
+#define PORT_UART_REPLAY_MAX_PACKET 4096
+
+static void port_uart_close(hal_uart_dev_t pdev);
+
+struct hal_uart_dev_s
+{
+    utl_ring_t* rx;
+    hal_uart_config_t cfg;
+    pthread_t thread;
+    bool max_speed;
+    volatile bool in_use;
+    hal_uart_port_t dev;
+};
+
+static _Alignas(uint32_t) uint8_t port_uart_area[HAL_UART_NUM_PORTS][UTL_RING_AREA_SIZE(PORT_UART_REPLAY_BUFFER_SIZE)];
+
+static struct hal_uart_dev_s port_uart_ctrl[] = {
+    {.dev = HAL_UART_PORT0},
+    {.dev = HAL_UART_PORT1},
+};
+
+static uint64_t port_uart_time_get_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void port_uart_sleep_until(uint64_t ns)
+{
+    uint64_t now = port_uart_time_get_ns();
+
+    if(ns > now)
+    {
+        struct timespec ts = {.tv_sec = (ns - now) / 1000000000ULL, .tv_nsec = (ns - now) % 1000000000ULL};
+        nanosleep(&ts, NULL);
+    }
+}
+
+static void port_uart_deliver(hal_uart_dev_t pdev, uint8_t* data, uint32_t size)
+{
+    uint32_t pos = 0;
+
+    hal_uart_capture_rx(pdev->dev, data, size);
+
+    if(pdev->cfg.interrupt_callback)
+    {
+        for(pos = 0; pos < size; pos++)
+            pdev->cfg.interrupt_callback(data[pos]);
+    }
+
+    while(!pdev->cfg.interrupt_callback && pos < size && pdev->in_use)
+    {
+        pos += utl_ring_write(pdev->rx, data + pos, size - pos);
+
+        // with original timing a slow reader loses data, as with a real receiver
+        if(!pdev->max_speed)
+            break;
+
+        if(pos < size)
+        {
+            hal_cpu_wakeup();
+            usleep(100);
+        }
+    }
+
+    if(pdev->cfg.data_ready_callback)
+        pdev->cfg.data_ready_callback(pdev);
+
+    hal_cpu_wakeup();
+}
+
+static void* port_uart_replay_thread(void* thread_param)
+{
+    static uint8_t data[HAL_UART_NUM_PORTS][PORT_UART_REPLAY_MAX_PACKET];
+    struct hal_uart_dev_s* pdev = (struct hal_uart_dev_s*) thread_param;
+    const char* file_name = getenv("PORT_UART_REPLAY_FILE");
+    utl_pcapng_packet_t pkt;
+    utl_pcapng_t pc;
+    uint64_t first_ts = 0, start_ns = 0;
+    uint32_t packets = 0;
+
+    if(file_name == 0)
+        file_name = PORT_UART_REPLAY_DEFAULT_FILE;
+
+    if(!utl_pcapng_open(&pc, file_name))
+    {
+        UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Can not open capture %s\n", file_name);
+        return 0;
+    }
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Replaying %s on port %d\n", file_name, pdev->dev);
+
+    while(pdev->in_use && utl_pcapng_packet_read(&pc, &pkt, data[pdev->dev], PORT_UART_REPLAY_MAX_PACKET))
+    {
+        if(pkt.iface != pdev->dev || pkt.dir == UTL_PCAPNG_DIR_OUTBOUND)
+            continue;
+
+        if(packets++ == 0)
+        {
+            first_ts = pkt.ts_ns;
+            start_ns = port_uart_time_get_ns();
+        }
+
+        if(!pdev->max_speed)
+            port_uart_sleep_until(start_ns + (pkt.ts_ns - first_ts));
+
+        port_uart_deliver(pdev, data[pdev->dev], pkt.size);
+    }
+
+    utl_pcapng_close(&pc);
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Replay finished on port %d (%u packets)\n", pdev->dev, packets);
+
+    return 0;
+}
+
+static void port_uart_init(void)
+{
+    for(size_t dev = HAL_UART_PORT0; dev < HAL_UART_NUM_PORTS; dev++)
+    {
+        port_uart_ctrl[dev].rx = utl_ring_init(port_uart_area[dev], sizeof(port_uart_area[dev]));
+        port_uart_ctrl[dev].in_use = false;
+    }
+}
+
+static void port_uart_deinit(void)
+{
+    for(size_t dev = HAL_UART_PORT0; dev < HAL_UART_NUM_PORTS; dev++)
+    {
+        if(port_uart_ctrl[dev].in_use)
+        {
+            port_uart_close(&(port_uart_ctrl[dev]));
+        }
+    }
+}
+
+static hal_uart_dev_t port_uart_open(hal_uart_port_t dev, hal_uart_config_t* cfg)
+{
+    hal_uart_dev_t pdev = 0;
+
+    if(dev >= HAL_UART_NUM_PORTS)
+    {
+        UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Invalid UART port %d\n", dev);
+        return 0;
+    }
+
+    if(port_uart_ctrl[dev].in_use)
+    {
+        UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "UART port %d in use\n", dev);
+        return 0;
+    }
+
+    pdev = &(port_uart_ctrl[dev]);
+    pdev->cfg = *cfg;
+    pdev->max_speed = getenv("PORT_UART_REPLAY_MAX_SPEED") != 0;
+    pdev->rx = cfg->rx_buffer ? utl_ring_init(cfg->rx_buffer, cfg->rx_buffer_size) : 0;
+    if(pdev->rx == 0)
+        pdev->rx = utl_ring_init(port_uart_area[dev], sizeof(port_uart_area[dev]));
+    pdev->in_use = true;
+
+    int err = pthread_create(&pdev->thread, NULL, &port_uart_replay_thread, (void*) pdev);
+    if(err != 0)
+    {
+        UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Cant create replay thread for port %d\n", pdev->dev);
+        pdev->in_use = false;
+        return 0;
+    }
+
+    return pdev;
+}
+
+static void port_uart_close(hal_uart_dev_t pdev)
+{
+    if(pdev->in_use)
+    {
+        pdev->in_use = false;
+        pthread_join(pdev->thread, NULL);
+    }
+}
+
+static size_t port_uart_bytes_available(hal_uart_dev_t pdev)
+{
+    if(pdev->cfg.interrupt_callback)
+        return 0;
+
+    return utl_ring_bytes_available(pdev->rx);
+}
+
+static ssize_t port_uart_read(hal_uart_dev_t pdev, uint8_t* buffer, size_t size)
+{
+    // data are not stored on buffers when using interrupt
+    if(pdev->cfg.interrupt_callback)
+        return 0;
+
+    return (ssize_t) utl_ring_read(pdev->rx, buffer, (uint32_t) size);
+}
+
+static ssize_t port_uart_write(hal_uart_dev_t pdev, uint8_t* buffer, size_t size)
+{
+    return pdev->in_use ? (ssize_t) size : 0;
+}
+
+static void port_uart_flush(hal_uart_dev_t pdev)
+{
+    if(pdev->cfg.interrupt_callback)
+        return;
+
+    utl_ring_flush(pdev->rx);
+}
+
+hal_uart_driver_t HAL_UART_DRIVER = {
+    .init = port_uart_init,
+    .deinit = port_uart_deinit,
+    .open = port_uart_open,
+    .close = port_uart_close,
+    .bytes_available = port_uart_bytes_available,
+    .read = port_uart_read,
+    .write = port_uart_write,
+    .flush = port_uart_flush,
+};
@@ -2,20 +2,29 @@
 #include <unistd.h>
 #include <time.h>
 #include <signal.h>
+#include <errno.h>
 #include <dispatch/dispatch.h>
 
 #include "hal.h"
 #include "app.h"
+#include "port_cpu_inline.h"
 
 extern char* main_app_name_get(void);
 
 static bool port_cpu_init_done = false;
-static pthread_mutex_t port_cpu_cs;
+pthread_mutex_t port_cpu_cs;
 static pthread_mutexattr_t port_cpu_cs_attr;
 
 static dispatch_queue_t port_systick_queue;
 static dispatch_source_t port_systick_timer = 0;
-static volatile uint32_t port_systick_cnt = 0;
+volatile uint32_t port_systick_cnt = 0;
+
+// low power mode: the main context sleeps until an RX thread wakes it up. CTRL+C runs in an
+// asynchronous signal handler that can not signal the condition, hence the bounded wait
+// (HAL_CPU_LOW_POWER_MAX_MS).
+static pthread_mutex_t port_cpu_wakeup_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t port_cpu_wakeup_cond = PTHREAD_COND_INITIALIZER;
+static bool port_cpu_wakeup_pending = false;
 
 static void port_cpu_sigint_handler(int sig_num)
 {
@@ -107,29 +116,53 @@ static uint32_t port_cpu_random_seed_get(void)
     return rnd_seed;
 }
 
-static void port_cpu_critical_section_leave(uint32_t last_level)
+static void port_cpu_low_power_enter(void)
 {
-    pthread_mutex_unlock(&port_cpu_cs);
+    struct timespec deadline;
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += HAL_CPU_LOW_POWER_MAX_MS * 1000000L;
+    if(deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&port_cpu_wakeup_lock);
+    while(!port_cpu_wakeup_pending)
+    {
+        if(pthread_cond_timedwait(&port_cpu_wakeup_cond, &port_cpu_wakeup_lock, &deadline) == ETIMEDOUT)
+            break;
+    }
+    port_cpu_wakeup_pending = false;
+    pthread_mutex_unlock(&port_cpu_wakeup_lock);
 }
 
-static uint32_t port_cpu_critical_section_enter(hal_cpu_cs_level_t level)
+static void port_cpu_wakeup(void)
 {
-    pthread_mutex_lock(&port_cpu_cs);
-    return 0;
+    pthread_mutex_lock(&port_cpu_wakeup_lock);
+    port_cpu_wakeup_pending = true;
+    pthread_cond_signal(&port_cpu_wakeup_cond);
+    pthread_mutex_unlock(&port_cpu_wakeup_lock);
 }
 
-static void port_cpu_low_power_enter(void)
+static void port_cpu_sleep_ms(uint32_t tmr_ms)
 {
+    usleep(1000 * tmr_ms);
 }
 
-static uint32_t port_cpu_time_get_ms(void)
+// nanoseconds play the role of CPU cycles, wraps every 4.29s
+static uint32_t port_cpu_cycles_get(void)
 {
-    return port_systick_cnt;
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return (uint32_t) ((uint64_t) t.tv_sec * 1000000000ULL + (uint64_t) t.tv_nsec);
 }
 
-static void port_cpu_sleep_ms(uint32_t tmr_ms)
+static uint32_t port_cpu_cycles_freq_get(void)
 {
-    usleep(1000 * tmr_ms);
+    return 1000000000UL;
 }
 
 hal_cpu_driver_t HAL_CPU_DRIVER = {
@@ -144,4 +177,7 @@ hal_cpu_driver_t HAL_CPU_DRIVER = {
     .low_power_enter = port_cpu_low_power_enter,
     .sleep_ms = port_cpu_sleep_ms,
     .time_get_ms = port_cpu_time_get_ms,
+    .wakeup = port_cpu_wakeup,
+    .cycles_get = port_cpu_cycles_get,
+    .cycles_freq_get = port_cpu_cycles_freq_get,
 };
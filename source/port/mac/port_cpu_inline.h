@@ -0,0 +1,26 @@
+#pragma once
+
+#include <pthread.h>
+
+// Hot hal_cpu calls of the mac port. port_cpu.c uses them for HAL_CPU_DRIVER and, when
+// HAL_CPU_STATIC_DRIVER is 1, hal_cpu.h calls them directly so they are inlined in the callers.
+
+// recursive mutex created by port_cpu_init(), 1 ms tick counter
+extern pthread_mutex_t port_cpu_cs;
+extern volatile uint32_t port_systick_cnt;
+
+static inline uint32_t port_cpu_critical_section_enter(hal_cpu_cs_level_t level)
+{
+    pthread_mutex_lock(&port_cpu_cs);
+    return 0;
+}
+
+static inline void port_cpu_critical_section_leave(uint32_t last_level)
+{
+    pthread_mutex_unlock(&port_cpu_cs);
+}
+
+static inline uint32_t port_cpu_time_get_ms(void)
+{
+    return port_systick_cnt;
+}
@@ -13,6 +13,9 @@
 
 #define PORT_UART_BUFFER_SIZE 512
 #define PORT_FILE_NAME_LEN 64
+// port names starting with this prefix create a pseudo terminal, the name after
+// the prefix is a symbolic link to the peer side (e.g. "pty:uart0" -> ./uart0 -> /dev/ttys003)
+#define PORT_UART_PTY_PREFIX "pty:"
 
 static void port_uart_close(hal_uart_dev_t pdev);
 
@@ -22,18 +25,21 @@ UTL_CBF_DECLARE(cb1, PORT_UART_BUFFER_SIZE);
 struct hal_uart_dev_s
 {
     utl_cbf_t* cb;
+    uint8_t* cb_area;
     uint8_t name[PORT_FILE_NAME_LEN];
+    char peer_name[PORT_FILE_NAME_LEN];
     hal_uart_interrupt_t cbk;
     hal_uart_config_t cfg;
     pthread_t thread;
     int file;
+    int peer_file;
     bool in_use;
     hal_uart_port_t dev;
 };
 
 static struct hal_uart_dev_s port_uart_ctrl[] = {
-    {.cb = &cb0, .name = "/dev/ttys010", .dev = HAL_UART_PORT0},
-    {.cb = &cb1, .name = "/dev/ttys011", .dev = HAL_UART_PORT1},
+    {.cb = &cb0, .cb_area = cb0buffer, .name = "pty:uart0", .dev = HAL_UART_PORT0},
+    {.cb = &cb1, .cb_area = cb1buffer, .name = "pty:uart1", .dev = HAL_UART_PORT1},
 };
 
 static void* port_uart_rx_thread(void* thread_param)
@@ -55,10 +61,16 @@ static void* port_uart_rx_thread(void* thread_param)
             else
             {
                 // UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "RX %02X\n",c);
+                hal_uart_capture_rx(pdev->dev, &c, 1);
                 if(pdev->cfg.interrupt_callback)
                     pdev->cfg.interrupt_callback(c);
                 else
                     utl_cbf_put(pdev->cb, c);
+
+                if(pdev->cfg.data_ready_callback)
+                    pdev->cfg.data_ready_callback(pdev);
+
+                hal_cpu_wakeup();
             }
         }
         else
@@ -70,32 +82,54 @@ static void* port_uart_rx_thread(void* thread_param)
     return 0;
 }
 
-static void port_uart_port_check(size_t dev)
+static void port_uart_name_update(size_t dev)
 {
-    UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Checking serial port %s...\n", port_uart_ctrl[dev].name);
+    // names can be changed without rebuilding, useful when several simulated devices share a host
+    char env[16];
+    snprintf(env, sizeof(env), "PORT_UART%u", (unsigned int) dev);
+    char* name = getenv(env);
 
-    int file = open((char*) port_uart_ctrl[dev].name, O_RDWR | O_NOCTTY | O_NDELAY);
+    if(name)
+        snprintf((char*) port_uart_ctrl[dev].name, PORT_FILE_NAME_LEN, "%s", name);
+}
 
-    if(file < 0)
-    {
-        UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Serial port %s does not exist\n", port_uart_ctrl[dev].name);
-    }
-    else
+static bool port_uart_pty_create(hal_uart_dev_t pdev)
+{
+    const char* link_name = (char*) pdev->name + strlen(PORT_UART_PTY_PREFIX);
+
+    pdev->file = posix_openpt(O_RDWR | O_NOCTTY);
+    if(pdev->file < 0 || grantpt(pdev->file) != 0 || unlockpt(pdev->file) != 0 || ptsname(pdev->file) == 0)
     {
-        UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Serial port %s is available\n", port_uart_ctrl[dev].name);
-        close(file);
+        UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Can not create pseudo terminal for %s: %s\n", pdev->name, strerror(errno));
+        if(pdev->file >= 0)
+            close(pdev->file);
+        return false;
     }
+
+    snprintf(pdev->peer_name, PORT_FILE_NAME_LEN, "%s", ptsname(pdev->file));
+    fcntl(pdev->file, F_SETFL, fcntl(pdev->file, F_GETFL) | O_NONBLOCK);
+
+    // keeping the peer side opened avoids EIO/hangups on master while nobody is connected
+    pdev->peer_file = open(pdev->peer_name, O_RDWR | O_NOCTTY);
+
+    unlink(link_name);
+    if(symlink(pdev->peer_name, link_name) != 0)
+        UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Can not create link %s: %s\n", link_name, strerror(errno));
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Pseudo terminal %s -> %s\n", link_name, pdev->peer_name);
+
+    return true;
 }
 
 static void port_uart_init(void)
 {
     for(size_t dev = HAL_UART_PORT0; dev < HAL_UART_NUM_PORTS; dev++)
     {
-        port_uart_port_check(dev);
-
         port_uart_ctrl[dev].in_use = false;
         port_uart_ctrl[dev].cbk = 0;
         port_uart_ctrl[dev].file = -1;
+        port_uart_ctrl[dev].peer_file = -1;
+        port_uart_ctrl[dev].peer_name[0] = '\0';
         utl_cbf_flush(port_uart_ctrl[dev].cb);
     }
 }
@@ -149,13 +183,26 @@ static hal_uart_dev_t port_uart_open(hal_uart_port_t dev, hal_uart_config_t* cfg
     // point to device and open serial port
     pdev = &(port_uart_ctrl[dev]);
     pdev->cfg = *cfg;
-    utl_cbf_flush(pdev->cb);
+    if(cfg->rx_buffer && cfg->rx_buffer_size > 1)
+        utl_cbf_init(pdev->cb, cfg->rx_buffer, cfg->rx_buffer_size > UINT16_MAX ? UINT16_MAX : cfg->rx_buffer_size);
+    else
+        utl_cbf_init(pdev->cb, pdev->cb_area, PORT_UART_BUFFER_SIZE + 1);
+    // devices are not probed at init time, a missing one is reported here
+    port_uart_name_update(dev);
 
-    pdev->file = open((char*) pdev->name, O_RDWR | O_NOCTTY | O_NDELAY);
-    if(pdev->file < 0)
+    if(strncmp((char*) pdev->name, PORT_UART_PTY_PREFIX, strlen(PORT_UART_PTY_PREFIX)) == 0)
     {
-        UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Can not open serial device %d (%s)\n", dev, pdev->name);
-        return 0;
+        if(!port_uart_pty_create(pdev))
+            return 0;
+    }
+    else
+    {
+        pdev->file = open((char*) pdev->name, O_RDWR | O_NOCTTY | O_NDELAY);
+        if(pdev->file < 0)
+        {
+            UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Can not open serial device %d (%s)\n", dev, pdev->name);
+            return 0;
+        }
     }
 
     // set baud rate
@@ -242,6 +289,14 @@ static void port_uart_close(hal_uart_dev_t pdev)
         pthread_join(pdev->thread, NULL);
         close(pdev->file);
         pdev->file = -1;
+
+        if(pdev->peer_file >= 0)
+        {
+            close(pdev->peer_file);
+            pdev->peer_file = -1;
+            unlink((char*) pdev->name + strlen(PORT_UART_PTY_PREFIX));
+        }
+        pdev->peer_name[0] = '\0';
     }
 }
 
@@ -321,6 +376,11 @@ static void port_uart_flush(hal_uart_dev_t pdev)
     hal_cpu_critical_section_leave(state);
 }
 
+static const char* port_uart_peer_name_get(hal_uart_dev_t pdev)
+{
+    return pdev->peer_name[0] ? pdev->peer_name : 0;
+}
+
 hal_uart_driver_t HAL_UART_DRIVER = {
     .init = port_uart_init,
     .deinit = port_uart_deinit,
@@ -330,4 +390,5 @@ hal_uart_driver_t HAL_UART_DRIVER = {
     .read = port_uart_read,
     .write = port_uart_write,
     .flush = port_uart_flush,
+    .peer_name_get = port_uart_peer_name_get,
 };
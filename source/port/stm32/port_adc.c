@@ -0,0 +1,223 @@
+#include "main.h"
+#include "hal.h"
+
+// ADC1 in scan mode, triggered by the update of TIM8 at the sample rate, with a circular DMA
+// channel (half words, half transfer and transfer complete interrupts) configured in CubeMX. HAL
+// inputs are the ADC channels 0 to 15. TIM8 must not be enabled in CubeMX, its clock is set here.
+extern ADC_HandleTypeDef hadc1;
+
+typedef struct port_adc_ctrl_s
+{
+    ADC_HandleTypeDef* hadc;
+    TIM_HandleTypeDef htim;
+    hal_adc_config_t cfg;
+    hal_adc_stats_t stats;
+    uint32_t buffer_size;
+    // the last callback ended with the DMA back in its half, already counted as an overrun
+    bool overran;
+} port_adc_ctrl_t;
+
+static const uint32_t port_adc_channels[HAL_ADC_NUM_INPUTS] = {
+    ADC_CHANNEL_0,  ADC_CHANNEL_1,  ADC_CHANNEL_2,  ADC_CHANNEL_3,  ADC_CHANNEL_4,  ADC_CHANNEL_5,
+    ADC_CHANNEL_6,  ADC_CHANNEL_7,  ADC_CHANNEL_8,  ADC_CHANNEL_9,  ADC_CHANNEL_10, ADC_CHANNEL_11,
+    ADC_CHANNEL_12, ADC_CHANNEL_13, ADC_CHANNEL_14, ADC_CHANNEL_15,
+};
+
+static port_adc_ctrl_t port_adc_ctrl[HAL_ADC_NUM_ADCS] = {
+    {.hadc = &hadc1},
+};
+
+static hal_adc_id_t port_adc_id_get(ADC_HandleTypeDef* hadc)
+{
+    for(uint32_t adc = 0; adc < HAL_ADC_NUM_ADCS; adc++)
+    {
+        if(port_adc_ctrl[adc].hadc == hadc)
+            return (hal_adc_id_t) adc;
+    }
+
+    return HAL_ADC_NUM_ADCS;
+}
+
+static uint32_t port_adc_timer_clock_get(void)
+{
+    // APB2 timers run at twice PCLK2 when the APB2 prescaler is not 1
+    uint32_t pclk2 = HAL_RCC_GetPCLK2Freq();
+
+    return (RCC->CFGR & RCC_CFGR_PPRE2) == RCC_CFGR_PPRE2_DIV1 ? pclk2 : 2 * pclk2;
+}
+
+static void port_adc_init(void)
+{
+    __HAL_RCC_TIM8_CLK_ENABLE();
+
+    for(uint32_t adc = 0; adc < HAL_ADC_NUM_ADCS; adc++)
+    {
+        memset(&port_adc_ctrl[adc].cfg, 0, sizeof(hal_adc_config_t));
+        port_adc_ctrl[adc].htim.Instance = 0;
+    }
+}
+
+static void port_adc_stop(hal_adc_id_t adc)
+{
+    port_adc_ctrl_t* ctrl = &port_adc_ctrl[adc];
+
+    if(ctrl->htim.Instance == 0)
+        return;
+
+    HAL_TIM_Base_Stop(&ctrl->htim);
+    HAL_ADC_Stop_DMA(ctrl->hadc);
+}
+
+static void port_adc_deinit(void)
+{
+    for(uint32_t adc = 0; adc < HAL_ADC_NUM_ADCS; adc++)
+    {
+        port_adc_stop((hal_adc_id_t) adc);
+
+        if(port_adc_ctrl[adc].htim.Instance)
+            HAL_TIM_Base_DeInit(&port_adc_ctrl[adc].htim);
+
+        port_adc_ctrl[adc].htim.Instance = 0;
+    }
+}
+
+static bool port_adc_config(hal_adc_id_t adc, hal_adc_config_t* cfg)
+{
+    port_adc_ctrl_t* ctrl = &port_adc_ctrl[adc];
+    ADC_HandleTypeDef* hadc = ctrl->hadc;
+    TIM_HandleTypeDef* htim = &ctrl->htim;
+    TIM_MasterConfigTypeDef master = {.MasterOutputTrigger = TIM_TRGO_UPDATE,
+                                      .MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE};
+    ADC_ChannelConfTypeDef channel_cfg = {.SamplingTime = ADC_SAMPLETIME_84CYCLES};
+    uint32_t ticks = port_adc_timer_clock_get() / cfg->sample_rate_hz;
+
+    // 16 bits counter: the prescaler takes the rest
+    uint32_t prescaler = ticks / 65536 + 1;
+    if(ticks == 0 || prescaler > 65536)
+        return false;
+
+    htim->Instance = TIM8;
+    htim->Init.Prescaler = prescaler - 1;
+    htim->Init.CounterMode = TIM_COUNTERMODE_UP;
+    htim->Init.Period = ticks / prescaler - 1;
+    htim->Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    htim->Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
+
+    if(HAL_TIM_Base_Init(htim) != HAL_OK || HAL_TIMEx_MasterConfigSynchronization(htim, &master) != HAL_OK)
+        return false;
+
+    hadc->Init.Resolution = ADC_RESOLUTION_12B;
+    hadc->Init.DataAlign = ADC_DATAALIGN_RIGHT;
+    hadc->Init.ScanConvMode = cfg->num_channels > 1 ? ENABLE : DISABLE;
+    hadc->Init.ContinuousConvMode = DISABLE;
+    hadc->Init.DiscontinuousConvMode = DISABLE;
+    hadc->Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_RISING;
+    hadc->Init.ExternalTrigConv = ADC_EXTERNALTRIGCONV_T8_TRGO;
+    hadc->Init.NbrOfConversion = cfg->num_channels;
+    hadc->Init.DMAContinuousRequests = ENABLE;
+    hadc->Init.EOCSelection = ADC_EOC_SEQ_CONV;
+
+    if(HAL_ADC_Init(hadc) != HAL_OK)
+        return false;
+
+    for(uint32_t channel = 0; channel < cfg->num_channels; channel++)
+    {
+        channel_cfg.Channel = port_adc_channels[cfg->inputs[channel]];
+        channel_cfg.Rank = channel + 1;
+
+        if(HAL_ADC_ConfigChannel(hadc, &channel_cfg) != HAL_OK)
+            return false;
+    }
+
+    ctrl->cfg = *cfg;
+    ctrl->buffer_size = 2 * cfg->frames_per_half * cfg->num_channels;
+
+    return true;
+}
+
+static bool port_adc_start(hal_adc_id_t adc)
+{
+    port_adc_ctrl_t* ctrl = &port_adc_ctrl[adc];
+
+    if(ctrl->htim.Instance == 0)
+        return false;
+
+    memset(&ctrl->stats, 0, sizeof(ctrl->stats));
+    ctrl->overran = false;
+    __HAL_TIM_SET_COUNTER(&ctrl->htim, 0);
+
+    if(HAL_ADC_Start_DMA(ctrl->hadc, (uint32_t*) ctrl->cfg.buffer, ctrl->buffer_size) != HAL_OK)
+        return false;
+
+    return HAL_TIM_Base_Start(&ctrl->htim) == HAL_OK;
+}
+
+static void port_adc_stats_get(hal_adc_id_t adc, hal_adc_stats_t* stats)
+{
+    *stats = port_adc_ctrl[adc].stats;
+}
+
+static bool port_adc_dma_in_other_half(port_adc_ctrl_t* ctrl, uint32_t half)
+{
+    // transfers left until the end of the buffer
+    uint32_t remaining = __HAL_DMA_GET_COUNTER(ctrl->hadc->DMA_Handle);
+
+    return half == 0 ? remaining <= ctrl->buffer_size / 2 : remaining > ctrl->buffer_size / 2;
+}
+
+static void port_adc_half_done(ADC_HandleTypeDef* hadc, uint32_t half)
+{
+    uint32_t timestamp = hal_cpu_cycles_get();
+    hal_adc_id_t adc = port_adc_id_get(hadc);
+
+    if(adc >= HAL_ADC_NUM_ADCS)
+        return;
+
+    port_adc_ctrl_t* ctrl = &port_adc_ctrl[adc];
+
+    // the DMA must be in the other half, unless the interrupt was late
+    if(!port_adc_dma_in_other_half(ctrl, half) && !ctrl->overran)
+        ctrl->stats.late++;
+
+    ctrl->stats.halves++;
+    ctrl->cfg.callback(adc, ctrl->cfg.buffer + half * ctrl->buffer_size / 2, ctrl->cfg.frames_per_half, timestamp);
+
+    // and still there when the callback returns
+    ctrl->overran = !port_adc_dma_in_other_half(ctrl, half);
+    if(ctrl->overran)
+        ctrl->stats.overruns++;
+
+    uint32_t busy = hal_cpu_cycles_get() - timestamp;
+    ctrl->stats.busy_cycles += busy;
+    if(busy > ctrl->stats.busy_cycles_max)
+        ctrl->stats.busy_cycles_max = busy;
+}
+
+// called by the DMA interrupt handler
+void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef* hadc)
+{
+    port_adc_half_done(hadc, 0);
+}
+
+void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef* hadc)
+{
+    port_adc_half_done(hadc, 1);
+}
+
+// conversions lost by the DMA
+void HAL_ADC_ErrorCallback(ADC_HandleTypeDef* hadc)
+{
+    hal_adc_id_t adc = port_adc_id_get(hadc);
+
+    if(adc < HAL_ADC_NUM_ADCS)
+        port_adc_ctrl[adc].stats.overruns++;
+}
+
+hal_adc_driver_t HAL_ADC_DRIVER = {
+    .init = port_adc_init,
+    .deinit = port_adc_deinit,
+    .config = port_adc_config,
+    .start = port_adc_start,
+    .stop = port_adc_stop,
+    .stats_get = port_adc_stats_get,
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "main.h"
+
+// Critical sections and time of the STM32 port. port_cpu.c uses them for HAL_CPU_DRIVER and, when
+// HAL_CPU_STATIC_DRIVER is 1, hal_cpu.h calls them directly: entering a critical section is then a
+// few instructions inlined in the caller.
+
+// Input level codification:
+//   0: disable all interrupts
+//   n: interrupt level
+//      interrupts with priority >= n will be disabled
+//      interrupts with priority <  n will be enabled
+//
+// Returned level codification:
+//   If bit1 is on (bit A), then basepri was used instead of primask (a level was provided)
+//   and the level value is shifted by 4 bits to the right.
+//
+//   If bit1 is off, then primask was used instead of basepri (the same as using __disable_irq() / __enable_irq())
+//   and bit 0 (bit B) indicates the last interrupt state (0 enabled, 1 disabled).
+//
+// Output level codification:
+// |         31-8           | 7-4| 3-0|
+// |000000000000000000000000|PRIO|00AB|
+//
+// indicates when basepri was used or not
+#define PORT_CPU_BASEPRI_USED (0x02)
+// indicates if interrupts were enabled or disabled before entering critical section
+#define PORT_CPU_INT_DISABLED (0x01)
+#define PORT_CPU_INT_ENABLED (0x00)
+// bits 7:4 are used for priority, bits 3:0 are not used
+#define PORT_CPU_PRIO_BITS_POS (4)
+// hal_cpu_cs_level_t to interrupt level: 0, 5, 10 and 15
+#define PORT_CPU_CS_PRIO_STEP (5)
+
+static inline uint32_t port_cpu_critsec_enter_imp(uint32_t level)
+{
+    uint32_t last_level = 0;
+
+    if(level == 0)
+    {
+        // PRIMASK:
+        // 0 - interrupts enabled,
+        // 1 - interrupts disabled
+        last_level = __get_PRIMASK() ? PORT_CPU_INT_DISABLED : PORT_CPU_INT_ENABLED;
+        __disable_irq();
+    }
+    else
+    {
+        last_level = __get_BASEPRI() | PORT_CPU_BASEPRI_USED;
+        __set_BASEPRI(level << PORT_CPU_PRIO_BITS_POS);
+    }
+
+    __ISB(); // flush pipeline
+    __DSB(); // wait for all memory accesses to complete
+
+    return last_level;
+}
+
+static inline uint32_t port_cpu_critical_section_enter(hal_cpu_cs_level_t level)
+{
+    return port_cpu_critsec_enter_imp((uint32_t) level * PORT_CPU_CS_PRIO_STEP);
+}
+
+static inline void port_cpu_critical_section_leave(uint32_t last_level)
+{
+    if(last_level & PORT_CPU_BASEPRI_USED)
+    {
+        last_level &= ~(PORT_CPU_BASEPRI_USED);
+        __set_BASEPRI(last_level);
+    }
+    else
+    {
+        if(last_level == PORT_CPU_INT_ENABLED)
+        {
+            // Restoring interrupts as they were enabled before calling
+            __enable_irq();
+        }
+        // else: keep interrupts disabled (as they were before)
+    }
+
+    __ISB(); // flush pipeline
+    __DSB(); // wait for all memory accesses to complete
+}
+
+static inline uint32_t port_cpu_time_get_ms(void)
+{
+    return HAL_GetTick();
+}
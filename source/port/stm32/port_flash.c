@@ -0,0 +1,77 @@
+#include "main.h"
+#include "hal.h"
+
+// Storage area: the last two 128 KiB sectors of an STM32F4 with 1 MiB of flash, adjust for the part
+// and keep them out of the linker script. Sectors are the erase pages; words are programmed with
+// the 2.7 V to 3.6 V parallelism.
+#define PORT_FLASH_BASE 0x080C0000UL
+#define PORT_FLASH_FIRST_SECTOR FLASH_SECTOR_10
+#define PORT_FLASH_NUM_PAGES 2
+#define PORT_FLASH_PAGE_SIZE (128 * 1024UL)
+#define PORT_FLASH_WRITE_SIZE 4
+
+static void port_flash_init(void)
+{
+}
+
+static void port_flash_deinit(void)
+{
+}
+
+static void port_flash_info_get(hal_flash_info_t* info)
+{
+    info->size = PORT_FLASH_NUM_PAGES * PORT_FLASH_PAGE_SIZE;
+    info->page_size = PORT_FLASH_PAGE_SIZE;
+    info->write_size = PORT_FLASH_WRITE_SIZE;
+    info->erased_value = 0xFF;
+}
+
+static bool port_flash_page_erase(uint32_t page)
+{
+    uint32_t error;
+    FLASH_EraseInitTypeDef erase = {
+        .TypeErase = FLASH_TYPEERASE_SECTORS,
+        .Sector = PORT_FLASH_FIRST_SECTOR + page,
+        .NbSectors = 1,
+        .VoltageRange = FLASH_VOLTAGE_RANGE_3,
+    };
+
+    HAL_FLASH_Unlock();
+    HAL_StatusTypeDef status = HAL_FLASHEx_Erase(&erase, &error);
+    HAL_FLASH_Lock();
+
+    return status == HAL_OK;
+}
+
+static bool port_flash_program(uint32_t offset, const uint8_t* data, uint32_t size)
+{
+    HAL_StatusTypeDef status = HAL_OK;
+
+    HAL_FLASH_Unlock();
+
+    for(uint32_t pos = 0; pos < size && status == HAL_OK; pos += PORT_FLASH_WRITE_SIZE)
+    {
+        uint32_t word;
+
+        memcpy(&word, data + pos, PORT_FLASH_WRITE_SIZE);
+        status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, PORT_FLASH_BASE + offset + pos, word);
+    }
+
+    HAL_FLASH_Lock();
+
+    return status == HAL_OK;
+}
+
+static const uint8_t* port_flash_ptr_get(uint32_t offset)
+{
+    return (const uint8_t*) (PORT_FLASH_BASE + offset);
+}
+
+hal_flash_driver_t HAL_FLASH_DRIVER = {
+    .init = port_flash_init,
+    .deinit = port_flash_deinit,
+    .info_get = port_flash_info_get,
+    .page_erase = port_flash_page_erase,
+    .program = port_flash_program,
+    .ptr_get = port_flash_ptr_get,
+};
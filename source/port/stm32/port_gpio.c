@@ -0,0 +1,150 @@
+#include "main.h"
+#include "hal.h"
+
+// HAL pins to board pins, adjust for the board. EXTI lines are shared by pins with the same number
+// on all GPIO ports: only one of them can have edge interrupts.
+typedef struct port_gpio_map_s
+{
+    GPIO_TypeDef* port;
+    uint16_t pin;
+} port_gpio_map_t;
+
+static const port_gpio_map_t port_gpio_map[HAL_GPIO_NUM_PINS] = {
+    {GPIOA, GPIO_PIN_0}, {GPIOA, GPIO_PIN_1}, {GPIOA, GPIO_PIN_4}, {GPIOA, GPIO_PIN_5},
+    {GPIOB, GPIO_PIN_6}, {GPIOB, GPIO_PIN_7}, {GPIOC, GPIO_PIN_8}, {GPIOC, GPIO_PIN_9},
+};
+
+static hal_gpio_interrupt_t port_gpio_callbacks[HAL_GPIO_NUM_PINS];
+
+static IRQn_Type port_gpio_irq_get(uint16_t pin)
+{
+    switch(pin)
+    {
+    case GPIO_PIN_0:
+        return EXTI0_IRQn;
+    case GPIO_PIN_1:
+        return EXTI1_IRQn;
+    case GPIO_PIN_2:
+        return EXTI2_IRQn;
+    case GPIO_PIN_3:
+        return EXTI3_IRQn;
+    case GPIO_PIN_4:
+        return EXTI4_IRQn;
+    case GPIO_PIN_5:
+    case GPIO_PIN_6:
+    case GPIO_PIN_7:
+    case GPIO_PIN_8:
+    case GPIO_PIN_9:
+        return EXTI9_5_IRQn;
+    default:
+        return EXTI15_10_IRQn;
+    }
+}
+
+static void port_gpio_init(void)
+{
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+    __HAL_RCC_GPIOB_CLK_ENABLE();
+    __HAL_RCC_GPIOC_CLK_ENABLE();
+
+    memset(port_gpio_callbacks, 0, sizeof(port_gpio_callbacks));
+}
+
+static void port_gpio_deinit(void)
+{
+    for(uint32_t pin = HAL_GPIO_PIN_0; pin < HAL_GPIO_NUM_PINS; pin++)
+    {
+        if(port_gpio_callbacks[pin])
+            HAL_NVIC_DisableIRQ(port_gpio_irq_get(port_gpio_map[pin].pin));
+
+        port_gpio_callbacks[pin] = 0;
+        HAL_GPIO_DeInit(port_gpio_map[pin].port, port_gpio_map[pin].pin);
+    }
+}
+
+static bool port_gpio_config(hal_gpio_pin_t pin, hal_gpio_config_t* cfg)
+{
+    const port_gpio_map_t* map = &port_gpio_map[pin];
+    GPIO_InitTypeDef init = {
+        .Pin = map->pin,
+        .Pull = GPIO_NOPULL,
+        .Speed = GPIO_SPEED_FREQ_VERY_HIGH,
+    };
+
+    if(cfg->dir == HAL_GPIO_DIR_INPUT && cfg->edge != HAL_GPIO_EDGE_NONE && cfg->interrupt_callback == 0)
+        return false;
+
+    if(cfg->dir == HAL_GPIO_DIR_OUTPUT)
+    {
+        init.Mode = GPIO_MODE_OUTPUT_PP;
+        HAL_GPIO_WritePin(map->port, map->pin, cfg->state ? GPIO_PIN_SET : GPIO_PIN_RESET);
+    }
+    else if(cfg->edge == HAL_GPIO_EDGE_RISING)
+        init.Mode = GPIO_MODE_IT_RISING;
+    else if(cfg->edge == HAL_GPIO_EDGE_FALLING)
+        init.Mode = GPIO_MODE_IT_FALLING;
+    else if(cfg->edge == HAL_GPIO_EDGE_BOTH)
+        init.Mode = GPIO_MODE_IT_RISING_FALLING;
+    else
+        init.Mode = GPIO_MODE_INPUT;
+
+    port_gpio_callbacks[pin] = cfg->dir == HAL_GPIO_DIR_INPUT ? cfg->interrupt_callback : 0;
+    HAL_GPIO_Init(map->port, &init);
+
+    if(port_gpio_callbacks[pin])
+    {
+        HAL_NVIC_SetPriority(port_gpio_irq_get(map->pin), 5, 0);
+        HAL_NVIC_EnableIRQ(port_gpio_irq_get(map->pin));
+    }
+
+    return true;
+}
+
+static void port_gpio_set(hal_gpio_pin_t pin, bool state)
+{
+    const port_gpio_map_t* map = &port_gpio_map[pin];
+
+    // BSRR: low half sets, high half resets, no read-modify-write
+    map->port->BSRR = state ? map->pin : (uint32_t) map->pin << 16;
+}
+
+static bool port_gpio_get(hal_gpio_pin_t pin)
+{
+    const port_gpio_map_t* map = &port_gpio_map[pin];
+
+    return (map->port->IDR & map->pin) != 0;
+}
+
+static void port_gpio_toggle(hal_gpio_pin_t pin)
+{
+    const port_gpio_map_t* map = &port_gpio_map[pin];
+    uint32_t odr = map->port->ODR;
+
+    map->port->BSRR = ((odr & map->pin) << 16) | (~odr & map->pin);
+}
+
+// called by HAL_GPIO_EXTI_IRQHandler() from the EXTIx_IRQHandler() of the board
+void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
+{
+    uint32_t timestamp = hal_cpu_cycles_get();
+
+    for(uint32_t pin = HAL_GPIO_PIN_0; pin < HAL_GPIO_NUM_PINS; pin++)
+    {
+        const port_gpio_map_t* map = &port_gpio_map[pin];
+
+        if(map->pin == GPIO_Pin && port_gpio_callbacks[pin])
+        {
+            port_gpio_callbacks[pin]((hal_gpio_pin_t) pin, (map->port->IDR & map->pin) != 0, timestamp);
+            break;
+        }
+    }
+}
+
+hal_gpio_driver_t HAL_GPIO_DRIVER = {
+    .init = port_gpio_init,
+    .deinit = port_gpio_deinit,
+    .config = port_gpio_config,
+    .set = port_gpio_set,
+    .get = port_gpio_get,
+    .toggle = port_gpio_toggle,
+};
@@ -0,0 +1,260 @@
+#include "main.h"
+#include "hal.h"
+
+// I2C1 and I2C2 as masters, configured in CubeMX with their event and error interrupts and a DMA
+// channel for TX and RX. Register reads (1 or 2 address bytes then a read) use the memory calls
+// for the repeated start; other write then read transfers are done as a write and a read, with a
+// stop between them. Batches go on from the completion interrupts.
+extern I2C_HandleTypeDef hi2c1;
+extern I2C_HandleTypeDef hi2c2;
+
+#define PORT_I2C_TIMEOUT_MS 100
+
+typedef enum port_i2c_call_e
+{
+    PORT_I2C_CALL_ASYNC = 0,
+    PORT_I2C_CALL_DMA,
+} port_i2c_call_t;
+
+typedef struct port_i2c_ctrl_s
+{
+    hal_i2c_xfer_t* xfers;
+    uint32_t count;
+    uint32_t index;
+    // the read part of the current transfer is still to be done
+    bool rx_pending;
+    port_i2c_call_t call;
+    hal_i2c_done_t done;
+    void* ctx;
+    volatile bool busy;
+} port_i2c_ctrl_t;
+
+static I2C_HandleTypeDef* const port_i2c_handles[HAL_I2C_NUM_BUSES] = {&hi2c1, &hi2c2};
+static port_i2c_ctrl_t port_i2c_ctrl[HAL_I2C_NUM_BUSES];
+
+static hal_i2c_bus_t port_i2c_bus_get(I2C_HandleTypeDef* hi2c)
+{
+    for(uint32_t bus = 0; bus < HAL_I2C_NUM_BUSES; bus++)
+    {
+        if(port_i2c_handles[bus] == hi2c)
+            return (hal_i2c_bus_t) bus;
+    }
+
+    return HAL_I2C_NUM_BUSES;
+}
+
+static bool port_i2c_is_mem_read(hal_i2c_xfer_t* xfer)
+{
+    return xfer->rx_size && (xfer->tx_size == 1 || xfer->tx_size == 2);
+}
+
+static uint16_t port_i2c_mem_addr(hal_i2c_xfer_t* xfer)
+{
+    return xfer->tx_size == 2 ? (uint16_t) ((xfer->tx[0] << 8) | xfer->tx[1]) : xfer->tx[0];
+}
+
+static uint16_t port_i2c_mem_addr_size(hal_i2c_xfer_t* xfer)
+{
+    return xfer->tx_size == 2 ? I2C_MEMADD_SIZE_16BIT : I2C_MEMADD_SIZE_8BIT;
+}
+
+static void port_i2c_init(void)
+{
+    memset(port_i2c_ctrl, 0, sizeof(port_i2c_ctrl));
+}
+
+static void port_i2c_deinit(void)
+{
+    for(uint32_t bus = 0; bus < HAL_I2C_NUM_BUSES; bus++)
+    {
+        port_i2c_ctrl_t* ctrl = &port_i2c_ctrl[bus];
+
+        if(ctrl->busy)
+            HAL_I2C_Master_Abort_IT(port_i2c_handles[bus], (uint16_t) (ctrl->xfers[ctrl->index].addr << 1));
+
+        ctrl->busy = false;
+    }
+}
+
+static bool port_i2c_config(hal_i2c_bus_t bus, hal_i2c_config_t* cfg)
+{
+    I2C_HandleTypeDef* hi2c = port_i2c_handles[bus];
+
+    if(port_i2c_ctrl[bus].busy)
+        return false;
+
+    hi2c->Init.ClockSpeed = cfg->clock_hz;
+    hi2c->Init.DutyCycle = I2C_DUTYCYCLE_2;
+
+    return HAL_I2C_Init(hi2c) == HAL_OK;
+}
+
+static bool port_i2c_transfer(hal_i2c_bus_t bus, hal_i2c_xfer_t* xfers, uint32_t count)
+{
+    I2C_HandleTypeDef* hi2c = port_i2c_handles[bus];
+    bool ok = true;
+
+    if(port_i2c_ctrl[bus].busy)
+        return false;
+
+    for(uint32_t n = 0; n < count && ok; n++)
+    {
+        hal_i2c_xfer_t* xfer = &xfers[n];
+        uint16_t addr = (uint16_t) (xfer->addr << 1);
+
+        if(port_i2c_is_mem_read(xfer))
+        {
+            ok = HAL_I2C_Mem_Read(hi2c, addr, port_i2c_mem_addr(xfer), port_i2c_mem_addr_size(xfer), xfer->rx,
+                                  (uint16_t) xfer->rx_size, PORT_I2C_TIMEOUT_MS) == HAL_OK;
+            continue;
+        }
+
+        if(xfer->tx_size)
+            ok = HAL_I2C_Master_Transmit(hi2c, addr, (uint8_t*) xfer->tx, (uint16_t) xfer->tx_size,
+                                         PORT_I2C_TIMEOUT_MS) == HAL_OK;
+
+        if(ok && xfer->rx_size)
+            ok = HAL_I2C_Master_Receive(hi2c, addr, xfer->rx, (uint16_t) xfer->rx_size, PORT_I2C_TIMEOUT_MS) == HAL_OK;
+    }
+
+    return ok;
+}
+
+// starts the next step of the current transfer
+static bool port_i2c_step_start(hal_i2c_bus_t bus)
+{
+    port_i2c_ctrl_t* ctrl = &port_i2c_ctrl[bus];
+    I2C_HandleTypeDef* hi2c = port_i2c_handles[bus];
+    hal_i2c_xfer_t* xfer = &ctrl->xfers[ctrl->index];
+    uint16_t addr = (uint16_t) (xfer->addr << 1);
+    bool dma = ctrl->call == PORT_I2C_CALL_DMA;
+    HAL_StatusTypeDef status;
+
+    if(ctrl->rx_pending)
+    {
+        ctrl->rx_pending = false;
+        status = dma ? HAL_I2C_Master_Receive_DMA(hi2c, addr, xfer->rx, (uint16_t) xfer->rx_size)
+                     : HAL_I2C_Master_Receive_IT(hi2c, addr, xfer->rx, (uint16_t) xfer->rx_size);
+    }
+    else if(port_i2c_is_mem_read(xfer))
+    {
+        uint16_t mem = port_i2c_mem_addr(xfer);
+        uint16_t mem_size = port_i2c_mem_addr_size(xfer);
+
+        status = dma ? HAL_I2C_Mem_Read_DMA(hi2c, addr, mem, mem_size, xfer->rx, (uint16_t) xfer->rx_size)
+                     : HAL_I2C_Mem_Read_IT(hi2c, addr, mem, mem_size, xfer->rx, (uint16_t) xfer->rx_size);
+    }
+    else if(xfer->tx_size)
+    {
+        ctrl->rx_pending = xfer->rx_size != 0;
+        status = dma ? HAL_I2C_Master_Transmit_DMA(hi2c, addr, (uint8_t*) xfer->tx, (uint16_t) xfer->tx_size)
+                     : HAL_I2C_Master_Transmit_IT(hi2c, addr, (uint8_t*) xfer->tx, (uint16_t) xfer->tx_size);
+    }
+    else
+    {
+        ctrl->rx_pending = true;
+        return port_i2c_step_start(bus);
+    }
+
+    return status == HAL_OK;
+}
+
+static bool port_i2c_start(hal_i2c_bus_t bus, port_i2c_call_t call, hal_i2c_xfer_t* xfers, uint32_t count,
+                           hal_i2c_done_t done, void* ctx)
+{
+    port_i2c_ctrl_t* ctrl = &port_i2c_ctrl[bus];
+
+    if(ctrl->busy)
+        return false;
+
+    ctrl->xfers = xfers;
+    ctrl->count = count;
+    ctrl->index = 0;
+    ctrl->rx_pending = false;
+    ctrl->call = call;
+    ctrl->done = done;
+    ctrl->ctx = ctx;
+    ctrl->busy = true;
+
+    if(!port_i2c_step_start(bus))
+    {
+        ctrl->busy = false;
+        return false;
+    }
+
+    return true;
+}
+
+static bool port_i2c_transfer_async(hal_i2c_bus_t bus, hal_i2c_xfer_t* xfers, uint32_t count, hal_i2c_done_t done,
+                                    void* ctx)
+{
+    return port_i2c_start(bus, PORT_I2C_CALL_ASYNC, xfers, count, done, ctx);
+}
+
+static bool port_i2c_transfer_dma(hal_i2c_bus_t bus, hal_i2c_xfer_t* xfers, uint32_t count, hal_i2c_done_t done,
+                                  void* ctx)
+{
+    return port_i2c_start(bus, PORT_I2C_CALL_DMA, xfers, count, done, ctx);
+}
+
+static void port_i2c_batch_end(hal_i2c_bus_t bus, bool ok)
+{
+    port_i2c_ctrl_t* ctrl = &port_i2c_ctrl[bus];
+
+    // released first, the callback may start the next batch
+    ctrl->busy = false;
+    ctrl->done(bus, ok, ctrl->ctx);
+}
+
+static void port_i2c_step_end(I2C_HandleTypeDef* hi2c)
+{
+    hal_i2c_bus_t bus = port_i2c_bus_get(hi2c);
+
+    if(bus >= HAL_I2C_NUM_BUSES || !port_i2c_ctrl[bus].busy)
+        return;
+
+    port_i2c_ctrl_t* ctrl = &port_i2c_ctrl[bus];
+
+    if(!ctrl->rx_pending && ++ctrl->index >= ctrl->count)
+    {
+        port_i2c_batch_end(bus, true);
+        return;
+    }
+
+    if(!port_i2c_step_start(bus))
+        port_i2c_batch_end(bus, false);
+}
+
+// called by HAL_I2C_EV_IRQHandler() and the DMA handlers
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef* hi2c)
+{
+    port_i2c_step_end(hi2c);
+}
+
+void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef* hi2c)
+{
+    port_i2c_step_end(hi2c);
+}
+
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef* hi2c)
+{
+    port_i2c_step_end(hi2c);
+}
+
+// no acknowledge included, called by HAL_I2C_ER_IRQHandler()
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef* hi2c)
+{
+    hal_i2c_bus_t bus = port_i2c_bus_get(hi2c);
+
+    if(bus < HAL_I2C_NUM_BUSES && port_i2c_ctrl[bus].busy)
+        port_i2c_batch_end(bus, false);
+}
+
+hal_i2c_driver_t HAL_I2C_DRIVER = {
+    .init = port_i2c_init,
+    .deinit = port_i2c_deinit,
+    .config = port_i2c_config,
+    .transfer = port_i2c_transfer,
+    .transfer_async = port_i2c_transfer_async,
+    .transfer_dma = port_i2c_transfer_dma,
+};
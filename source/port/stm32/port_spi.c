@@ -0,0 +1,294 @@
+#include "main.h"
+#include "hal.h"
+
+// SPI1 and SPI2 as masters, configured in CubeMX with software NSS and a DMA channel for TX and RX.
+// Chip selects are GPIO outputs driven here, adjust the map for the board. Batches go on from the
+// completion interrupts. Every transfer is full duplex: a missing tx or rx side is replaced by a
+// dummy buffer, the transfer going in pieces of its size.
+extern SPI_HandleTypeDef hspi1;
+extern SPI_HandleTypeDef hspi2;
+
+#define PORT_SPI_TIMEOUT_MS 100
+#define PORT_SPI_DUMMY_SIZE 64
+
+typedef enum port_spi_call_e
+{
+    PORT_SPI_CALL_ASYNC = 0,
+    PORT_SPI_CALL_DMA,
+} port_spi_call_t;
+
+typedef struct port_spi_map_s
+{
+    SPI_HandleTypeDef* hspi;
+    GPIO_TypeDef* cs_port[HAL_SPI_MAX_CS];
+    uint16_t cs_pin[HAL_SPI_MAX_CS];
+} port_spi_map_t;
+
+typedef struct port_spi_ctrl_s
+{
+    hal_spi_xfer_t* xfers;
+    uint32_t count;
+    uint32_t index;
+    // bytes of the current transfer done, size of the piece in progress
+    uint32_t pos;
+    uint32_t chunk;
+    port_spi_call_t call;
+    hal_spi_done_t done;
+    void* ctx;
+    volatile bool busy;
+} port_spi_ctrl_t;
+
+static const port_spi_map_t port_spi_map[HAL_SPI_NUM_BUSES] = {
+    {&hspi1, {GPIOA, GPIOA, GPIOB, GPIOB}, {GPIO_PIN_8, GPIO_PIN_9, GPIO_PIN_0, GPIO_PIN_1}},
+    {&hspi2, {GPIOB, GPIOB, GPIOC, GPIOC}, {GPIO_PIN_11, GPIO_PIN_12, GPIO_PIN_6, GPIO_PIN_7}},
+};
+
+static port_spi_ctrl_t port_spi_ctrl[HAL_SPI_NUM_BUSES];
+// 0xFF sent when tx is 0, bytes received when rx is 0
+static uint8_t port_spi_ones[PORT_SPI_DUMMY_SIZE];
+static uint8_t port_spi_scratch[HAL_SPI_NUM_BUSES][PORT_SPI_DUMMY_SIZE];
+
+static hal_spi_bus_t port_spi_bus_get(SPI_HandleTypeDef* hspi)
+{
+    for(uint32_t bus = 0; bus < HAL_SPI_NUM_BUSES; bus++)
+    {
+        if(port_spi_map[bus].hspi == hspi)
+            return (hal_spi_bus_t) bus;
+    }
+
+    return HAL_SPI_NUM_BUSES;
+}
+
+static void port_spi_cs_set(hal_spi_bus_t bus, uint8_t cs, bool active)
+{
+    HAL_GPIO_WritePin(port_spi_map[bus].cs_port[cs], port_spi_map[bus].cs_pin[cs],
+                      active ? GPIO_PIN_RESET : GPIO_PIN_SET);
+}
+
+// next piece of @p xfer from @p pos: all of it, or at most a dummy buffer when a side is missing
+static uint32_t port_spi_chunk_get(hal_spi_bus_t bus, hal_spi_xfer_t* xfer, uint32_t pos, uint8_t** tx, uint8_t** rx)
+{
+    uint32_t size = xfer->size - pos;
+
+    *tx = xfer->tx ? (uint8_t*) xfer->tx + pos : port_spi_ones;
+    *rx = xfer->rx ? xfer->rx + pos : port_spi_scratch[bus];
+
+    if((xfer->tx == 0 || xfer->rx == 0) && size > PORT_SPI_DUMMY_SIZE)
+        size = PORT_SPI_DUMMY_SIZE;
+
+    return size;
+}
+
+static void port_spi_init(void)
+{
+    GPIO_InitTypeDef init = {.Mode = GPIO_MODE_OUTPUT_PP, .Pull = GPIO_NOPULL, .Speed = GPIO_SPEED_FREQ_HIGH};
+
+    memset(port_spi_ctrl, 0, sizeof(port_spi_ctrl));
+    memset(port_spi_ones, 0xFF, sizeof(port_spi_ones));
+
+    for(uint32_t bus = 0; bus < HAL_SPI_NUM_BUSES; bus++)
+    {
+        for(uint8_t cs = 0; cs < HAL_SPI_MAX_CS; cs++)
+        {
+            port_spi_cs_set((hal_spi_bus_t) bus, cs, false);
+            init.Pin = port_spi_map[bus].cs_pin[cs];
+            HAL_GPIO_Init(port_spi_map[bus].cs_port[cs], &init);
+        }
+    }
+}
+
+static void port_spi_deinit(void)
+{
+    for(uint32_t bus = 0; bus < HAL_SPI_NUM_BUSES; bus++)
+    {
+        HAL_SPI_Abort(port_spi_map[bus].hspi);
+        port_spi_ctrl[bus].busy = false;
+    }
+}
+
+static bool port_spi_config(hal_spi_bus_t bus, hal_spi_config_t* cfg)
+{
+    static const uint32_t prescalers[] = {SPI_BAUDRATEPRESCALER_2,   SPI_BAUDRATEPRESCALER_4,
+                                          SPI_BAUDRATEPRESCALER_8,   SPI_BAUDRATEPRESCALER_16,
+                                          SPI_BAUDRATEPRESCALER_32,  SPI_BAUDRATEPRESCALER_64,
+                                          SPI_BAUDRATEPRESCALER_128, SPI_BAUDRATEPRESCALER_256};
+    SPI_HandleTypeDef* hspi = port_spi_map[bus].hspi;
+    // SPI1 is on APB2, SPI2 on APB1
+    uint32_t pclk = hspi->Instance == SPI1 ? HAL_RCC_GetPCLK2Freq() : HAL_RCC_GetPCLK1Freq();
+    uint32_t n = 0;
+
+    if(port_spi_ctrl[bus].busy)
+        return false;
+
+    // the fastest clock not above the requested one
+    while(n < 7 && (pclk >> (n + 1)) > cfg->clock_hz)
+        n++;
+
+    hspi->Init.BaudRatePrescaler = prescalers[n];
+    hspi->Init.CLKPolarity = cfg->mode >= HAL_SPI_MODE_2 ? SPI_POLARITY_HIGH : SPI_POLARITY_LOW;
+    hspi->Init.CLKPhase = (cfg->mode & 1) ? SPI_PHASE_2EDGE : SPI_PHASE_1EDGE;
+
+    return HAL_SPI_Init(hspi) == HAL_OK;
+}
+
+static bool port_spi_transfer(hal_spi_bus_t bus, hal_spi_xfer_t* xfers, uint32_t count)
+{
+    SPI_HandleTypeDef* hspi = port_spi_map[bus].hspi;
+    bool ok = true;
+
+    if(port_spi_ctrl[bus].busy)
+        return false;
+
+    for(uint32_t n = 0; n < count && ok; n++)
+    {
+        hal_spi_xfer_t* xfer = &xfers[n];
+        uint32_t pos = 0;
+
+        port_spi_cs_set(bus, xfer->cs, true);
+
+        do
+        {
+            uint8_t* tx;
+            uint8_t* rx;
+            uint32_t chunk = port_spi_chunk_get(bus, xfer, pos, &tx, &rx);
+
+            ok = HAL_SPI_TransmitReceive(hspi, tx, rx, chunk, PORT_SPI_TIMEOUT_MS) == HAL_OK;
+            pos += chunk;
+        } while(ok && pos < xfer->size);
+
+        port_spi_cs_set(bus, xfer->cs, false);
+    }
+
+    return ok;
+}
+
+// starts the current transfer of the batch
+static bool port_spi_xfer_start(hal_spi_bus_t bus)
+{
+    port_spi_ctrl_t* ctrl = &port_spi_ctrl[bus];
+    SPI_HandleTypeDef* hspi = port_spi_map[bus].hspi;
+    hal_spi_xfer_t* xfer = &ctrl->xfers[ctrl->index];
+    uint8_t* tx;
+    uint8_t* rx;
+    HAL_StatusTypeDef status;
+
+    ctrl->chunk = port_spi_chunk_get(bus, xfer, ctrl->pos, &tx, &rx);
+
+    if(ctrl->pos == 0)
+        port_spi_cs_set(bus, xfer->cs, true);
+
+    if(ctrl->call == PORT_SPI_CALL_DMA)
+        status = HAL_SPI_TransmitReceive_DMA(hspi, tx, rx, ctrl->chunk);
+    else
+        status = HAL_SPI_TransmitReceive_IT(hspi, tx, rx, ctrl->chunk);
+
+    if(status != HAL_OK)
+        port_spi_cs_set(bus, xfer->cs, false);
+
+    return status == HAL_OK;
+}
+
+static bool port_spi_start(hal_spi_bus_t bus, port_spi_call_t call, hal_spi_xfer_t* xfers, uint32_t count,
+                           hal_spi_done_t done, void* ctx)
+{
+    port_spi_ctrl_t* ctrl = &port_spi_ctrl[bus];
+
+    if(ctrl->busy)
+        return false;
+
+    ctrl->xfers = xfers;
+    ctrl->count = count;
+    ctrl->index = 0;
+    ctrl->pos = 0;
+    ctrl->call = call;
+    ctrl->done = done;
+    ctrl->ctx = ctx;
+    ctrl->busy = true;
+
+    if(!port_spi_xfer_start(bus))
+    {
+        ctrl->busy = false;
+        return false;
+    }
+
+    return true;
+}
+
+static bool port_spi_transfer_async(hal_spi_bus_t bus, hal_spi_xfer_t* xfers, uint32_t count, hal_spi_done_t done,
+                                    void* ctx)
+{
+    return port_spi_start(bus, PORT_SPI_CALL_ASYNC, xfers, count, done, ctx);
+}
+
+static bool port_spi_transfer_dma(hal_spi_bus_t bus, hal_spi_xfer_t* xfers, uint32_t count, hal_spi_done_t done,
+                                  void* ctx)
+{
+    return port_spi_start(bus, PORT_SPI_CALL_DMA, xfers, count, done, ctx);
+}
+
+static void port_spi_batch_end(hal_spi_bus_t bus, bool ok)
+{
+    port_spi_ctrl_t* ctrl = &port_spi_ctrl[bus];
+
+    // released first, the callback may start the next batch
+    ctrl->busy = false;
+    ctrl->done(bus, ok, ctrl->ctx);
+}
+
+static void port_spi_xfer_end(SPI_HandleTypeDef* hspi)
+{
+    hal_spi_bus_t bus = port_spi_bus_get(hspi);
+
+    if(bus >= HAL_SPI_NUM_BUSES || !port_spi_ctrl[bus].busy)
+        return;
+
+    port_spi_ctrl_t* ctrl = &port_spi_ctrl[bus];
+
+    // the chip select stays active between the pieces of a transfer
+    ctrl->pos += ctrl->chunk;
+    if(ctrl->pos < ctrl->xfers[ctrl->index].size)
+    {
+        if(!port_spi_xfer_start(bus))
+            port_spi_batch_end(bus, false);
+        return;
+    }
+
+    port_spi_cs_set(bus, ctrl->xfers[ctrl->index].cs, false);
+    ctrl->pos = 0;
+
+    if(++ctrl->index < ctrl->count)
+    {
+        if(!port_spi_xfer_start(bus))
+            port_spi_batch_end(bus, false);
+    }
+    else
+    {
+        port_spi_batch_end(bus, true);
+    }
+}
+
+// called by HAL_SPI_IRQHandler() and the DMA handlers
+void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef* hspi)
+{
+    port_spi_xfer_end(hspi);
+}
+
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef* hspi)
+{
+    hal_spi_bus_t bus = port_spi_bus_get(hspi);
+
+    if(bus >= HAL_SPI_NUM_BUSES || !port_spi_ctrl[bus].busy)
+        return;
+
+    port_spi_cs_set(bus, port_spi_ctrl[bus].xfers[port_spi_ctrl[bus].index].cs, false);
+    port_spi_batch_end(bus, false);
+}
+
+hal_spi_driver_t HAL_SPI_DRIVER = {
+    .init = port_spi_init,
+    .deinit = port_spi_deinit,
+    .config = port_spi_config,
+    .transfer = port_spi_transfer,
+    .transfer_async = port_spi_transfer_async,
+    .transfer_dma = port_spi_transfer_dma,
+};
@@ -0,0 +1,224 @@
+#include "main.h"
+#include "hal.h"
+
+// HAL timers on the APB1 general purpose timers, counting at 1 MHz. TIM3 and TIM4 are 16 bits
+// (periods up to 65536 us), TIM2 and TIM5 are 32 bits. They must not be enabled in CubeMX, this file
+// has their interrupt handlers, and the HAL time base must stay on SysTick (CubeMX generates its own
+// HAL_TIM_PeriodElapsedCallback() for a TIM time base).
+typedef struct port_timer_map_s
+{
+    TIM_TypeDef* instance;
+    IRQn_Type irq;
+    uint32_t max_period_us;
+} port_timer_map_t;
+
+static const port_timer_map_t port_timer_map[HAL_TIMER_NUM_TIMERS] = {
+    {TIM2, TIM2_IRQn, UINT32_MAX},
+    {TIM3, TIM3_IRQn, 65536},
+    {TIM4, TIM4_IRQn, 65536},
+    {TIM5, TIM5_IRQn, UINT32_MAX},
+};
+
+static const uint32_t port_timer_channels[HAL_TIMER_NUM_CHANNELS] = {TIM_CHANNEL_1, TIM_CHANNEL_2};
+
+static TIM_HandleTypeDef port_timer_handles[HAL_TIMER_NUM_TIMERS];
+static hal_timer_config_t port_timer_cfg[HAL_TIMER_NUM_TIMERS];
+// an interrupt flag set again before the handler clears it is not seen: nothing is counted as merged
+static hal_timer_stats_t port_timer_stats[HAL_TIMER_NUM_TIMERS];
+
+static uint32_t port_timer_clock_get(void)
+{
+    // APB1 timers run at twice PCLK1 when the APB1 prescaler is not 1
+    uint32_t pclk1 = HAL_RCC_GetPCLK1Freq();
+
+    return (RCC->CFGR & RCC_CFGR_PPRE1) == RCC_CFGR_PPRE1_DIV1 ? pclk1 : 2 * pclk1;
+}
+
+static hal_timer_id_t port_timer_id_get(TIM_HandleTypeDef* htim)
+{
+    return (hal_timer_id_t) (htim - port_timer_handles);
+}
+
+static void port_timer_init(void)
+{
+    __HAL_RCC_TIM2_CLK_ENABLE();
+    __HAL_RCC_TIM3_CLK_ENABLE();
+    __HAL_RCC_TIM4_CLK_ENABLE();
+    __HAL_RCC_TIM5_CLK_ENABLE();
+
+    memset(port_timer_handles, 0, sizeof(port_timer_handles));
+    memset(port_timer_cfg, 0, sizeof(port_timer_cfg));
+    memset(port_timer_stats, 0, sizeof(port_timer_stats));
+}
+
+static void port_timer_stop(hal_timer_id_t tmr)
+{
+    TIM_HandleTypeDef* htim = &port_timer_handles[tmr];
+
+    if(htim->Instance == 0)
+        return;
+
+    for(uint32_t channel = 0; channel < HAL_TIMER_NUM_CHANNELS; channel++)
+    {
+        if(port_timer_cfg[tmr].compare_us[channel])
+            HAL_TIM_OC_Stop_IT(htim, port_timer_channels[channel]);
+    }
+
+    HAL_TIM_Base_Stop_IT(htim);
+}
+
+static void port_timer_deinit(void)
+{
+    for(uint32_t tmr = 0; tmr < HAL_TIMER_NUM_TIMERS; tmr++)
+    {
+        port_timer_stop((hal_timer_id_t) tmr);
+        HAL_NVIC_DisableIRQ(port_timer_map[tmr].irq);
+
+        if(port_timer_handles[tmr].Instance)
+            HAL_TIM_OC_DeInit(&port_timer_handles[tmr]);
+
+        port_timer_handles[tmr].Instance = 0;
+    }
+}
+
+static bool port_timer_config(hal_timer_id_t tmr, hal_timer_config_t* cfg)
+{
+    const port_timer_map_t* map = &port_timer_map[tmr];
+    TIM_HandleTypeDef* htim = &port_timer_handles[tmr];
+    TIM_OC_InitTypeDef oc = {
+        .OCMode = TIM_OCMODE_TIMING,
+        .OCPolarity = TIM_OCPOLARITY_HIGH,
+        .OCFastMode = TIM_OCFAST_DISABLE,
+    };
+
+    if(cfg->period_us > map->max_period_us)
+        return false;
+
+    htim->Instance = map->instance;
+    htim->Init.Prescaler = port_timer_clock_get() / 1000000 - 1;
+    htim->Init.CounterMode = TIM_COUNTERMODE_UP;
+    htim->Init.Period = cfg->period_us - 1;
+    htim->Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    htim->Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
+
+    if(HAL_TIM_OC_Init(htim) != HAL_OK)
+        return false;
+
+    for(uint32_t channel = 0; channel < HAL_TIMER_NUM_CHANNELS; channel++)
+    {
+        oc.Pulse = cfg->compare_us[channel];
+        if(cfg->compare_us[channel] && HAL_TIM_OC_ConfigChannel(htim, &oc, port_timer_channels[channel]) != HAL_OK)
+            return false;
+    }
+
+    // one pulse mode: the counter stops at the update event
+    if(cfg->mode == HAL_TIMER_MODE_ONE_SHOT)
+        htim->Instance->CR1 |= TIM_CR1_OPM;
+    else
+        htim->Instance->CR1 &= ~TIM_CR1_OPM;
+
+    port_timer_cfg[tmr] = *cfg;
+
+    HAL_NVIC_SetPriority(map->irq, 5, 0);
+    HAL_NVIC_EnableIRQ(map->irq);
+
+    return true;
+}
+
+static void port_timer_start(hal_timer_id_t tmr)
+{
+    TIM_HandleTypeDef* htim = &port_timer_handles[tmr];
+
+    if(htim->Instance == 0)
+        return;
+
+    port_timer_stop(tmr);
+    memset(&port_timer_stats[tmr], 0, sizeof(hal_timer_stats_t));
+    __HAL_TIM_SET_COUNTER(htim, 0);
+    // the update generated by HAL_TIM_Base_Init() to load the prescaler is not an event
+    __HAL_TIM_CLEAR_FLAG(htim, TIM_FLAG_UPDATE);
+
+    for(uint32_t channel = 0; channel < HAL_TIMER_NUM_CHANNELS; channel++)
+    {
+        if(port_timer_cfg[tmr].compare_us[channel])
+            HAL_TIM_OC_Start_IT(htim, port_timer_channels[channel]);
+    }
+
+    HAL_TIM_Base_Start_IT(htim);
+}
+
+static uint32_t port_timer_count_get(hal_timer_id_t tmr)
+{
+    TIM_HandleTypeDef* htim = &port_timer_handles[tmr];
+
+    return htim->Instance ? __HAL_TIM_GET_COUNTER(htim) : 0;
+}
+
+static void port_timer_stats_get(hal_timer_id_t tmr, hal_timer_stats_t* stats)
+{
+    *stats = port_timer_stats[tmr];
+}
+
+void TIM2_IRQHandler(void)
+{
+    HAL_TIM_IRQHandler(&port_timer_handles[HAL_TIMER_0]);
+}
+
+void TIM3_IRQHandler(void)
+{
+    HAL_TIM_IRQHandler(&port_timer_handles[HAL_TIMER_1]);
+}
+
+void TIM4_IRQHandler(void)
+{
+    HAL_TIM_IRQHandler(&port_timer_handles[HAL_TIMER_2]);
+}
+
+void TIM5_IRQHandler(void)
+{
+    HAL_TIM_IRQHandler(&port_timer_handles[HAL_TIMER_3]);
+}
+
+// called by HAL_TIM_IRQHandler()
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef* htim)
+{
+    uint32_t timestamp = hal_cpu_cycles_get();
+    hal_timer_id_t tmr = port_timer_id_get(htim);
+
+    if(tmr >= HAL_TIMER_NUM_TIMERS)
+        return;
+
+    port_timer_stats[tmr].updates++;
+    if(port_timer_cfg[tmr].update_callback)
+        port_timer_cfg[tmr].update_callback(tmr, timestamp);
+}
+
+void HAL_TIM_OC_DelayElapsedCallback(TIM_HandleTypeDef* htim)
+{
+    uint32_t timestamp = hal_cpu_cycles_get();
+    hal_timer_id_t tmr = port_timer_id_get(htim);
+
+    if(tmr >= HAL_TIMER_NUM_TIMERS)
+        return;
+
+    if(htim->Channel == HAL_TIM_ACTIVE_CHANNEL_1)
+    {
+        port_timer_stats[tmr].compares[0]++;
+        port_timer_cfg[tmr].compare_callback(tmr, 0, timestamp);
+    }
+    else if(htim->Channel == HAL_TIM_ACTIVE_CHANNEL_2)
+    {
+        port_timer_stats[tmr].compares[1]++;
+        port_timer_cfg[tmr].compare_callback(tmr, 1, timestamp);
+    }
+}
+
+hal_timer_driver_t HAL_TIMER_DRIVER = {
+    .init = port_timer_init,
+    .deinit = port_timer_deinit,
+    .config = port_timer_config,
+    .start = port_timer_start,
+    .stop = port_timer_stop,
+    .count_get = port_timer_count_get,
+    .stats_get = port_timer_stats_get,
+};
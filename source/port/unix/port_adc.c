@@ -0,0 +1,376 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "hal.h"
+#include "utl_dbg.h"
+#include "port_reactor.h"
+
+// Samples streamed from a file (adc.wav, PORT_ADC changes the name) at the configured sample rate,
+// played in a loop. WAV files are 16 bits PCM: input n reads channel n of the file and signed
+// samples become codes, (sample + 32768) >> 4. Other files are raw little endian codes with
+// PORT_ADC_RAW_CHANNELS interleaved channels. Inputs without a channel in the file read mid scale.
+//
+// A timerfd fills a half of the buffer at each expiration and calls the callback in the reactor
+// thread. Halves coming due while the callback runs are counted as overruns. When the handler runs
+// after more than one expiration, the missed halves are filled too but only the last one is given
+// to the callback, the DMA would have written over the others: those not explained by an overrun
+// are counted as late.
+
+#ifndef PORT_ADC_RAW_CHANNELS
+#define PORT_ADC_RAW_CHANNELS 1
+#endif
+
+#define PORT_ADC_NAME_LEN 256
+#define PORT_ADC_MID_SCALE (1 << (HAL_ADC_RESOLUTION_BITS - 1))
+#define PORT_ADC_CODE_MASK ((1 << HAL_ADC_RESOLUTION_BITS) - 1)
+
+typedef struct port_adc_ctrl_s
+{
+    hal_adc_config_t cfg;
+    hal_adc_stats_t stats;
+    // source file, mapped
+    const uint8_t* map;
+    size_t map_size;
+    const uint8_t* data;
+    uint32_t num_frames;
+    uint32_t file_channels;
+    bool wav;
+    // next frame of the file and next half of the buffer
+    uint32_t pos;
+    uint32_t half;
+    int timer;
+    uint64_t start_ns;
+    uint64_t fired;
+    // halves the next handler skips because of the last overrun, already counted
+    uint32_t busy_skips;
+    volatile bool running;
+} port_adc_ctrl_t;
+
+static char port_adc_name[PORT_ADC_NAME_LEN] = "adc.wav";
+static port_adc_ctrl_t port_adc_ctrl[HAL_ADC_NUM_ADCS];
+
+static uint64_t port_adc_now_ns(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return (uint64_t) t.tv_sec * 1000000000ULL + (uint64_t) t.tv_nsec;
+}
+
+static struct timespec port_adc_timespec(uint64_t ns)
+{
+    struct timespec t = {.tv_sec = (time_t) (ns / 1000000000ULL), .tv_nsec = (long) (ns % 1000000000ULL)};
+
+    return t;
+}
+
+static uint16_t port_adc_rd16(const uint8_t* p)
+{
+    return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+static uint32_t port_adc_rd32(const uint8_t* p)
+{
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+// end of the n-th half from the start, in nanoseconds
+static uint64_t port_adc_half_end_ns(port_adc_ctrl_t* ctrl, uint64_t n)
+{
+    return ctrl->start_ns + n * ctrl->cfg.frames_per_half * 1000000000ULL / ctrl->cfg.sample_rate_hz;
+}
+
+// halves completed at @p ns
+static uint64_t port_adc_halves_at(port_adc_ctrl_t* ctrl, uint64_t ns)
+{
+    return (ns - ctrl->start_ns) * ctrl->cfg.sample_rate_hz / (ctrl->cfg.frames_per_half * 1000000000ULL);
+}
+
+static bool port_adc_wav_parse(port_adc_ctrl_t* ctrl)
+{
+    const uint8_t* p = ctrl->map + 12;
+    const uint8_t* end = ctrl->map + ctrl->map_size;
+    uint32_t rate = 0;
+
+    ctrl->file_channels = 0;
+
+    while(p + 8 <= end)
+    {
+        uint32_t size = port_adc_rd32(p + 4);
+        const uint8_t* body = p + 8;
+
+        if(size > (size_t) (end - body))
+            size = (uint32_t) (end - body);
+
+        if(memcmp(p, "fmt ", 4) == 0 && size >= 16)
+        {
+            // PCM, 16 bits
+            if(port_adc_rd16(body) != 1 || port_adc_rd16(body + 14) != 16)
+                return false;
+
+            ctrl->file_channels = port_adc_rd16(body + 2);
+            rate = port_adc_rd32(body + 4);
+        }
+        else if(memcmp(p, "data", 4) == 0 && ctrl->file_channels)
+        {
+            ctrl->data = body;
+            ctrl->num_frames = size / (2 * ctrl->file_channels);
+
+            if(rate != ctrl->cfg.sample_rate_hz)
+                UTL_DBG_PRINTF(UTL_DBG_MOD_ADC, "%s recorded at %u Hz, played at %u Hz\n", port_adc_name, rate,
+                               ctrl->cfg.sample_rate_hz);
+
+            return ctrl->num_frames != 0;
+        }
+
+        // chunks are padded to an even size
+        p = body + size + (size & 1);
+    }
+
+    return false;
+}
+
+static void port_adc_unmap(port_adc_ctrl_t* ctrl)
+{
+    if(ctrl->map)
+        munmap((void*) ctrl->map, ctrl->map_size);
+
+    ctrl->map = 0;
+    ctrl->num_frames = 0;
+}
+
+static bool port_adc_map(port_adc_ctrl_t* ctrl)
+{
+    struct stat st;
+
+    port_adc_unmap(ctrl);
+
+    int file = open(port_adc_name, O_RDONLY);
+    if(file < 0 || fstat(file, &st) != 0 || st.st_size < 2)
+    {
+        UTL_DBG_PRINTF(UTL_DBG_MOD_ADC, "Can not open ADC source %s: %s\n", port_adc_name, strerror(errno));
+        if(file >= 0)
+            close(file);
+        return false;
+    }
+
+    const uint8_t* map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+
+    if(map == MAP_FAILED)
+    {
+        UTL_DBG_PRINTF(UTL_DBG_MOD_ADC, "Can not map ADC source %s: %s\n", port_adc_name, strerror(errno));
+        return false;
+    }
+
+    ctrl->map = map;
+    ctrl->map_size = (size_t) st.st_size;
+    ctrl->wav = ctrl->map_size >= 12 && memcmp(map, "RIFF", 4) == 0 && memcmp(map + 8, "WAVE", 4) == 0;
+
+    if(ctrl->wav)
+    {
+        if(!port_adc_wav_parse(ctrl))
+        {
+            UTL_DBG_PRINTF(UTL_DBG_MOD_ADC, "%s: not a 16 bits PCM WAV file\n", port_adc_name);
+            port_adc_unmap(ctrl);
+            return false;
+        }
+    }
+    else
+    {
+        ctrl->data = map;
+        ctrl->file_channels = PORT_ADC_RAW_CHANNELS;
+        ctrl->num_frames = (uint32_t) (ctrl->map_size / (2 * PORT_ADC_RAW_CHANNELS));
+    }
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_ADC, "ADC source %s: %u frames of %u channels\n", port_adc_name, ctrl->num_frames,
+                   ctrl->file_channels);
+
+    return ctrl->num_frames != 0;
+}
+
+static uint16_t port_adc_sample_get(port_adc_ctrl_t* ctrl, uint32_t frame, uint8_t input)
+{
+    if(input >= ctrl->file_channels)
+        return PORT_ADC_MID_SCALE;
+
+    uint16_t value = port_adc_rd16(ctrl->data + 2 * ((size_t) frame * ctrl->file_channels + input));
+
+    if(ctrl->wav)
+        return (uint16_t) (((int32_t) (int16_t) value + 32768) >> (16 - HAL_ADC_RESOLUTION_BITS));
+
+    return value & PORT_ADC_CODE_MASK;
+}
+
+static uint16_t* port_adc_half_fill(port_adc_ctrl_t* ctrl)
+{
+    uint32_t num_channels = ctrl->cfg.num_channels;
+    uint16_t* dst = ctrl->cfg.buffer + ctrl->half * ctrl->cfg.frames_per_half * num_channels;
+
+    for(uint32_t frame = 0; frame < ctrl->cfg.frames_per_half; frame++)
+    {
+        for(uint32_t channel = 0; channel < num_channels; channel++)
+            *dst++ = port_adc_sample_get(ctrl, ctrl->pos, ctrl->cfg.inputs[channel]);
+
+        if(++ctrl->pos >= ctrl->num_frames)
+            ctrl->pos = 0;
+    }
+
+    uint16_t* half = ctrl->cfg.buffer + ctrl->half * ctrl->cfg.frames_per_half * num_channels;
+    ctrl->half ^= 1;
+
+    return half;
+}
+
+static void port_adc_handler(int fd, uint32_t events, void* ctx)
+{
+    port_adc_ctrl_t* ctrl = ctx;
+    uint64_t expirations;
+    uint16_t* half = 0;
+
+    // nothing to read when the ADC was stopped after epoll reported it
+    if(read(fd, &expirations, sizeof(expirations)) != sizeof(expirations) || !ctrl->running)
+        return;
+
+    for(uint64_t n = 0; n < expirations; n++)
+        half = port_adc_half_fill(ctrl);
+
+    uint32_t skipped = (uint32_t) (expirations - 1);
+
+    ctrl->fired += expirations;
+    ctrl->stats.late += skipped > ctrl->busy_skips ? skipped - ctrl->busy_skips : 0;
+    ctrl->stats.halves++;
+
+    uint64_t start_ns = port_adc_now_ns();
+    uint32_t start = hal_cpu_cycles_get();
+    ctrl->cfg.callback((hal_adc_id_t) (ctrl - port_adc_ctrl), half, ctrl->cfg.frames_per_half,
+                       (uint32_t) port_adc_half_end_ns(ctrl, ctrl->fired));
+    uint32_t busy = hal_cpu_cycles_get() - start;
+
+    // halves due before the callback started belong to a late handler, not to an overrun
+    uint64_t due = port_adc_halves_at(ctrl, start_ns);
+    uint64_t done = port_adc_halves_at(ctrl, port_adc_now_ns());
+    uint64_t from = due > ctrl->fired ? due : ctrl->fired;
+    uint32_t overruns = done > from ? (uint32_t) (done - from) : 0;
+
+    ctrl->stats.overruns += overruns;
+    ctrl->busy_skips = overruns ? overruns - 1 : 0;
+
+    ctrl->stats.busy_cycles += busy;
+    if(busy > ctrl->stats.busy_cycles_max)
+        ctrl->stats.busy_cycles_max = busy;
+
+    hal_cpu_wakeup();
+}
+
+static void port_adc_init(void)
+{
+    char* name = getenv("PORT_ADC");
+
+    if(name)
+        snprintf(port_adc_name, PORT_ADC_NAME_LEN, "%s", name);
+
+    for(uint32_t adc = 0; adc < HAL_ADC_NUM_ADCS; adc++)
+    {
+        port_adc_ctrl_t* ctrl = &port_adc_ctrl[adc];
+
+        memset(ctrl, 0, sizeof(port_adc_ctrl_t));
+
+        ctrl->timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if(ctrl->timer >= 0 && !port_reactor_add(ctrl->timer, EPOLLIN, port_adc_handler, ctrl))
+        {
+            close(ctrl->timer);
+            ctrl->timer = -1;
+        }
+
+        if(ctrl->timer < 0)
+            UTL_DBG_PRINTF(UTL_DBG_MOD_ADC, "ADC %u: no sampling timer\n", adc);
+    }
+}
+
+static void port_adc_stop(hal_adc_id_t adc)
+{
+    port_adc_ctrl_t* ctrl = &port_adc_ctrl[adc];
+    struct itimerspec spec = {0};
+
+    ctrl->running = false;
+
+    if(ctrl->timer >= 0)
+        timerfd_settime(ctrl->timer, 0, &spec, NULL);
+}
+
+static void port_adc_deinit(void)
+{
+    for(uint32_t adc = 0; adc < HAL_ADC_NUM_ADCS; adc++)
+    {
+        port_adc_ctrl_t* ctrl = &port_adc_ctrl[adc];
+
+        port_adc_stop((hal_adc_id_t) adc);
+
+        // waits for a running handler, the reactor does not own the descriptor
+        if(ctrl->timer >= 0)
+        {
+            port_reactor_remove(ctrl->timer);
+            close(ctrl->timer);
+            ctrl->timer = -1;
+        }
+
+        port_adc_unmap(ctrl);
+    }
+}
+
+static bool port_adc_config(hal_adc_id_t adc, hal_adc_config_t* cfg)
+{
+    port_adc_ctrl_t* ctrl = &port_adc_ctrl[adc];
+
+    ctrl->cfg = *cfg;
+
+    // the source is opened again, it may have changed since the last configuration
+    return ctrl->timer >= 0 && port_adc_map(ctrl);
+}
+
+static bool port_adc_start(hal_adc_id_t adc)
+{
+    port_adc_ctrl_t* ctrl = &port_adc_ctrl[adc];
+
+    if(ctrl->map == 0)
+        return false;
+
+    port_adc_stop(adc);
+
+    memset(&ctrl->stats, 0, sizeof(ctrl->stats));
+    ctrl->pos = 0;
+    ctrl->half = 0;
+    ctrl->fired = 0;
+    ctrl->busy_skips = 0;
+    ctrl->start_ns = port_adc_now_ns();
+    ctrl->running = true;
+
+    // absolute start, then a period of one half (rounded to the nanosecond)
+    struct itimerspec spec = {
+        .it_value = port_adc_timespec(port_adc_half_end_ns(ctrl, 1)),
+        .it_interval = port_adc_timespec(port_adc_half_end_ns(ctrl, 1) - ctrl->start_ns),
+    };
+
+    return timerfd_settime(ctrl->timer, TFD_TIMER_ABSTIME, &spec, NULL) == 0;
+}
+
+static void port_adc_stats_get(hal_adc_id_t adc, hal_adc_stats_t* stats)
+{
+    *stats = port_adc_ctrl[adc].stats;
+}
+
+hal_adc_driver_t HAL_ADC_DRIVER = {
+    .init = port_adc_init,
+    .deinit = port_adc_deinit,
+    .config = port_adc_config,
+    .start = port_adc_start,
+    .stop = port_adc_stop,
+    .stats_get = port_adc_stats_get,
+};
@@ -0,0 +1,131 @@
+#include <unistd.h>
+#include <time.h>
+#include <sys/timerfd.h>
+
+#include "hal.h"
+#include "port_reactor.h"
+#include "port_bus.h"
+
+static uint64_t port_bus_now_ns(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return (uint64_t) t.tv_sec * 1000000000ULL + (uint64_t) t.tv_nsec;
+}
+
+static void port_bus_handler(int fd, uint32_t events, void* ctx)
+{
+    port_bus_t* bus = ctx;
+    uint64_t expirations;
+
+    if(read(fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+        return;
+
+    bus->complete(bus->ctx);
+    hal_cpu_wakeup();
+}
+
+bool port_bus_init(port_bus_t* bus, const port_bus_timing_t* timing, port_bus_complete_t complete, void* ctx)
+{
+    memset(&bus->stats, 0, sizeof(bus->stats));
+    bus->timing = *timing;
+    bus->complete = complete;
+    bus->ctx = ctx;
+    atomic_store(&bus->busy, false);
+
+    bus->timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if(bus->timer < 0)
+        return false;
+
+    if(!port_reactor_add(bus->timer, EPOLLIN, port_bus_handler, bus))
+    {
+        close(bus->timer);
+        bus->timer = -1;
+        return false;
+    }
+
+    return true;
+}
+
+void port_bus_deinit(port_bus_t* bus)
+{
+    if(bus->timer < 0)
+        return;
+
+    port_reactor_remove(bus->timer);
+    close(bus->timer);
+    bus->timer = -1;
+}
+
+bool port_bus_acquire(port_bus_t* bus)
+{
+    bool idle = false;
+
+    return atomic_compare_exchange_strong(&bus->busy, &idle, true);
+}
+
+void port_bus_release(port_bus_t* bus)
+{
+    atomic_store(&bus->busy, false);
+}
+
+uint64_t port_bus_xfer_account(port_bus_t* bus, port_bus_call_t call, uint32_t bytes, uint64_t wire_ns)
+{
+    uint64_t bus_ns = bus->timing.xfer_ns + wire_ns;
+
+    bus->stats.xfers++;
+    bus->stats.bytes += bytes;
+    bus->stats.bus_ns += bus_ns;
+
+    if(call == PORT_BUS_CALL_BLOCKING)
+    {
+        bus->stats.cpu_ns += bus_ns;
+    }
+    else if(call == PORT_BUS_CALL_ASYNC)
+    {
+        bus->stats.interrupts += bytes;
+        bus->stats.cpu_ns += bus->timing.xfer_ns + (uint64_t) bytes * bus->timing.irq_ns;
+    }
+    else
+    {
+        bus->stats.interrupts++;
+        bus->stats.cpu_ns += bus->timing.xfer_ns + bus->timing.dma_ns;
+    }
+
+    return bus_ns;
+}
+
+bool port_bus_run(port_bus_t* bus, port_bus_call_t call, uint64_t bus_ns)
+{
+    bus->stats.calls++;
+
+    if(call == PORT_BUS_CALL_BLOCKING)
+    {
+        // the CPU is busy on a target too: sleep most of it, spin the end for microsecond accuracy
+        uint64_t end = port_bus_now_ns() + bus_ns;
+
+        if(bus_ns > 200000)
+        {
+            uint64_t sleep_ns = bus_ns - 100000;
+            struct timespec t = {.tv_sec = (time_t) (sleep_ns / 1000000000ULL),
+                                 .tv_nsec = (long) (sleep_ns % 1000000000ULL)};
+            nanosleep(&t, NULL);
+        }
+
+        while(port_bus_now_ns() < end)
+            ;
+
+        return true;
+    }
+
+    // timerfd does not accept a zero expiration, which disarms it
+    struct itimerspec spec = {
+        .it_value = {.tv_sec = (time_t) (bus_ns / 1000000000ULL), .tv_nsec = (long) (bus_ns % 1000000000ULL)},
+    };
+    if(bus_ns == 0)
+        spec.it_value.tv_nsec = 1;
+
+    return timerfd_settime(bus->timer, 0, &spec, NULL) == 0;
+}
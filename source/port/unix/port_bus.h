@@ -0,0 +1,75 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdatomic.h>
+
+// Timing model shared by the simulated SPI and I2C buses. Bytes take their time on the wire (from
+// the bus clock) plus a fixed cost per transfer; blocking calls wait for it, asynchronous and DMA
+// calls end in the reactor thread when it has elapsed. The CPU time each mode would cost on a
+// target is accounted in the statistics: the whole bus time for blocking calls, one interrupt per
+// byte for asynchronous calls, the channel setup per transfer for DMA calls.
+
+typedef struct port_bus_timing_s
+{
+    // per transfer: chip select handling, start and stop conditions, driver code
+    uint32_t xfer_ns;
+    // asynchronous calls: interrupt handler run for each byte
+    uint32_t irq_ns;
+    // DMA calls: channel setup and completion interrupt for each transfer
+    uint32_t dma_ns;
+} port_bus_timing_t;
+
+typedef struct port_bus_stats_s
+{
+    uint32_t calls;
+    uint32_t xfers;
+    uint32_t bytes;
+    uint32_t interrupts;
+    uint64_t bus_ns;
+    uint64_t cpu_ns;
+} port_bus_stats_t;
+
+typedef enum port_bus_call_e
+{
+    PORT_BUS_CALL_BLOCKING = 0,
+    PORT_BUS_CALL_ASYNC,
+    PORT_BUS_CALL_DMA,
+} port_bus_call_t;
+
+// called from the reactor thread when an asynchronous or DMA call ends
+typedef void (*port_bus_complete_t)(void* ctx);
+
+typedef struct port_bus_s
+{
+    port_bus_timing_t timing;
+    port_bus_stats_t stats;
+    int timer;
+    atomic_bool busy;
+    port_bus_complete_t complete;
+    void* ctx;
+} port_bus_t;
+
+bool port_bus_init(port_bus_t* bus, const port_bus_timing_t* timing, port_bus_complete_t complete, void* ctx);
+void port_bus_deinit(port_bus_t* bus);
+
+// take the bus for a call, false when a call is running
+bool port_bus_acquire(port_bus_t* bus);
+void port_bus_release(port_bus_t* bus);
+
+/** Account a transfer of @p bytes taking @p wire_ns on the wire
+    @return Bus time of the transfer
+*/
+uint64_t port_bus_xfer_account(port_bus_t* bus, port_bus_call_t call, uint32_t bytes, uint64_t wire_ns);
+
+/** End a call after @p bus_ns: blocking calls wait here, the others complete in the reactor thread
+    @return false if the completion could not be scheduled
+*/
+bool port_bus_run(port_bus_t* bus, port_bus_call_t call, uint64_t bus_ns);
+
+#ifdef __cplusplus
+}
+#endif
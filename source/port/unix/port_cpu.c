@@ -1,4 +1,5 @@
 #include <pthread.h>
+#include <errno.h>
 #include <unistd.h>
 #include <time.h>
 #include <signal.h>
@@ -9,33 +10,63 @@
 
 #include "hal.h"
 #include "app.h"
+#include "port_reactor.h"
+#include "port_cpu_inline.h"
 
-pthread_mutex_t semaphore;
+pthread_mutex_t port_cpu_semaphore;
+pthread_mutexattr_t semaphore_attr;
+
+// low power mode: the main context sleeps until an interrupt (reactor handler) wakes it up or
+// HAL_CPU_LOW_POWER_MAX_MS elapse (the SysTick of the target)
+static pthread_mutex_t port_cpu_wakeup_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t port_cpu_wakeup_cond = PTHREAD_COND_INITIALIZER;
+static bool port_cpu_wakeup_pending = false;
 
 extern char *main_app_name_get(void);
 
-//interrupt signal handler
-static void port_cpu_sigint_handler(int sig_num)
+static void port_cpu_wakeup(void)
+{
+    pthread_mutex_lock(&port_cpu_wakeup_lock);
+    port_cpu_wakeup_pending = true;
+    pthread_cond_signal(&port_cpu_wakeup_cond);
+    pthread_mutex_unlock(&port_cpu_wakeup_lock);
+}
+
+//interrupt signal handler, called from the reactor thread
+static void port_cpu_sigint_handler(int fd, uint32_t events, void *ctx)
 {
     UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "CTRL+C pressed!\n");
     app_terminate_set();
+    port_cpu_wakeup();
 }
 
 static void port_cpu_init(void)
 {
+    sigset_t mask;
+
+    // critical sections may be nested (e.g. UART calls from inside the main loop lock)
+    pthread_mutexattr_init(&semaphore_attr);
+    pthread_mutexattr_settype(&semaphore_attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&port_cpu_semaphore, &semaphore_attr);
+
     UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "Top master semaphore lock data protection!\n");
-    pthread_mutex_lock(&semaphore);
+    pthread_mutex_lock(&port_cpu_semaphore);
 
-    //atrribute the SIGINT (CTRL+C) terminal command to the handler function
-    signal(SIGINT, port_cpu_sigint_handler);
+    // SIGINT (CTRL+C) is read by the reactor, so it must be blocked before any thread is created
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+    port_reactor_init();
+    port_reactor_signal_add(SIGINT, port_cpu_sigint_handler, 0);
 
     UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "Top master semaphore unlock!\n");
-    pthread_mutex_unlock(&semaphore);
+    pthread_mutex_unlock(&port_cpu_semaphore);
 }
 
 static void port_cpu_deinit(void)
 {
-    //nothing to deinit
+    port_reactor_deinit();
 }
 
 static void port_cpu_reset(void)
@@ -70,22 +101,28 @@ static uint32_t port_cpu_random_seed_get(void)
     return rnd;
 }
 
-static uint32_t port_cpu_critical_section_enter(hal_cpu_cs_level_t level) {
-    pthread_mutex_lock(&semaphore);
-
-    //return timestamp in ms
-    // return port_cpu_time_get_ms();
-    return 0;
-}
-
-static void port_cpu_critical_section_leave(uint32_t last_level)
-{
-    pthread_mutex_unlock(&semaphore);
-}
-
 static void port_cpu_low_power_enter(void)
 {
-    //don't have low power mode implementation 
+    struct timespec deadline;
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += HAL_CPU_LOW_POWER_MAX_MS * 1000000L;
+    if(deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    // a wake up sent while the main context was busy ends the next sleep at once (like the event
+    // register of WFE), so data received between a check and this call are not missed
+    pthread_mutex_lock(&port_cpu_wakeup_lock);
+    while(!port_cpu_wakeup_pending)
+    {
+        if(pthread_cond_timedwait(&port_cpu_wakeup_cond, &port_cpu_wakeup_lock, &deadline) == ETIMEDOUT)
+            break;
+    }
+    port_cpu_wakeup_pending = false;
+    pthread_mutex_unlock(&port_cpu_wakeup_lock);
 }
 
 
@@ -93,13 +130,18 @@ static void port_cpu_sleep_ms(uint32_t tmr_ms) {
     usleep(tmr_ms * 1000);
 }
 
-//port_get_time_since_simul_cpu_boot_ms
-static uint32_t port_cpu_time_get_ms(void)
+// nanoseconds play the role of CPU cycles, wraps every 4.29s
+static uint32_t port_cpu_cycles_get(void)
 {
     struct timespec t;
     clock_gettime(CLOCK_MONOTONIC, &t);
 
-    return (uint32_t)(t.tv_sec * 1000);
+    return (uint32_t) ((uint64_t) t.tv_sec * 1000000000ULL + (uint64_t) t.tv_nsec);
+}
+
+static uint32_t port_cpu_cycles_freq_get(void)
+{
+    return 1000000000UL;
 }
 
 hal_cpu_driver_t HAL_CPU_DRIVER = {
@@ -114,4 +156,7 @@ hal_cpu_driver_t HAL_CPU_DRIVER = {
     .low_power_enter = port_cpu_low_power_enter,
     .sleep_ms = port_cpu_sleep_ms,
     .time_get_ms = port_cpu_time_get_ms,
+    .wakeup = port_cpu_wakeup,
+    .cycles_get = port_cpu_cycles_get,
+    .cycles_freq_get = port_cpu_cycles_freq_get,
 };
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <pthread.h>
+#include <time.h>
+
+// Hot hal_cpu calls of the unix port. port_cpu.c uses them for HAL_CPU_DRIVER and, when
+// HAL_CPU_STATIC_DRIVER is 1, hal_cpu.h calls them directly so they are inlined in the callers.
+
+// recursive mutex, created by port_cpu_init()
+extern pthread_mutex_t port_cpu_semaphore;
+
+static inline uint32_t port_cpu_critical_section_enter(hal_cpu_cs_level_t level)
+{
+    pthread_mutex_lock(&port_cpu_semaphore);
+
+    return 0;
+}
+
+static inline void port_cpu_critical_section_leave(uint32_t last_level)
+{
+    pthread_mutex_unlock(&port_cpu_semaphore);
+}
+
+// port_get_time_since_simul_cpu_boot_ms
+static inline uint32_t port_cpu_time_get_ms(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return (uint32_t) (t.tv_sec * 1000 + t.tv_nsec / 1000000);
+}
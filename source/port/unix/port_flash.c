@@ -0,0 +1,166 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "hal.h"
+#include "utl_dbg.h"
+
+// Flash storage area emulated by an image file (flash.bin, PORT_FLASH changes the name), mapped
+// twice: read only for hal_flash_ptr_get(), so stray writes fault as on a target, and read/write
+// for erase and program. The image is followed by the erase counter of each page, so wear is kept
+// across runs. Programming needs erased write units, as on flashes with ECC.
+
+#ifndef PORT_FLASH_PAGE_SIZE
+#define PORT_FLASH_PAGE_SIZE 2048
+#endif
+
+#ifndef PORT_FLASH_NUM_PAGES
+#define PORT_FLASH_NUM_PAGES 128
+#endif
+
+#ifndef PORT_FLASH_WRITE_SIZE
+#define PORT_FLASH_WRITE_SIZE 8
+#endif
+
+#define PORT_FLASH_NAME_LEN 256
+#define PORT_FLASH_ERASED_VALUE 0xFF
+#define PORT_FLASH_SIZE ((uint32_t) PORT_FLASH_PAGE_SIZE * PORT_FLASH_NUM_PAGES)
+#define PORT_FLASH_FILE_SIZE (PORT_FLASH_SIZE + PORT_FLASH_NUM_PAGES * sizeof(uint32_t))
+
+typedef struct port_flash_ctrl_s
+{
+    char name[PORT_FLASH_NAME_LEN];
+    const uint8_t* rd;
+    uint8_t* wr;
+    uint32_t* erase_counts;
+} port_flash_ctrl_t;
+
+static port_flash_ctrl_t port_flash_ctrl = {.name = "flash.bin"};
+
+static void port_flash_init(void)
+{
+    struct stat st;
+    char* name = getenv("PORT_FLASH");
+
+    if(name)
+        snprintf(port_flash_ctrl.name, PORT_FLASH_NAME_LEN, "%s", name);
+
+    int file = open(port_flash_ctrl.name, O_RDWR | O_CREAT, 0600);
+    if(file < 0 || fstat(file, &st) != 0)
+    {
+        UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "Can not open flash image %s: %s\n", port_flash_ctrl.name, strerror(errno));
+        if(file >= 0)
+            close(file);
+        return;
+    }
+
+    bool format = st.st_size != (off_t) PORT_FLASH_FILE_SIZE;
+    if(format)
+    {
+        if(st.st_size)
+            UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "Flash image %s has another geometry, erasing it\n", port_flash_ctrl.name);
+
+        if(ftruncate(file, 0) != 0 || ftruncate(file, PORT_FLASH_FILE_SIZE) != 0)
+        {
+            UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "Can not resize flash image %s\n", port_flash_ctrl.name);
+            close(file);
+            return;
+        }
+    }
+
+    uint8_t* wr = mmap(NULL, PORT_FLASH_FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    const uint8_t* rd = mmap(NULL, PORT_FLASH_SIZE, PROT_READ, MAP_SHARED, file, 0);
+    close(file);
+
+    if(wr == MAP_FAILED || rd == MAP_FAILED)
+    {
+        UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "Can not map flash image %s: %s\n", port_flash_ctrl.name, strerror(errno));
+        if(wr != MAP_FAILED)
+            munmap(wr, PORT_FLASH_FILE_SIZE);
+        if(rd != MAP_FAILED)
+            munmap((void*) rd, PORT_FLASH_SIZE);
+        return;
+    }
+
+    // a new image leaves the factory erased, with zeroed counters
+    if(format)
+        memset(wr, PORT_FLASH_ERASED_VALUE, PORT_FLASH_SIZE);
+
+    port_flash_ctrl.wr = wr;
+    port_flash_ctrl.rd = rd;
+    port_flash_ctrl.erase_counts = (uint32_t*) (wr + PORT_FLASH_SIZE);
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "Flash image %s: %u pages of %u bytes\n", port_flash_ctrl.name,
+                   PORT_FLASH_NUM_PAGES, PORT_FLASH_PAGE_SIZE);
+}
+
+static void port_flash_deinit(void)
+{
+    if(port_flash_ctrl.wr == 0)
+        return;
+
+    munmap(port_flash_ctrl.wr, PORT_FLASH_FILE_SIZE);
+    munmap((void*) port_flash_ctrl.rd, PORT_FLASH_SIZE);
+    port_flash_ctrl.wr = 0;
+    port_flash_ctrl.rd = 0;
+    port_flash_ctrl.erase_counts = 0;
+}
+
+static void port_flash_info_get(hal_flash_info_t* info)
+{
+    // no image: an empty storage area, every access is out of range
+    info->size = port_flash_ctrl.wr ? PORT_FLASH_SIZE : 0;
+    info->page_size = PORT_FLASH_PAGE_SIZE;
+    info->write_size = PORT_FLASH_WRITE_SIZE;
+    info->erased_value = PORT_FLASH_ERASED_VALUE;
+}
+
+static bool port_flash_page_erase(uint32_t page)
+{
+    memset(port_flash_ctrl.wr + page * PORT_FLASH_PAGE_SIZE, PORT_FLASH_ERASED_VALUE, PORT_FLASH_PAGE_SIZE);
+    port_flash_ctrl.erase_counts[page]++;
+
+    return true;
+}
+
+static bool port_flash_program(uint32_t offset, const uint8_t* data, uint32_t size)
+{
+    uint8_t* dst = port_flash_ctrl.wr + offset;
+
+    // nothing is written when a single unit is not erased
+    for(uint32_t pos = 0; pos < size; pos++)
+    {
+        if(dst[pos] != PORT_FLASH_ERASED_VALUE)
+        {
+            UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "Flash program at 0x%08X: not erased\n",
+                           (offset + pos) & ~(PORT_FLASH_WRITE_SIZE - 1));
+            return false;
+        }
+    }
+
+    memcpy(dst, data, size);
+
+    return true;
+}
+
+static const uint8_t* port_flash_ptr_get(uint32_t offset)
+{
+    return port_flash_ctrl.rd + offset;
+}
+
+static uint32_t port_flash_erase_count_get(uint32_t page)
+{
+    return port_flash_ctrl.erase_counts[page];
+}
+
+hal_flash_driver_t HAL_FLASH_DRIVER = {
+    .init = port_flash_init,
+    .deinit = port_flash_deinit,
+    .info_get = port_flash_info_get,
+    .page_erase = port_flash_page_erase,
+    .program = port_flash_program,
+    .ptr_get = port_flash_ptr_get,
+    .erase_count_get = port_flash_erase_count_get,
+};
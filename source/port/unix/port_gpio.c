@@ -0,0 +1,461 @@
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <time.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "hal.h"
+#include "utl_dbg.h"
+
+// Simulated pins in a shared memory segment (/dev/shm/fwdev_gpio, PORT_GPIO changes the name).
+// Every process mapping the segment sees the same pins: outputs of a simulated device are inputs
+// of another one, and external tools drive inputs by changing the same words.
+//
+// Writers other than this port: flip the pin bit in state and, if watchers[pin] is not zero, store
+// the CLOCK_MONOTONIC time (ns) of the change in rising_ns[pin] (or falling_ns), then OR the pin
+// bit in slots[n].rising (or falling) of every slot in slots_used whose pins include it, increment
+// seq and wake the futex on seq when waiting is not zero. Changing a pin nobody watches for edges
+// is a single atomic operation.
+
+#define PORT_GPIO_NAME_LEN 64
+#define PORT_GPIO_SHM_MAGIC 0x4750494FUL
+#define PORT_GPIO_WAIT_MS 100
+#define PORT_GPIO_MAX_SLOTS 8
+
+// edges pending for one process with edge interrupts, set by writers and taken by its edge thread
+typedef struct port_gpio_slot_s
+{
+    // pins watched by the process
+    _Atomic uint32_t pins;
+    _Atomic uint32_t rising;
+    _Atomic uint32_t falling;
+} port_gpio_slot_t;
+
+typedef struct port_gpio_shm_s
+{
+    _Atomic uint32_t magic;
+    // one bit per pin
+    _Atomic uint32_t state;
+    // pins used as outputs by some process, for tools
+    _Atomic uint32_t outputs;
+    // incremented after each change of a watched pin, futex word of the edge threads
+    _Atomic uint32_t seq;
+    // edge threads sleeping on seq and processes attached
+    _Atomic uint32_t waiting;
+    _Atomic uint32_t users;
+    // processes with edge interrupts on each pin
+    _Atomic uint32_t watchers[HAL_GPIO_NUM_PINS];
+    // time of the last edge of each direction, merged edges keep the stamp of their own direction
+    _Atomic uint64_t rising_ns[HAL_GPIO_NUM_PINS];
+    _Atomic uint64_t falling_ns[HAL_GPIO_NUM_PINS];
+    // one bit per slot
+    _Atomic uint32_t slots_used;
+    port_gpio_slot_t slots[PORT_GPIO_MAX_SLOTS];
+} port_gpio_shm_t;
+
+_Static_assert(HAL_GPIO_NUM_PINS <= 32, "pin states are kept in 32 bits words");
+
+typedef struct port_gpio_ctrl_s
+{
+    char name[PORT_GPIO_NAME_LEN];
+    port_gpio_shm_t* shm;
+    hal_gpio_config_t cfg[HAL_GPIO_NUM_PINS];
+    // inputs calling their interrupt callback on rising/falling edges, pins counted in watchers[]
+    _Atomic uint32_t rising;
+    _Atomic uint32_t falling;
+    uint32_t watched;
+    port_gpio_slot_t* slot;
+    pthread_t thread;
+    volatile bool running;
+} port_gpio_ctrl_t;
+
+static port_gpio_ctrl_t port_gpio_ctrl = {.name = "/fwdev_gpio"};
+// pins private to the process when the segment can not be mapped
+static port_gpio_shm_t port_gpio_local;
+
+static void port_gpio_shm_wait(port_gpio_shm_t* shm, uint32_t seq)
+{
+    struct timespec ts = {.tv_sec = 0, .tv_nsec = PORT_GPIO_WAIT_MS * 1000000L};
+
+    atomic_fetch_add(&shm->waiting, 1);
+    // the futex only sleeps if no change happened since seq was read
+    syscall(SYS_futex, (uint32_t*) &shm->seq, FUTEX_WAIT, seq, &ts, NULL, 0);
+    atomic_fetch_sub(&shm->waiting, 1);
+}
+
+static port_gpio_slot_t* port_gpio_slot_claim(port_gpio_shm_t* shm)
+{
+    uint32_t used = atomic_load(&shm->slots_used);
+
+    for(uint32_t n = 0; n < PORT_GPIO_MAX_SLOTS; n++)
+    {
+        if((used & (1UL << n)) == 0 && (atomic_fetch_or(&shm->slots_used, 1UL << n) & (1UL << n)) == 0)
+        {
+            atomic_store(&shm->slots[n].pins, 0);
+            atomic_store(&shm->slots[n].rising, 0);
+            atomic_store(&shm->slots[n].falling, 0);
+            return &shm->slots[n];
+        }
+    }
+
+    return 0;
+}
+
+static void port_gpio_slot_release(port_gpio_shm_t* shm, port_gpio_slot_t* slot)
+{
+    atomic_store(&slot->pins, 0);
+    atomic_fetch_and(&shm->slots_used, ~(1UL << (slot - shm->slots)));
+}
+
+// the edge is kept until the edge thread of each process watching the pin takes it
+static void port_gpio_shm_edge(port_gpio_shm_t* shm, uint32_t mask, bool rising)
+{
+    uint32_t used = atomic_load(&shm->slots_used);
+
+    for(uint32_t n = 0; n < PORT_GPIO_MAX_SLOTS; n++)
+    {
+        if((used & (1UL << n)) && (atomic_load(&shm->slots[n].pins) & mask))
+            atomic_fetch_or(rising ? &shm->slots[n].rising : &shm->slots[n].falling, mask);
+    }
+}
+
+static void port_gpio_shm_notify(port_gpio_shm_t* shm)
+{
+    atomic_fetch_add(&shm->seq, 1);
+
+    if(atomic_load(&shm->waiting))
+        syscall(SYS_futex, (uint32_t*) &shm->seq, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+}
+
+static port_gpio_shm_t* port_gpio_shm_map(const char* name)
+{
+    bool creator = true;
+    port_gpio_shm_t* shm;
+
+    int file = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if(file < 0 && errno == EEXIST)
+    {
+        creator = false;
+        file = shm_open(name, O_RDWR, 0600);
+    }
+
+    if(file < 0)
+        return 0;
+
+    if(creator && ftruncate(file, sizeof(port_gpio_shm_t)) != 0)
+    {
+        close(file);
+        shm_unlink(name);
+        return 0;
+    }
+
+    // the creator may not have resized the segment yet
+    for(uint32_t retries = 100; !creator; retries--)
+    {
+        struct stat st;
+        if(fstat(file, &st) == 0 && st.st_size >= (off_t) sizeof(port_gpio_shm_t))
+            break;
+
+        if(retries == 0)
+        {
+            close(file);
+            return 0;
+        }
+        usleep(1000);
+    }
+
+    shm = mmap(NULL, sizeof(port_gpio_shm_t), PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    close(file);
+
+    if(shm == MAP_FAILED)
+        return 0;
+
+    if(creator)
+    {
+        // a new segment is all zeros: pins low, nobody waiting
+        atomic_store(&shm->magic, PORT_GPIO_SHM_MAGIC);
+    }
+    else
+    {
+        for(uint32_t retries = 100; atomic_load(&shm->magic) != PORT_GPIO_SHM_MAGIC; retries--)
+        {
+            if(retries == 0)
+            {
+                munmap(shm, sizeof(port_gpio_shm_t));
+                return 0;
+            }
+            usleep(1000);
+        }
+    }
+
+    atomic_fetch_add(&shm->users, 1);
+
+    return shm;
+}
+
+static void port_gpio_edge_call(hal_gpio_pin_t pin, bool state)
+{
+    port_gpio_shm_t* shm = port_gpio_ctrl.shm;
+    uint32_t timestamp = (uint32_t) atomic_load(state ? &shm->rising_ns[pin] : &shm->falling_ns[pin]);
+
+    port_gpio_ctrl.cfg[pin].interrupt_callback(pin, state, timestamp);
+}
+
+static void* port_gpio_edge_thread(void* thread_param)
+{
+    port_gpio_shm_t* shm = port_gpio_ctrl.shm;
+    port_gpio_slot_t* slot = port_gpio_ctrl.slot;
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "Starting GPIO edge thread (%s)\n", port_gpio_ctrl.name);
+
+    while(port_gpio_ctrl.running)
+    {
+        // seq first: an edge set after taking the pending bits makes the wait return at once
+        uint32_t seq = atomic_load(&shm->seq);
+        // edges of pins being configured are dropped
+        uint32_t rising = atomic_exchange(&slot->rising, 0) & atomic_load(&port_gpio_ctrl.rising);
+        uint32_t falling = atomic_exchange(&slot->falling, 0) & atomic_load(&port_gpio_ctrl.falling);
+
+        if((rising | falling) == 0)
+        {
+            port_gpio_shm_wait(shm, seq);
+            continue;
+        }
+
+        // like EXTI pending flags, edges of the same direction on a pin happening before they are
+        // handled are merged: a pulse shorter than the interrupt latency gives both edges, in the
+        // order the current level implies
+        uint32_t state = atomic_load(&shm->state);
+        for(uint32_t pin = HAL_GPIO_PIN_0; pin < HAL_GPIO_NUM_PINS; pin++)
+        {
+            uint32_t mask = 1UL << pin;
+            bool high = (state & mask) != 0;
+
+            if((rising & falling & mask) && high)
+                port_gpio_edge_call((hal_gpio_pin_t) pin, false);
+            if(rising & mask)
+                port_gpio_edge_call((hal_gpio_pin_t) pin, true);
+            if((falling & mask) && !((rising & mask) && high))
+                port_gpio_edge_call((hal_gpio_pin_t) pin, false);
+        }
+
+        hal_cpu_wakeup();
+    }
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "Stoping GPIO edge thread (%s)\n", port_gpio_ctrl.name);
+
+    return 0;
+}
+
+static void port_gpio_init(void)
+{
+    char* name = getenv("PORT_GPIO");
+
+    if(name)
+        snprintf(port_gpio_ctrl.name, PORT_GPIO_NAME_LEN, "%s", name);
+
+    memset(port_gpio_ctrl.cfg, 0, sizeof(port_gpio_ctrl.cfg));
+    atomic_store(&port_gpio_ctrl.rising, 0);
+    atomic_store(&port_gpio_ctrl.falling, 0);
+    port_gpio_ctrl.watched = 0;
+    port_gpio_ctrl.slot = 0;
+    port_gpio_ctrl.running = false;
+
+    port_gpio_ctrl.shm = port_gpio_shm_map(port_gpio_ctrl.name);
+    if(port_gpio_ctrl.shm == 0)
+    {
+        UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "Can not map GPIO shared memory %s (%s), pins are local\n",
+                       port_gpio_ctrl.name, strerror(errno));
+        memset(&port_gpio_local, 0, sizeof(port_gpio_local));
+        port_gpio_ctrl.shm = &port_gpio_local;
+    }
+}
+
+static void port_gpio_deinit(void)
+{
+    port_gpio_shm_t* shm = port_gpio_ctrl.shm;
+
+    if(shm == 0)
+        return;
+
+    if(port_gpio_ctrl.running)
+    {
+        port_gpio_ctrl.running = false;
+        port_gpio_shm_notify(shm);
+        pthread_join(port_gpio_ctrl.thread, NULL);
+    }
+
+    for(uint32_t pin = HAL_GPIO_PIN_0; pin < HAL_GPIO_NUM_PINS; pin++)
+    {
+        if(port_gpio_ctrl.cfg[pin].dir == HAL_GPIO_DIR_OUTPUT)
+            atomic_fetch_and(&shm->outputs, ~(1UL << pin));
+        if(port_gpio_ctrl.watched & (1UL << pin))
+            atomic_fetch_sub(&shm->watchers[pin], 1);
+    }
+
+    port_gpio_ctrl.watched = 0;
+
+    if(port_gpio_ctrl.slot)
+    {
+        port_gpio_slot_release(shm, port_gpio_ctrl.slot);
+        port_gpio_ctrl.slot = 0;
+    }
+
+    port_gpio_ctrl.shm = 0;
+
+    if(shm == &port_gpio_local)
+        return;
+
+    // last one leaving removes the segment
+    if(atomic_fetch_sub(&shm->users, 1) == 1)
+        shm_unlink(port_gpio_ctrl.name);
+
+    munmap(shm, sizeof(port_gpio_shm_t));
+}
+
+static void port_gpio_stamp(port_gpio_shm_t* shm, hal_gpio_pin_t pin, bool state)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    atomic_store(state ? &shm->rising_ns[pin] : &shm->falling_ns[pin],
+                 (uint64_t) t.tv_sec * 1000000000ULL + (uint64_t) t.tv_nsec);
+}
+
+static void port_gpio_set(hal_gpio_pin_t pin, bool state)
+{
+    port_gpio_shm_t* shm = port_gpio_ctrl.shm;
+    uint32_t mask = 1UL << pin;
+
+    if(atomic_load_explicit(&shm->watchers[pin], memory_order_relaxed) == 0)
+    {
+        if(state)
+            atomic_fetch_or(&shm->state, mask);
+        else
+            atomic_fetch_and(&shm->state, ~mask);
+
+        return;
+    }
+
+    uint32_t old = state ? atomic_fetch_or(&shm->state, mask) : atomic_fetch_and(&shm->state, ~mask);
+    if(((old & mask) != 0) != state)
+    {
+        // the stamp must be in place before the pending bit
+        port_gpio_stamp(shm, pin, state);
+        port_gpio_shm_edge(shm, mask, state);
+        port_gpio_shm_notify(shm);
+    }
+}
+
+static bool port_gpio_get(hal_gpio_pin_t pin)
+{
+    return (atomic_load(&port_gpio_ctrl.shm->state) >> pin) & 1;
+}
+
+static void port_gpio_toggle(hal_gpio_pin_t pin)
+{
+    port_gpio_shm_t* shm = port_gpio_ctrl.shm;
+
+    if(atomic_load_explicit(&shm->watchers[pin], memory_order_relaxed) == 0)
+    {
+        atomic_fetch_xor(&shm->state, 1UL << pin);
+        return;
+    }
+
+    uint32_t old = atomic_fetch_xor(&shm->state, 1UL << pin);
+    bool state = (old & (1UL << pin)) == 0;
+    port_gpio_stamp(shm, pin, state);
+    port_gpio_shm_edge(shm, 1UL << pin, state);
+    port_gpio_shm_notify(shm);
+}
+
+static bool port_gpio_config(hal_gpio_pin_t pin, hal_gpio_config_t* cfg)
+{
+    port_gpio_shm_t* shm = port_gpio_ctrl.shm;
+    uint32_t mask = 1UL << pin;
+
+    if(cfg->dir == HAL_GPIO_DIR_INPUT && cfg->edge != HAL_GPIO_EDGE_NONE && cfg->interrupt_callback == 0)
+    {
+        UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "GPIO %d: edge interrupt without callback\n", pin);
+        return false;
+    }
+
+    // no edges while the pin changes its configuration
+    atomic_fetch_and(&port_gpio_ctrl.rising, ~mask);
+    atomic_fetch_and(&port_gpio_ctrl.falling, ~mask);
+    port_gpio_ctrl.cfg[pin] = *cfg;
+
+    bool watch = cfg->dir == HAL_GPIO_DIR_INPUT && cfg->edge != HAL_GPIO_EDGE_NONE;
+    if(watch && port_gpio_ctrl.slot == 0)
+    {
+        port_gpio_ctrl.slot = port_gpio_slot_claim(shm);
+        if(port_gpio_ctrl.slot == 0)
+        {
+            UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "GPIO %d: more than %d processes with edge interrupts\n", pin,
+                           PORT_GPIO_MAX_SLOTS);
+            return false;
+        }
+    }
+
+    if(watch != ((port_gpio_ctrl.watched & mask) != 0))
+    {
+        // writers only timestamp and signal changes of watched pins, the slot is found before
+        // watchers[] says there is one
+        port_gpio_ctrl.watched ^= mask;
+        atomic_store(&port_gpio_ctrl.slot->pins, port_gpio_ctrl.watched);
+        if(watch)
+            atomic_fetch_add(&shm->watchers[pin], 1);
+        else
+            atomic_fetch_sub(&shm->watchers[pin], 1);
+    }
+
+    if(cfg->dir == HAL_GPIO_DIR_OUTPUT)
+    {
+        atomic_fetch_or(&shm->outputs, mask);
+        port_gpio_set(pin, cfg->state);
+        return true;
+    }
+
+    atomic_fetch_and(&shm->outputs, ~mask);
+
+    if(!watch)
+        return true;
+
+    if(!port_gpio_ctrl.running)
+    {
+        port_gpio_ctrl.running = true;
+
+        if(pthread_create(&port_gpio_ctrl.thread, NULL, &port_gpio_edge_thread, 0) != 0)
+        {
+            UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "Cant create GPIO edge thread\n");
+            port_gpio_ctrl.running = false;
+            port_gpio_ctrl.watched &= ~mask;
+            atomic_store(&port_gpio_ctrl.slot->pins, port_gpio_ctrl.watched);
+            atomic_fetch_sub(&shm->watchers[pin], 1);
+            return false;
+        }
+    }
+
+    if(cfg->edge == HAL_GPIO_EDGE_RISING || cfg->edge == HAL_GPIO_EDGE_BOTH)
+        atomic_fetch_or(&port_gpio_ctrl.rising, mask);
+    if(cfg->edge == HAL_GPIO_EDGE_FALLING || cfg->edge == HAL_GPIO_EDGE_BOTH)
+        atomic_fetch_or(&port_gpio_ctrl.falling, mask);
+
+    return true;
+}
+
+hal_gpio_driver_t HAL_GPIO_DRIVER = {
+    .init = port_gpio_init,
+    .deinit = port_gpio_deinit,
+    .config = port_gpio_config,
+    .set = port_gpio_set,
+    .get = port_gpio_get,
+    .toggle = port_gpio_toggle,
+};
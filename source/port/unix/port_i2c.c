@@ -0,0 +1,188 @@
+#include "hal.h"
+#include "port_i2c.h"
+
+// default timing, see port_i2c_timing_set()
+#define PORT_I2C_XFER_NS 5000
+#define PORT_I2C_IRQ_NS 2000
+#define PORT_I2C_DMA_NS 4000
+#define PORT_I2C_CLOCK_HZ 100000
+#define PORT_I2C_NUM_ADDRS 128
+
+typedef struct port_i2c_ctrl_s
+{
+    port_bus_t bus;
+    hal_i2c_config_t cfg;
+    port_i2c_device_t* devices[PORT_I2C_NUM_ADDRS];
+    // batch of the running asynchronous or DMA call
+    hal_i2c_xfer_t* xfers;
+    uint32_t count;
+    hal_i2c_done_t done;
+    void* ctx;
+} port_i2c_ctrl_t;
+
+static port_i2c_ctrl_t port_i2c_ctrl[HAL_I2C_NUM_BUSES];
+
+// stops at the first transfer not acknowledged
+static bool port_i2c_batch_exchange(port_i2c_ctrl_t* ctrl, hal_i2c_xfer_t* xfers, uint32_t count)
+{
+    for(uint32_t n = 0; n < count; n++)
+    {
+        port_i2c_device_t* dev = ctrl->devices[xfers[n].addr];
+
+        if(!dev || !dev->transfer(dev->ctx, xfers[n].tx, xfers[n].tx_size, xfers[n].rx, xfers[n].rx_size))
+            return false;
+    }
+
+    return true;
+}
+
+static uint64_t port_i2c_batch_time(port_i2c_ctrl_t* ctrl, port_bus_call_t call, hal_i2c_xfer_t* xfers,
+                                    uint32_t count)
+{
+    uint64_t bit_ns = 1000000000ULL / ctrl->cfg.clock_hz;
+    uint64_t bus_ns = 0;
+
+    for(uint32_t n = 0; n < count; n++)
+    {
+        // start, address and a bit of acknowledge per byte, repeated start for the read, stop
+        uint64_t bits = 1 + 9 + 9 * (uint64_t) xfers[n].tx_size + 1;
+
+        if(xfers[n].rx_size)
+            bits += 1 + 9 + 9 * (uint64_t) xfers[n].rx_size;
+
+        bus_ns += port_bus_xfer_account(&ctrl->bus, call, xfers[n].tx_size + xfers[n].rx_size, bits * bit_ns);
+    }
+
+    return bus_ns;
+}
+
+static void port_i2c_complete(void* ctx)
+{
+    port_i2c_ctrl_t* ctrl = ctx;
+    hal_i2c_done_t done = ctrl->done;
+    void* done_ctx = ctrl->ctx;
+    bool ok = port_i2c_batch_exchange(ctrl, ctrl->xfers, ctrl->count);
+
+    // released first, the callback may start the next batch
+    port_bus_release(&ctrl->bus);
+    done((hal_i2c_bus_t) (ctrl - port_i2c_ctrl), ok, done_ctx);
+}
+
+static void port_i2c_init(void)
+{
+    port_bus_timing_t timing = {.xfer_ns = PORT_I2C_XFER_NS, .irq_ns = PORT_I2C_IRQ_NS, .dma_ns = PORT_I2C_DMA_NS};
+
+    for(uint32_t bus = 0; bus < HAL_I2C_NUM_BUSES; bus++)
+    {
+        port_i2c_ctrl_t* ctrl = &port_i2c_ctrl[bus];
+
+        memset(ctrl->devices, 0, sizeof(ctrl->devices));
+        ctrl->cfg.clock_hz = PORT_I2C_CLOCK_HZ;
+
+        if(!port_bus_init(&ctrl->bus, &timing, port_i2c_complete, ctrl))
+            UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "I2C bus %u: no completion timer\n", bus);
+    }
+}
+
+static void port_i2c_deinit(void)
+{
+    for(uint32_t bus = 0; bus < HAL_I2C_NUM_BUSES; bus++)
+        port_bus_deinit(&port_i2c_ctrl[bus].bus);
+}
+
+static bool port_i2c_config(hal_i2c_bus_t bus, hal_i2c_config_t* cfg)
+{
+    port_i2c_ctrl_t* ctrl = &port_i2c_ctrl[bus];
+
+    if(!port_bus_acquire(&ctrl->bus))
+        return false;
+
+    ctrl->cfg = *cfg;
+    port_bus_release(&ctrl->bus);
+
+    return true;
+}
+
+static bool port_i2c_transfer(hal_i2c_bus_t bus, hal_i2c_xfer_t* xfers, uint32_t count)
+{
+    port_i2c_ctrl_t* ctrl = &port_i2c_ctrl[bus];
+
+    if(!port_bus_acquire(&ctrl->bus))
+        return false;
+
+    port_bus_run(&ctrl->bus, PORT_BUS_CALL_BLOCKING, port_i2c_batch_time(ctrl, PORT_BUS_CALL_BLOCKING, xfers, count));
+    bool ok = port_i2c_batch_exchange(ctrl, xfers, count);
+    port_bus_release(&ctrl->bus);
+
+    return ok;
+}
+
+static bool port_i2c_start(hal_i2c_bus_t bus, port_bus_call_t call, hal_i2c_xfer_t* xfers, uint32_t count,
+                           hal_i2c_done_t done, void* ctx)
+{
+    port_i2c_ctrl_t* ctrl = &port_i2c_ctrl[bus];
+
+    if(!port_bus_acquire(&ctrl->bus))
+        return false;
+
+    ctrl->xfers = xfers;
+    ctrl->count = count;
+    ctrl->done = done;
+    ctrl->ctx = ctx;
+
+    if(!port_bus_run(&ctrl->bus, call, port_i2c_batch_time(ctrl, call, xfers, count)))
+    {
+        port_bus_release(&ctrl->bus);
+        return false;
+    }
+
+    return true;
+}
+
+static bool port_i2c_transfer_async(hal_i2c_bus_t bus, hal_i2c_xfer_t* xfers, uint32_t count, hal_i2c_done_t done,
+                                    void* ctx)
+{
+    return port_i2c_start(bus, PORT_BUS_CALL_ASYNC, xfers, count, done, ctx);
+}
+
+static bool port_i2c_transfer_dma(hal_i2c_bus_t bus, hal_i2c_xfer_t* xfers, uint32_t count, hal_i2c_done_t done,
+                                  void* ctx)
+{
+    return port_i2c_start(bus, PORT_BUS_CALL_DMA, xfers, count, done, ctx);
+}
+
+bool port_i2c_device_register(hal_i2c_bus_t bus, uint8_t addr, port_i2c_device_t* dev)
+{
+    if(bus >= HAL_I2C_NUM_BUSES || addr >= PORT_I2C_NUM_ADDRS)
+        return false;
+
+    port_i2c_ctrl[bus].devices[addr] = dev;
+    if(dev)
+        UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "I2C bus %u, address 0x%02X: %s\n", bus, addr, dev->name);
+
+    return true;
+}
+
+void port_i2c_timing_set(hal_i2c_bus_t bus, const port_bus_timing_t* timing)
+{
+    port_i2c_ctrl[bus].bus.timing = *timing;
+}
+
+void port_i2c_stats_get(hal_i2c_bus_t bus, port_bus_stats_t* stats)
+{
+    *stats = port_i2c_ctrl[bus].bus.stats;
+}
+
+void port_i2c_stats_reset(hal_i2c_bus_t bus)
+{
+    memset(&port_i2c_ctrl[bus].bus.stats, 0, sizeof(port_bus_stats_t));
+}
+
+hal_i2c_driver_t HAL_I2C_DRIVER = {
+    .init = port_i2c_init,
+    .deinit = port_i2c_deinit,
+    .config = port_i2c_config,
+    .transfer = port_i2c_transfer,
+    .transfer_async = port_i2c_transfer_async,
+    .transfer_dma = port_i2c_transfer_dma,
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "port_bus.h"
+
+// Simulated I2C buses: devices are models registered on an address. Nobody acknowledges an address
+// without a device.
+
+typedef struct port_i2c_device_s
+{
+    const char* name;
+    /** One transaction: write, repeated start, read (@p tx_size or @p rx_size may be 0)
+        @return false when the device does not acknowledge
+    */
+    bool (*transfer)(void* ctx, const uint8_t* tx, uint32_t tx_size, uint8_t* rx, uint32_t rx_size);
+    void* ctx;
+} port_i2c_device_t;
+
+// call after hal_init(), 0 removes the device
+bool port_i2c_device_register(hal_i2c_bus_t bus, uint8_t addr, port_i2c_device_t* dev);
+void port_i2c_timing_set(hal_i2c_bus_t bus, const port_bus_timing_t* timing);
+void port_i2c_stats_get(hal_i2c_bus_t bus, port_bus_stats_t* stats);
+void port_i2c_stats_reset(hal_i2c_bus_t bus);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,64 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "port_spi.h"
+#include "port_i2c.h"
+
+// Device models for the simulated buses, register them with port_i2c_device_register() or
+// port_spi_device_register() using their dev member.
+
+// 24Cxx like I2C EEPROM: one address byte up to 256 bytes, two above. Writes wrap inside a page and
+// start a write cycle during which the device does not acknowledge (poll it with an empty write).
+// Reads go on sequentially over the whole memory.
+typedef struct port_model_eeprom_s
+{
+    port_i2c_device_t dev;
+    uint8_t* mem;
+    uint32_t size;
+    uint32_t page_size;
+    uint32_t addr_bytes;
+    uint64_t write_cycle_ns;
+    uint64_t busy_until_ns;
+    uint32_t ptr;
+    // write cycles and accesses refused during them
+    uint32_t writes;
+    uint32_t nacks;
+} port_model_eeprom_t;
+
+// @p size and @p page_size are powers of 2, @p mem is the memory content
+void port_model_eeprom_init(port_model_eeprom_t* ee, uint8_t* mem, uint32_t size, uint32_t page_size,
+                            uint32_t write_cycle_us);
+
+// LIS3DH like SPI accelerometer. The first byte of a transaction is the register address with bit 7
+// set for reads and bit 6 for auto increment. CTRL_REG1 selects the output data rate, new samples
+// follow a triangle wave on each axis (1 mg per digit, left justified) and set ZYXDA in STATUS_REG
+// until OUT_X_L is read.
+#define PORT_MODEL_SENSOR_WHO_AM_I 0x0F
+#define PORT_MODEL_SENSOR_CTRL_REG1 0x20
+#define PORT_MODEL_SENSOR_STATUS_REG 0x27
+#define PORT_MODEL_SENSOR_OUT_X_L 0x28
+#define PORT_MODEL_SENSOR_READ 0x80
+#define PORT_MODEL_SENSOR_INC 0x40
+#define PORT_MODEL_SENSOR_ID 0x33
+#define PORT_MODEL_SENSOR_ZYXDA 0x08
+#define PORT_MODEL_SENSOR_NUM_REGS 0x40
+
+typedef struct port_model_sensor_s
+{
+    port_spi_device_t dev;
+    uint8_t regs[PORT_MODEL_SENSOR_NUM_REGS];
+    uint64_t start_ns;
+    uint32_t sample;
+} port_model_sensor_t;
+
+void port_model_sensor_init(port_model_sensor_t* sensor);
+// value in mg of an axis for the sample @p sample after the data rate was set
+int16_t port_model_sensor_value(uint32_t sample, uint32_t axis);
+
+#ifdef __cplusplus
+}
+#endif
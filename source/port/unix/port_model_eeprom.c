@@ -0,0 +1,72 @@
+#include <time.h>
+
+#include "hal.h"
+#include "port_model.h"
+
+static uint64_t port_model_eeprom_now_ns(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return (uint64_t) t.tv_sec * 1000000000ULL + (uint64_t) t.tv_nsec;
+}
+
+static bool port_model_eeprom_transfer(void* ctx, const uint8_t* tx, uint32_t tx_size, uint8_t* rx, uint32_t rx_size)
+{
+    port_model_eeprom_t* ee = ctx;
+    uint64_t now_ns = port_model_eeprom_now_ns();
+
+    if(now_ns < ee->busy_until_ns)
+    {
+        ee->nacks++;
+        return false;
+    }
+
+    // the address, then data up to the stop condition
+    if(tx_size >= ee->addr_bytes)
+    {
+        uint32_t addr = 0;
+
+        for(uint32_t n = 0; n < ee->addr_bytes; n++)
+            addr = (addr << 8) | tx[n];
+
+        ee->ptr = addr & (ee->size - 1);
+
+        uint32_t page = ee->ptr & ~(ee->page_size - 1);
+        for(uint32_t n = ee->addr_bytes; n < tx_size; n++)
+        {
+            ee->mem[ee->ptr] = tx[n];
+            ee->ptr = page | ((ee->ptr + 1) & (ee->page_size - 1));
+        }
+
+        if(tx_size > ee->addr_bytes)
+        {
+            ee->busy_until_ns = now_ns + ee->write_cycle_ns;
+            ee->writes++;
+        }
+    }
+
+    for(uint32_t n = 0; n < rx_size; n++)
+    {
+        rx[n] = ee->mem[ee->ptr];
+        ee->ptr = (ee->ptr + 1) & (ee->size - 1);
+    }
+
+    return true;
+}
+
+void port_model_eeprom_init(port_model_eeprom_t* ee, uint8_t* mem, uint32_t size, uint32_t page_size,
+                            uint32_t write_cycle_us)
+{
+    memset(ee, 0, sizeof(port_model_eeprom_t));
+
+    ee->dev.name = "EEPROM";
+    ee->dev.transfer = port_model_eeprom_transfer;
+    ee->dev.ctx = ee;
+    ee->mem = mem;
+    ee->size = size;
+    ee->page_size = page_size;
+    ee->addr_bytes = size > 256 ? 2 : 1;
+    ee->write_cycle_ns = (uint64_t) write_cycle_us * 1000ULL;
+}
@@ -0,0 +1,112 @@
+#include <time.h>
+
+#include "hal.h"
+#include "port_model.h"
+
+// triangle wave of 64 samples between -1000 mg and +1000 mg, phase shifted for each axis, gravity on Z
+#define PORT_MODEL_SENSOR_WAVE_SAMPLES 64
+#define PORT_MODEL_SENSOR_WAVE_MG 1000
+
+static const uint32_t port_model_sensor_odr_hz[16] = {0, 1, 10, 25, 50, 100, 200, 400};
+
+static uint64_t port_model_sensor_now_ns(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return (uint64_t) t.tv_sec * 1000000000ULL + (uint64_t) t.tv_nsec;
+}
+
+int16_t port_model_sensor_value(uint32_t sample, uint32_t axis)
+{
+    const int32_t half = PORT_MODEL_SENSOR_WAVE_SAMPLES / 2;
+    int32_t pos = (int32_t) ((sample + axis * PORT_MODEL_SENSOR_WAVE_SAMPLES / 4) % PORT_MODEL_SENSOR_WAVE_SAMPLES);
+    int32_t mg = pos < half ? pos : PORT_MODEL_SENSOR_WAVE_SAMPLES - pos;
+
+    mg = (mg * 2 * PORT_MODEL_SENSOR_WAVE_MG) / half - PORT_MODEL_SENSOR_WAVE_MG;
+
+    return (int16_t) (axis == 2 ? mg / 2 + 1000 : mg);
+}
+
+// latches the last sample when the data rate gives a new one
+static void port_model_sensor_update(port_model_sensor_t* sensor)
+{
+    uint32_t odr_hz = port_model_sensor_odr_hz[sensor->regs[PORT_MODEL_SENSOR_CTRL_REG1] >> 4];
+
+    if(odr_hz == 0)
+        return;
+
+    uint32_t sample = (uint32_t) ((port_model_sensor_now_ns() - sensor->start_ns) * odr_hz / 1000000000ULL);
+
+    if(sample == sensor->sample)
+        return;
+
+    sensor->sample = sample;
+    for(uint32_t axis = 0; axis < 3; axis++)
+    {
+        uint16_t raw = (uint16_t) (port_model_sensor_value(sample, axis) * 16);
+
+        sensor->regs[PORT_MODEL_SENSOR_OUT_X_L + 2 * axis] = (uint8_t) raw;
+        sensor->regs[PORT_MODEL_SENSOR_OUT_X_L + 2 * axis + 1] = (uint8_t) (raw >> 8);
+    }
+
+    sensor->regs[PORT_MODEL_SENSOR_STATUS_REG] |= PORT_MODEL_SENSOR_ZYXDA;
+}
+
+static void port_model_sensor_transfer(void* ctx, const uint8_t* tx, uint8_t* rx, uint32_t size)
+{
+    port_model_sensor_t* sensor = ctx;
+
+    // the address byte is clocked out while MISO is still floating
+    if(rx)
+        rx[0] = 0xFF;
+
+    if(!tx)
+        return;
+
+    bool read = (tx[0] & PORT_MODEL_SENSOR_READ) != 0;
+    bool inc = (tx[0] & PORT_MODEL_SENSOR_INC) != 0;
+    uint8_t reg = tx[0] & (PORT_MODEL_SENSOR_NUM_REGS - 1);
+
+    port_model_sensor_update(sensor);
+
+    for(uint32_t n = 1; n < size; n++)
+    {
+        if(read)
+        {
+            if(rx)
+                rx[n] = sensor->regs[reg];
+
+            if(reg == PORT_MODEL_SENSOR_OUT_X_L)
+                sensor->regs[PORT_MODEL_SENSOR_STATUS_REG] &= (uint8_t) ~PORT_MODEL_SENSOR_ZYXDA;
+        }
+        else if(reg == PORT_MODEL_SENSOR_CTRL_REG1)
+        {
+            // a new data rate restarts the samples
+            sensor->regs[reg] = tx[n];
+            sensor->start_ns = port_model_sensor_now_ns();
+            sensor->sample = UINT32_MAX;
+        }
+        else if(reg > PORT_MODEL_SENSOR_WHO_AM_I && reg < PORT_MODEL_SENSOR_STATUS_REG)
+        {
+            // other control registers are kept, without effect
+            sensor->regs[reg] = tx[n];
+        }
+
+        if(inc)
+            reg = (reg + 1) & (PORT_MODEL_SENSOR_NUM_REGS - 1);
+    }
+}
+
+void port_model_sensor_init(port_model_sensor_t* sensor)
+{
+    memset(sensor, 0, sizeof(port_model_sensor_t));
+
+    sensor->dev.name = "Accelerometer";
+    sensor->dev.transfer = port_model_sensor_transfer;
+    sensor->dev.ctx = sensor;
+    sensor->regs[PORT_MODEL_SENSOR_WHO_AM_I] = PORT_MODEL_SENSOR_ID;
+    // X, Y and Z enabled, powered down
+    sensor->regs[PORT_MODEL_SENSOR_CTRL_REG1] = 0x07;
+}
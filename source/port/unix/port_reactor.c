@@ -0,0 +1,345 @@
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+#include "hal.h"
+#include "utl_dbg.h"
+#include "port_reactor.h"
+#include "port_cpu_inline.h"
+
+#define PORT_REACTOR_MAX_EVENTS 16
+// epoll user data: slot generation (high 32 bits) and slot index, so events of a source removed
+// while a batch of events is being dispatched are recognized and dropped
+#define PORT_REACTOR_WAKE_INDEX UINT32_MAX
+
+typedef enum port_reactor_type_e
+{
+    PORT_REACTOR_TYPE_FD = 0,
+    PORT_REACTOR_TYPE_TIMER,
+    PORT_REACTOR_TYPE_SIGNAL,
+} port_reactor_type_t;
+
+typedef struct port_reactor_slot_s
+{
+    int fd;
+    uint32_t gen;
+    port_reactor_type_t type;
+    port_reactor_handler_t handler;
+    void* ctx;
+} port_reactor_slot_t;
+
+static port_reactor_slot_t port_reactor_slots[PORT_REACTOR_MAX_SOURCES];
+// protects the slots, not held while a handler runs: handlers may take the CPU critical section,
+// which the main thread holds when it adds or removes sources
+static pthread_mutex_t port_reactor_lock;
+// slot whose handler is running, signaled when it returns
+static pthread_cond_t port_reactor_done;
+static uint32_t port_reactor_busy = PORT_REACTOR_WAKE_INDEX;
+static pthread_t port_reactor_thread;
+static int port_reactor_epoll = -1;
+static int port_reactor_wake = -1;
+static volatile bool port_reactor_running = false;
+
+static uint64_t port_reactor_data(uint32_t index)
+{
+    return ((uint64_t) port_reactor_slots[index].gen << 32) | index;
+}
+
+static port_reactor_slot_t* port_reactor_slot_find(int fd)
+{
+    for(uint32_t index = 0; index < PORT_REACTOR_MAX_SOURCES; index++)
+    {
+        if(port_reactor_slots[index].fd == fd)
+            return &port_reactor_slots[index];
+    }
+
+    return 0;
+}
+
+static void port_reactor_dispatch(struct epoll_event* ev)
+{
+    uint32_t index = (uint32_t) ev->data.u64;
+    uint32_t gen = (uint32_t) (ev->data.u64 >> 32);
+
+    if(index == PORT_REACTOR_WAKE_INDEX)
+    {
+        uint64_t value;
+        if(read(port_reactor_wake, &value, sizeof(value)) < 0)
+            UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "Reactor wake up read error\n");
+        return;
+    }
+
+    pthread_mutex_lock(&port_reactor_lock);
+
+    port_reactor_slot_t* slot = index < PORT_REACTOR_MAX_SOURCES ? &port_reactor_slots[index] : 0;
+    if(slot && slot->fd >= 0 && slot->gen == gen)
+    {
+        port_reactor_slot_t run = *slot;
+
+        // timers and signals are consumed here, handlers only see the event
+        if(slot->type == PORT_REACTOR_TYPE_TIMER)
+        {
+            uint64_t expirations;
+            if(read(slot->fd, &expirations, sizeof(expirations)) < 0)
+                expirations = 0;
+        }
+        else if(slot->type == PORT_REACTOR_TYPE_SIGNAL)
+        {
+            struct signalfd_siginfo info;
+            if(read(slot->fd, &info, sizeof(info)) < 0)
+                memset(&info, 0, sizeof(info));
+        }
+
+        port_reactor_busy = index;
+        pthread_mutex_unlock(&port_reactor_lock);
+
+        run.handler(run.fd, ev->events, run.ctx);
+
+        pthread_mutex_lock(&port_reactor_lock);
+        port_reactor_busy = PORT_REACTOR_WAKE_INDEX;
+        pthread_cond_broadcast(&port_reactor_done);
+    }
+
+    pthread_mutex_unlock(&port_reactor_lock);
+}
+
+static void* port_reactor_thread_run(void* thread_param)
+{
+    struct epoll_event events[PORT_REACTOR_MAX_EVENTS];
+
+    while(port_reactor_running)
+    {
+        int n = epoll_wait(port_reactor_epoll, events, PORT_REACTOR_MAX_EVENTS, -1);
+
+        if(n < 0 && errno != EINTR)
+        {
+            UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "Reactor wait error: %s\n", strerror(errno));
+            break;
+        }
+
+        for(int pos = 0; pos < n; pos++)
+            port_reactor_dispatch(&events[pos]);
+    }
+
+    return 0;
+}
+
+static bool port_reactor_register(int fd, uint32_t events, port_reactor_type_t type, port_reactor_handler_t handler,
+                                  void* ctx)
+{
+    bool ok = false;
+
+    pthread_mutex_lock(&port_reactor_lock);
+
+    port_reactor_slot_t* slot = port_reactor_slot_find(-1);
+    if(slot && port_reactor_epoll >= 0)
+    {
+        uint32_t index = (uint32_t) (slot - port_reactor_slots);
+
+        slot->fd = fd;
+        slot->gen++;
+        slot->type = type;
+        slot->handler = handler;
+        slot->ctx = ctx;
+
+        struct epoll_event ev = {.events = events, .data.u64 = port_reactor_data(index)};
+        ok = epoll_ctl(port_reactor_epoll, EPOLL_CTL_ADD, fd, &ev) == 0;
+        if(!ok)
+            slot->fd = -1;
+    }
+
+    pthread_mutex_unlock(&port_reactor_lock);
+
+    if(!ok)
+        UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "Reactor can not watch fd %d\n", fd);
+
+    return ok;
+}
+
+bool port_reactor_init(void)
+{
+    pthread_mutex_init(&port_reactor_lock, NULL);
+    pthread_cond_init(&port_reactor_done, NULL);
+    port_reactor_busy = PORT_REACTOR_WAKE_INDEX;
+
+    for(uint32_t index = 0; index < PORT_REACTOR_MAX_SOURCES; index++)
+        port_reactor_slots[index].fd = -1;
+
+    port_reactor_epoll = epoll_create1(EPOLL_CLOEXEC);
+    port_reactor_wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(port_reactor_epoll < 0 || port_reactor_wake < 0)
+    {
+        UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "Reactor creation failed: %s\n", strerror(errno));
+        return false;
+    }
+
+    struct epoll_event ev = {.events = EPOLLIN, .data.u64 = PORT_REACTOR_WAKE_INDEX};
+    epoll_ctl(port_reactor_epoll, EPOLL_CTL_ADD, port_reactor_wake, &ev);
+
+    port_reactor_running = true;
+    if(pthread_create(&port_reactor_thread, NULL, &port_reactor_thread_run, NULL) != 0)
+    {
+        UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "Cant create reactor thread\n");
+        port_reactor_running = false;
+        return false;
+    }
+
+    return true;
+}
+
+void port_reactor_deinit(void)
+{
+    uint64_t value = 1;
+
+    if(port_reactor_running)
+    {
+        port_reactor_running = false;
+        if(write(port_reactor_wake, &value, sizeof(value)) < 0)
+            UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "Reactor wake up write error\n");
+        pthread_join(port_reactor_thread, NULL);
+    }
+
+    // timers and signals belong to the reactor, other descriptors to their owners
+    for(uint32_t index = 0; index < PORT_REACTOR_MAX_SOURCES; index++)
+    {
+        if(port_reactor_slots[index].fd >= 0 && port_reactor_slots[index].type != PORT_REACTOR_TYPE_FD)
+            close(port_reactor_slots[index].fd);
+
+        port_reactor_slots[index].fd = -1;
+    }
+
+    if(port_reactor_wake >= 0)
+        close(port_reactor_wake);
+    if(port_reactor_epoll >= 0)
+        close(port_reactor_epoll);
+
+    port_reactor_wake = -1;
+    port_reactor_epoll = -1;
+    pthread_mutex_destroy(&port_reactor_lock);
+    pthread_cond_destroy(&port_reactor_done);
+}
+
+bool port_reactor_add(int fd, uint32_t events, port_reactor_handler_t handler, void* ctx)
+{
+    return port_reactor_register(fd, events, PORT_REACTOR_TYPE_FD, handler, ctx);
+}
+
+bool port_reactor_events_set(int fd, uint32_t events)
+{
+    bool ok = false;
+
+    pthread_mutex_lock(&port_reactor_lock);
+
+    port_reactor_slot_t* slot = port_reactor_slot_find(fd);
+    if(slot)
+    {
+        struct epoll_event ev = {.events = events, .data.u64 = port_reactor_data((uint32_t) (slot - port_reactor_slots))};
+        ok = epoll_ctl(port_reactor_epoll, EPOLL_CTL_MOD, fd, &ev) == 0;
+    }
+
+    pthread_mutex_unlock(&port_reactor_lock);
+
+    return ok;
+}
+
+void port_reactor_remove(int fd)
+{
+    uint32_t depth = 0;
+
+    if(fd < 0)
+        return;
+
+    pthread_mutex_lock(&port_reactor_lock);
+
+    port_reactor_slot_t* slot = port_reactor_slot_find(fd);
+    if(slot)
+    {
+        uint32_t index = (uint32_t) (slot - port_reactor_slots);
+        bool owned = slot->type != PORT_REACTOR_TYPE_FD;
+        bool released = false;
+
+        epoll_ctl(port_reactor_epoll, EPOLL_CTL_DEL, fd, NULL);
+        // free again: the slot may be taken by another source while waiting below
+        slot->fd = -1;
+
+        // a handler removing a source from the reactor thread can not wait for itself. The handler
+        // may wait for the CPU critical section the caller holds (the main loop runs inside it):
+        // the caller gives it up meanwhile, as the interrupt would run to its end on the target
+        while(port_reactor_busy == index && !pthread_equal(pthread_self(), port_reactor_thread))
+        {
+            // the recursive mutex refuses an unlock from a thread not holding it
+            while(!released && pthread_mutex_unlock(&port_cpu_semaphore) == 0)
+                depth++;
+            released = true;
+
+            pthread_cond_wait(&port_reactor_done, &port_reactor_lock);
+        }
+
+        if(owned)
+            close(fd);
+    }
+
+    pthread_mutex_unlock(&port_reactor_lock);
+
+    // taken again after the reactor lock, in the order of the main loop
+    while(depth--)
+        pthread_mutex_lock(&port_cpu_semaphore);
+}
+
+bool port_reactor_timer_set(int timer, uint32_t first_ms, uint32_t period_ms)
+{
+    struct itimerspec spec = {
+        .it_value = {.tv_sec = first_ms / 1000, .tv_nsec = (long) (first_ms % 1000) * 1000000L},
+        .it_interval = {.tv_sec = period_ms / 1000, .tv_nsec = (long) (period_ms % 1000) * 1000000L},
+    };
+
+    return timerfd_settime(timer, 0, &spec, NULL) == 0;
+}
+
+int port_reactor_timer_add(uint32_t first_ms, uint32_t period_ms, port_reactor_handler_t handler, void* ctx)
+{
+    int timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    if(timer < 0)
+        return -1;
+
+    if(!port_reactor_register(timer, EPOLLIN, PORT_REACTOR_TYPE_TIMER, handler, ctx))
+    {
+        close(timer);
+        return -1;
+    }
+
+    port_reactor_timer_set(timer, first_ms, period_ms);
+
+    return timer;
+}
+
+int port_reactor_signal_add(int signum, port_reactor_handler_t handler, void* ctx)
+{
+    sigset_t mask;
+
+    sigemptyset(&mask);
+    sigaddset(&mask, signum);
+
+    int sig = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if(sig < 0)
+        return -1;
+
+    if(!port_reactor_register(sig, EPOLLIN, PORT_REACTOR_TYPE_SIGNAL, handler, ctx))
+    {
+        close(sig);
+        return -1;
+    }
+
+    return sig;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+
+// Single I/O thread for the unix port: file descriptors, timers and signals are multiplexed with
+// epoll and their handlers run in the reactor thread, which plays the role of the interrupt
+// context of a real target. Handlers must not block. They run without any reactor lock held, so they
+// may take the CPU critical section like an interrupt handler of the target.
+
+#define PORT_REACTOR_MAX_SOURCES 64
+
+/** Called from the reactor thread
+    @param fd Source that triggered the call (timer or signal id for timers and signals)
+    @param events EPOLLIN, EPOLLOUT, EPOLLHUP, ... for file descriptors, EPOLLIN for timers/signals
+*/
+typedef void (*port_reactor_handler_t)(int fd, uint32_t events, void* ctx);
+
+/** Create the epoll instance and start the reactor thread.
+    Signals handled with port_reactor_signal_add() must be blocked before this call, so threads
+    created from now on inherit the mask.
+*/
+bool port_reactor_init(void);
+void port_reactor_deinit(void);
+
+/** Watch @p fd for @p events (EPOLLIN, EPOLLOUT, ...), the reactor does not own the descriptor */
+bool port_reactor_add(int fd, uint32_t events, port_reactor_handler_t handler, void* ctx);
+
+/** Change the events watched for @p fd */
+bool port_reactor_events_set(int fd, uint32_t events);
+
+/** Stop watching @p fd (or a timer/signal id). When called from another thread it waits for a
+    running handler of @p fd to return, so @p ctx can be released right after. The CPU critical
+    section held by the caller is given up during that wait, the handler may need it.
+*/
+void port_reactor_remove(int fd);
+
+/** Periodic or one-shot timer (period_ms = 0), first expiration after first_ms
+    @return Timer id or -1 on error, the id is removed with port_reactor_remove()
+*/
+int port_reactor_timer_add(uint32_t first_ms, uint32_t period_ms, port_reactor_handler_t handler, void* ctx);
+
+/** Rearm a timer, first_ms = 0 disarms it */
+bool port_reactor_timer_set(int timer, uint32_t first_ms, uint32_t period_ms);
+
+/** Deliver @p signum to @p handler in the reactor thread instead of using an asynchronous signal handler
+    @return Signal id or -1 on error
+*/
+int port_reactor_signal_add(int signum, port_reactor_handler_t handler, void* ctx);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,182 @@
+#include "hal.h"
+#include "port_spi.h"
+
+// default timing, see port_spi_timing_set()
+#define PORT_SPI_XFER_NS 2000
+#define PORT_SPI_IRQ_NS 1000
+#define PORT_SPI_DMA_NS 3000
+#define PORT_SPI_CLOCK_HZ 1000000
+
+typedef struct port_spi_ctrl_s
+{
+    port_bus_t bus;
+    hal_spi_config_t cfg;
+    port_spi_device_t* devices[HAL_SPI_MAX_CS];
+    // batch of the running asynchronous or DMA call
+    hal_spi_xfer_t* xfers;
+    uint32_t count;
+    hal_spi_done_t done;
+    void* ctx;
+} port_spi_ctrl_t;
+
+static port_spi_ctrl_t port_spi_ctrl[HAL_SPI_NUM_BUSES];
+
+static void port_spi_batch_exchange(port_spi_ctrl_t* ctrl, hal_spi_xfer_t* xfers, uint32_t count)
+{
+    for(uint32_t n = 0; n < count; n++)
+    {
+        port_spi_device_t* dev = ctrl->devices[xfers[n].cs];
+
+        if(dev)
+            dev->transfer(dev->ctx, xfers[n].tx, xfers[n].rx, xfers[n].size);
+        else if(xfers[n].rx)
+            memset(xfers[n].rx, 0xFF, xfers[n].size);
+    }
+}
+
+static uint64_t port_spi_batch_time(port_spi_ctrl_t* ctrl, port_bus_call_t call, hal_spi_xfer_t* xfers,
+                                    uint32_t count)
+{
+    uint64_t bus_ns = 0;
+
+    for(uint32_t n = 0; n < count; n++)
+    {
+        uint64_t wire_ns = (uint64_t) xfers[n].size * 8 * 1000000000ULL / ctrl->cfg.clock_hz;
+        bus_ns += port_bus_xfer_account(&ctrl->bus, call, xfers[n].size, wire_ns);
+    }
+
+    return bus_ns;
+}
+
+static void port_spi_complete(void* ctx)
+{
+    port_spi_ctrl_t* ctrl = ctx;
+    hal_spi_done_t done = ctrl->done;
+    void* done_ctx = ctrl->ctx;
+
+    port_spi_batch_exchange(ctrl, ctrl->xfers, ctrl->count);
+
+    // released first, the callback may start the next batch
+    port_bus_release(&ctrl->bus);
+    done((hal_spi_bus_t) (ctrl - port_spi_ctrl), true, done_ctx);
+}
+
+static void port_spi_init(void)
+{
+    port_bus_timing_t timing = {.xfer_ns = PORT_SPI_XFER_NS, .irq_ns = PORT_SPI_IRQ_NS, .dma_ns = PORT_SPI_DMA_NS};
+
+    for(uint32_t bus = 0; bus < HAL_SPI_NUM_BUSES; bus++)
+    {
+        port_spi_ctrl_t* ctrl = &port_spi_ctrl[bus];
+
+        memset(ctrl->devices, 0, sizeof(ctrl->devices));
+        ctrl->cfg.clock_hz = PORT_SPI_CLOCK_HZ;
+        ctrl->cfg.mode = HAL_SPI_MODE_0;
+
+        if(!port_bus_init(&ctrl->bus, &timing, port_spi_complete, ctrl))
+            UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "SPI bus %u: no completion timer\n", bus);
+    }
+}
+
+static void port_spi_deinit(void)
+{
+    for(uint32_t bus = 0; bus < HAL_SPI_NUM_BUSES; bus++)
+        port_bus_deinit(&port_spi_ctrl[bus].bus);
+}
+
+static bool port_spi_config(hal_spi_bus_t bus, hal_spi_config_t* cfg)
+{
+    port_spi_ctrl_t* ctrl = &port_spi_ctrl[bus];
+
+    if(!port_bus_acquire(&ctrl->bus))
+        return false;
+
+    ctrl->cfg = *cfg;
+    port_bus_release(&ctrl->bus);
+
+    return true;
+}
+
+static bool port_spi_transfer(hal_spi_bus_t bus, hal_spi_xfer_t* xfers, uint32_t count)
+{
+    port_spi_ctrl_t* ctrl = &port_spi_ctrl[bus];
+
+    if(!port_bus_acquire(&ctrl->bus))
+        return false;
+
+    port_bus_run(&ctrl->bus, PORT_BUS_CALL_BLOCKING, port_spi_batch_time(ctrl, PORT_BUS_CALL_BLOCKING, xfers, count));
+    port_spi_batch_exchange(ctrl, xfers, count);
+    port_bus_release(&ctrl->bus);
+
+    return true;
+}
+
+static bool port_spi_start(hal_spi_bus_t bus, port_bus_call_t call, hal_spi_xfer_t* xfers, uint32_t count,
+                           hal_spi_done_t done, void* ctx)
+{
+    port_spi_ctrl_t* ctrl = &port_spi_ctrl[bus];
+
+    if(!port_bus_acquire(&ctrl->bus))
+        return false;
+
+    ctrl->xfers = xfers;
+    ctrl->count = count;
+    ctrl->done = done;
+    ctrl->ctx = ctx;
+
+    if(!port_bus_run(&ctrl->bus, call, port_spi_batch_time(ctrl, call, xfers, count)))
+    {
+        port_bus_release(&ctrl->bus);
+        return false;
+    }
+
+    return true;
+}
+
+static bool port_spi_transfer_async(hal_spi_bus_t bus, hal_spi_xfer_t* xfers, uint32_t count, hal_spi_done_t done,
+                                    void* ctx)
+{
+    return port_spi_start(bus, PORT_BUS_CALL_ASYNC, xfers, count, done, ctx);
+}
+
+static bool port_spi_transfer_dma(hal_spi_bus_t bus, hal_spi_xfer_t* xfers, uint32_t count, hal_spi_done_t done,
+                                  void* ctx)
+{
+    return port_spi_start(bus, PORT_BUS_CALL_DMA, xfers, count, done, ctx);
+}
+
+bool port_spi_device_register(hal_spi_bus_t bus, uint8_t cs, port_spi_device_t* dev)
+{
+    if(bus >= HAL_SPI_NUM_BUSES || cs >= HAL_SPI_MAX_CS)
+        return false;
+
+    port_spi_ctrl[bus].devices[cs] = dev;
+    if(dev)
+        UTL_DBG_PRINTF(UTL_DBG_MOD_PORT, "SPI bus %u, CS %u: %s\n", bus, cs, dev->name);
+
+    return true;
+}
+
+void port_spi_timing_set(hal_spi_bus_t bus, const port_bus_timing_t* timing)
+{
+    port_spi_ctrl[bus].bus.timing = *timing;
+}
+
+void port_spi_stats_get(hal_spi_bus_t bus, port_bus_stats_t* stats)
+{
+    *stats = port_spi_ctrl[bus].bus.stats;
+}
+
+void port_spi_stats_reset(hal_spi_bus_t bus)
+{
+    memset(&port_spi_ctrl[bus].bus.stats, 0, sizeof(port_bus_stats_t));
+}
+
+hal_spi_driver_t HAL_SPI_DRIVER = {
+    .init = port_spi_init,
+    .deinit = port_spi_deinit,
+    .config = port_spi_config,
+    .transfer = port_spi_transfer,
+    .transfer_async = port_spi_transfer_async,
+    .transfer_dma = port_spi_transfer_dma,
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "port_bus.h"
+
+// Simulated SPI buses: devices are models registered on a chip select. Without a device, MISO
+// floats high and reads return 0xFF.
+
+typedef struct port_spi_device_s
+{
+    const char* name;
+    // one chip select framed transaction, @p tx or @p rx may be 0
+    void (*transfer)(void* ctx, const uint8_t* tx, uint8_t* rx, uint32_t size);
+    void* ctx;
+} port_spi_device_t;
+
+// call after hal_init(), 0 removes the device
+bool port_spi_device_register(hal_spi_bus_t bus, uint8_t cs, port_spi_device_t* dev);
+void port_spi_timing_set(hal_spi_bus_t bus, const port_bus_timing_t* timing);
+void port_spi_stats_get(hal_spi_bus_t bus, port_bus_stats_t* stats);
+void port_spi_stats_reset(hal_spi_bus_t bus);
+
+#ifdef __cplusplus
+}
+#endif
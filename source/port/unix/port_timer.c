@@ -0,0 +1,241 @@
+#include <unistd.h>
+#include <time.h>
+#include <sys/timerfd.h>
+
+#include "hal.h"
+#include "port_reactor.h"
+
+// Timers on timerfd (CLOCK_MONOTONIC, absolute expirations from the start of the timer so the
+// update event and the compare channels keep their phase), handled in the reactor thread. The
+// timestamp passed to callbacks is the programmed expiration, the reactor latency can be measured
+// against hal_cpu_cycles_get() (nanoseconds on this port). Expirations missed by a late handler are
+// merged into one call, like a pending interrupt flag, and counted in the statistics.
+
+// event 0 is the update, then one per compare channel
+#define PORT_TIMER_NUM_EVENTS (1 + HAL_TIMER_NUM_CHANNELS)
+
+typedef struct port_timer_event_s
+{
+    hal_timer_id_t tmr;
+    uint32_t event;
+} port_timer_event_t;
+
+typedef struct port_timer_ctrl_s
+{
+    hal_timer_config_t cfg;
+    int fd[PORT_TIMER_NUM_EVENTS];
+    uint64_t fired[PORT_TIMER_NUM_EVENTS];
+    uint32_t calls[PORT_TIMER_NUM_EVENTS];
+    uint32_t merged[PORT_TIMER_NUM_EVENTS];
+    uint64_t start_ns;
+    volatile bool running;
+} port_timer_ctrl_t;
+
+static port_timer_ctrl_t port_timer_ctrl[HAL_TIMER_NUM_TIMERS];
+static port_timer_event_t port_timer_events[HAL_TIMER_NUM_TIMERS][PORT_TIMER_NUM_EVENTS];
+
+static uint64_t port_timer_now_ns(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return (uint64_t) t.tv_sec * 1000000000ULL + (uint64_t) t.tv_nsec;
+}
+
+static struct timespec port_timer_timespec(uint64_t ns)
+{
+    struct timespec t = {.tv_sec = (time_t) (ns / 1000000000ULL), .tv_nsec = (long) (ns % 1000000000ULL)};
+
+    return t;
+}
+
+// offset of an event from the start of the period
+static uint64_t port_timer_offset_ns(port_timer_ctrl_t* ctrl, uint32_t event)
+{
+    return (uint64_t) (event == 0 ? ctrl->cfg.period_us : ctrl->cfg.compare_us[event - 1]) * 1000ULL;
+}
+
+static void port_timer_handler(int fd, uint32_t events, void* ctx)
+{
+    port_timer_event_t* ev = ctx;
+    port_timer_ctrl_t* ctrl = &port_timer_ctrl[ev->tmr];
+    uint64_t expirations;
+
+    // nothing to read when the timer was stopped after epoll reported it
+    if(read(fd, &expirations, sizeof(expirations)) != sizeof(expirations) || !ctrl->running)
+        return;
+
+    ctrl->fired[ev->event] += expirations;
+    ctrl->calls[ev->event]++;
+    ctrl->merged[ev->event] += (uint32_t) (expirations - 1);
+
+    uint64_t when = ctrl->start_ns + port_timer_offset_ns(ctrl, ev->event) +
+                    (ctrl->fired[ev->event] - 1) * (uint64_t) ctrl->cfg.period_us * 1000ULL;
+
+    if(ev->event == 0)
+    {
+        if(ctrl->cfg.mode == HAL_TIMER_MODE_ONE_SHOT)
+            ctrl->running = false;
+
+        if(ctrl->cfg.update_callback)
+            ctrl->cfg.update_callback(ev->tmr, (uint32_t) when);
+    }
+    else
+    {
+        ctrl->cfg.compare_callback(ev->tmr, ev->event - 1, (uint32_t) when);
+    }
+
+    hal_cpu_wakeup();
+}
+
+static void port_timer_event_close(port_timer_ctrl_t* ctrl, uint32_t event)
+{
+    if(ctrl->fd[event] < 0)
+        return;
+
+    // waits for a running handler, the reactor does not own the descriptor
+    port_reactor_remove(ctrl->fd[event]);
+    close(ctrl->fd[event]);
+    ctrl->fd[event] = -1;
+}
+
+static void port_timer_init(void)
+{
+    for(uint32_t tmr = 0; tmr < HAL_TIMER_NUM_TIMERS; tmr++)
+    {
+        port_timer_ctrl_t* ctrl = &port_timer_ctrl[tmr];
+
+        memset(ctrl, 0, sizeof(port_timer_ctrl_t));
+        for(uint32_t event = 0; event < PORT_TIMER_NUM_EVENTS; event++)
+        {
+            ctrl->fd[event] = -1;
+            port_timer_events[tmr][event].tmr = (hal_timer_id_t) tmr;
+            port_timer_events[tmr][event].event = event;
+        }
+    }
+}
+
+static void port_timer_stop(hal_timer_id_t tmr)
+{
+    port_timer_ctrl_t* ctrl = &port_timer_ctrl[tmr];
+    struct itimerspec spec = {0};
+
+    ctrl->running = false;
+
+    for(uint32_t event = 0; event < PORT_TIMER_NUM_EVENTS; event++)
+    {
+        if(ctrl->fd[event] >= 0)
+            timerfd_settime(ctrl->fd[event], 0, &spec, NULL);
+    }
+}
+
+static void port_timer_deinit(void)
+{
+    for(uint32_t tmr = 0; tmr < HAL_TIMER_NUM_TIMERS; tmr++)
+    {
+        port_timer_stop((hal_timer_id_t) tmr);
+
+        for(uint32_t event = 0; event < PORT_TIMER_NUM_EVENTS; event++)
+            port_timer_event_close(&port_timer_ctrl[tmr], event);
+    }
+}
+
+static bool port_timer_config(hal_timer_id_t tmr, hal_timer_config_t* cfg)
+{
+    port_timer_ctrl_t* ctrl = &port_timer_ctrl[tmr];
+
+    ctrl->cfg = *cfg;
+
+    for(uint32_t event = 0; event < PORT_TIMER_NUM_EVENTS; event++)
+    {
+        bool used = event == 0 || cfg->compare_us[event - 1] != 0;
+
+        if(!used)
+        {
+            port_timer_event_close(ctrl, event);
+            continue;
+        }
+
+        if(ctrl->fd[event] >= 0)
+            continue;
+
+        ctrl->fd[event] = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if(ctrl->fd[event] < 0)
+            return false;
+
+        if(!port_reactor_add(ctrl->fd[event], EPOLLIN, port_timer_handler, &port_timer_events[tmr][event]))
+        {
+            close(ctrl->fd[event]);
+            ctrl->fd[event] = -1;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void port_timer_start(hal_timer_id_t tmr)
+{
+    port_timer_ctrl_t* ctrl = &port_timer_ctrl[tmr];
+    uint64_t period_ns = ctrl->cfg.mode == HAL_TIMER_MODE_PERIODIC ? (uint64_t) ctrl->cfg.period_us * 1000ULL : 0;
+
+    port_timer_stop(tmr);
+
+    memset(ctrl->fired, 0, sizeof(ctrl->fired));
+    memset(ctrl->calls, 0, sizeof(ctrl->calls));
+    memset(ctrl->merged, 0, sizeof(ctrl->merged));
+    ctrl->start_ns = port_timer_now_ns();
+    ctrl->running = true;
+
+    for(uint32_t event = 0; event < PORT_TIMER_NUM_EVENTS; event++)
+    {
+        if(ctrl->fd[event] < 0)
+            continue;
+
+        struct itimerspec spec = {
+            .it_value = port_timer_timespec(ctrl->start_ns + port_timer_offset_ns(ctrl, event)),
+            .it_interval = port_timer_timespec(period_ns),
+        };
+
+        timerfd_settime(ctrl->fd[event], TFD_TIMER_ABSTIME, &spec, NULL);
+    }
+}
+
+static uint32_t port_timer_count_get(hal_timer_id_t tmr)
+{
+    port_timer_ctrl_t* ctrl = &port_timer_ctrl[tmr];
+
+    if(!ctrl->running)
+        return 0;
+
+    uint64_t elapsed_us = (port_timer_now_ns() - ctrl->start_ns) / 1000ULL;
+
+    if(ctrl->cfg.mode == HAL_TIMER_MODE_PERIODIC)
+        return (uint32_t) (elapsed_us % ctrl->cfg.period_us);
+
+    return elapsed_us < ctrl->cfg.period_us ? (uint32_t) elapsed_us : ctrl->cfg.period_us;
+}
+
+static void port_timer_stats_get(hal_timer_id_t tmr, hal_timer_stats_t* stats)
+{
+    port_timer_ctrl_t* ctrl = &port_timer_ctrl[tmr];
+
+    stats->updates = ctrl->calls[0];
+    stats->updates_merged = ctrl->merged[0];
+    for(uint32_t channel = 0; channel < HAL_TIMER_NUM_CHANNELS; channel++)
+    {
+        stats->compares[channel] = ctrl->calls[1 + channel];
+        stats->compares_merged[channel] = ctrl->merged[1 + channel];
+    }
+}
+
+hal_timer_driver_t HAL_TIMER_DRIVER = {
+    .init = port_timer_init,
+    .deinit = port_timer_deinit,
+    .config = port_timer_config,
+    .start = port_timer_start,
+    .stop = port_timer_stop,
+    .count_get = port_timer_count_get,
+    .stats_get = port_timer_stats_get,
+};
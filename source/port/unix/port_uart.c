@@ -0,0 +1,982 @@
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#if defined(__linux__)
+#include <linux/serial.h>
+#endif
+
+#include "hal.h"
+#include "utl_dbg.h"
+#include "utl_cbf.h"
+#include "utl_ring.h"
+#include "port_reactor.h"
+
+#define PORT_UART_BUFFER_SIZE 512
+// frame mode: largest frame and room for frames not read yet
+#define PORT_UART_FRAME_MAX_SIZE 1024
+#define PORT_UART_FRAME_QUEUE_SIZE 4096
+#define PORT_FILE_NAME_LEN 64
+#define PORT_UART_RX_CHUNK 256
+#define PORT_UART_TX_CHUNK 256
+// pieces given to a single writev()/sendmsg(), longer lists are sent in groups
+#define PORT_UART_IOV_MAX 16
+#define PORT_UART_RECONNECT_MS 100
+// port names starting with this prefix create a pseudo terminal, the name after
+// the prefix is a symbolic link to the peer side (e.g. "pty:uart0" -> ./uart0 -> /dev/pts/3)
+#define PORT_UART_PTY_PREFIX "pty:"
+// socket ports: "unix:<path>" or "tcp:[<ipv4>]:<port>". The first process to open an address
+// listens on it and the second one connects, so two simulated devices can talk directly.
+#define PORT_UART_UNIX_PREFIX "unix:"
+#define PORT_UART_TCP_PREFIX "tcp:"
+
+typedef enum port_uart_type_e
+{
+    PORT_UART_TYPE_DEVICE = 0,
+    PORT_UART_TYPE_PTY,
+    PORT_UART_TYPE_SOCKET,
+} port_uart_type_t;
+
+static void port_uart_close(hal_uart_dev_t pdev);
+
+UTL_CBF_DECLARE(cb0, PORT_UART_BUFFER_SIZE);
+UTL_CBF_DECLARE(cb1, PORT_UART_BUFFER_SIZE);
+
+struct hal_uart_dev_s
+{
+    utl_cbf_t* cb;
+    uint8_t* cb_area;
+    // bytes accepted by hal_uart_write() and not sent yet, sent by the reactor (tx_buffer only)
+    utl_ring_t* tx;
+    char name[PORT_FILE_NAME_LEN];
+    char peer_name[PORT_FILE_NAME_LEN];
+    hal_uart_config_t cfg;
+    // hal_uart_read_timeout() sleeps here until the reactor has data
+    pthread_mutex_t rx_lock;
+    pthread_cond_t rx_cond;
+    atomic_bool rx_waiting;
+    volatile int file;
+    int peer_file;
+    int listen_file;
+    int reconnect_timer;
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    port_uart_type_t type;
+    hal_uart_stats_t stats;
+    utl_frame_t frame;
+    uint8_t frame_buffer[PORT_UART_FRAME_MAX_SIZE];
+    utl_ring_t* frames;
+#if defined(TIOCGICOUNT)
+    // line error counters of the serial driver when the port was opened
+    struct serial_icounter_struct icount;
+#endif
+    volatile bool in_use;
+    hal_uart_port_t dev;
+};
+
+static _Alignas(uint32_t) uint8_t port_uart_frame_area[HAL_UART_NUM_PORTS][UTL_RING_AREA_SIZE(PORT_UART_FRAME_QUEUE_SIZE)];
+
+static struct hal_uart_dev_s port_uart_ctrl[] = {
+    {.cb = &cb0, .cb_area = cb0buffer, .name = "pty:uart0", .dev = HAL_UART_PORT0},
+    {.cb = &cb1, .cb_area = cb1buffer, .name = "pty:uart1", .dev = HAL_UART_PORT1},
+};
+
+static ssize_t port_uart_send(hal_uart_dev_t pdev, int file, const uint8_t* data, size_t size, bool wait)
+{
+    // pty and device files are non blocking, sockets block unless asked otherwise
+    if(pdev->type == PORT_UART_TYPE_SOCKET)
+        return send(file, data, size, MSG_NOSIGNAL | (wait ? 0 : MSG_DONTWAIT));
+
+    return write(file, data, size);
+}
+
+static bool port_uart_prefix_check(hal_uart_dev_t pdev, const char* prefix)
+{
+    return strncmp(pdev->name, prefix, strlen(prefix)) == 0;
+}
+
+static bool port_uart_socket_addr_get(hal_uart_dev_t pdev)
+{
+    memset(&pdev->addr, 0, sizeof(pdev->addr));
+
+    if(port_uart_prefix_check(pdev, PORT_UART_UNIX_PREFIX))
+    {
+        struct sockaddr_un* addr = (struct sockaddr_un*) &pdev->addr;
+        addr->sun_family = AF_UNIX;
+        snprintf(addr->sun_path, sizeof(addr->sun_path), "%s", pdev->name + strlen(PORT_UART_UNIX_PREFIX));
+        pdev->addr_len = sizeof(struct sockaddr_un);
+    }
+    else
+    {
+        struct sockaddr_in* addr = (struct sockaddr_in*) &pdev->addr;
+        char host[INET_ADDRSTRLEN] = "127.0.0.1";
+        const char* spec = pdev->name + strlen(PORT_UART_TCP_PREFIX);
+        const char* port = strrchr(spec, ':');
+
+        if(port == 0)
+            port = spec;
+        else if(port != spec)
+            snprintf(host, sizeof(host), "%.*s", (int) (port - spec), spec);
+
+        if(*port == ':')
+            port++;
+
+        addr->sin_family = AF_INET;
+        addr->sin_port = htons((uint16_t) atoi(port));
+        if(inet_pton(AF_INET, host, &addr->sin_addr) != 1)
+            return false;
+
+        pdev->addr_len = sizeof(struct sockaddr_in);
+    }
+
+    return true;
+}
+
+static void port_uart_io_handler(int fd, uint32_t events, void* ctx);
+
+static void port_uart_socket_setup(hal_uart_dev_t pdev, int file)
+{
+    int on = 1;
+
+    // bytes are sent as soon as they are written, as a real serial line would do
+    if(pdev->addr.ss_family == AF_INET)
+        setsockopt(file, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    pdev->file = file;
+    port_reactor_add(file, EPOLLIN, port_uart_io_handler, pdev);
+}
+
+static bool port_uart_socket_connect(hal_uart_dev_t pdev)
+{
+    int file = socket(pdev->addr.ss_family, SOCK_STREAM, 0);
+
+    if(file < 0)
+        return false;
+
+    if(connect(file, (struct sockaddr*) &pdev->addr, pdev->addr_len) != 0)
+    {
+        close(file);
+        return false;
+    }
+
+    port_uart_socket_setup(pdev, file);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Port %s connected\n", pdev->name);
+
+    return true;
+}
+
+static bool port_uart_socket_open(hal_uart_dev_t pdev)
+{
+    int on = 1;
+
+    pdev->file = -1;
+    pdev->listen_file = -1;
+
+    if(!port_uart_socket_addr_get(pdev))
+    {
+        UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Invalid socket address %s\n", pdev->name);
+        return false;
+    }
+
+    // somebody already listening, just connect to it
+    if(port_uart_socket_connect(pdev))
+        return true;
+
+    if(pdev->addr.ss_family == AF_UNIX)
+        unlink(((struct sockaddr_un*) &pdev->addr)->sun_path);
+
+    pdev->listen_file = socket(pdev->addr.ss_family, SOCK_STREAM, 0);
+    if(pdev->listen_file < 0)
+        return false;
+
+    setsockopt(pdev->listen_file, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    if(bind(pdev->listen_file, (struct sockaddr*) &pdev->addr, pdev->addr_len) != 0 ||
+       listen(pdev->listen_file, 1) != 0)
+    {
+        UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Can not listen on %s: %s\n", pdev->name, strerror(errno));
+        close(pdev->listen_file);
+        pdev->listen_file = -1;
+        return false;
+    }
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Port %s waiting for connection\n", pdev->name);
+
+    return true;
+}
+
+static void port_uart_socket_accept_handler(int fd, uint32_t events, void* ctx)
+{
+    hal_uart_dev_t pdev = (hal_uart_dev_t) ctx;
+    int file = accept(fd, NULL, NULL);
+
+    if(file < 0)
+        return;
+
+    if(!pdev->in_use)
+    {
+        close(file);
+        return;
+    }
+
+    // a serial line has only one peer
+    if(pdev->file >= 0)
+    {
+        UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Port %s already connected, connection refused\n", pdev->name);
+        close(file);
+        return;
+    }
+
+    port_uart_socket_setup(pdev, file);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Port %s accepted connection\n", pdev->name);
+}
+
+static void port_uart_socket_reconnect_handler(int fd, uint32_t events, void* ctx)
+{
+    hal_uart_dev_t pdev = (hal_uart_dev_t) ctx;
+
+    if(pdev->in_use && port_uart_socket_connect(pdev))
+    {
+        port_reactor_remove(pdev->reconnect_timer);
+        pdev->reconnect_timer = -1;
+    }
+}
+
+static void port_uart_socket_disconnect(hal_uart_dev_t pdev)
+{
+    int file = pdev->file;
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Port %s disconnected\n", pdev->name);
+    port_reactor_remove(file);
+    pdev->file = -1;
+    close(file);
+
+    // the next peer does not get the end of a stream sent to another one
+    if(pdev->tx)
+        utl_ring_skip(pdev->tx, utl_ring_bytes_available(pdev->tx));
+
+    // the listening side went away, retry from time to time
+    if(pdev->in_use && pdev->listen_file < 0)
+        pdev->reconnect_timer = port_reactor_timer_add(PORT_UART_RECONNECT_MS, PORT_UART_RECONNECT_MS,
+                                                       port_uart_socket_reconnect_handler, pdev);
+}
+
+static void port_uart_rx_notify(hal_uart_dev_t pdev)
+{
+    if(pdev->cfg.data_ready_callback)
+        pdev->cfg.data_ready_callback(pdev);
+
+    hal_cpu_wakeup();
+
+    // bytes must be visible before the flag is checked, the reader does the opposite
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if(atomic_load(&pdev->rx_waiting))
+    {
+        pthread_mutex_lock(&pdev->rx_lock);
+        pthread_cond_signal(&pdev->rx_cond);
+        pthread_mutex_unlock(&pdev->rx_lock);
+    }
+}
+
+static void port_uart_frame_handler(void* ctx, uint8_t* frame, uint32_t size)
+{
+    hal_uart_dev_t pdev = (hal_uart_dev_t) ctx;
+
+    if(pdev->cfg.frame_callback)
+        pdev->cfg.frame_callback(frame, size);
+    else if(!utl_frame_queue_put(pdev->frames, frame, size))
+        pdev->stats.rx_overflows += size;
+}
+
+static void port_uart_tx_handler(hal_uart_dev_t pdev, int fd)
+{
+    uint8_t data[PORT_UART_TX_CHUNK];
+
+    // bytes leave the queue only once written, so hal_uart_write() never sends ahead of them
+    uint32_t n = utl_ring_peek(pdev->tx, data, sizeof(data));
+    ssize_t sent = n ? port_uart_send(pdev, fd, data, n, false) : 0;
+    if(sent > 0)
+        utl_ring_skip(pdev->tx, (uint32_t) sent);
+
+    if(utl_ring_bytes_available(pdev->tx) == 0)
+    {
+        port_reactor_events_set(fd, EPOLLIN);
+
+        // a writer may have queued bytes and asked for EPOLLOUT just before, the reactor does not
+        // serialize it with this handler
+        if(utl_ring_bytes_available(pdev->tx) != 0)
+            port_reactor_events_set(fd, EPOLLIN | EPOLLOUT);
+    }
+}
+
+static void port_uart_io_handler(int fd, uint32_t events, void* ctx)
+{
+    uint8_t data[PORT_UART_RX_CHUNK];
+    hal_uart_dev_t pdev = (hal_uart_dev_t) ctx;
+
+    if(events & EPOLLOUT)
+        port_uart_tx_handler(pdev, fd);
+
+    if((events & (EPOLLIN | EPOLLHUP | EPOLLERR)) == 0)
+        return;
+
+    // one read per event, the reactor calls again while there is data
+    ssize_t n = read(fd, data, sizeof(data));
+    if(n < 0 && (errno == EAGAIN || errno == EINTR))
+        return;
+
+    if(n <= 0)
+    {
+        if(pdev->type == PORT_UART_TYPE_SOCKET)
+        {
+            port_uart_socket_disconnect(pdev);
+        }
+        else
+        {
+            // device gone (unplugged adapter, ...), nothing more will be received
+            UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Port %s read error, reception stopped\n", pdev->name);
+            port_reactor_remove(fd);
+        }
+        return;
+    }
+
+    pdev->stats.rx_bytes += (uint32_t) n;
+    hal_uart_capture_rx(pdev->dev, data, (size_t) n);
+
+    if(pdev->cfg.frame.mode != UTL_FRAME_MODE_NONE)
+    {
+        utl_frame_feed(&pdev->frame, data, (uint32_t) n);
+    }
+    else
+    {
+        for(ssize_t pos = 0; pos < n; pos++)
+        {
+            if(pdev->cfg.interrupt_callback)
+                pdev->cfg.interrupt_callback(data[pos]);
+            else if(utl_cbf_put(pdev->cb, data[pos]) == UTL_CBF_FULL)
+                pdev->stats.rx_overflows++;
+        }
+    }
+
+    if(!pdev->cfg.interrupt_callback && !pdev->cfg.frame_callback)
+    {
+        uint32_t occupancy = pdev->cfg.frame.mode != UTL_FRAME_MODE_NONE ? utl_ring_bytes_available(pdev->frames)
+                                                                           : utl_cbf_bytes_available(pdev->cb);
+        if(occupancy > pdev->stats.rx_peak_occupancy)
+            pdev->stats.rx_peak_occupancy = occupancy;
+    }
+
+    port_uart_rx_notify(pdev);
+}
+
+static void port_uart_name_update(size_t dev)
+{
+    // names can be changed without rebuilding, useful when several simulated devices share a host
+    char env[16];
+    snprintf(env, sizeof(env), "PORT_UART%u", (unsigned int) dev);
+    char* name = getenv(env);
+
+    if(name)
+        snprintf(port_uart_ctrl[dev].name, PORT_FILE_NAME_LEN, "%s", name);
+}
+
+static bool port_uart_pty_create(hal_uart_dev_t pdev)
+{
+    const char* link_name = pdev->name + strlen(PORT_UART_PTY_PREFIX);
+
+    pdev->file = posix_openpt(O_RDWR | O_NOCTTY);
+    if(pdev->file < 0 || grantpt(pdev->file) != 0 || unlockpt(pdev->file) != 0 || ptsname(pdev->file) == 0)
+    {
+        UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Can not create pseudo terminal for %s: %s\n", pdev->name, strerror(errno));
+        if(pdev->file >= 0)
+            close(pdev->file);
+        pdev->file = -1;
+        return false;
+    }
+
+    snprintf(pdev->peer_name, PORT_FILE_NAME_LEN, "%s", ptsname(pdev->file));
+    fcntl(pdev->file, F_SETFL, fcntl(pdev->file, F_GETFL) | O_NONBLOCK);
+
+    // keeping the peer side opened avoids EIO/hangups on master while nobody is connected
+    pdev->peer_file = open(pdev->peer_name, O_RDWR | O_NOCTTY);
+
+    unlink(link_name);
+    if(symlink(pdev->peer_name, link_name) != 0)
+        UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Can not create link %s: %s\n", link_name, strerror(errno));
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Pseudo terminal %s -> %s\n", link_name, pdev->peer_name);
+
+    return true;
+}
+
+static void port_uart_init(void)
+{
+    pthread_condattr_t cond_attr;
+
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+
+    for(size_t dev = HAL_UART_PORT0; dev < HAL_UART_NUM_PORTS; dev++)
+    {
+        pthread_mutex_init(&port_uart_ctrl[dev].rx_lock, NULL);
+        pthread_cond_init(&port_uart_ctrl[dev].rx_cond, &cond_attr);
+        atomic_store(&port_uart_ctrl[dev].rx_waiting, false);
+        port_uart_ctrl[dev].frames = utl_ring_init(port_uart_frame_area[dev], sizeof(port_uart_frame_area[dev]));
+
+        port_uart_ctrl[dev].in_use = false;
+        port_uart_ctrl[dev].file = -1;
+        port_uart_ctrl[dev].peer_file = -1;
+        port_uart_ctrl[dev].listen_file = -1;
+        port_uart_ctrl[dev].reconnect_timer = -1;
+        port_uart_ctrl[dev].peer_name[0] = '\0';
+        utl_cbf_flush(port_uart_ctrl[dev].cb);
+    }
+
+    pthread_condattr_destroy(&cond_attr);
+}
+
+static void port_uart_deinit(void)
+{
+    for(size_t dev = HAL_UART_PORT0; dev < HAL_UART_NUM_PORTS; dev++)
+    {
+        if(port_uart_ctrl[dev].in_use)
+        {
+            port_uart_close(&(port_uart_ctrl[dev]));
+        }
+
+        pthread_cond_destroy(&port_uart_ctrl[dev].rx_cond);
+        pthread_mutex_destroy(&port_uart_ctrl[dev].rx_lock);
+    }
+}
+
+static speed_t port_uart_baud_rate_translate(hal_uart_baud_rate_t baud_rate)
+{
+    switch(baud_rate)
+    {
+    case HAL_UART_BAUD_RATE_9600:
+        return B9600;
+    case HAL_UART_BAUD_RATE_19200:
+        return B19200;
+    case HAL_UART_BAUD_RATE_38400:
+        return B38400;
+    case HAL_UART_BAUD_RATE_57600:
+        return B57600;
+    case HAL_UART_BAUD_RATE_115200:
+        return B115200;
+    default:
+        return B9600; // Default to 9600 if unknown
+    }
+}
+
+static void port_uart_termios_set(hal_uart_dev_t pdev, int file)
+{
+    struct termios settings;
+    tcgetattr(file, &settings);
+    cfmakeraw(&settings);
+    cfsetospeed(&settings, port_uart_baud_rate_translate(pdev->cfg.baud_rate));
+    cfsetispeed(&settings, port_uart_baud_rate_translate(pdev->cfg.baud_rate));
+
+    // parity
+    if(pdev->cfg.parity == HAL_UART_PARITY_NONE)
+        settings.c_cflag &= ~PARENB; // no parity
+    else if(pdev->cfg.parity == HAL_UART_PARITY_ODD)
+        settings.c_cflag |= (PARENB | PARODD); // odd parity
+    else if(pdev->cfg.parity == HAL_UART_PARITY_EVEN)
+        settings.c_cflag |= PARENB; // even parity
+
+    // stop bits
+    if(pdev->cfg.stop_bits == HAL_UART_STOP_BITS_1)
+        settings.c_cflag &= ~CSTOPB; // 1 stop bit
+    else if(pdev->cfg.stop_bits == HAL_UART_STOP_BITS_2)
+        settings.c_cflag |= CSTOPB; // 2 stop bits
+
+    // flow control
+    if(pdev->cfg.flow_control == HAL_UART_FLOW_CONTROL_NONE)
+        settings.c_cflag &= ~CRTSCTS;
+    else if(pdev->cfg.flow_control == HAL_UART_FLOW_CONTROL_CTS_RTS)
+        settings.c_cflag |= CRTSCTS;
+
+    // 8 bits data size, receiver enabled, ignore modem lines
+    settings.c_cflag &= ~CSIZE;
+    settings.c_cflag |= CS8 | CREAD | CLOCAL;
+
+    // read returns with what is available
+    settings.c_cc[VMIN] = 0;
+    settings.c_cc[VTIME] = 0;
+
+    tcsetattr(file, TCSANOW, &settings);
+    tcflush(file, TCIOFLUSH);
+}
+
+static void port_uart_files_close(hal_uart_dev_t pdev)
+{
+    if(pdev->file >= 0)
+        close(pdev->file);
+    pdev->file = -1;
+
+    if(pdev->peer_file >= 0)
+        close(pdev->peer_file);
+    pdev->peer_file = -1;
+
+    if(pdev->type == PORT_UART_TYPE_PTY)
+        unlink(pdev->name + strlen(PORT_UART_PTY_PREFIX));
+
+    if(pdev->listen_file >= 0)
+    {
+        close(pdev->listen_file);
+        pdev->listen_file = -1;
+        if(pdev->addr.ss_family == AF_UNIX)
+            unlink(((struct sockaddr_un*) &pdev->addr)->sun_path);
+    }
+
+    pdev->peer_name[0] = '\0';
+}
+
+static hal_uart_dev_t port_uart_open(hal_uart_port_t dev, hal_uart_config_t* cfg)
+{
+    hal_uart_dev_t pdev = 0;
+
+    if(dev >= HAL_UART_NUM_PORTS)
+    {
+        UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Invalid UART port %d\n", dev);
+        return 0;
+    }
+
+    if(port_uart_ctrl[dev].in_use)
+    {
+        UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "UART port %d in use\n", dev);
+        return 0;
+    }
+
+    // point to device and open serial port (or create a pseudo terminal)
+    pdev = &(port_uart_ctrl[dev]);
+    pdev->cfg = *cfg;
+    if(cfg->rx_buffer && cfg->rx_buffer_size > 1)
+        utl_cbf_init(pdev->cb, cfg->rx_buffer, cfg->rx_buffer_size > UINT16_MAX ? UINT16_MAX : cfg->rx_buffer_size);
+    else
+        utl_cbf_init(pdev->cb, pdev->cb_area, PORT_UART_BUFFER_SIZE + 1);
+    pdev->tx = cfg->tx_buffer ? utl_ring_init(cfg->tx_buffer, cfg->tx_buffer_size) : 0;
+    memset(&pdev->stats, 0, sizeof(pdev->stats));
+    utl_ring_flush(pdev->frames);
+    utl_frame_init(&pdev->frame, &cfg->frame, pdev->frame_buffer, sizeof(pdev->frame_buffer), port_uart_frame_handler,
+                   pdev);
+    port_uart_name_update(dev);
+
+    if(port_uart_prefix_check(pdev, PORT_UART_UNIX_PREFIX) || port_uart_prefix_check(pdev, PORT_UART_TCP_PREFIX))
+    {
+        pdev->type = PORT_UART_TYPE_SOCKET;
+        if(!port_uart_socket_open(pdev))
+            return 0;
+
+        // same size as name, always terminated
+        memcpy(pdev->peer_name, pdev->name, PORT_FILE_NAME_LEN);
+    }
+    else if(port_uart_prefix_check(pdev, PORT_UART_PTY_PREFIX))
+    {
+        pdev->type = PORT_UART_TYPE_PTY;
+        if(!port_uart_pty_create(pdev))
+            return 0;
+
+        if(pdev->peer_file >= 0)
+            port_uart_termios_set(pdev, pdev->peer_file);
+
+        port_uart_termios_set(pdev, pdev->file);
+    }
+    else
+    {
+        pdev->type = PORT_UART_TYPE_DEVICE;
+        pdev->file = open(pdev->name, O_RDWR | O_NOCTTY | O_NONBLOCK);
+        if(pdev->file < 0)
+        {
+            UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Can not open serial device %d (%s)\n", dev, pdev->name);
+            return 0;
+        }
+
+        port_uart_termios_set(pdev, pdev->file);
+
+#if defined(TIOCGICOUNT)
+        // not supported by every driver (pty, usb adapters), counters stay at zero then
+        memset(&pdev->icount, 0, sizeof(pdev->icount));
+        ioctl(pdev->file, TIOCGICOUNT, &pdev->icount);
+#endif
+    }
+
+    // connected sockets are already watched (see port_uart_socket_setup())
+    if(pdev->type != PORT_UART_TYPE_SOCKET && !port_reactor_add(pdev->file, EPOLLIN, port_uart_io_handler, pdev))
+    {
+        port_uart_files_close(pdev);
+        return 0;
+    }
+
+    pdev->in_use = true;
+    if(pdev->listen_file >= 0)
+        port_reactor_add(pdev->listen_file, EPOLLIN, port_uart_socket_accept_handler, pdev);
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Serial port %d opened (%s)\n", pdev->dev, pdev->name);
+
+    return pdev;
+}
+
+static void port_uart_close(hal_uart_dev_t pdev)
+{
+    if(pdev->in_use)
+    {
+        // a handler already running may still add a source, later ones see in_use cleared:
+        // after the first removal nothing new is added
+        pdev->in_use = false;
+        port_reactor_remove(pdev->listen_file);
+        port_reactor_remove(pdev->reconnect_timer);
+        port_reactor_remove(pdev->file);
+        pdev->reconnect_timer = -1;
+        port_uart_files_close(pdev);
+    }
+}
+
+static size_t port_uart_bytes_available(hal_uart_dev_t pdev)
+{
+    size_t size;
+
+    if(pdev->cfg.interrupt_callback)
+        return 0;
+
+    uint32_t state = hal_cpu_critical_section_enter(HAL_CPU_CS_PROCESSOR_LEVEL);
+    size = utl_cbf_bytes_available(pdev->cb);
+    hal_cpu_critical_section_leave(state);
+
+    return size;
+}
+
+static ssize_t port_uart_read(hal_uart_dev_t pdev, uint8_t* buffer, size_t size)
+{
+    ssize_t pos = 0;
+
+    // data are not stored on buffers when using interrupt
+    if(pdev->cfg.interrupt_callback)
+        return 0;
+
+    if(port_uart_bytes_available(pdev) == 0)
+        return 0;
+
+    while(pos < size)
+    {
+        if(utl_cbf_get(pdev->cb, &buffer[pos]) == UTL_CBF_EMPTY)
+            break;
+
+        pos++;
+    }
+
+    return pos;
+}
+
+static ssize_t port_uart_read_timeout(hal_uart_dev_t pdev, uint8_t* buffer, size_t min, size_t max,
+                                      uint32_t timeout_ms)
+{
+    struct timespec deadline;
+    size_t pos = 0;
+
+    if(pdev->cfg.interrupt_callback)
+        return 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long) (timeout_ms % 1000) * 1000000L;
+    if(deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pos += (size_t) port_uart_read(pdev, buffer, max);
+
+    if(pos < min)
+    {
+        pthread_mutex_lock(&pdev->rx_lock);
+        atomic_store(&pdev->rx_waiting, true);
+
+        while(pos < min && pdev->in_use)
+        {
+            // check again after announcing the wait, so no notification is lost
+            pos += (size_t) port_uart_read(pdev, buffer + pos, max - pos);
+            if(pos >= min)
+                break;
+
+            if(pthread_cond_timedwait(&pdev->rx_cond, &pdev->rx_lock, &deadline) == ETIMEDOUT)
+            {
+                pos += (size_t) port_uart_read(pdev, buffer + pos, max - pos);
+                break;
+            }
+        }
+
+        atomic_store(&pdev->rx_waiting, false);
+        pthread_mutex_unlock(&pdev->rx_lock);
+    }
+
+    return (ssize_t) pos;
+}
+
+static ssize_t port_uart_write_queued(hal_uart_dev_t pdev, int file, uint8_t* buffer, size_t size)
+{
+    size_t pos = 0;
+
+    // nothing pending: try the line first, the queue only takes what does not go through
+    if(utl_ring_bytes_available(pdev->tx) == 0)
+    {
+        ssize_t sent = port_uart_send(pdev, file, buffer, size, false);
+        if(sent > 0)
+            pos = (size_t) sent;
+    }
+
+    if(pos < size)
+    {
+        pos += utl_ring_write(pdev->tx, buffer + pos, (uint32_t) (size - pos));
+        port_reactor_events_set(file, EPOLLIN | EPOLLOUT);
+
+        if(pos < size)
+            pdev->stats.tx_partial_writes++;
+    }
+
+    return (ssize_t) pos;
+}
+
+static ssize_t port_uart_write(hal_uart_dev_t pdev, uint8_t* buffer, size_t size)
+{
+    ssize_t bytes_written;
+    uint8_t* pdata = buffer;
+    uint32_t retries = 20;
+
+    if(pdev->in_use)
+    {
+        int file = pdev->file;
+
+        if(pdev->tx && file >= 0)
+        {
+            bytes_written = port_uart_write_queued(pdev, file, buffer, size);
+            pdev->stats.tx_bytes += (uint32_t) bytes_written;
+            return bytes_written;
+        }
+
+        while(size > 0)
+        {
+            file = pdev->file;
+
+            // socket without peer: nobody listening, bytes are sent to the void
+            if(file < 0)
+                return (ssize_t) (pdata - buffer) + size;
+
+            bytes_written = port_uart_send(pdev, file, pdata, size, true);
+            if(bytes_written < 0)
+            {
+                // Handle error
+                UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Error writing to serial port %s: %s\n", pdev->name, strerror(errno));
+                pdev->stats.tx_retries++;
+                usleep(1000);
+                if(--retries == 0)
+                    break;
+                else
+                    continue;
+            }
+            retries = 20;
+            if((size_t) bytes_written < size)
+                pdev->stats.tx_partial_writes++;
+
+            pdata += bytes_written;
+            size -= bytes_written;
+        }
+    }
+
+    pdev->stats.tx_bytes += (uint32_t) (pdata - buffer);
+
+    return (ssize_t) (pdata - buffer);
+}
+
+static ssize_t port_uart_sendv(hal_uart_dev_t pdev, int file, struct iovec* vec, size_t cnt, bool wait)
+{
+    if(pdev->type == PORT_UART_TYPE_SOCKET)
+    {
+        struct msghdr msg = {.msg_iov = vec, .msg_iovlen = cnt};
+        return sendmsg(file, &msg, MSG_NOSIGNAL | (wait ? 0 : MSG_DONTWAIT));
+    }
+
+    return writev(file, vec, (int) cnt);
+}
+
+// skip n bytes already written, returns the first piece with bytes left
+static size_t port_uart_iov_advance(struct iovec* vec, size_t first, size_t cnt, size_t n)
+{
+    while(first < cnt && n >= vec[first].iov_len)
+        n -= vec[first++].iov_len;
+
+    if(first < cnt)
+    {
+        vec[first].iov_base = (uint8_t*) vec[first].iov_base + n;
+        vec[first].iov_len -= n;
+    }
+
+    return first;
+}
+
+static size_t port_uart_writev_group(hal_uart_dev_t pdev, const hal_uart_iov_t* iov, size_t cnt, size_t total)
+{
+    struct iovec vec[PORT_UART_IOV_MAX];
+    size_t written = 0, first = 0;
+    uint32_t retries = 20;
+    int file = pdev->file;
+
+    for(size_t n = 0; n < cnt; n++)
+    {
+        vec[n].iov_base = (void*) iov[n].data;
+        vec[n].iov_len = iov[n].size;
+    }
+
+    // socket without peer: nobody listening, bytes are sent to the void
+    if(file < 0)
+        return total;
+
+    if(pdev->tx)
+    {
+        if(utl_ring_bytes_available(pdev->tx) == 0)
+        {
+            ssize_t sent = port_uart_sendv(pdev, file, vec, cnt, false);
+            if(sent > 0)
+                written = (size_t) sent;
+        }
+
+        // what the line did not take goes to the queue, as for hal_uart_write()
+        size_t direct = written;
+        for(first = port_uart_iov_advance(vec, 0, cnt, written); first < cnt && written < total; first++)
+        {
+            uint32_t n = utl_ring_write(pdev->tx, vec[first].iov_base, (uint32_t) vec[first].iov_len);
+            written += n;
+            if(n < vec[first].iov_len)
+                break;
+        }
+
+        if(written > direct)
+            port_reactor_events_set(file, EPOLLIN | EPOLLOUT);
+    }
+    else
+    {
+        while(written < total)
+        {
+            ssize_t sent = port_uart_sendv(pdev, file, vec + first, cnt - first, true);
+            if(sent < 0)
+            {
+                UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Error writing to serial port %s: %s\n", pdev->name, strerror(errno));
+                pdev->stats.tx_retries++;
+                usleep(1000);
+                if(--retries == 0)
+                    break;
+                else
+                    continue;
+            }
+            retries = 20;
+
+            written += (size_t) sent;
+            first = port_uart_iov_advance(vec, first, cnt, (size_t) sent);
+        }
+    }
+
+    if(written < total)
+        pdev->stats.tx_partial_writes++;
+
+    return written;
+}
+
+static ssize_t port_uart_writev(hal_uart_dev_t pdev, const hal_uart_iov_t* iov, size_t cnt)
+{
+    size_t written = 0;
+
+    if(!pdev->in_use)
+        return 0;
+
+    for(size_t first = 0; first < cnt; first += PORT_UART_IOV_MAX)
+    {
+        size_t group = cnt - first < PORT_UART_IOV_MAX ? cnt - first : PORT_UART_IOV_MAX;
+        size_t total = 0;
+
+        for(size_t n = first; n < first + group; n++)
+            total += iov[n].size;
+
+        size_t n = port_uart_writev_group(pdev, iov + first, group, total);
+        written += n;
+        if(n < total)
+            break;
+    }
+
+    pdev->stats.tx_bytes += (uint32_t) written;
+
+    return (ssize_t) written;
+}
+
+static void port_uart_flush(hal_uart_dev_t pdev)
+{
+    if(pdev->cfg.interrupt_callback)
+        return;
+
+    uint32_t state = hal_cpu_critical_section_enter(HAL_CPU_CS_PROCESSOR_LEVEL);
+    utl_cbf_flush(pdev->cb);
+    hal_cpu_critical_section_leave(state);
+
+    utl_ring_flush(pdev->frames);
+}
+
+static ssize_t port_uart_frame_read(hal_uart_dev_t pdev, uint8_t* buffer, size_t size)
+{
+    if(pdev->cfg.frame.mode == UTL_FRAME_MODE_NONE || pdev->cfg.frame_callback)
+        return 0;
+
+    return (ssize_t) utl_frame_queue_get(pdev->frames, buffer, (uint32_t) size);
+}
+
+static void port_uart_stats_get(hal_uart_dev_t pdev, hal_uart_stats_t* stats)
+{
+    *stats = pdev->stats;
+
+#if defined(TIOCGICOUNT)
+    struct serial_icounter_struct icount;
+
+    if(pdev->in_use && pdev->type == PORT_UART_TYPE_DEVICE && ioctl(pdev->file, TIOCGICOUNT, &icount) == 0)
+    {
+        stats->framing_errors = (uint32_t) (icount.frame - pdev->icount.frame);
+        stats->parity_errors = (uint32_t) (icount.parity - pdev->icount.parity);
+        stats->rx_overflows += (uint32_t) ((icount.overrun - pdev->icount.overrun) +
+                                           (icount.buf_overrun - pdev->icount.buf_overrun));
+    }
+#endif
+}
+
+static const char* port_uart_peer_name_get(hal_uart_dev_t pdev)
+{
+    return pdev->peer_name[0] ? pdev->peer_name : 0;
+}
+
+hal_uart_driver_t HAL_UART_DRIVER = {
+    .init = port_uart_init,
+    .deinit = port_uart_deinit,
+    .open = port_uart_open,
+    .close = port_uart_close,
+    .bytes_available = port_uart_bytes_available,
+    .read = port_uart_read,
+    .write = port_uart_write,
+    .flush = port_uart_flush,
+    .read_timeout = port_uart_read_timeout,
+    .frame_read = port_uart_frame_read,
+    .stats_get = port_uart_stats_get,
+    .peer_name_get = port_uart_peer_name_get,
+    .writev = port_uart_writev,
+};
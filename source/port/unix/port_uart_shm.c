@@ -0,0 +1,560 @@
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <time.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "hal.h"
+#include "utl_dbg.h"
+#include "utl_ring.h"
+
+// UART link between two processes through a shared memory segment named after the port
+// (/dev/shm/fwdev_uart0, ...). The first process to open a segment creates it, the second one
+// attaches to the other side. Each direction is a lock-free ring; readers and blocked writers
+// sleep on futexes, so a write only costs a syscall when the other side is actually sleeping.
+
+#ifndef PORT_UART_SHM_RING_SIZE
+#define PORT_UART_SHM_RING_SIZE (64 * 1024)
+#endif
+
+#define PORT_FILE_NAME_LEN 64
+#define PORT_UART_SHM_MAGIC 0x55415254UL
+#define PORT_UART_SHM_NUM_SIDES 2
+#define PORT_UART_SHM_RX_CHUNK 256
+#define PORT_UART_SHM_WAIT_MS 100
+// frame mode: largest frame and room for frames not read yet (local to the process)
+#define PORT_UART_SHM_FRAME_MAX_SIZE 1024
+#define PORT_UART_SHM_FRAME_QUEUE_SIZE 4096
+
+typedef struct port_uart_shm_dir_s
+{
+    _Atomic uint32_t rx_waiting; // readers sleeping on ring->prod (reader and RX thread)
+    _Atomic uint32_t tx_waiting; // writer sleeping on ring->cons
+    // updated by the writer, as the reader can not see what did not fit
+    _Atomic uint32_t rx_overflows;
+    _Atomic uint32_t rx_peak_occupancy;
+    uint32_t ring_offset;
+} port_uart_shm_dir_t;
+
+typedef struct port_uart_shm_hdr_s
+{
+    _Atomic uint32_t magic;
+    _Atomic uint32_t sides;
+    // dir[n] holds the bytes received by side n
+    port_uart_shm_dir_t dir[PORT_UART_SHM_NUM_SIDES];
+} port_uart_shm_hdr_t;
+
+#define PORT_UART_SHM_RING_AREA ((UTL_RING_AREA_SIZE(PORT_UART_SHM_RING_SIZE) + 63) & ~63UL)
+#define PORT_UART_SHM_HDR_AREA ((sizeof(port_uart_shm_hdr_t) + 63) & ~63UL)
+#define PORT_UART_SHM_SEG_SIZE (PORT_UART_SHM_HDR_AREA + PORT_UART_SHM_NUM_SIDES * PORT_UART_SHM_RING_AREA)
+
+static void port_uart_close(hal_uart_dev_t pdev);
+
+struct hal_uart_dev_s
+{
+    char name[PORT_FILE_NAME_LEN];
+    hal_uart_config_t cfg;
+    port_uart_shm_hdr_t* shm;
+    port_uart_shm_dir_t* rx_dir;
+    port_uart_shm_dir_t* tx_dir;
+    utl_ring_t* rx;
+    utl_ring_t* tx;
+    pthread_t thread;
+    uint32_t side;
+    hal_uart_stats_t stats;
+    utl_frame_t frame;
+    uint8_t frame_buffer[PORT_UART_SHM_FRAME_MAX_SIZE];
+    utl_ring_t* frames;
+    volatile bool in_use;
+    hal_uart_port_t dev;
+};
+
+static _Alignas(uint32_t) uint8_t port_uart_frame_area[HAL_UART_NUM_PORTS][UTL_RING_AREA_SIZE(PORT_UART_SHM_FRAME_QUEUE_SIZE)];
+
+static struct hal_uart_dev_s port_uart_ctrl[] = {
+    {.name = "/fwdev_uart0", .dev = HAL_UART_PORT0},
+    {.name = "/fwdev_uart1", .dev = HAL_UART_PORT1},
+};
+
+static void port_uart_shm_wait(_Atomic uint32_t* word, uint32_t val, _Atomic uint32_t* waiting, uint32_t wait_ms)
+{
+    struct timespec ts = {.tv_sec = wait_ms / 1000, .tv_nsec = (long) (wait_ms % 1000) * 1000000L};
+
+    atomic_fetch_add(waiting, 1);
+    // the futex only sleeps if the word still holds the value the caller saw
+    syscall(SYS_futex, (uint32_t*) word, FUTEX_WAIT, val, &ts, NULL, 0);
+    atomic_fetch_sub(waiting, 1);
+}
+
+static void port_uart_shm_wake(_Atomic uint32_t* word, _Atomic uint32_t* waiting)
+{
+    // the ring index was published with a release store: without a full fence the load of waiting
+    // may be done first, miss a reader going to sleep and leave it there until its timeout
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if(atomic_load(waiting))
+        syscall(SYS_futex, (uint32_t*) word, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+}
+
+// the RX thread reads the ring in interrupt and frame modes, otherwise hal_uart_read() does
+static bool port_uart_rx_owned(hal_uart_dev_t pdev)
+{
+    return pdev->cfg.interrupt_callback || pdev->cfg.frame.mode != UTL_FRAME_MODE_NONE;
+}
+
+// polling mode only watches the ring when asked to, a watcher costs the writer a wake up per write
+static bool port_uart_rx_thread_needed(hal_uart_dev_t pdev)
+{
+    return port_uart_rx_owned(pdev) || pdev->cfg.data_ready_callback;
+}
+
+static void port_uart_rx_notify(hal_uart_dev_t pdev)
+{
+    if(pdev->cfg.data_ready_callback)
+        pdev->cfg.data_ready_callback(pdev);
+
+    hal_cpu_wakeup();
+}
+
+static void port_uart_frame_handler(void* ctx, uint8_t* frame, uint32_t size)
+{
+    hal_uart_dev_t pdev = (hal_uart_dev_t) ctx;
+
+    if(pdev->cfg.frame_callback)
+        pdev->cfg.frame_callback(frame, size);
+    else if(!utl_frame_queue_put(pdev->frames, frame, size))
+        pdev->stats.rx_overflows += size;
+}
+
+static void* port_uart_rx_thread(void* thread_param)
+{
+    uint8_t data[PORT_UART_SHM_RX_CHUNK];
+    struct hal_uart_dev_s* pdev = (struct hal_uart_dev_s*) thread_param;
+
+    uint32_t seen = atomic_load(&pdev->rx->prod);
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Starting thread for port %s\n", pdev->name);
+
+    while(pdev->in_use)
+    {
+        uint32_t prod = atomic_load(&pdev->rx->prod);
+
+        // polling mode: only signal new bytes, they stay in the ring for hal_uart_read()
+        if(!port_uart_rx_owned(pdev))
+        {
+            if(prod == seen)
+                port_uart_shm_wait(&pdev->rx->prod, prod, &pdev->rx_dir->rx_waiting, PORT_UART_SHM_WAIT_MS);
+            else
+                port_uart_rx_notify(pdev);
+
+            seen = prod;
+            continue;
+        }
+
+        uint32_t n = utl_ring_read(pdev->rx, data, sizeof(data));
+
+        if(n == 0)
+        {
+            port_uart_shm_wait(&pdev->rx->prod, prod, &pdev->rx_dir->rx_waiting, PORT_UART_SHM_WAIT_MS);
+            continue;
+        }
+
+        port_uart_shm_wake(&pdev->rx->cons, &pdev->rx_dir->tx_waiting);
+        pdev->stats.rx_bytes += n;
+        hal_uart_capture_rx(pdev->dev, data, n);
+
+        if(pdev->cfg.frame.mode != UTL_FRAME_MODE_NONE)
+        {
+            utl_frame_feed(&pdev->frame, data, n);
+        }
+        else
+        {
+            for(uint32_t pos = 0; pos < n; pos++)
+                pdev->cfg.interrupt_callback(data[pos]);
+        }
+
+        port_uart_rx_notify(pdev);
+    }
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Stoping thread for port %s\n", pdev->name);
+
+    return 0;
+}
+
+static void port_uart_name_update(size_t dev)
+{
+    // names can be changed without rebuilding, useful when several simulated devices share a host
+    char env[16];
+    snprintf(env, sizeof(env), "PORT_UART%u", (unsigned int) dev);
+    char* name = getenv(env);
+
+    if(name)
+        snprintf(port_uart_ctrl[dev].name, PORT_FILE_NAME_LEN, "%s", name);
+}
+
+static port_uart_shm_hdr_t* port_uart_shm_map(hal_uart_dev_t pdev)
+{
+    bool creator = true;
+    port_uart_shm_hdr_t* shm;
+
+    int file = shm_open(pdev->name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if(file < 0 && errno == EEXIST)
+    {
+        creator = false;
+        file = shm_open(pdev->name, O_RDWR, 0600);
+    }
+
+    if(file < 0)
+        return 0;
+
+    if(creator && ftruncate(file, PORT_UART_SHM_SEG_SIZE) != 0)
+    {
+        close(file);
+        shm_unlink(pdev->name);
+        return 0;
+    }
+
+    // the creator may not have resized the segment yet
+    for(uint32_t retries = 100; !creator; retries--)
+    {
+        struct stat st;
+        if(fstat(file, &st) == 0 && st.st_size >= (off_t) PORT_UART_SHM_SEG_SIZE)
+            break;
+
+        if(retries == 0)
+        {
+            close(file);
+            return 0;
+        }
+        usleep(1000);
+    }
+
+    shm = mmap(NULL, PORT_UART_SHM_SEG_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    close(file);
+
+    if(shm == MAP_FAILED)
+        return 0;
+
+    if(creator)
+    {
+        for(uint32_t side = 0; side < PORT_UART_SHM_NUM_SIDES; side++)
+        {
+            uint32_t offset = PORT_UART_SHM_HDR_AREA + side * PORT_UART_SHM_RING_AREA;
+
+            utl_ring_init((uint8_t*) shm + offset, PORT_UART_SHM_RING_AREA);
+            atomic_init(&shm->dir[side].rx_waiting, 0);
+            atomic_init(&shm->dir[side].tx_waiting, 0);
+            atomic_init(&shm->dir[side].rx_overflows, 0);
+            atomic_init(&shm->dir[side].rx_peak_occupancy, 0);
+            shm->dir[side].ring_offset = offset;
+        }
+        atomic_store(&shm->sides, 0);
+        atomic_store(&shm->magic, PORT_UART_SHM_MAGIC);
+    }
+    else
+    {
+        for(uint32_t retries = 100; atomic_load(&shm->magic) != PORT_UART_SHM_MAGIC; retries--)
+        {
+            if(retries == 0)
+            {
+                munmap(shm, PORT_UART_SHM_SEG_SIZE);
+                return 0;
+            }
+            usleep(1000);
+        }
+    }
+
+    return shm;
+}
+
+static bool port_uart_shm_side_claim(hal_uart_dev_t pdev)
+{
+    for(uint32_t side = 0; side < PORT_UART_SHM_NUM_SIDES; side++)
+    {
+        uint32_t mask = 1UL << side;
+
+        if((atomic_fetch_or(&pdev->shm->sides, mask) & mask) == 0)
+        {
+            pdev->side = side;
+            pdev->rx_dir = &pdev->shm->dir[side];
+            pdev->tx_dir = &pdev->shm->dir[side ^ 1];
+            pdev->rx = (utl_ring_t*) ((uint8_t*) pdev->shm + pdev->rx_dir->ring_offset);
+            pdev->tx = (utl_ring_t*) ((uint8_t*) pdev->shm + pdev->tx_dir->ring_offset);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void port_uart_init(void)
+{
+    for(size_t dev = HAL_UART_PORT0; dev < HAL_UART_NUM_PORTS; dev++)
+    {
+        port_uart_ctrl[dev].in_use = false;
+        port_uart_ctrl[dev].shm = 0;
+        port_uart_ctrl[dev].frames = utl_ring_init(port_uart_frame_area[dev], sizeof(port_uart_frame_area[dev]));
+    }
+}
+
+static void port_uart_deinit(void)
+{
+    for(size_t dev = HAL_UART_PORT0; dev < HAL_UART_NUM_PORTS; dev++)
+    {
+        if(port_uart_ctrl[dev].in_use)
+        {
+            port_uart_close(&(port_uart_ctrl[dev]));
+        }
+    }
+}
+
+static hal_uart_dev_t port_uart_open(hal_uart_port_t dev, hal_uart_config_t* cfg)
+{
+    hal_uart_dev_t pdev = 0;
+
+    if(dev >= HAL_UART_NUM_PORTS)
+    {
+        UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Invalid UART port %d\n", dev);
+        return 0;
+    }
+
+    if(port_uart_ctrl[dev].in_use)
+    {
+        UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "UART port %d in use\n", dev);
+        return 0;
+    }
+
+    pdev = &(port_uart_ctrl[dev]);
+    pdev->cfg = *cfg;
+    port_uart_name_update(dev);
+
+    pdev->shm = port_uart_shm_map(pdev);
+    if(pdev->shm == 0)
+    {
+        UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Can not map shared memory %s: %s\n", pdev->name, strerror(errno));
+        return 0;
+    }
+
+    if(!port_uart_shm_side_claim(pdev))
+    {
+        UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Both sides of %s in use (stale segment?)\n", pdev->name);
+        munmap(pdev->shm, PORT_UART_SHM_SEG_SIZE);
+        pdev->shm = 0;
+        return 0;
+    }
+
+    utl_ring_flush(pdev->rx);
+    memset(&pdev->stats, 0, sizeof(pdev->stats));
+    atomic_store(&pdev->rx_dir->rx_overflows, 0);
+    atomic_store(&pdev->rx_dir->rx_peak_occupancy, 0);
+    utl_ring_flush(pdev->frames);
+    utl_frame_init(&pdev->frame, &cfg->frame, pdev->frame_buffer, sizeof(pdev->frame_buffer), port_uart_frame_handler,
+                   pdev);
+    pdev->in_use = true;
+
+    // interrupt and frame modes need somebody waiting for the bytes, polling mode reads the ring
+    // directly and only needs the thread to signal new data
+    if(port_uart_rx_thread_needed(pdev))
+    {
+        int err = pthread_create(&pdev->thread, NULL, &port_uart_rx_thread, (void*) pdev);
+        if(err != 0)
+        {
+            UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Cant create RX thread for port %d\n", pdev->dev);
+            pdev->in_use = false;
+            atomic_fetch_and(&pdev->shm->sides, ~(1UL << pdev->side));
+            munmap(pdev->shm, PORT_UART_SHM_SEG_SIZE);
+            pdev->shm = 0;
+            return 0;
+        }
+    }
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_UART, "Shared memory port %d opened (%s, side %u)\n", pdev->dev, pdev->name,
+                   pdev->side);
+
+    return pdev;
+}
+
+static void port_uart_close(hal_uart_dev_t pdev)
+{
+    if(pdev->in_use)
+    {
+        pdev->in_use = false;
+
+        if(port_uart_rx_thread_needed(pdev))
+            pthread_join(pdev->thread, NULL);
+
+        // last one leaving removes the segment
+        if((atomic_fetch_and(&pdev->shm->sides, ~(1UL << pdev->side)) & ~(1UL << pdev->side)) == 0)
+            shm_unlink(pdev->name);
+
+        munmap(pdev->shm, PORT_UART_SHM_SEG_SIZE);
+        pdev->shm = 0;
+    }
+}
+
+static size_t port_uart_bytes_available(hal_uart_dev_t pdev)
+{
+    if(port_uart_rx_owned(pdev))
+        return 0;
+
+    return utl_ring_bytes_available(pdev->rx);
+}
+
+static ssize_t port_uart_read(hal_uart_dev_t pdev, uint8_t* buffer, size_t size)
+{
+    uint32_t n;
+
+    if(port_uart_rx_owned(pdev))
+        return 0;
+
+    n = utl_ring_read(pdev->rx, buffer, (uint32_t) size);
+    if(n > 0)
+    {
+        port_uart_shm_wake(&pdev->rx->cons, &pdev->rx_dir->tx_waiting);
+        pdev->stats.rx_bytes += n;
+        // the peer process wrote them in the shared ring, they are only seen here
+        hal_uart_capture_rx(pdev->dev, buffer, n);
+    }
+
+    return (ssize_t) n;
+}
+
+static ssize_t port_uart_read_timeout(hal_uart_dev_t pdev, uint8_t* buffer, size_t min, size_t max,
+                                      uint32_t timeout_ms)
+{
+    struct timespec ts;
+    size_t pos = 0;
+
+    if(port_uart_rx_owned(pdev))
+        return 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t deadline_ms = (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000 + timeout_ms;
+
+    while(pdev->in_use)
+    {
+        uint32_t prod = atomic_load(&pdev->rx->prod);
+
+        pos += (size_t) port_uart_read(pdev, buffer + pos, max - pos);
+        if(pos >= min)
+            break;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        uint64_t now_ms = (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+        if(now_ms >= deadline_ms)
+            break;
+
+        // bounded waits also notice a peer that went away
+        uint64_t wait_ms = deadline_ms - now_ms;
+        port_uart_shm_wait(&pdev->rx->prod, prod, &pdev->rx_dir->rx_waiting,
+                           wait_ms < PORT_UART_SHM_WAIT_MS ? (uint32_t) wait_ms : PORT_UART_SHM_WAIT_MS);
+    }
+
+    return (ssize_t) pos;
+}
+
+static ssize_t port_uart_write(hal_uart_dev_t pdev, uint8_t* buffer, size_t size)
+{
+    size_t pos = 0;
+
+    if(!pdev->in_use)
+        return 0;
+
+    while(pos < size)
+    {
+        uint32_t cons = atomic_load(&pdev->tx->cons);
+        uint32_t n = utl_ring_write(pdev->tx, buffer + pos, (uint32_t) (size - pos));
+
+        if(n > 0)
+        {
+            pos += n;
+            port_uart_shm_wake(&pdev->tx->prod, &pdev->tx_dir->rx_waiting);
+
+            // single producer, no other writer races for the peak
+            uint32_t occupancy = utl_ring_bytes_available(pdev->tx);
+            if(occupancy > atomic_load(&pdev->tx_dir->rx_peak_occupancy))
+                atomic_store(&pdev->tx_dir->rx_peak_occupancy, occupancy);
+            continue;
+        }
+
+        // receiver is full: with flow control wait for room, otherwise bytes are lost (overrun)
+        if(pdev->cfg.flow_control != HAL_UART_FLOW_CONTROL_CTS_RTS)
+        {
+            atomic_fetch_add(&pdev->tx_dir->rx_overflows, (uint32_t) (size - pos));
+            break;
+        }
+
+        // nobody on the other side to make room
+        if(atomic_load(&pdev->shm->sides) != ((1UL << PORT_UART_SHM_NUM_SIDES) - 1))
+            break;
+
+        pdev->stats.tx_retries++;
+        port_uart_shm_wait(&pdev->tx->cons, cons, &pdev->tx_dir->tx_waiting, PORT_UART_SHM_WAIT_MS);
+    }
+
+    pdev->stats.tx_bytes += (uint32_t) pos;
+
+    // without flow control the rest went to the line and was lost there, with flow control it was
+    // held back and the caller must retry
+    if(pdev->cfg.flow_control == HAL_UART_FLOW_CONTROL_CTS_RTS)
+        return (ssize_t) pos;
+
+    return (ssize_t) size;
+}
+
+static void port_uart_flush(hal_uart_dev_t pdev)
+{
+    if(pdev->cfg.frame.mode != UTL_FRAME_MODE_NONE)
+        utl_ring_flush(pdev->frames);
+
+    if(port_uart_rx_owned(pdev))
+        return;
+
+    utl_ring_flush(pdev->rx);
+    port_uart_shm_wake(&pdev->rx->cons, &pdev->rx_dir->tx_waiting);
+}
+
+static ssize_t port_uart_frame_read(hal_uart_dev_t pdev, uint8_t* buffer, size_t size)
+{
+    if(pdev->cfg.frame.mode == UTL_FRAME_MODE_NONE || pdev->cfg.frame_callback)
+        return 0;
+
+    return (ssize_t) utl_frame_queue_get(pdev->frames, buffer, (uint32_t) size);
+}
+
+static void port_uart_stats_get(hal_uart_dev_t pdev, hal_uart_stats_t* stats)
+{
+    *stats = pdev->stats;
+
+    if(pdev->in_use)
+    {
+        stats->rx_overflows = atomic_load(&pdev->rx_dir->rx_overflows);
+        stats->rx_peak_occupancy = atomic_load(&pdev->rx_dir->rx_peak_occupancy);
+    }
+}
+
+static const char* port_uart_peer_name_get(hal_uart_dev_t pdev)
+{
+    return pdev->name;
+}
+
+hal_uart_driver_t HAL_UART_DRIVER = {
+    .init = port_uart_init,
+    .deinit = port_uart_deinit,
+    .open = port_uart_open,
+    .close = port_uart_close,
+    .bytes_available = port_uart_bytes_available,
+    .read = port_uart_read,
+    .write = port_uart_write,
+    .flush = port_uart_flush,
+    .read_timeout = port_uart_read_timeout,
+    .frame_read = port_uart_frame_read,
+    .stats_get = port_uart_stats_get,
+    .peer_name_get = port_uart_peer_name_get,
+};
@@ -0,0 +1,150 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "utl_frame.h"
+
+void utl_frame_init(utl_frame_t* fr, const utl_frame_cfg_t* cfg, uint8_t* buffer, uint32_t size,
+                    utl_frame_handler_t handler, void* ctx)
+{
+    fr->cfg = *cfg;
+    fr->handler = handler;
+    fr->ctx = ctx;
+    fr->buffer = buffer;
+    fr->max_size = (cfg->max_size && cfg->max_size < size) ? cfg->max_size : size;
+    fr->frames = 0;
+    fr->errors = 0;
+
+    if(fr->cfg.length_size != 2)
+        fr->cfg.length_size = 1;
+
+    utl_frame_reset(fr);
+}
+
+void utl_frame_reset(utl_frame_t* fr)
+{
+    fr->pos = 0;
+    fr->expected = 0;
+    fr->discarding = false;
+}
+
+static void utl_frame_deliver(utl_frame_t* fr, uint32_t size)
+{
+    fr->frames++;
+    fr->handler(fr->ctx, fr->buffer, size);
+}
+
+static void utl_frame_delimiter_put(utl_frame_t* fr, uint8_t c)
+{
+    if(c == fr->cfg.delimiter)
+    {
+        if(!fr->discarding && fr->pos > 0)
+            utl_frame_deliver(fr, fr->pos);
+
+        utl_frame_reset(fr);
+        return;
+    }
+
+    if(fr->discarding)
+        return;
+
+    if(fr->pos >= fr->max_size)
+    {
+        fr->discarding = true;
+        fr->errors++;
+        return;
+    }
+
+    fr->buffer[fr->pos++] = c;
+}
+
+static uint32_t utl_frame_length_get(utl_frame_t* fr)
+{
+    uint8_t* field = &fr->buffer[fr->cfg.length_offset];
+
+    if(fr->cfg.length_size == 1)
+        return field[0];
+
+    return fr->cfg.length_big_endian ? ((uint32_t) field[0] << 8) | field[1] : ((uint32_t) field[1] << 8) | field[0];
+}
+
+static void utl_frame_length_put(utl_frame_t* fr, uint8_t c)
+{
+    uint32_t header = (uint32_t) fr->cfg.length_offset + fr->cfg.length_size;
+
+    if(fr->pos >= fr->max_size)
+    {
+        // header does not even fit the buffer, nothing can be received
+        fr->errors++;
+        utl_frame_reset(fr);
+        return;
+    }
+
+    fr->buffer[fr->pos++] = c;
+
+    if(fr->expected == 0 && fr->pos == header)
+    {
+        int32_t total = (int32_t) utl_frame_length_get(fr) + fr->cfg.length_adjust;
+
+        if(total < (int32_t) header || total > (int32_t) fr->max_size)
+        {
+            // invalid header: resynchronize one byte later
+            fr->errors++;
+            fr->pos--;
+            memmove(fr->buffer, fr->buffer + 1, fr->pos);
+            return;
+        }
+
+        fr->expected = (uint32_t) total;
+    }
+
+    if(fr->expected && fr->pos == fr->expected)
+    {
+        utl_frame_deliver(fr, fr->pos);
+        utl_frame_reset(fr);
+    }
+}
+
+void utl_frame_feed(utl_frame_t* fr, const uint8_t* data, uint32_t size)
+{
+    for(uint32_t pos = 0; pos < size; pos++)
+    {
+        if(fr->cfg.mode == UTL_FRAME_MODE_DELIMITER)
+            utl_frame_delimiter_put(fr, data[pos]);
+        else if(fr->cfg.mode == UTL_FRAME_MODE_LENGTH)
+            utl_frame_length_put(fr, data[pos]);
+    }
+}
+
+bool utl_frame_queue_put(utl_ring_t* queue, const uint8_t* frame, uint32_t size)
+{
+    uint16_t len = (uint16_t) size;
+
+    if(size > UINT16_MAX || utl_ring_space_available(queue) < sizeof(len) + size)
+        return false;
+
+    // the consumer only takes a frame when all its bytes are there, so two writes are fine
+    utl_ring_write(queue, (uint8_t*) &len, sizeof(len));
+    utl_ring_write(queue, frame, size);
+
+    return true;
+}
+
+uint32_t utl_frame_queue_get(utl_ring_t* queue, uint8_t* buffer, uint32_t size)
+{
+    uint16_t len;
+
+    if(utl_ring_peek(queue, (uint8_t*) &len, sizeof(len)) != sizeof(len) ||
+       utl_ring_bytes_available(queue) < sizeof(len) + len)
+        return 0;
+
+    if(size > len)
+        size = len;
+
+    utl_ring_skip(queue, sizeof(len));
+    utl_ring_read(queue, buffer, size);
+    utl_ring_skip(queue, len - size);
+
+    return size;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "utl_ring.h"
+
+/**
+ Frame assembler: splits a byte stream into frames, either on a delimiter byte (0x00 for COBS
+ encoded data) or using a length field found in a fixed position of the frame header.
+
+ Bytes are fed as they are received and every complete frame is passed to a handler. Frames can
+ be stored in a utl_ring (see utl_frame_queue_put()) when the consumer runs in another context.
+*/
+
+typedef enum utl_frame_mode_e
+{
+    UTL_FRAME_MODE_NONE = 0,
+    UTL_FRAME_MODE_DELIMITER,
+    UTL_FRAME_MODE_LENGTH,
+} utl_frame_mode_t;
+
+typedef struct utl_frame_cfg_s
+{
+    utl_frame_mode_t mode;
+    // UTL_FRAME_MODE_DELIMITER: byte ending a frame, not delivered; empty frames are ignored
+    uint8_t delimiter;
+    // UTL_FRAME_MODE_LENGTH: the length field has length_size (1 or 2) bytes and starts at byte
+    // length_offset of the frame. Frame size (header included) = length field + length_adjust.
+    uint8_t length_offset;
+    uint8_t length_size;
+    bool length_big_endian;
+    int16_t length_adjust;
+    // larger frames are discarded, 0 means the size of the assembly buffer
+    uint16_t max_size;
+} utl_frame_cfg_t;
+
+typedef void (*utl_frame_handler_t)(void* ctx, uint8_t* frame, uint32_t size);
+
+typedef struct utl_frame_s
+{
+    utl_frame_cfg_t cfg;
+    utl_frame_handler_t handler;
+    void* ctx;
+    uint8_t* buffer;
+    uint32_t max_size;
+    uint32_t pos;
+    // UTL_FRAME_MODE_LENGTH: size of the frame being received, 0 while the header is incomplete
+    uint32_t expected;
+    // UTL_FRAME_MODE_DELIMITER: frame too large, bytes are dropped until the next delimiter
+    bool discarding;
+    uint32_t frames;
+    uint32_t errors;
+} utl_frame_t;
+
+/** Initialize a frame assembler
+    @param buffer Assembly buffer, it must hold the largest frame
+    @param handler Called with each complete frame, the frame is valid only during the call
+*/
+void utl_frame_init(utl_frame_t* fr, const utl_frame_cfg_t* cfg, uint8_t* buffer, uint32_t size,
+                    utl_frame_handler_t handler, void* ctx);
+
+/** Drop a partially received frame */
+void utl_frame_reset(utl_frame_t* fr);
+
+/** Process received bytes, the handler is called for every frame completed by them */
+void utl_frame_feed(utl_frame_t* fr, const uint8_t* data, uint32_t size);
+
+/** Producer side: store a frame in @p queue as a 16 bits size followed by the frame data
+    @return false if there is no room for the whole frame (nothing is stored)
+*/
+bool utl_frame_queue_put(utl_ring_t* queue, const uint8_t* frame, uint32_t size);
+
+/** Consumer side: remove the oldest frame from @p queue
+    @param size Size of @p buffer, larger frames are truncated
+    @return Number of bytes copied, 0 if no frame is available
+*/
+uint32_t utl_frame_queue_get(utl_ring_t* queue, uint8_t* buffer, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
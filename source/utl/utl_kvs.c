@@ -0,0 +1,599 @@
+#include "hal.h"
+#include "utl_crc16.h"
+#include "utl_kvs.h"
+
+// sector header: magic and sequence number, padded to the write size
+#define UTL_KVS_MAGIC 0x3153564BUL
+// record header: key size, flags, value size (16 bits), CRC16 (16 bits), 2 bytes of padding.
+// The CRC covers the first 4 header bytes, key and value. Records are padded to the write size.
+#define UTL_KVS_RECORD_HEADER_SIZE 8
+#define UTL_KVS_FLAG_VALUE 0x00
+#define UTL_KVS_FLAG_DELETED 0x01
+#define UTL_KVS_NO_SECTOR UTL_KVS_MAX_SECTORS
+
+typedef enum utl_kvs_record_e
+{
+    UTL_KVS_RECORD_OK = 0,
+    // erased area: end of the sector log
+    UTL_KVS_RECORD_END,
+    // interrupted program or corrupted data: the rest of the sector is not used
+    UTL_KVS_RECORD_BAD,
+} utl_kvs_record_t;
+
+static uint32_t utl_kvs_hash(const uint8_t* key, uint32_t size)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261UL;
+
+    while(size--)
+        hash = (hash ^ *key++) * 16777619UL;
+
+    return hash;
+}
+
+static uint32_t utl_kvs_align(utl_kvs_t* kvs, uint32_t size)
+{
+    return (size + kvs->write_size - 1) / kvs->write_size * kvs->write_size;
+}
+
+static uint32_t utl_kvs_sector_offset(utl_kvs_t* kvs, uint32_t sector)
+{
+    return (kvs->cfg.first_page + sector) * kvs->page_size;
+}
+
+static uint32_t utl_kvs_free_sectors(utl_kvs_t* kvs)
+{
+    uint32_t count = 0;
+
+    for(uint32_t sector = 0; sector < kvs->cfg.num_pages; sector++)
+        count += kvs->seq[sector] == 0;
+
+    return count;
+}
+
+static utl_kvs_record_t utl_kvs_record_check(utl_kvs_t* kvs, uint32_t sector, uint32_t pos, uint32_t* size)
+{
+    const uint8_t* rec = hal_flash_ptr_get(utl_kvs_sector_offset(kvs, sector) + pos);
+
+    if(pos + UTL_KVS_RECORD_HEADER_SIZE > kvs->page_size || rec[0] == kvs->erased_value)
+        return UTL_KVS_RECORD_END;
+
+    uint32_t key_size = rec[0];
+    uint32_t value_size = rec[2] | ((uint32_t) rec[3] << 8);
+
+    if(key_size == 0 || key_size > UTL_KVS_MAX_KEY_SIZE || value_size > UTL_KVS_MAX_VALUE_SIZE)
+        return UTL_KVS_RECORD_BAD;
+
+    *size = utl_kvs_align(kvs, UTL_KVS_RECORD_HEADER_SIZE + key_size + value_size);
+    if(pos + *size > kvs->page_size)
+        return UTL_KVS_RECORD_BAD;
+
+    uint16_t crc = utl_crc16_data(rec, 4, 0xFFFF);
+    crc = utl_crc16_data(rec + UTL_KVS_RECORD_HEADER_SIZE, key_size + value_size, crc);
+
+    return crc == (rec[4] | ((uint16_t) rec[5] << 8)) ? UTL_KVS_RECORD_OK : UTL_KVS_RECORD_BAD;
+}
+
+// slot holding the key or, when not found, the empty slot where it goes (0 if the index is full)
+static utl_kvs_slot_t* utl_kvs_slot_find(utl_kvs_t* kvs, const uint8_t* key, uint32_t key_size, uint32_t hash,
+                                         bool* found)
+{
+    uint32_t mask = kvs->index_size - 1;
+
+    *found = false;
+
+    for(uint32_t n = 0, pos = hash & mask; n < kvs->index_size; n++, pos = (pos + 1) & mask)
+    {
+        utl_kvs_slot_t* slot = &kvs->index[pos];
+
+        if(slot->offset == 0)
+            return slot;
+
+        if(slot->hash == hash)
+        {
+            const uint8_t* rec = hal_flash_ptr_get(slot->offset);
+
+            if(rec[0] == key_size && memcmp(rec + UTL_KVS_RECORD_HEADER_SIZE, key, key_size) == 0)
+            {
+                *found = true;
+                return slot;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static void utl_kvs_slot_remove(utl_kvs_t* kvs, utl_kvs_slot_t* slot)
+{
+    uint32_t mask = kvs->index_size - 1;
+    uint32_t hole = (uint32_t) (slot - kvs->index);
+
+    // linear probing: move back the following entries that can no longer be reached past the hole
+    for(uint32_t pos = (hole + 1) & mask; kvs->index[pos].offset != 0; pos = (pos + 1) & mask)
+    {
+        uint32_t home = kvs->index[pos].hash & mask;
+
+        if(((pos - home) & mask) >= ((pos - hole) & mask))
+        {
+            kvs->index[hole] = kvs->index[pos];
+            hole = pos;
+        }
+    }
+
+    kvs->index[hole].offset = 0;
+    kvs->stats.keys--;
+}
+
+static bool utl_kvs_sector_erase(utl_kvs_t* kvs, uint32_t sector)
+{
+    kvs->seq[sector] = 0;
+    kvs->stats.erases++;
+
+    return hal_flash_page_erase(kvs->cfg.first_page + sector);
+}
+
+// next free sector after the active one, in ring order
+static utl_kvs_status_t utl_kvs_sector_open(utl_kvs_t* kvs)
+{
+    uint8_t header[32];
+    uint32_t magic = UTL_KVS_MAGIC;
+
+    for(uint32_t n = 1; n <= kvs->cfg.num_pages; n++)
+    {
+        uint32_t sector = (kvs->active + n) % kvs->cfg.num_pages;
+
+        if(kvs->seq[sector] != 0)
+            continue;
+
+        memset(header, kvs->erased_value, kvs->header_size);
+        memcpy(&header[0], &magic, 4);
+        memcpy(&header[4], &kvs->next_seq, 4);
+
+        if(!hal_flash_program(utl_kvs_sector_offset(kvs, sector), header, kvs->header_size))
+            return UTL_KVS_FLASH_ERROR;
+
+        kvs->seq[sector] = kvs->next_seq++;
+        kvs->active = sector;
+        kvs->wr_pos = kvs->header_size;
+        kvs->stats.flash_bytes += kvs->header_size;
+
+        return UTL_KVS_OK;
+    }
+
+    return UTL_KVS_NO_SPACE;
+}
+
+static utl_kvs_status_t utl_kvs_append(utl_kvs_t* kvs, const uint8_t* record, uint32_t size, uint32_t* offset)
+{
+    if(kvs->wr_pos + size > kvs->page_size)
+        return UTL_KVS_NO_SPACE;
+
+    *offset = utl_kvs_sector_offset(kvs, kvs->active) + kvs->wr_pos;
+    if(!hal_flash_program(*offset, record, size))
+        return UTL_KVS_FLASH_ERROR;
+
+    kvs->wr_pos += size;
+    kvs->stats.flash_bytes += size;
+
+    return UTL_KVS_OK;
+}
+
+static uint32_t utl_kvs_oldest_get(utl_kvs_t* kvs)
+{
+    uint32_t oldest = UTL_KVS_NO_SECTOR;
+
+    for(uint32_t sector = 0; sector < kvs->cfg.num_pages; sector++)
+    {
+        if(kvs->seq[sector] && (oldest == UTL_KVS_NO_SECTOR || kvs->seq[sector] < kvs->seq[oldest]))
+            oldest = sector;
+    }
+
+    return oldest;
+}
+
+// only the spare sector is free and there is an older sector to collect (or a collection running)
+static bool utl_kvs_gc_needed(utl_kvs_t* kvs)
+{
+    return kvs->gc_sector != UTL_KVS_NO_SECTOR ||
+           (utl_kvs_free_sectors(kvs) <= 1 && utl_kvs_oldest_get(kvs) != kvs->active);
+}
+
+static utl_kvs_status_t utl_kvs_gc_start(utl_kvs_t* kvs)
+{
+    uint32_t victim = utl_kvs_oldest_get(kvs);
+
+    // the active sector itself is collected only when it is the last used one
+    if(victim == kvs->active)
+    {
+        utl_kvs_status_t status = utl_kvs_sector_open(kvs);
+        if(status != UTL_KVS_OK)
+            return status;
+    }
+
+    kvs->gc_sector = victim;
+    kvs->gc_pos = kvs->header_size;
+
+    return UTL_KVS_OK;
+}
+
+static utl_kvs_status_t utl_kvs_gc_run(utl_kvs_t* kvs, uint32_t records)
+{
+    uint32_t base = utl_kvs_sector_offset(kvs, kvs->gc_sector);
+
+    while(records--)
+    {
+        uint32_t size;
+
+        if(utl_kvs_record_check(kvs, kvs->gc_sector, kvs->gc_pos, &size) != UTL_KVS_RECORD_OK)
+        {
+            uint32_t sector = kvs->gc_sector;
+
+            kvs->gc_sector = UTL_KVS_NO_SECTOR;
+            return utl_kvs_sector_erase(kvs, sector) ? UTL_KVS_OK : UTL_KVS_FLASH_ERROR;
+        }
+
+        const uint8_t* rec = hal_flash_ptr_get(base + kvs->gc_pos);
+        uint32_t offset = base + kvs->gc_pos;
+        bool found;
+        utl_kvs_slot_t* slot =
+            utl_kvs_slot_find(kvs, rec + UTL_KVS_RECORD_HEADER_SIZE, rec[0],
+                              utl_kvs_hash(rec + UTL_KVS_RECORD_HEADER_SIZE, rec[0]), &found);
+
+        // superseded records and deletions are dropped: older sectors were already collected
+        if(found && slot->offset == offset)
+        {
+            utl_kvs_status_t status = utl_kvs_append(kvs, rec, size, &slot->offset);
+
+            if(status == UTL_KVS_NO_SPACE)
+            {
+                status = utl_kvs_sector_open(kvs);
+                if(status == UTL_KVS_OK)
+                    status = utl_kvs_append(kvs, rec, size, &slot->offset);
+            }
+
+            if(status != UTL_KVS_OK)
+            {
+                slot->offset = offset;
+                return status;
+            }
+
+            kvs->stats.gc_bytes += size;
+        }
+
+        kvs->gc_pos += size;
+    }
+
+    return UTL_KVS_OK;
+}
+
+// room for @p size bytes in the active sector, collecting sectors if needed
+static utl_kvs_status_t utl_kvs_space_make(utl_kvs_t* kvs, uint32_t size)
+{
+    utl_kvs_status_t status = UTL_KVS_OK;
+
+    for(uint32_t n = 0; n <= 2 * kvs->cfg.num_pages && status == UTL_KVS_OK; n++)
+    {
+        if(kvs->wr_pos + size <= kvs->page_size)
+            return UTL_KVS_OK;
+
+        if(kvs->gc_sector == UTL_KVS_NO_SECTOR && utl_kvs_free_sectors(kvs) > 1)
+            status = utl_kvs_sector_open(kvs);
+        else if(kvs->gc_sector == UTL_KVS_NO_SECTOR)
+            status = utl_kvs_gc_start(kvs);
+        else
+            status = utl_kvs_gc_run(kvs, UINT32_MAX);
+    }
+
+    return status == UTL_KVS_OK ? UTL_KVS_NO_SPACE : status;
+}
+
+static utl_kvs_status_t utl_kvs_record_write(utl_kvs_t* kvs, const uint8_t* key, uint32_t key_size, uint8_t flags,
+                                             const void* value, uint32_t size)
+{
+    uint8_t* rec = kvs->record;
+    uint32_t rec_size = utl_kvs_align(kvs, UTL_KVS_RECORD_HEADER_SIZE + key_size + size);
+    uint32_t hash = utl_kvs_hash(key, key_size);
+    utl_kvs_status_t status;
+    uint32_t offset;
+    bool found;
+
+    memset(rec, kvs->erased_value, rec_size);
+    rec[0] = (uint8_t) key_size;
+    rec[1] = flags;
+    rec[2] = (uint8_t) size;
+    rec[3] = (uint8_t) (size >> 8);
+    memcpy(rec + UTL_KVS_RECORD_HEADER_SIZE, key, key_size);
+    if(size)
+        memcpy(rec + UTL_KVS_RECORD_HEADER_SIZE + key_size, value, size);
+
+    uint16_t crc = utl_crc16_data(rec, 4, 0xFFFF);
+    crc = utl_crc16_data(rec + UTL_KVS_RECORD_HEADER_SIZE, key_size + size, crc);
+    rec[4] = (uint8_t) crc;
+    rec[5] = (uint8_t) (crc >> 8);
+
+    if(utl_kvs_gc_needed(kvs))
+    {
+        status = kvs->gc_sector == UTL_KVS_NO_SECTOR ? utl_kvs_gc_start(kvs) : UTL_KVS_OK;
+        if(status == UTL_KVS_OK)
+            status = utl_kvs_gc_run(kvs, UTL_KVS_GC_STEP_RECORDS);
+        if(status != UTL_KVS_OK)
+            return status;
+    }
+
+    if((status = utl_kvs_space_make(kvs, rec_size)) != UTL_KVS_OK)
+        return status;
+
+    // looked up after the collection, which may have moved the record of the key
+    utl_kvs_slot_t* slot = utl_kvs_slot_find(kvs, key, key_size, hash, &found);
+
+    if((status = utl_kvs_append(kvs, rec, rec_size, &offset)) != UTL_KVS_OK)
+        return status;
+
+    kvs->stats.user_bytes += key_size + size;
+
+    if(flags == UTL_KVS_FLAG_DELETED)
+    {
+        utl_kvs_slot_remove(kvs, slot);
+    }
+    else
+    {
+        if(!found)
+        {
+            slot->hash = hash;
+            kvs->stats.keys++;
+        }
+        slot->offset = offset;
+    }
+
+    return UTL_KVS_OK;
+}
+
+static bool utl_kvs_key_check(const char* key, uint32_t* key_size)
+{
+    *key_size = (uint32_t) strlen(key);
+
+    return *key_size > 0 && *key_size <= UTL_KVS_MAX_KEY_SIZE;
+}
+
+static const uint8_t* utl_kvs_value_get(utl_kvs_t* kvs, const char* key, uint32_t* size)
+{
+    uint32_t key_size;
+    bool found;
+
+    if(!utl_kvs_key_check(key, &key_size))
+        return 0;
+
+    utl_kvs_slot_t* slot =
+        utl_kvs_slot_find(kvs, (const uint8_t*) key, key_size, utl_kvs_hash((const uint8_t*) key, key_size), &found);
+    if(!found)
+        return 0;
+
+    const uint8_t* rec = hal_flash_ptr_get(slot->offset);
+    *size = rec[2] | ((uint32_t) rec[3] << 8);
+
+    return rec + UTL_KVS_RECORD_HEADER_SIZE + key_size;
+}
+
+static utl_kvs_status_t utl_kvs_sector_scan(utl_kvs_t* kvs, uint32_t sector)
+{
+    uint32_t base = utl_kvs_sector_offset(kvs, sector);
+    uint32_t pos = kvs->header_size;
+    utl_kvs_record_t state;
+    uint32_t size;
+
+    while((state = utl_kvs_record_check(kvs, sector, pos, &size)) == UTL_KVS_RECORD_OK)
+    {
+        const uint8_t* rec = hal_flash_ptr_get(base + pos);
+        const uint8_t* key = rec + UTL_KVS_RECORD_HEADER_SIZE;
+        uint32_t hash = utl_kvs_hash(key, rec[0]);
+        bool found;
+        utl_kvs_slot_t* slot = utl_kvs_slot_find(kvs, key, rec[0], hash, &found);
+
+        if(rec[1] == UTL_KVS_FLAG_DELETED)
+        {
+            if(found)
+                utl_kvs_slot_remove(kvs, slot);
+        }
+        else if(found)
+        {
+            slot->offset = base + pos;
+        }
+        else
+        {
+            if(slot == 0 || kvs->stats.keys + 1 >= kvs->index_size)
+                return UTL_KVS_INDEX_FULL;
+
+            slot->hash = hash;
+            slot->offset = base + pos;
+            kvs->stats.keys++;
+        }
+
+        kvs->stats.scanned++;
+        pos += size;
+    }
+
+    // a damaged tail is never written again
+    kvs->wr_pos = state == UTL_KVS_RECORD_BAD ? kvs->page_size : pos;
+
+    return UTL_KVS_OK;
+}
+
+utl_kvs_status_t utl_kvs_init(utl_kvs_t* kvs, const utl_kvs_cfg_t* cfg, utl_kvs_slot_t* index, uint32_t index_size)
+{
+    hal_flash_info_t info;
+    uint32_t order[UTL_KVS_MAX_SECTORS];
+    uint32_t used = 0;
+
+    hal_flash_info_get(&info);
+
+    if(cfg->num_pages < 2 || cfg->num_pages > UTL_KVS_MAX_SECTORS ||
+       (cfg->first_page + cfg->num_pages) * info.page_size > info.size || index_size < 2 ||
+       (index_size & (index_size - 1)) != 0 || info.write_size > 32 ||
+       info.page_size < 2 * (32 + sizeof(kvs->record)))
+        return UTL_KVS_INVALID;
+
+    memset(kvs, 0, sizeof(utl_kvs_t));
+    memset(index, 0, index_size * sizeof(utl_kvs_slot_t));
+    kvs->cfg = *cfg;
+    kvs->index = index;
+    kvs->index_size = index_size;
+    kvs->page_size = info.page_size;
+    kvs->write_size = info.write_size;
+    kvs->header_size = utl_kvs_align(kvs, 8);
+    kvs->gc_sector = UTL_KVS_NO_SECTOR;
+    kvs->next_seq = 1;
+    kvs->erased_value = info.erased_value;
+
+    for(uint32_t sector = 0; sector < cfg->num_pages; sector++)
+    {
+        const uint8_t* header = hal_flash_ptr_get(utl_kvs_sector_offset(kvs, sector));
+        uint32_t magic, seq;
+
+        memcpy(&magic, &header[0], 4);
+        memcpy(&seq, &header[4], 4);
+
+        if(magic == UTL_KVS_MAGIC && seq != 0 && seq != UINT32_MAX)
+        {
+            kvs->seq[sector] = seq;
+            if(seq >= kvs->next_seq)
+                kvs->next_seq = seq + 1;
+
+            // insertion sort by sequence number
+            uint32_t pos = used++;
+            for(; pos > 0 && kvs->seq[order[pos - 1]] > seq; pos--)
+                order[pos] = order[pos - 1];
+            order[pos] = sector;
+            continue;
+        }
+
+        // not a sector: erased only when needed (interrupted erase or header program)
+        for(uint32_t n = 0; n < kvs->page_size; n++)
+        {
+            if(header[n] != info.erased_value)
+            {
+                if(!utl_kvs_sector_erase(kvs, sector))
+                    return UTL_KVS_FLASH_ERROR;
+                break;
+            }
+        }
+    }
+
+    for(uint32_t n = 0; n < used; n++)
+    {
+        utl_kvs_status_t status = utl_kvs_sector_scan(kvs, order[n]);
+        if(status != UTL_KVS_OK)
+            return status;
+    }
+
+    if(used == 0)
+    {
+        kvs->active = cfg->num_pages - 1;
+        return utl_kvs_sector_open(kvs);
+    }
+
+    // wr_pos was left by the scan of the newest sector
+    kvs->active = order[used - 1];
+
+    return UTL_KVS_OK;
+}
+
+utl_kvs_status_t utl_kvs_format(utl_kvs_t* kvs)
+{
+    memset(kvs->index, 0, kvs->index_size * sizeof(utl_kvs_slot_t));
+    kvs->stats.keys = 0;
+    kvs->gc_sector = UTL_KVS_NO_SECTOR;
+    kvs->next_seq = 1;
+
+    for(uint32_t sector = 0; sector < kvs->cfg.num_pages; sector++)
+    {
+        if(!utl_kvs_sector_erase(kvs, sector))
+            return UTL_KVS_FLASH_ERROR;
+    }
+
+    kvs->active = kvs->cfg.num_pages - 1;
+
+    return utl_kvs_sector_open(kvs);
+}
+
+utl_kvs_status_t utl_kvs_set(utl_kvs_t* kvs, const char* key, const void* value, uint32_t size)
+{
+    uint32_t key_size;
+    uint32_t old_size;
+
+    if(!utl_kvs_key_check(key, &key_size) || size > UTL_KVS_MAX_VALUE_SIZE)
+        return UTL_KVS_INVALID;
+
+    const uint8_t* old = utl_kvs_value_get(kvs, key, &old_size);
+    if(old)
+    {
+        // rewriting configuration with the same values costs nothing
+        if(old_size == size && memcmp(old, value, size) == 0)
+            return UTL_KVS_OK;
+    }
+    else if(kvs->stats.keys + 1 >= kvs->index_size)
+    {
+        return UTL_KVS_INDEX_FULL;
+    }
+
+    return utl_kvs_record_write(kvs, (const uint8_t*) key, key_size, UTL_KVS_FLAG_VALUE, value, size);
+}
+
+utl_kvs_status_t utl_kvs_get(utl_kvs_t* kvs, const char* key, void* value, uint32_t* size)
+{
+    uint32_t stored;
+    const uint8_t* data = utl_kvs_value_get(kvs, key, &stored);
+
+    if(data == 0)
+        return UTL_KVS_NOT_FOUND;
+
+    if(stored > *size)
+    {
+        *size = stored;
+        return UTL_KVS_NO_SPACE;
+    }
+
+    memcpy(value, data, stored);
+    *size = stored;
+
+    return UTL_KVS_OK;
+}
+
+const uint8_t* utl_kvs_ptr_get(utl_kvs_t* kvs, const char* key, uint32_t* size)
+{
+    return utl_kvs_value_get(kvs, key, size);
+}
+
+utl_kvs_status_t utl_kvs_delete(utl_kvs_t* kvs, const char* key)
+{
+    uint32_t key_size;
+    uint32_t size;
+
+    if(!utl_kvs_key_check(key, &key_size))
+        return UTL_KVS_INVALID;
+
+    if(utl_kvs_value_get(kvs, key, &size) == 0)
+        return UTL_KVS_NOT_FOUND;
+
+    return utl_kvs_record_write(kvs, (const uint8_t*) key, key_size, UTL_KVS_FLAG_DELETED, 0, 0);
+}
+
+bool utl_kvs_gc_step(utl_kvs_t* kvs)
+{
+    if(!utl_kvs_gc_needed(kvs))
+        return false;
+
+    if(kvs->gc_sector == UTL_KVS_NO_SECTOR && utl_kvs_gc_start(kvs) != UTL_KVS_OK)
+        return false;
+
+    if(utl_kvs_gc_run(kvs, UTL_KVS_GC_STEP_RECORDS) != UTL_KVS_OK)
+        return false;
+
+    return utl_kvs_gc_needed(kvs);
+}
+
+void utl_kvs_stats_get(utl_kvs_t* kvs, utl_kvs_stats_t* stats)
+{
+    *stats = kvs->stats;
+    stats->free_sectors = utl_kvs_free_sectors(kvs);
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ Log structured key-value store on hal_flash.
+
+ Each flash page of the store is a sector: a header with a sequence number followed by records
+ appended one after the other (key, value and a CRC16). Updating a key appends a new record, so a
+ page is only erased by the garbage collector, which moves the live records of the oldest sector
+ to the newest one. Sectors are used in a ring and the oldest one is always the next collected:
+ static data moves too and erases are spread over all pages.
+
+ Keys are found through a RAM index (open addressing, key hash and flash offset per slot) rebuilt
+ by utl_kvs_init() scanning the sectors in sequence order. Values are read in place.
+
+ One sector is kept free for the garbage collector. When the free sectors drop to that spare, every
+ utl_kvs_set() runs a few collection steps; utl_kvs_gc_step() runs them from idle time instead.
+*/
+
+#define UTL_KVS_MAX_KEY_SIZE 32
+#define UTL_KVS_MAX_VALUE_SIZE 256
+#define UTL_KVS_MAX_SECTORS 32
+// records examined by each garbage collection step
+#define UTL_KVS_GC_STEP_RECORDS 4
+
+typedef enum utl_kvs_status_e
+{
+    UTL_KVS_OK = 0,
+    UTL_KVS_NOT_FOUND,
+    UTL_KVS_INVALID,
+    UTL_KVS_NO_SPACE,
+    UTL_KVS_INDEX_FULL,
+    UTL_KVS_FLASH_ERROR,
+} utl_kvs_status_t;
+
+typedef struct utl_kvs_cfg_s
+{
+    uint32_t first_page;
+    // 2 up to UTL_KVS_MAX_SECTORS
+    uint32_t num_pages;
+} utl_kvs_cfg_t;
+
+typedef struct utl_kvs_slot_s
+{
+    uint32_t hash;
+    // flash offset of the record, 0 for an empty slot
+    uint32_t offset;
+} utl_kvs_slot_t;
+
+typedef struct utl_kvs_stats_s
+{
+    uint32_t keys;
+    uint32_t free_sectors;
+    // key and value bytes passed to utl_kvs_set() and utl_kvs_delete()
+    uint32_t user_bytes;
+    // bytes programmed: records with headers and padding, sector headers and garbage collection
+    uint32_t flash_bytes;
+    uint32_t gc_bytes;
+    uint32_t erases;
+    // utl_kvs_init(): records read to build the index
+    uint32_t scanned;
+} utl_kvs_stats_t;
+
+typedef struct utl_kvs_s
+{
+    utl_kvs_cfg_t cfg;
+    utl_kvs_slot_t* index;
+    uint32_t index_size;
+    uint32_t page_size;
+    uint32_t write_size;
+    uint32_t header_size;
+    uint8_t erased_value;
+    // per sector, 0 when erased
+    uint32_t seq[UTL_KVS_MAX_SECTORS];
+    uint32_t next_seq;
+    uint32_t active;
+    // offset of the next record in the active sector
+    uint32_t wr_pos;
+    // sector being collected (UTL_KVS_MAX_SECTORS when none) and next record in it
+    uint32_t gc_sector;
+    uint32_t gc_pos;
+    utl_kvs_stats_t stats;
+    uint8_t record[8 + UTL_KVS_MAX_KEY_SIZE + UTL_KVS_MAX_VALUE_SIZE + 32];
+} utl_kvs_t;
+
+/** Mount the store, formatting pages that do not hold a valid sector, and build the index
+    @param index Index slots, a power of two larger than the number of keys
+*/
+utl_kvs_status_t utl_kvs_init(utl_kvs_t* kvs, const utl_kvs_cfg_t* cfg, utl_kvs_slot_t* index, uint32_t index_size);
+
+/** Erase all pages of the store */
+utl_kvs_status_t utl_kvs_format(utl_kvs_t* kvs);
+
+/** Store a value, nothing is written when the key already has it
+    @param key Null terminated, up to UTL_KVS_MAX_KEY_SIZE characters
+*/
+utl_kvs_status_t utl_kvs_set(utl_kvs_t* kvs, const char* key, const void* value, uint32_t size);
+
+/** Copy a value
+    @param size In: size of @p value. Out: size of the stored value (also when it does not fit).
+*/
+utl_kvs_status_t utl_kvs_get(utl_kvs_t* kvs, const char* key, void* value, uint32_t* size);
+
+/** Direct access to a value in flash, valid until the next utl_kvs_set(), utl_kvs_delete() or
+    utl_kvs_gc_step() call
+    @return 0 when the key does not exist
+*/
+const uint8_t* utl_kvs_ptr_get(utl_kvs_t* kvs, const char* key, uint32_t* size);
+
+utl_kvs_status_t utl_kvs_delete(utl_kvs_t* kvs, const char* key);
+
+/** Run one incremental garbage collection step when free sectors are low
+    @return true when there is still collection work pending
+*/
+bool utl_kvs_gc_step(utl_kvs_t* kvs);
+
+void utl_kvs_stats_get(utl_kvs_t* kvs, utl_kvs_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
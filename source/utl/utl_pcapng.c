@@ -0,0 +1,267 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "utl_pcapng.h"
+
+// ref: https://www.ietf.org/archive/id/draft-ietf-opsawg-pcapng-02.html
+
+#define UTL_PCAPNG_BT_SHB 0x0A0D0D0AUL
+#define UTL_PCAPNG_BT_IDB 0x00000001UL
+#define UTL_PCAPNG_BT_EPB 0x00000006UL
+#define UTL_PCAPNG_BYTE_ORDER_MAGIC 0x1A2B3C4DUL
+
+#define UTL_PCAPNG_OPT_END 0
+#define UTL_PCAPNG_OPT_IF_NAME 2
+#define UTL_PCAPNG_OPT_IF_TSRESOL 9
+#define UTL_PCAPNG_OPT_EPB_FLAGS 2
+
+#define UTL_PCAPNG_PAD4(x) (((x) + 3) & ~3UL)
+#define UTL_PCAPNG_MAX_OPTIONS_SIZE 256
+
+static bool utl_pcapng_write32(utl_pcapng_t* pc, uint32_t value)
+{
+    return fwrite(&value, sizeof(value), 1, pc->file) == 1;
+}
+
+static bool utl_pcapng_write16(utl_pcapng_t* pc, uint16_t value)
+{
+    return fwrite(&value, sizeof(value), 1, pc->file) == 1;
+}
+
+static bool utl_pcapng_write_padded(utl_pcapng_t* pc, const void* data, uint32_t size)
+{
+    static const uint8_t zeros[4] = {0};
+    uint32_t pad = UTL_PCAPNG_PAD4(size) - size;
+
+    if(size && fwrite(data, size, 1, pc->file) != 1)
+        return false;
+
+    return pad == 0 || fwrite(zeros, pad, 1, pc->file) == 1;
+}
+
+static bool utl_pcapng_read32(utl_pcapng_t* pc, uint32_t* value)
+{
+    return fread(value, sizeof(*value), 1, pc->file) == 1;
+}
+
+static bool utl_pcapng_skip(utl_pcapng_t* pc, uint32_t size)
+{
+    return fseek(pc->file, (long) size, SEEK_CUR) == 0;
+}
+
+bool utl_pcapng_create(utl_pcapng_t* pc, const char* file_name)
+{
+    const uint32_t len = 28;
+    bool ok;
+
+    pc->num_ifaces = 0;
+    pc->file = fopen(file_name, "wb");
+    if(pc->file == 0)
+        return false;
+
+    ok = utl_pcapng_write32(pc, UTL_PCAPNG_BT_SHB) && utl_pcapng_write32(pc, len) &&
+         utl_pcapng_write32(pc, UTL_PCAPNG_BYTE_ORDER_MAGIC) && utl_pcapng_write16(pc, 1) &&
+         utl_pcapng_write16(pc, 0) && utl_pcapng_write32(pc, 0xFFFFFFFFUL) && // section length unknown
+         utl_pcapng_write32(pc, 0xFFFFFFFFUL) && utl_pcapng_write32(pc, len);
+
+    if(!ok)
+        utl_pcapng_close(pc);
+
+    return ok;
+}
+
+bool utl_pcapng_iface_add(utl_pcapng_t* pc, uint16_t link_type, const char* name)
+{
+    uint32_t name_len = (uint32_t) strlen(name);
+    const uint8_t tsresol = 9; // nanoseconds
+    // header + link type/reserved/snaplen + if_name + if_tsresol + end of options + trailer
+    uint32_t len = 8 + 8 + (4 + UTL_PCAPNG_PAD4(name_len)) + (4 + 4) + 4 + 4;
+
+    if(pc->file == 0 || pc->num_ifaces >= UTL_PCAPNG_MAX_IFACES)
+        return false;
+
+    bool ok = utl_pcapng_write32(pc, UTL_PCAPNG_BT_IDB) && utl_pcapng_write32(pc, len) &&
+              utl_pcapng_write16(pc, link_type) && utl_pcapng_write16(pc, 0) && utl_pcapng_write32(pc, 0) &&
+              utl_pcapng_write16(pc, UTL_PCAPNG_OPT_IF_NAME) && utl_pcapng_write16(pc, (uint16_t) name_len) &&
+              utl_pcapng_write_padded(pc, name, name_len) && utl_pcapng_write16(pc, UTL_PCAPNG_OPT_IF_TSRESOL) &&
+              utl_pcapng_write16(pc, 1) && utl_pcapng_write_padded(pc, &tsresol, 1) &&
+              utl_pcapng_write32(pc, UTL_PCAPNG_OPT_END) && utl_pcapng_write32(pc, len);
+
+    if(ok)
+        pc->num_ifaces++;
+
+    return ok;
+}
+
+bool utl_pcapng_packet_write(utl_pcapng_t* pc, uint32_t iface, uint64_t ts_ns, utl_pcapng_dir_t dir,
+                             const uint8_t* data, uint32_t size)
+{
+    // header + fixed fields + data + epb_flags + end of options + trailer
+    uint32_t len = 8 + 20 + UTL_PCAPNG_PAD4(size) + (4 + 4) + 4 + 4;
+
+    if(pc->file == 0 || iface >= pc->num_ifaces)
+        return false;
+
+    return utl_pcapng_write32(pc, UTL_PCAPNG_BT_EPB) && utl_pcapng_write32(pc, len) && utl_pcapng_write32(pc, iface) &&
+           utl_pcapng_write32(pc, (uint32_t) (ts_ns >> 32)) && utl_pcapng_write32(pc, (uint32_t) ts_ns) &&
+           utl_pcapng_write32(pc, size) && utl_pcapng_write32(pc, size) && utl_pcapng_write_padded(pc, data, size) &&
+           utl_pcapng_write16(pc, UTL_PCAPNG_OPT_EPB_FLAGS) && utl_pcapng_write16(pc, 4) &&
+           utl_pcapng_write32(pc, (uint32_t) dir) && utl_pcapng_write32(pc, UTL_PCAPNG_OPT_END) &&
+           utl_pcapng_write32(pc, len);
+}
+
+bool utl_pcapng_open(utl_pcapng_t* pc, const char* file_name)
+{
+    uint32_t type, len, magic;
+
+    pc->num_ifaces = 0;
+    pc->file = fopen(file_name, "rb");
+    if(pc->file == 0)
+        return false;
+
+    // only files in host byte order are supported
+    if(!utl_pcapng_read32(pc, &type) || !utl_pcapng_read32(pc, &len) || !utl_pcapng_read32(pc, &magic) ||
+       type != UTL_PCAPNG_BT_SHB || magic != UTL_PCAPNG_BYTE_ORDER_MAGIC || len < 28 || !utl_pcapng_skip(pc, len - 12))
+    {
+        utl_pcapng_close(pc);
+        return false;
+    }
+
+    return true;
+}
+
+static bool utl_pcapng_options_read(utl_pcapng_t* pc, uint32_t size, uint8_t* opts)
+{
+    if(size > UTL_PCAPNG_MAX_OPTIONS_SIZE)
+        return utl_pcapng_skip(pc, size);
+
+    return size == 0 || fread(opts, size, 1, pc->file) == 1;
+}
+
+// search an option inside an option list, returns its value or NULL
+static uint8_t* utl_pcapng_option_find(uint8_t* opts, uint32_t size, uint16_t code, uint16_t* opt_len)
+{
+    uint32_t pos = 0;
+
+    if(size > UTL_PCAPNG_MAX_OPTIONS_SIZE)
+        return 0;
+
+    while(pos + 4 <= size)
+    {
+        uint16_t opt_code, len;
+        memcpy(&opt_code, &opts[pos], 2);
+        memcpy(&len, &opts[pos + 2], 2);
+
+        if(opt_code == UTL_PCAPNG_OPT_END || pos + 4 + len > size)
+            break;
+
+        if(opt_code == code)
+        {
+            *opt_len = len;
+            return &opts[pos + 4];
+        }
+
+        pos += 4 + UTL_PCAPNG_PAD4(len);
+    }
+
+    return 0;
+}
+
+static bool utl_pcapng_idb_read(utl_pcapng_t* pc, uint32_t len)
+{
+    uint8_t opts[UTL_PCAPNG_MAX_OPTIONS_SIZE];
+    uint32_t link, snaplen, opts_size = len - 20;
+    uint64_t units = 1000000; // default resolution is microseconds
+    uint16_t opt_len;
+
+    if(len < 20 || !utl_pcapng_read32(pc, &link) || !utl_pcapng_read32(pc, &snaplen) ||
+       !utl_pcapng_options_read(pc, opts_size, opts))
+        return false;
+
+    uint8_t* tsresol = utl_pcapng_option_find(opts, opts_size, UTL_PCAPNG_OPT_IF_TSRESOL, &opt_len);
+    if(tsresol && opt_len == 1)
+    {
+        units = 1;
+        for(uint8_t n = 0; n < (*tsresol & 0x7F); n++)
+            units *= (*tsresol & 0x80) ? 2 : 10;
+    }
+
+    if(pc->num_ifaces < UTL_PCAPNG_MAX_IFACES)
+        pc->ts_units[pc->num_ifaces++] = units;
+
+    return utl_pcapng_skip(pc, 4);
+}
+
+static bool utl_pcapng_epb_read(utl_pcapng_t* pc, uint32_t len, utl_pcapng_packet_t* pkt, uint8_t* data,
+                                uint32_t size)
+{
+    uint8_t opts[UTL_PCAPNG_MAX_OPTIONS_SIZE];
+    uint32_t ts_high, ts_low, cap_len, orig_len, opts_size;
+    uint16_t opt_len;
+
+    if(len < 32 || !utl_pcapng_read32(pc, &pkt->iface) || !utl_pcapng_read32(pc, &ts_high) ||
+       !utl_pcapng_read32(pc, &ts_low) || !utl_pcapng_read32(pc, &cap_len) || !utl_pcapng_read32(pc, &orig_len) ||
+       UTL_PCAPNG_PAD4(cap_len) > len - 32)
+        return false;
+
+    pkt->size = cap_len < size ? cap_len : size;
+    if(pkt->size && fread(data, pkt->size, 1, pc->file) != 1)
+        return false;
+
+    opts_size = len - 32 - UTL_PCAPNG_PAD4(cap_len);
+    if(!utl_pcapng_skip(pc, UTL_PCAPNG_PAD4(cap_len) - pkt->size) || !utl_pcapng_options_read(pc, opts_size, opts))
+        return false;
+
+    uint64_t ts = ((uint64_t) ts_high << 32) | ts_low;
+    uint64_t units = pkt->iface < pc->num_ifaces ? pc->ts_units[pkt->iface] : 1000000;
+    pkt->ts_ns = (ts / units) * 1000000000ULL + (ts % units) * 1000000000ULL / units;
+
+    uint8_t* flags = utl_pcapng_option_find(opts, opts_size, UTL_PCAPNG_OPT_EPB_FLAGS, &opt_len);
+    pkt->dir = UTL_PCAPNG_DIR_UNKNOWN;
+    if(flags && opt_len == 4)
+    {
+        uint32_t value;
+        memcpy(&value, flags, 4);
+        pkt->dir = (utl_pcapng_dir_t) (value & 0x03);
+    }
+
+    return utl_pcapng_skip(pc, 4);
+}
+
+bool utl_pcapng_packet_read(utl_pcapng_t* pc, utl_pcapng_packet_t* pkt, uint8_t* data, uint32_t size)
+{
+    uint32_t type, len;
+
+    if(pc->file == 0)
+        return false;
+
+    while(utl_pcapng_read32(pc, &type) && utl_pcapng_read32(pc, &len))
+    {
+        if(len < 12 || (len & 3))
+            return false;
+
+        if(type == UTL_PCAPNG_BT_EPB)
+            return utl_pcapng_epb_read(pc, len, pkt, data, size);
+
+        if(type == UTL_PCAPNG_BT_IDB)
+        {
+            if(!utl_pcapng_idb_read(pc, len))
+                return false;
+        }
+        else if(!utl_pcapng_skip(pc, len - 8))
+            return false;
+    }
+
+    return false;
+}
+
+void utl_pcapng_close(utl_pcapng_t* pc)
+{
+    if(pc->file)
+        fclose(pc->file);
+
+    pc->file = 0;
+}
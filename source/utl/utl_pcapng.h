@@ -0,0 +1,69 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Minimal pcapng reader/writer: one section, any number of interfaces and enhanced packet blocks.
+// Files are written in host byte order with nanosecond timestamps.
+
+#define UTL_PCAPNG_LINKTYPE_USER0 147
+
+typedef enum utl_pcapng_dir_e
+{
+    UTL_PCAPNG_DIR_UNKNOWN = 0,
+    UTL_PCAPNG_DIR_INBOUND = 1,
+    UTL_PCAPNG_DIR_OUTBOUND = 2,
+} utl_pcapng_dir_t;
+
+typedef struct utl_pcapng_packet_s
+{
+    uint32_t iface;
+    uint64_t ts_ns;
+    utl_pcapng_dir_t dir;
+    uint32_t size;
+} utl_pcapng_packet_t;
+
+#define UTL_PCAPNG_MAX_IFACES 8
+
+typedef struct utl_pcapng_s
+{
+    FILE* file;
+    uint32_t num_ifaces;
+    // timestamp units per second, for each interface (reader only)
+    uint64_t ts_units[UTL_PCAPNG_MAX_IFACES];
+} utl_pcapng_t;
+
+/** Create a capture file and write the section header
+    @return true on success
+*/
+bool utl_pcapng_create(utl_pcapng_t* pc, const char* file_name);
+
+/** Add an interface description, interfaces are numbered from 0 in the order they are added
+    @return true on success
+*/
+bool utl_pcapng_iface_add(utl_pcapng_t* pc, uint16_t link_type, const char* name);
+
+/** Write one packet, @p ts_ns is the time since epoch in nanoseconds
+    @return true on success
+*/
+bool utl_pcapng_packet_write(utl_pcapng_t* pc, uint32_t iface, uint64_t ts_ns, utl_pcapng_dir_t dir,
+                             const uint8_t* data, uint32_t size);
+
+/** Open a capture file for reading
+    @return true on success
+*/
+bool utl_pcapng_open(utl_pcapng_t* pc, const char* file_name);
+
+/** Read the next packet, other block types are skipped
+    @param data Destination for packet data, packets larger than @p size are truncated
+    @return true if a packet was read, false at end of file or on error
+*/
+bool utl_pcapng_packet_read(utl_pcapng_t* pc, utl_pcapng_packet_t* pkt, uint8_t* data, uint32_t size);
+
+void utl_pcapng_close(utl_pcapng_t* pc);
+
+#ifdef __cplusplus
+}
+#endif
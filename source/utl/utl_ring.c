@@ -0,0 +1,117 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "utl_ring.h"
+
+utl_ring_t* utl_ring_init(void* area, size_t area_size)
+{
+    utl_ring_t* ring = (utl_ring_t*) area;
+    uint32_t size = 1;
+
+    if(area == 0 || area_size < UTL_RING_AREA_SIZE(2))
+        return 0;
+
+    area_size -= sizeof(utl_ring_t);
+    while((size_t) size * 2 <= area_size && size < 0x80000000UL)
+        size *= 2;
+
+    atomic_init(&ring->prod, 0);
+    atomic_init(&ring->cons, 0);
+    ring->size = size;
+
+    return ring;
+}
+
+uint32_t utl_ring_bytes_available(utl_ring_t* ring)
+{
+    uint32_t prod = atomic_load_explicit(&ring->prod, memory_order_acquire);
+    uint32_t cons = atomic_load_explicit(&ring->cons, memory_order_acquire);
+
+    return prod - cons;
+}
+
+uint32_t utl_ring_space_available(utl_ring_t* ring)
+{
+    return ring->size - utl_ring_bytes_available(ring);
+}
+
+uint32_t utl_ring_write(utl_ring_t* ring, const uint8_t* data, uint32_t size)
+{
+    uint32_t prod = atomic_load_explicit(&ring->prod, memory_order_relaxed);
+    uint32_t cons = atomic_load_explicit(&ring->cons, memory_order_acquire);
+    uint32_t space = ring->size - (prod - cons);
+    uint32_t pos = prod & (ring->size - 1);
+    uint32_t chunk;
+
+    if(size > space)
+        size = space;
+
+    // copy in two steps when crossing the end of the data area
+    chunk = ring->size - pos;
+    if(chunk > size)
+        chunk = size;
+
+    memcpy(&ring->buffer[pos], data, chunk);
+    memcpy(&ring->buffer[0], data + chunk, size - chunk);
+
+    atomic_store_explicit(&ring->prod, prod + size, memory_order_release);
+
+    return size;
+}
+
+static uint32_t utl_ring_copy(utl_ring_t* ring, uint32_t cons, uint8_t* data, uint32_t size)
+{
+    uint32_t prod = atomic_load_explicit(&ring->prod, memory_order_acquire);
+    uint32_t avail = prod - cons;
+    uint32_t pos = cons & (ring->size - 1);
+    uint32_t chunk;
+
+    if(size > avail)
+        size = avail;
+
+    chunk = ring->size - pos;
+    if(chunk > size)
+        chunk = size;
+
+    memcpy(data, &ring->buffer[pos], chunk);
+    memcpy(data + chunk, &ring->buffer[0], size - chunk);
+
+    return size;
+}
+
+uint32_t utl_ring_read(utl_ring_t* ring, uint8_t* data, uint32_t size)
+{
+    uint32_t cons = atomic_load_explicit(&ring->cons, memory_order_relaxed);
+
+    size = utl_ring_copy(ring, cons, data, size);
+    atomic_store_explicit(&ring->cons, cons + size, memory_order_release);
+
+    return size;
+}
+
+uint32_t utl_ring_peek(utl_ring_t* ring, uint8_t* data, uint32_t size)
+{
+    return utl_ring_copy(ring, atomic_load_explicit(&ring->cons, memory_order_relaxed), data, size);
+}
+
+uint32_t utl_ring_skip(utl_ring_t* ring, uint32_t size)
+{
+    uint32_t cons = atomic_load_explicit(&ring->cons, memory_order_relaxed);
+    uint32_t avail = atomic_load_explicit(&ring->prod, memory_order_acquire) - cons;
+
+    if(size > avail)
+        size = avail;
+
+    atomic_store_explicit(&ring->cons, cons + size, memory_order_release);
+
+    return size;
+}
+
+void utl_ring_flush(utl_ring_t* ring)
+{
+    uint32_t prod = atomic_load_explicit(&ring->prod, memory_order_acquire);
+
+    atomic_store_explicit(&ring->cons, prod, memory_order_release);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdatomic.h>
+
+/**
+ Lock-free single producer / single consumer byte ring.
+
+ The control block and the data area live in the same memory region, so a ring can be placed in
+ static memory, in a heap block or in a segment shared between processes. Producer and consumer
+ indexes are free running 32 bits counters and the data area size is always a power of two.
+*/
+typedef struct utl_ring_s
+{
+    _Atomic uint32_t prod;
+    _Atomic uint32_t cons;
+    uint32_t size;
+    uint8_t buffer[];
+} utl_ring_t;
+
+/** Memory required to hold a ring with @p size data bytes */
+#define UTL_RING_AREA_SIZE(size) (sizeof(utl_ring_t) + (size))
+
+/** Initialize a ring inside @p area (4 bytes aligned)
+    @param area Memory used for control block and data
+    @param area_size Size of @p area in bytes, data size is rounded down to a power of two
+    @return Pointer to the ring or NULL if area is too small
+*/
+utl_ring_t* utl_ring_init(void* area, size_t area_size);
+
+/** Bytes available for the consumer */
+uint32_t utl_ring_bytes_available(utl_ring_t* ring);
+
+/** Free space available for the producer */
+uint32_t utl_ring_space_available(utl_ring_t* ring);
+
+/** Producer side: copy up to @p size bytes into the ring
+    @return Number of bytes copied (less than @p size when ring is full)
+*/
+uint32_t utl_ring_write(utl_ring_t* ring, const uint8_t* data, uint32_t size);
+
+/** Consumer side: copy up to @p size bytes from the ring
+    @return Number of bytes copied
+*/
+uint32_t utl_ring_read(utl_ring_t* ring, uint8_t* data, uint32_t size);
+
+/** Consumer side: copy up to @p size bytes without removing them from the ring
+    @return Number of bytes copied
+*/
+uint32_t utl_ring_peek(utl_ring_t* ring, uint8_t* data, uint32_t size);
+
+/** Consumer side: discard up to @p size bytes
+    @return Number of bytes discarded
+*/
+uint32_t utl_ring_skip(utl_ring_t* ring, uint32_t size);
+
+/** Consumer side: discard all pending bytes */
+void utl_ring_flush(utl_ring_t* ring);
+
+#ifdef __cplusplus
+}
+#endif
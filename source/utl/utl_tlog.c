@@ -0,0 +1,383 @@
+#include "hal.h"
+#include "utl_crc16.h"
+#include "utl_tlog.h"
+
+// sector header, three write units: magic and sequence number, timestamp of the first record
+// (both programmed when the sector is opened), timestamp of the last record and record count
+// (programmed when it is closed). Records follow.
+#define UTL_TLOG_MAGIC 0x474F4C54UL
+// record header: timestamp, data size (16 bits), CRC16 of timestamp, size and data
+#define UTL_TLOG_RECORD_HEADER_SIZE 8
+
+typedef enum utl_tlog_record_e
+{
+    UTL_TLOG_RECORD_OK = 0,
+    UTL_TLOG_RECORD_END,
+    UTL_TLOG_RECORD_BAD,
+} utl_tlog_record_check_t;
+
+static uint32_t utl_tlog_align(utl_tlog_t* tlog, uint32_t size)
+{
+    return (size + tlog->write_size - 1) / tlog->write_size * tlog->write_size;
+}
+
+static const uint8_t* utl_tlog_sector_ptr(utl_tlog_t* tlog, uint32_t sector, uint32_t pos)
+{
+    return hal_flash_ptr_get((tlog->cfg.first_page + sector) * tlog->page_size + pos);
+}
+
+static uint32_t utl_tlog_u32_get(const uint8_t* data)
+{
+    uint32_t value;
+
+    memcpy(&value, data, 4);
+
+    return value;
+}
+
+static bool utl_tlog_erased(utl_tlog_t* tlog, const uint8_t* data, uint32_t size)
+{
+    while(size--)
+    {
+        if(*data++ != tlog->erased_value)
+            return false;
+    }
+
+    return true;
+}
+
+// sector at position @p index of the ring, 0 is the oldest
+static uint32_t utl_tlog_sector_get(utl_tlog_t* tlog, uint32_t index)
+{
+    return (tlog->oldest + index) % tlog->cfg.num_pages;
+}
+
+static uint32_t utl_tlog_records_start(utl_tlog_t* tlog)
+{
+    return 3 * tlog->unit_size;
+}
+
+static utl_tlog_record_check_t utl_tlog_record_check(utl_tlog_t* tlog, uint32_t sector, uint32_t pos, uint32_t* size)
+{
+    const uint8_t* rec = utl_tlog_sector_ptr(tlog, sector, pos);
+
+    if(pos + UTL_TLOG_RECORD_HEADER_SIZE > tlog->page_size || utl_tlog_erased(tlog, rec + 4, 2))
+        return UTL_TLOG_RECORD_END;
+
+    uint32_t data_size = rec[4] | ((uint32_t) rec[5] << 8);
+    if(data_size > UTL_TLOG_MAX_DATA_SIZE)
+        return UTL_TLOG_RECORD_BAD;
+
+    *size = utl_tlog_align(tlog, UTL_TLOG_RECORD_HEADER_SIZE + data_size);
+    if(pos + *size > tlog->page_size)
+        return UTL_TLOG_RECORD_BAD;
+
+    uint16_t crc = utl_crc16_data(rec, 6, 0xFFFF);
+    crc = utl_crc16_data(rec + UTL_TLOG_RECORD_HEADER_SIZE, data_size, crc);
+
+    return crc == (rec[6] | ((uint16_t) rec[7] << 8)) ? UTL_TLOG_RECORD_OK : UTL_TLOG_RECORD_BAD;
+}
+
+// records of a sector: count, timestamp of the last one and where the next one goes
+static uint32_t utl_tlog_sector_scan(utl_tlog_t* tlog, uint32_t sector, uint32_t* t_last, uint32_t* wr_pos)
+{
+    uint32_t pos = utl_tlog_records_start(tlog);
+    utl_tlog_record_check_t state;
+    uint32_t count = 0;
+    uint32_t size;
+
+    while((state = utl_tlog_record_check(tlog, sector, pos, &size)) == UTL_TLOG_RECORD_OK)
+    {
+        *t_last = utl_tlog_u32_get(utl_tlog_sector_ptr(tlog, sector, pos));
+        pos += size;
+        count++;
+    }
+
+    // a damaged tail is never written again
+    *wr_pos = state == UTL_TLOG_RECORD_BAD ? tlog->page_size : pos;
+
+    return count;
+}
+
+static bool utl_tlog_sector_close(utl_tlog_t* tlog, uint32_t sector, uint32_t t_last, uint32_t count)
+{
+    uint32_t offset = (tlog->cfg.first_page + sector) * tlog->page_size + 2 * tlog->unit_size;
+    uint8_t unit[32];
+
+    // already closed when a reset happened before the next sector was opened
+    if(!utl_tlog_erased(tlog, hal_flash_ptr_get(offset), tlog->unit_size))
+        return true;
+
+    memset(unit, tlog->erased_value, tlog->unit_size);
+    memcpy(&unit[0], &t_last, 4);
+    memcpy(&unit[4], &count, 4);
+
+    return hal_flash_program(offset, unit, tlog->unit_size);
+}
+
+static uint32_t utl_tlog_t_first_get(utl_tlog_t* tlog, uint32_t index)
+{
+    return utl_tlog_u32_get(utl_tlog_sector_ptr(tlog, utl_tlog_sector_get(tlog, index), tlog->unit_size));
+}
+
+static uint32_t utl_tlog_t_last_get(utl_tlog_t* tlog, uint32_t index)
+{
+    if(index == tlog->used - 1)
+        return tlog->t_last;
+
+    return utl_tlog_u32_get(utl_tlog_sector_ptr(tlog, utl_tlog_sector_get(tlog, index), 2 * tlog->unit_size));
+}
+
+static utl_tlog_status_t utl_tlog_sector_open(utl_tlog_t* tlog, uint32_t t_first)
+{
+    uint8_t header[64];
+    uint32_t magic = UTL_TLOG_MAGIC;
+
+    if(tlog->used && !utl_tlog_sector_close(tlog, utl_tlog_sector_get(tlog, tlog->used - 1), tlog->t_last, tlog->count))
+        return UTL_TLOG_FLASH_ERROR;
+
+    // full: the oldest sector goes
+    if(tlog->used == tlog->cfg.num_pages)
+    {
+        const uint8_t* closing = utl_tlog_sector_ptr(tlog, tlog->oldest, 2 * tlog->unit_size);
+
+        tlog->stats.records -= utl_tlog_u32_get(closing + 4);
+        tlog->stats.erases++;
+        if(!hal_flash_page_erase(tlog->cfg.first_page + tlog->oldest))
+            return UTL_TLOG_FLASH_ERROR;
+
+        tlog->oldest = utl_tlog_sector_get(tlog, 1);
+        tlog->used--;
+    }
+
+    uint32_t sector = utl_tlog_sector_get(tlog, tlog->used);
+
+    memset(header, tlog->erased_value, 2 * tlog->unit_size);
+    memcpy(&header[0], &magic, 4);
+    memcpy(&header[4], &tlog->next_seq, 4);
+    memcpy(&header[tlog->unit_size], &t_first, 4);
+
+    if(!hal_flash_program((tlog->cfg.first_page + sector) * tlog->page_size, header, 2 * tlog->unit_size))
+        return UTL_TLOG_FLASH_ERROR;
+
+    tlog->next_seq++;
+    tlog->used++;
+    tlog->wr_pos = utl_tlog_records_start(tlog);
+    tlog->count = 0;
+
+    return UTL_TLOG_OK;
+}
+
+utl_tlog_status_t utl_tlog_init(utl_tlog_t* tlog, const utl_tlog_cfg_t* cfg)
+{
+    hal_flash_info_t info;
+    uint32_t oldest = 0, newest = 0;
+    uint32_t seq_min = UINT32_MAX, seq_max = 0;
+
+    hal_flash_info_get(&info);
+
+    if(cfg->num_pages < 2 || cfg->num_pages > UTL_TLOG_MAX_SECTORS ||
+       (cfg->first_page + cfg->num_pages) * info.page_size > info.size || info.write_size > 32 ||
+       info.page_size < 2 * (96 + sizeof(tlog->record)))
+        return UTL_TLOG_INVALID;
+
+    memset(tlog, 0, sizeof(utl_tlog_t));
+    tlog->cfg = *cfg;
+    tlog->page_size = info.page_size;
+    tlog->write_size = info.write_size;
+    tlog->unit_size = utl_tlog_align(tlog, 8);
+    tlog->erased_value = info.erased_value;
+
+    for(uint32_t sector = 0; sector < cfg->num_pages; sector++)
+    {
+        const uint8_t* header = utl_tlog_sector_ptr(tlog, sector, 0);
+        uint32_t seq = utl_tlog_u32_get(header + 4);
+
+        if(utl_tlog_u32_get(header) == UTL_TLOG_MAGIC && seq != 0 && seq != UINT32_MAX)
+        {
+            if(seq < seq_min)
+                seq_min = seq, oldest = sector;
+            if(seq >= seq_max)
+                seq_max = seq, newest = sector;
+            continue;
+        }
+
+        // not a sector: erased only when needed (interrupted erase or header program)
+        if(!utl_tlog_erased(tlog, header, tlog->page_size))
+        {
+            tlog->stats.erases++;
+            if(!hal_flash_page_erase(cfg->first_page + sector))
+                return UTL_TLOG_FLASH_ERROR;
+        }
+    }
+
+    tlog->next_seq = seq_max + 1;
+    tlog->oldest = oldest;
+    // sectors are opened in ring order, from the oldest to the newest
+    tlog->used = seq_max ? (newest + cfg->num_pages - oldest) % cfg->num_pages + 1 : 0;
+
+    for(uint32_t index = 0; index < tlog->used; index++)
+    {
+        uint32_t sector = utl_tlog_sector_get(tlog, index);
+        const uint8_t* closing = utl_tlog_sector_ptr(tlog, sector, 2 * tlog->unit_size);
+        uint32_t t_last = utl_tlog_t_first_get(tlog, index);
+        uint32_t wr_pos;
+
+        if(index == tlog->used - 1)
+        {
+            tlog->count = utl_tlog_sector_scan(tlog, sector, &tlog->t_last, &tlog->wr_pos);
+            tlog->t_last = tlog->count ? tlog->t_last : t_last;
+            tlog->stats.records += tlog->count;
+        }
+        else if(utl_tlog_erased(tlog, closing, tlog->unit_size))
+        {
+            // left open by a reset
+            uint32_t count = utl_tlog_sector_scan(tlog, sector, &t_last, &wr_pos);
+
+            if(!utl_tlog_sector_close(tlog, sector, t_last, count))
+                return UTL_TLOG_FLASH_ERROR;
+            tlog->stats.records += count;
+        }
+        else
+        {
+            tlog->stats.records += utl_tlog_u32_get(closing + 4);
+        }
+    }
+
+    return UTL_TLOG_OK;
+}
+
+utl_tlog_status_t utl_tlog_format(utl_tlog_t* tlog)
+{
+    for(uint32_t sector = 0; sector < tlog->cfg.num_pages; sector++)
+    {
+        tlog->stats.erases++;
+        if(!hal_flash_page_erase(tlog->cfg.first_page + sector))
+            return UTL_TLOG_FLASH_ERROR;
+    }
+
+    tlog->oldest = 0;
+    tlog->used = 0;
+    tlog->next_seq = 1;
+    tlog->t_last = 0;
+    tlog->count = 0;
+    tlog->stats.records = 0;
+
+    return UTL_TLOG_OK;
+}
+
+utl_tlog_status_t utl_tlog_append(utl_tlog_t* tlog, uint32_t timestamp, const void* data, uint32_t size)
+{
+    uint8_t* rec = tlog->record;
+    uint32_t rec_size = utl_tlog_align(tlog, UTL_TLOG_RECORD_HEADER_SIZE + size);
+
+    if(size > UTL_TLOG_MAX_DATA_SIZE || (tlog->used && timestamp < tlog->t_last))
+        return UTL_TLOG_INVALID;
+
+    if(tlog->used == 0 || tlog->wr_pos + rec_size > tlog->page_size)
+    {
+        utl_tlog_status_t status = utl_tlog_sector_open(tlog, timestamp);
+        if(status != UTL_TLOG_OK)
+            return status;
+    }
+
+    memset(rec, tlog->erased_value, rec_size);
+    memcpy(&rec[0], &timestamp, 4);
+    rec[4] = (uint8_t) size;
+    rec[5] = (uint8_t) (size >> 8);
+    if(size)
+        memcpy(rec + UTL_TLOG_RECORD_HEADER_SIZE, data, size);
+
+    uint16_t crc = utl_crc16_data(rec, 6, 0xFFFF);
+    crc = utl_crc16_data(rec + UTL_TLOG_RECORD_HEADER_SIZE, size, crc);
+    rec[6] = (uint8_t) crc;
+    rec[7] = (uint8_t) (crc >> 8);
+
+    uint32_t sector = utl_tlog_sector_get(tlog, tlog->used - 1);
+    if(!hal_flash_program((tlog->cfg.first_page + sector) * tlog->page_size + tlog->wr_pos, rec, rec_size))
+        return UTL_TLOG_FLASH_ERROR;
+
+    tlog->wr_pos += rec_size;
+    tlog->t_last = timestamp;
+    tlog->count++;
+    tlog->stats.records++;
+
+    return UTL_TLOG_OK;
+}
+
+bool utl_tlog_range_get(utl_tlog_t* tlog, uint32_t* t_first, uint32_t* t_last)
+{
+    if(tlog->used == 0)
+        return false;
+
+    *t_first = utl_tlog_t_first_get(tlog, 0);
+    *t_last = tlog->t_last;
+
+    return true;
+}
+
+void utl_tlog_find(utl_tlog_t* tlog, utl_tlog_iter_t* iter, uint32_t t_start, uint32_t t_end)
+{
+    uint32_t low = 0, high = tlog->used;
+
+    // first sector whose last record is not older than t_start
+    while(low < high)
+    {
+        uint32_t mid = low + (high - low) / 2;
+
+        tlog->stats.probes++;
+        if(utl_tlog_t_last_get(tlog, mid) < t_start)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    iter->index = low;
+    iter->pos = utl_tlog_records_start(tlog);
+    iter->t_start = t_start;
+    iter->t_end = t_end;
+}
+
+bool utl_tlog_next(utl_tlog_t* tlog, utl_tlog_iter_t* iter, utl_tlog_record_t* record)
+{
+    while(iter->index < tlog->used)
+    {
+        uint32_t sector = utl_tlog_sector_get(tlog, iter->index);
+        uint32_t size;
+
+        if(utl_tlog_record_check(tlog, sector, iter->pos, &size) != UTL_TLOG_RECORD_OK)
+        {
+            iter->index++;
+            iter->pos = utl_tlog_records_start(tlog);
+            continue;
+        }
+
+        const uint8_t* rec = utl_tlog_sector_ptr(tlog, sector, iter->pos);
+        uint32_t timestamp = utl_tlog_u32_get(rec);
+
+        iter->pos += size;
+
+        if(timestamp < iter->t_start)
+            continue;
+
+        if(timestamp > iter->t_end)
+        {
+            iter->index = tlog->used;
+            return false;
+        }
+
+        record->timestamp = timestamp;
+        record->size = rec[4] | ((uint32_t) rec[5] << 8);
+        record->data = rec + UTL_TLOG_RECORD_HEADER_SIZE;
+
+        return true;
+    }
+
+    return false;
+}
+
+void utl_tlog_stats_get(utl_tlog_t* tlog, utl_tlog_stats_t* stats)
+{
+    *stats = tlog->stats;
+    stats->used_sectors = tlog->used;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ Circular log of time stamped records on hal_flash.
+
+ Each flash page of the log is a sector, filled in ring order with records of non decreasing
+ timestamps; when all sectors are used the oldest one is erased. The sector header holds its
+ sequence number and the timestamp of its first record, and the timestamp of the last record is
+ programmed when the sector is closed. A range query binary searches these headers to find the
+ first sector of the range and only scans records from there.
+
+ Timestamps are 32 bits in any unit chosen by the application (seconds, milliseconds...).
+*/
+
+#define UTL_TLOG_MAX_DATA_SIZE 256
+#define UTL_TLOG_MAX_SECTORS 64
+
+typedef enum utl_tlog_status_e
+{
+    UTL_TLOG_OK = 0,
+    UTL_TLOG_INVALID,
+    UTL_TLOG_FLASH_ERROR,
+} utl_tlog_status_t;
+
+typedef struct utl_tlog_cfg_s
+{
+    uint32_t first_page;
+    // 2 up to UTL_TLOG_MAX_SECTORS
+    uint32_t num_pages;
+} utl_tlog_cfg_t;
+
+typedef struct utl_tlog_record_s
+{
+    uint32_t timestamp;
+    uint32_t size;
+    // in flash, valid until the log wraps over its sector
+    const uint8_t* data;
+} utl_tlog_record_t;
+
+typedef struct utl_tlog_iter_s
+{
+    // position in ring order (0: oldest sector) and offset in the sector
+    uint32_t index;
+    uint32_t pos;
+    uint32_t t_start;
+    uint32_t t_end;
+} utl_tlog_iter_t;
+
+typedef struct utl_tlog_stats_s
+{
+    uint32_t records;
+    uint32_t used_sectors;
+    uint32_t erases;
+    // sector headers read by range queries, for the binary search
+    uint32_t probes;
+} utl_tlog_stats_t;
+
+typedef struct utl_tlog_s
+{
+    utl_tlog_cfg_t cfg;
+    uint32_t page_size;
+    uint32_t write_size;
+    uint32_t unit_size;
+    uint8_t erased_value;
+    // ring: oldest sector and number of used sectors, the newest is the active one
+    uint32_t oldest;
+    uint32_t used;
+    uint32_t next_seq;
+    uint32_t wr_pos;
+    uint32_t t_last;
+    // records in the active sector
+    uint32_t count;
+    utl_tlog_stats_t stats;
+    uint8_t record[8 + UTL_TLOG_MAX_DATA_SIZE + 32];
+} utl_tlog_t;
+
+/** Mount the log: find the oldest and newest sectors, close sectors left open by a reset and erase
+    pages that do not hold a valid sector
+*/
+utl_tlog_status_t utl_tlog_init(utl_tlog_t* tlog, const utl_tlog_cfg_t* cfg);
+
+/** Erase all pages of the log */
+utl_tlog_status_t utl_tlog_format(utl_tlog_t* tlog);
+
+/** Append a record
+    @return UTL_TLOG_INVALID when @p timestamp is older than the last record or @p size is too large
+*/
+utl_tlog_status_t utl_tlog_append(utl_tlog_t* tlog, uint32_t timestamp, const void* data, uint32_t size);
+
+/** Timestamps of the oldest and newest records
+    @return false when the log is empty
+*/
+bool utl_tlog_range_get(utl_tlog_t* tlog, uint32_t* t_first, uint32_t* t_last);
+
+/** Start a query of the records with timestamps from @p t_start to @p t_end (both included) */
+void utl_tlog_find(utl_tlog_t* tlog, utl_tlog_iter_t* iter, uint32_t t_start, uint32_t t_end);
+
+/** Next record of a query, in timestamp order
+    @return false at the end of the range
+*/
+bool utl_tlog_next(utl_tlog_t* tlog, utl_tlog_iter_t* iter, utl_tlog_record_t* record);
+
+void utl_tlog_stats_get(utl_tlog_t* tlog, utl_tlog_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
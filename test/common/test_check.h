@@ -0,0 +1,38 @@
+#pragma once
+
+#include "hal.h"
+#include "utl_dbg.h"
+
+// Pass/fail checks and timing shared by the host tests: each check prints one line, test_report()
+// prints the number of failed ones. Meant to be included by the single source file of a test.
+
+static uint32_t test_errors = 0;
+
+static inline void test_check(bool ok, const char* what)
+{
+    if(!ok)
+        test_errors++;
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "%s: %s\n", what, ok ? "ok" : "FAILED");
+}
+
+// for checks repeated in loops: counted like test_check(), printed only when they fail
+static inline void test_check_silent(bool ok, const char* what)
+{
+    if(ok)
+        return;
+
+    test_errors++;
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "%s: FAILED\n", what);
+}
+
+static inline void test_report(void)
+{
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "%u errors\n", test_errors);
+}
+
+// microseconds since a hal_cpu_cycles_get() value
+static inline uint32_t test_us_get(uint32_t start)
+{
+    return (uint32_t) ((uint64_t) (hal_cpu_cycles_get() - start) * 1000000 / hal_cpu_cycles_freq_get());
+}
@@ -0,0 +1,219 @@
+#include <unistd.h>
+
+#include "hal.h"
+#include "app.h"
+#include "test_check.h"
+
+#define TEST_SOURCE "adc.wav"
+// a ramp on channel 0 and its mirror on channel 1, a whole number of ramps so the loop is seamless
+#define TEST_SOURCE_CHANNELS 2
+#define TEST_SOURCE_FRAMES (4 * 4096)
+#define TEST_SOURCE_RATE 16000
+#define TEST_RUN_MS 1000
+#define TEST_HALF_MS 10
+#define TEST_FIR_TAPS 64
+#define TEST_SLOW_MS 15
+
+typedef enum test_mode_e
+{
+    TEST_MODE_CHECK = 0,
+    TEST_MODE_FIR,
+    TEST_MODE_SLOW,
+} test_mode_t;
+
+static uint16_t buffer[2 * TEST_SOURCE_RATE * TEST_HALF_MS / 1000 * 3];
+static volatile test_mode_t mode;
+static volatile uint32_t halves = 0;
+static volatile uint32_t bad_frames = 0;
+static volatile uint32_t gaps = 0;
+static int32_t next_code = -1;
+static int32_t fir_history[TEST_FIR_TAPS];
+static volatile int32_t fir_out = 0;
+
+static void test_wr16(FILE* f, uint16_t v)
+{
+    fputc(v & 0xFF, f);
+    fputc(v >> 8, f);
+}
+
+static void test_wr32(FILE* f, uint32_t v)
+{
+    test_wr16(f, (uint16_t) v);
+    test_wr16(f, (uint16_t) (v >> 16));
+}
+
+static bool test_source_write(void)
+{
+    FILE* f = fopen(TEST_SOURCE, "wb");
+    uint32_t data_size = TEST_SOURCE_FRAMES * TEST_SOURCE_CHANNELS * 2;
+
+    if(f == 0)
+        return false;
+
+    fwrite("RIFF", 1, 4, f);
+    test_wr32(f, 36 + data_size);
+    fwrite("WAVEfmt ", 1, 8, f);
+    test_wr32(f, 16);
+    test_wr16(f, 1);
+    test_wr16(f, TEST_SOURCE_CHANNELS);
+    test_wr32(f, TEST_SOURCE_RATE);
+    test_wr32(f, TEST_SOURCE_RATE * TEST_SOURCE_CHANNELS * 2);
+    test_wr16(f, TEST_SOURCE_CHANNELS * 2);
+    test_wr16(f, 16);
+    fwrite("data", 1, 4, f);
+    test_wr32(f, data_size);
+
+    // codes n and 4095 - n, as 16 bits signed samples
+    for(uint32_t n = 0; n < TEST_SOURCE_FRAMES; n++)
+    {
+        test_wr16(f, (uint16_t) ((n % 4096) * 16 - 32768));
+        test_wr16(f, (uint16_t) ((4095 - n % 4096) * 16 - 32768));
+    }
+
+    return fclose(f) == 0;
+}
+
+static void test_check_half(const uint16_t* samples, uint32_t num_frames)
+{
+    if(next_code >= 0 && samples[0] != next_code)
+        gaps++;
+
+    for(uint32_t frame = 0; frame < num_frames; frame++, samples += 3)
+    {
+        // the ramp, its mirror, and an input not in the file
+        bool ramp = frame == 0 || samples[0] == ((samples[-3] + 1) & 0xFFF);
+
+        if(!ramp || samples[1] != 4095 - samples[0] || samples[2] != 2048)
+            bad_frames++;
+    }
+
+    next_code = (samples[-3] + 1) & 0xFFF;
+}
+
+// moving average, as a stand-in for a real filter
+static void test_fir(const uint16_t* samples, uint32_t num_frames)
+{
+    for(uint32_t frame = 0; frame < num_frames; frame++)
+    {
+        int32_t acc = 0;
+
+        memmove(&fir_history[1], &fir_history[0], (TEST_FIR_TAPS - 1) * sizeof(int32_t));
+        fir_history[0] = (int32_t) samples[frame] - 2048;
+
+        for(uint32_t tap = 0; tap < TEST_FIR_TAPS; tap++)
+            acc += fir_history[tap];
+
+        fir_out = acc / TEST_FIR_TAPS;
+    }
+}
+
+static void test_callback(hal_adc_id_t adc, const uint16_t* samples, uint32_t num_frames, uint32_t timestamp)
+{
+    halves++;
+
+    if(mode == TEST_MODE_CHECK)
+    {
+        test_check_half(samples, num_frames);
+    }
+    else if(mode == TEST_MODE_FIR)
+    {
+        test_fir(samples, num_frames);
+    }
+    else
+    {
+        uint32_t start = hal_cpu_cycles_get();
+        uint32_t cycles = (uint32_t) ((uint64_t) hal_cpu_cycles_freq_get() * TEST_SLOW_MS / 1000);
+
+        while(hal_cpu_cycles_get() - start < cycles)
+            ;
+    }
+}
+
+static void test_run(test_mode_t run_mode, uint32_t rate, uint32_t num_channels, uint32_t run_ms,
+                     hal_adc_stats_t* stats)
+{
+    hal_adc_config_t cfg = {
+        .sample_rate_hz = rate,
+        .num_channels = num_channels,
+        .inputs = {0, 1, 5},
+        .buffer = buffer,
+        .frames_per_half = rate * TEST_HALF_MS / 1000,
+        .callback = test_callback,
+    };
+
+    mode = run_mode;
+    halves = 0;
+    test_check(hal_adc_config(HAL_ADC_0, &cfg) && hal_adc_start(HAL_ADC_0), "Start");
+
+    uint32_t start = hal_cpu_time_get_ms();
+    while(hal_cpu_time_elapsed_get_ms(start) < run_ms)
+        hal_cpu_low_power_enter();
+
+    hal_adc_stop(HAL_ADC_0);
+    hal_adc_stats_get(HAL_ADC_0, stats);
+
+    uint32_t expected = run_ms / TEST_HALF_MS;
+    uint64_t period_cycles = (uint64_t) hal_cpu_cycles_freq_get() * TEST_HALF_MS / 1000;
+    uint32_t average_us =
+        stats->halves ? (uint32_t) (stats->busy_cycles * 1000000 / hal_cpu_cycles_freq_get() / stats->halves) : 0;
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP,
+                   "%u Hz, %u channels, %u ms halves: %u halves (expected %u), %u overruns, %u late, callback "
+                   "average %u us, max %u us, load %u.%u%%\n",
+                   rate, num_channels, TEST_HALF_MS, stats->halves, expected, stats->overruns, stats->late, average_us,
+                   (uint32_t) ((uint64_t) stats->busy_cycles_max * 1000000 / hal_cpu_cycles_freq_get()),
+                   (uint32_t) (stats->busy_cycles * 100 / (expected * period_cycles)),
+                   (uint32_t) (stats->busy_cycles * 1000 / (expected * period_cycles) % 10));
+}
+
+void app_init(void)
+{
+    utl_dbg_mod_enable(UTL_DBG_MOD_APP);
+    utl_dbg_mod_enable(UTL_DBG_MOD_ADC);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Initalizing app...\n");
+}
+
+bool app_loop(void)
+{
+    hal_adc_stats_t stats;
+    hal_adc_config_t cfg = {.sample_rate_hz = TEST_SOURCE_RATE, .num_channels = 1, .buffer = buffer};
+
+    test_check(!hal_adc_config(HAL_ADC_0, &cfg), "Missing callback refused");
+    cfg.callback = test_callback;
+    cfg.frames_per_half = 10;
+    cfg.inputs[0] = HAL_ADC_NUM_INPUTS;
+    test_check(!hal_adc_config(HAL_ADC_0, &cfg), "Unknown input refused");
+
+    unlink(TEST_SOURCE);
+    cfg.inputs[0] = 0;
+    test_check(!hal_adc_config(HAL_ADC_0, &cfg), "Missing source refused");
+    test_check(test_source_write(), "Source written");
+
+    // every sample checked against the file, at its own rate
+    test_run(TEST_MODE_CHECK, TEST_SOURCE_RATE, 3, TEST_RUN_MS, &stats);
+    // every half is given to the callback, or skipped by a late handler or after an overrun
+    test_check(stats.halves == halves &&
+                   stats.halves + stats.late + stats.overruns >= TEST_RUN_MS / TEST_HALF_MS * 9 / 10 &&
+                   stats.halves + stats.late <= TEST_RUN_MS / TEST_HALF_MS + 1,
+               "Half count");
+    test_check(bad_frames == 0 && gaps <= stats.overruns + stats.late, "Samples");
+
+    // a filter on a 48 kHz stream, the file played faster
+    test_run(TEST_MODE_FIR, 48000, 1, TEST_RUN_MS, &stats);
+    // a late reactor thread may still lose a half on a loaded host, that is not an overrun
+    test_check(stats.busy_cycles_max > 0 &&
+                   stats.busy_cycles_max < (uint64_t) hal_cpu_cycles_freq_get() * TEST_HALF_MS / 1000 &&
+                   stats.overruns == 0 && stats.late <= TEST_RUN_MS / TEST_HALF_MS / 50,
+               "Filter keeps up");
+
+    // a callback longer than a half: the next half always comes due while it runs
+    test_run(TEST_MODE_SLOW, TEST_SOURCE_RATE, 1, TEST_RUN_MS / 2, &stats);
+    test_check(stats.overruns > 0 && stats.overruns + 1 >= stats.halves, "Overruns detected");
+
+    test_report();
+
+    unlink(TEST_SOURCE);
+    app_terminate_set();
+
+    return false;
+}
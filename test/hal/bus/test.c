@@ -0,0 +1,258 @@
+#include "hal.h"
+#include "app.h"
+#include "test_check.h"
+#include "port_model.h"
+
+#define TEST_SPI_CLOCK_HZ 8000000
+// slow enough for the byte interrupts to leave some CPU time
+#define TEST_SPI_MODES_CLOCK_HZ 1000000
+#define TEST_I2C_CLOCK_HZ 400000
+#define TEST_EEPROM_ADDR 0x50
+#define TEST_EEPROM_SIZE 4096
+#define TEST_EEPROM_PAGE 32
+#define TEST_EEPROM_CYCLE_US 5000
+#define TEST_READ_SIZE 64
+#define TEST_NUM_CALLS 100
+#define TEST_NUM_REGS 16
+
+static port_model_sensor_t sensor;
+static port_model_eeprom_t eeprom;
+static uint8_t eeprom_mem[TEST_EEPROM_SIZE];
+
+static volatile uint32_t completions = 0;
+static volatile bool completed_ok = false;
+
+static void test_spi_done(hal_spi_bus_t bus, bool ok, void* ctx)
+{
+    completed_ok = ok;
+    completions++;
+}
+
+static void test_i2c_done(hal_i2c_bus_t bus, bool ok, void* ctx)
+{
+    completed_ok = ok;
+    completions++;
+}
+
+static void test_wait(uint32_t count)
+{
+    while(completions < count)
+        hal_cpu_low_power_enter();
+}
+
+static uint8_t test_sensor_read(uint8_t reg)
+{
+    uint8_t tx[2] = {PORT_MODEL_SENSOR_READ | reg, 0};
+    uint8_t rx[2] = {0};
+    hal_spi_xfer_t xfer = {.cs = 0, .tx = tx, .rx = rx, .size = sizeof(tx)};
+
+    hal_spi_transfer(HAL_SPI_BUS_0, &xfer, 1);
+
+    return rx[1];
+}
+
+static void test_sensor(void)
+{
+    uint8_t tx[7] = {PORT_MODEL_SENSOR_CTRL_REG1, 0x57};
+    uint8_t rx[7];
+    hal_spi_xfer_t xfer = {.cs = 0, .tx = tx, .rx = 0, .size = 2};
+
+    test_check(test_sensor_read(PORT_MODEL_SENSOR_WHO_AM_I) == PORT_MODEL_SENSOR_ID, "Sensor WHO_AM_I");
+    test_check((test_sensor_read(PORT_MODEL_SENSOR_STATUS_REG) & PORT_MODEL_SENSOR_ZYXDA) == 0, "Sensor powered down");
+
+    // 100 Hz
+    test_check(hal_spi_transfer(HAL_SPI_BUS_0, &xfer, 1), "Sensor data rate");
+    hal_cpu_sleep_ms(25);
+    test_check((test_sensor_read(PORT_MODEL_SENSOR_STATUS_REG) & PORT_MODEL_SENSOR_ZYXDA) != 0, "Sensor new data");
+
+    memset(tx, 0, sizeof(tx));
+    tx[0] = PORT_MODEL_SENSOR_READ | PORT_MODEL_SENSOR_INC | PORT_MODEL_SENSOR_OUT_X_L;
+    xfer.rx = rx;
+    xfer.size = sizeof(tx);
+    hal_spi_transfer(HAL_SPI_BUS_0, &xfer, 1);
+
+    int16_t z_mg = (int16_t) (rx[5] | (rx[6] << 8)) / 16;
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Sensor Z %d mg\n", z_mg);
+    test_check(z_mg >= 500 && z_mg <= 1500, "Sensor output");
+    test_check((test_sensor_read(PORT_MODEL_SENSOR_STATUS_REG) & PORT_MODEL_SENSOR_ZYXDA) == 0, "Sensor data read");
+
+    test_check(test_sensor_read(PORT_MODEL_SENSOR_WHO_AM_I) == PORT_MODEL_SENSOR_ID &&
+                   hal_spi_transfer(HAL_SPI_BUS_0, &(hal_spi_xfer_t) {.cs = 1, .tx = tx, .rx = rx, .size = 2}, 1) &&
+                   rx[1] == 0xFF,
+               "No device on CS 1");
+}
+
+static void test_eeprom(void)
+{
+    uint8_t tx[2 + TEST_EEPROM_PAGE];
+    uint8_t rx[TEST_EEPROM_PAGE];
+    hal_i2c_xfer_t xfer = {.addr = TEST_EEPROM_ADDR, .tx = tx, .tx_size = 2 + 16};
+    uint32_t polls = 0;
+
+    tx[0] = 0x00;
+    tx[1] = 0x40;
+    for(uint32_t n = 0; n < 16; n++)
+        tx[2 + n] = (uint8_t) (0xA0 + n);
+
+    test_check(hal_i2c_transfer(HAL_I2C_BUS_0, &xfer, 1), "EEPROM write");
+    uint32_t start = hal_cpu_cycles_get();
+
+    // acknowledge polling with the address only
+    xfer.tx_size = 2;
+    while(!hal_i2c_transfer(HAL_I2C_BUS_0, &xfer, 1))
+        polls++;
+
+    uint32_t cycle_us = test_us_get(start);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "EEPROM write cycle %u us, %u polls\n", cycle_us, polls);
+    test_check(polls > 0 && cycle_us >= TEST_EEPROM_CYCLE_US * 9 / 10, "EEPROM busy during the write cycle");
+
+    xfer.rx = rx;
+    xfer.rx_size = 16;
+    test_check(hal_i2c_transfer(HAL_I2C_BUS_0, &xfer, 1) && memcmp(rx, &tx[2], 16) == 0, "EEPROM read back");
+
+    // 8 bytes from the end of a page wrap to its start
+    tx[1] = 0x5C;
+    xfer.tx_size = 2 + 8;
+    xfer.rx_size = 0;
+    hal_i2c_transfer(HAL_I2C_BUS_0, &xfer, 1);
+    test_check(memcmp(&eeprom_mem[0x5C], &tx[2], 4) == 0 && memcmp(&eeprom_mem[0x40], &tx[6], 4) == 0,
+               "EEPROM page wrap");
+    hal_cpu_sleep_ms(TEST_EEPROM_CYCLE_US / 1000 + 1);
+
+    xfer.addr = TEST_EEPROM_ADDR + 1;
+    xfer.tx_size = 2;
+    test_check(!hal_i2c_transfer(HAL_I2C_BUS_0, &xfer, 1), "No acknowledge without a device");
+
+    uint32_t expected = completions + 1;
+    test_check(hal_i2c_transfer_async(HAL_I2C_BUS_0, &xfer, 1, test_i2c_done, 0), "Asynchronous start");
+    test_wait(expected);
+    test_check(!completed_ok, "No acknowledge reported to the callback");
+}
+
+// the same reads in each mode: the bus time is the same, the CPU time is not
+static void test_modes(void)
+{
+    static const char* names[] = {"Blocking", "Interrupts", "DMA"};
+    uint64_t cpu_ns[3];
+    uint8_t tx[TEST_READ_SIZE] = {PORT_MODEL_SENSOR_READ | PORT_MODEL_SENSOR_INC | PORT_MODEL_SENSOR_OUT_X_L};
+    uint8_t rx[TEST_READ_SIZE];
+    hal_spi_xfer_t xfer = {.cs = 0, .tx = tx, .rx = rx, .size = sizeof(tx)};
+    port_bus_stats_t stats;
+
+    hal_spi_config(HAL_SPI_BUS_0, &(hal_spi_config_t) {.clock_hz = TEST_SPI_MODES_CLOCK_HZ, .mode = HAL_SPI_MODE_3});
+
+    for(uint32_t mode = 0; mode < 3; mode++)
+    {
+        port_spi_stats_reset(HAL_SPI_BUS_0);
+        uint32_t start = hal_cpu_cycles_get();
+
+        for(uint32_t n = 0; n < TEST_NUM_CALLS; n++)
+        {
+            uint32_t expected = completions + 1;
+
+            if(mode == 0)
+                hal_spi_transfer(HAL_SPI_BUS_0, &xfer, 1);
+            else if(mode == 1 && hal_spi_transfer_async(HAL_SPI_BUS_0, &xfer, 1, test_spi_done, 0))
+                test_wait(expected);
+            else if(mode == 2 && hal_spi_transfer_dma(HAL_SPI_BUS_0, &xfer, 1, test_spi_done, 0))
+                test_wait(expected);
+        }
+
+        uint32_t elapsed_us = test_us_get(start);
+        port_spi_stats_get(HAL_SPI_BUS_0, &stats);
+        cpu_ns[mode] = stats.cpu_ns;
+
+        UTL_DBG_PRINTF(UTL_DBG_MOD_APP,
+                       "%s: %u reads of %u bytes in %u us, bus %u us, CPU %u us, %u interrupts\n", names[mode],
+                       stats.calls, TEST_READ_SIZE, elapsed_us, (uint32_t) (stats.bus_ns / 1000),
+                       (uint32_t) (stats.cpu_ns / 1000), stats.interrupts);
+    }
+
+    test_check(cpu_ns[2] < cpu_ns[1] && cpu_ns[1] < cpu_ns[0], "CPU time: DMA < interrupts < blocking");
+}
+
+// register reads one call at a time, then in a single batch
+static void test_batch(void)
+{
+    uint8_t tx[TEST_NUM_REGS];
+    uint8_t rx[TEST_NUM_REGS][2];
+    hal_i2c_xfer_t xfers[TEST_NUM_REGS];
+    port_bus_stats_t stats;
+
+    hal_i2c_config(HAL_I2C_BUS_0, &(hal_i2c_config_t) {.clock_hz = TEST_I2C_CLOCK_HZ});
+    memset(eeprom_mem, 0x5A, sizeof(eeprom_mem));
+
+    // one address byte: a 256 bytes device
+    port_model_eeprom_init(&eeprom, eeprom_mem, 256, TEST_EEPROM_PAGE, TEST_EEPROM_CYCLE_US);
+
+    for(uint32_t n = 0; n < TEST_NUM_REGS; n++)
+    {
+        tx[n] = (uint8_t) (n * 8);
+        xfers[n] = (hal_i2c_xfer_t) {.addr = TEST_EEPROM_ADDR, .tx = &tx[n], .tx_size = 1, .rx = rx[n], .rx_size = 2};
+    }
+
+    port_i2c_stats_reset(HAL_I2C_BUS_0);
+    uint32_t first = completions;
+    uint32_t start = hal_cpu_cycles_get();
+
+    for(uint32_t n = 0; n < TEST_NUM_REGS; n++)
+    {
+        uint32_t expected = completions + 1;
+
+        if(hal_i2c_transfer_dma(HAL_I2C_BUS_0, &xfers[n], 1, test_i2c_done, 0))
+            test_wait(expected);
+    }
+
+    uint32_t single_us = test_us_get(start);
+    uint32_t single_completions = completions - first;
+    port_i2c_stats_get(HAL_I2C_BUS_0, &stats);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "%u single reads: %u us, %u completions, bus %u us\n", TEST_NUM_REGS, single_us,
+                   single_completions, (uint32_t) (stats.bus_ns / 1000));
+
+    memset(rx, 0, sizeof(rx));
+    port_i2c_stats_reset(HAL_I2C_BUS_0);
+    first = completions;
+    start = hal_cpu_cycles_get();
+
+    if(hal_i2c_transfer_dma(HAL_I2C_BUS_0, xfers, TEST_NUM_REGS, test_i2c_done, 0))
+        test_wait(first + 1);
+
+    uint32_t batch_us = test_us_get(start);
+    port_i2c_stats_get(HAL_I2C_BUS_0, &stats);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Batch of %u reads: %u us, %u completions, bus %u us\n", TEST_NUM_REGS, batch_us,
+                   completions - first, (uint32_t) (stats.bus_ns / 1000));
+
+    bool ok = completed_ok;
+    for(uint32_t n = 0; n < TEST_NUM_REGS; n++)
+        ok &= rx[n][0] == 0x5A && rx[n][1] == 0x5A;
+
+    test_check(ok && completions - first == 1 && single_completions == TEST_NUM_REGS, "Batch results");
+    test_check(batch_us < single_us, "Batch faster than single calls");
+}
+
+void app_init(void)
+{
+    utl_dbg_mod_enable(UTL_DBG_MOD_APP);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Initalizing app...\n");
+
+    port_model_sensor_init(&sensor);
+    port_spi_device_register(HAL_SPI_BUS_0, 0, &sensor.dev);
+    hal_spi_config(HAL_SPI_BUS_0, &(hal_spi_config_t) {.clock_hz = TEST_SPI_CLOCK_HZ, .mode = HAL_SPI_MODE_3});
+
+    port_model_eeprom_init(&eeprom, eeprom_mem, TEST_EEPROM_SIZE, TEST_EEPROM_PAGE, TEST_EEPROM_CYCLE_US);
+    port_i2c_device_register(HAL_I2C_BUS_0, TEST_EEPROM_ADDR, &eeprom.dev);
+}
+
+bool app_loop(void)
+{
+    test_sensor();
+    test_eeprom();
+    test_modes();
+    test_batch();
+
+    test_report();
+
+    app_terminate_set();
+
+    return false;
+}
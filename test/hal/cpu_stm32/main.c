@@ -0,0 +1,71 @@
+#include "hal.h"
+
+uint32_t test_primask = 0;
+uint32_t test_basepri = 0;
+uint32_t test_tick = 0;
+
+static uint32_t test_errors = 0;
+
+static void test_check(const char* what, uint32_t value, uint32_t expected)
+{
+    if(value != expected)
+        test_errors++;
+
+    printf("%-40s 0x%02X (expected 0x%02X) %s\n", what, value, expected, value == expected ? "ok" : "FAIL");
+}
+
+int main(void)
+{
+    uint32_t outer, inner, innermost;
+
+    // processor level: PRIMASK, the previous interrupt state is returned in bit 0
+    outer = hal_cpu_critical_section_enter(HAL_CPU_CS_PROCESSOR_LEVEL);
+    test_check("processor level, interrupts were enabled", outer, 0x00);
+    test_check("PRIMASK set", test_primask, 1);
+
+    inner = hal_cpu_critical_section_enter(HAL_CPU_CS_PROCESSOR_LEVEL);
+    test_check("nested, interrupts were disabled", inner, 0x01);
+
+    hal_cpu_critical_section_leave(inner);
+    test_check("nested leave keeps PRIMASK", test_primask, 1);
+
+    hal_cpu_critical_section_leave(outer);
+    test_check("outer leave clears PRIMASK", test_primask, 0);
+
+    // custom and user levels: BASEPRI = 5, 10, 15 in bits 7:4, bit 1 marks BASEPRI was used
+    outer = hal_cpu_critical_section_enter(HAL_CPU_CS_USER_LEVEL);
+    test_check("user level, previous BASEPRI 0", outer, 0x02);
+    test_check("BASEPRI for user level", test_basepri, 15 << 4);
+
+    inner = hal_cpu_critical_section_enter(HAL_CPU_CS_CUSTOM_LEVEL2);
+    test_check("custom level 2, previous BASEPRI 15", inner, (15 << 4) | 0x02);
+    test_check("BASEPRI for custom level 2", test_basepri, 10 << 4);
+
+    innermost = hal_cpu_critical_section_enter(HAL_CPU_CS_CUSTOM_LEVEL1);
+    test_check("custom level 1, previous BASEPRI 10", innermost, (10 << 4) | 0x02);
+    test_check("BASEPRI for custom level 1", test_basepri, 5 << 4);
+    test_check("PRIMASK untouched", test_primask, 0);
+
+    hal_cpu_critical_section_leave(innermost);
+    test_check("restored BASEPRI 10", test_basepri, 10 << 4);
+    hal_cpu_critical_section_leave(inner);
+    test_check("restored BASEPRI 15", test_basepri, 15 << 4);
+    hal_cpu_critical_section_leave(outer);
+    test_check("restored BASEPRI 0", test_basepri, 0);
+
+    // mixed: processor level inside a BASEPRI section
+    outer = hal_cpu_critical_section_enter(HAL_CPU_CS_CUSTOM_LEVEL1);
+    inner = hal_cpu_critical_section_enter(HAL_CPU_CS_PROCESSOR_LEVEL);
+    hal_cpu_critical_section_leave(inner);
+    test_check("mixed, PRIMASK restored", test_primask, 0);
+    test_check("mixed, BASEPRI kept", test_basepri, 5 << 4);
+    hal_cpu_critical_section_leave(outer);
+    test_check("mixed, BASEPRI restored", test_basepri, 0);
+
+    test_tick = 1234;
+    test_check("time from HAL_GetTick()", hal_cpu_time_get_ms() & 0xFF, 1234 & 0xFF);
+
+    printf("%u errors\n", test_errors);
+
+    return test_errors ? 1 : 0;
+}
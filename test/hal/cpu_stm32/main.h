@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+
+// Host stand-ins for the CMSIS core registers used by port_cpu_inline.h
+extern uint32_t test_primask;
+extern uint32_t test_basepri;
+extern uint32_t test_tick;
+
+static inline uint32_t __get_PRIMASK(void)
+{
+    return test_primask;
+}
+
+static inline void __disable_irq(void)
+{
+    test_primask = 1;
+}
+
+static inline void __enable_irq(void)
+{
+    test_primask = 0;
+}
+
+static inline uint32_t __get_BASEPRI(void)
+{
+    return test_basepri;
+}
+
+static inline void __set_BASEPRI(uint32_t basepri)
+{
+    // 4 priority bits, as on STM32
+    test_basepri = basepri & 0xF0;
+}
+
+static inline void __ISB(void)
+{
+}
+
+static inline void __DSB(void)
+{
+}
+
+static inline uint32_t HAL_GetTick(void)
+{
+    return test_tick;
+}
@@ -0,0 +1,127 @@
+#include <unistd.h>
+
+#include "hal.h"
+#include "app.h"
+#include "test_check.h"
+
+#define TEST_IMAGE "flash.bin"
+#define TEST_NUM_READS 200
+#define TEST_WEAR_PAGE 3
+#define TEST_WEAR_CYCLES 10
+
+static hal_flash_info_t info;
+static uint8_t buffer[4096];
+
+static void test_erase_program_read(void)
+{
+    uint8_t data[64];
+    bool erased = true;
+
+    for(uint32_t n = 0; n < sizeof(data); n++)
+        data[n] = (uint8_t) (n * 7 + 1);
+
+    test_check(hal_flash_page_erase(0), "Erase page 0");
+    for(uint32_t n = 0; n < info.page_size; n++)
+        erased &= hal_flash_ptr_get(0)[n] == info.erased_value;
+    test_check(erased, "Page 0 erased");
+
+    test_check(hal_flash_program(info.write_size, data, sizeof(data)), "Program 64 bytes");
+    test_check(hal_flash_read(info.write_size, buffer, sizeof(data)) && memcmp(buffer, data, sizeof(data)) == 0,
+               "Read back");
+    test_check(memcmp(hal_flash_ptr_get(info.write_size), data, sizeof(data)) == 0, "Pointer read back");
+    test_check(hal_flash_ptr_get(0)[0] == info.erased_value, "Unit before untouched");
+
+    // erase before write: programmed units are refused, erased ones next to them are still fine
+    test_check(!hal_flash_program(info.write_size, data, info.write_size), "Program without erase refused");
+    test_check(memcmp(hal_flash_ptr_get(info.write_size), data, sizeof(data)) == 0, "Refused program wrote nothing");
+    test_check(hal_flash_program(0, data, info.write_size), "Program erased unit");
+
+    test_check(!hal_flash_program(info.page_size + 1, data, info.write_size), "Misaligned offset refused");
+    test_check(!hal_flash_program(info.page_size, data, info.write_size + 1), "Misaligned size refused");
+    test_check(!hal_flash_program(info.size - info.write_size, data, 2 * info.write_size), "Out of range refused");
+    test_check(!hal_flash_page_erase(info.size / info.page_size), "Erase out of range refused");
+    test_check(hal_flash_ptr_get(info.size) == 0, "Pointer out of range");
+}
+
+static void test_wear(void)
+{
+    uint32_t count = hal_flash_erase_count_get(TEST_WEAR_PAGE);
+
+    for(uint32_t n = 0; n < TEST_WEAR_CYCLES; n++)
+        hal_flash_page_erase(TEST_WEAR_PAGE);
+
+    test_check(hal_flash_erase_count_get(TEST_WEAR_PAGE) == count + TEST_WEAR_CYCLES, "Erase cycles counted");
+
+    // counters live in the image, a new session finds them
+    hal_flash_deinit();
+    hal_flash_init();
+    hal_flash_info_get(&info);
+    test_check(hal_flash_erase_count_get(TEST_WEAR_PAGE) == count + TEST_WEAR_CYCLES, "Erase cycles kept");
+    test_check(memcmp(hal_flash_ptr_get(info.write_size), buffer, 64) == 0, "Data kept");
+}
+
+static void test_throughput(void)
+{
+    uint32_t pages = info.size / info.page_size;
+    uint32_t start = hal_cpu_cycles_get();
+
+    for(uint32_t page = 0; page < pages; page++)
+        hal_flash_page_erase(page);
+
+    uint32_t erase_us = test_us_get(start);
+
+    memset(buffer, 0x5A, sizeof(buffer));
+    start = hal_cpu_cycles_get();
+    for(uint32_t offset = 0; offset < info.size; offset += sizeof(buffer))
+        hal_flash_program(offset, buffer, sizeof(buffer));
+
+    uint32_t program_us = test_us_get(start);
+
+    // no syscall per read: a copy out of the mapping
+    start = hal_cpu_cycles_get();
+    for(uint32_t n = 0; n < TEST_NUM_READS; n++)
+    {
+        for(uint32_t offset = 0; offset < info.size; offset += sizeof(buffer))
+            hal_flash_read(offset, buffer, sizeof(buffer));
+    }
+
+    uint32_t read_us = test_us_get(start) / TEST_NUM_READS;
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "%u KiB: erase %u us, program %u us, read %u us\n", info.size / 1024, erase_us,
+                   program_us, read_us);
+    if(read_us)
+        UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Read: %u MiB/s, program: %u MiB/s\n",
+                       (uint32_t) ((uint64_t) info.size * 1000000 / read_us / (1024 * 1024)),
+                       (uint32_t) ((uint64_t) info.size * 1000000 / (program_us ? program_us : 1) / (1024 * 1024)));
+}
+
+void app_init(void)
+{
+    utl_dbg_mod_enable(UTL_DBG_MOD_APP);
+    utl_dbg_mod_enable(UTL_DBG_MOD_PORT);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Initalizing app...\n");
+
+    // start from a new image
+    hal_flash_deinit();
+    unlink(TEST_IMAGE);
+    hal_flash_init();
+    hal_flash_info_get(&info);
+}
+
+bool app_loop(void)
+{
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Flash: %u bytes, pages of %u, writes of %u\n", info.size, info.page_size,
+                   info.write_size);
+
+    test_erase_program_read();
+    test_wear();
+    test_throughput();
+
+    test_report();
+
+    hal_flash_deinit();
+    unlink(TEST_IMAGE);
+    app_terminate_set();
+
+    return false;
+}
@@ -0,0 +1,133 @@
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "hal.h"
+#include "app.h"
+
+#define TEST_NUM_TOGGLES 1000000
+#define TEST_NUM_EDGES 20
+#define TEST_EDGE_PERIOD_US 2000
+
+static volatile uint32_t rising_count = 0;
+static volatile uint32_t falling_count = 0;
+static volatile uint32_t latency_max_us = 0;
+// falling edges not stamped after the rising edge before them
+static volatile uint32_t order_errors = 0;
+static uint32_t rising_stamp = 0;
+static bool rising_seen = false;
+
+static void test_edge(hal_gpio_pin_t pin, bool state, uint32_t timestamp)
+{
+    uint32_t latency_us = (uint32_t) ((uint64_t) (hal_cpu_cycles_get() - timestamp) * 1000000 /
+                                      hal_cpu_cycles_freq_get());
+
+    if(state)
+    {
+        rising_count++;
+        rising_stamp = timestamp;
+        rising_seen = true;
+    }
+    else
+    {
+        falling_count++;
+        if(rising_seen && (int32_t) (timestamp - rising_stamp) <= 0)
+            order_errors++;
+    }
+
+    if(latency_us > latency_max_us)
+        latency_max_us = latency_us;
+}
+
+static uint32_t test_toggle_ns(hal_gpio_pin_t pin)
+{
+    uint32_t start = hal_cpu_cycles_get();
+
+    for(uint32_t n = 0; n < TEST_NUM_TOGGLES; n++)
+        hal_gpio_toggle(pin);
+
+    return (uint32_t) ((uint64_t) (hal_cpu_cycles_get() - start) * 1000000000ULL / hal_cpu_cycles_freq_get() /
+                       (TEST_NUM_TOGGLES / 100));
+}
+
+void app_init(void)
+{
+    utl_dbg_mod_enable(UTL_DBG_MOD_APP);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Initalizing app...\n");
+}
+
+bool app_loop(void)
+{
+    hal_gpio_config_t out_cfg = {.dir = HAL_GPIO_DIR_OUTPUT, .state = false};
+    hal_gpio_config_t in_cfg = {.dir = HAL_GPIO_DIR_INPUT, .edge = HAL_GPIO_EDGE_BOTH, .interrupt_callback = test_edge};
+
+    hal_gpio_config(HAL_GPIO_PIN_0, &out_cfg);
+    uint32_t toggle_ns = test_toggle_ns(HAL_GPIO_PIN_0);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Toggle: %u.%02u ns\n", toggle_ns / 100, toggle_ns % 100);
+
+    hal_gpio_set(HAL_GPIO_PIN_0, true);
+    bool high = hal_gpio_get(HAL_GPIO_PIN_0);
+    hal_gpio_set(HAL_GPIO_PIN_0, false);
+    bool low = hal_gpio_get(HAL_GPIO_PIN_0);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Set/get: %d %d (expected 1 0)\n", high, low);
+
+    // pins past the table are ignored instead of indexing the driver state out of range
+    hal_gpio_set(HAL_GPIO_NUM_PINS, true);
+    hal_gpio_toggle(HAL_GPIO_NUM_PINS);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Unknown pin: %d (expected 0)\n", hal_gpio_get(HAL_GPIO_NUM_PINS));
+
+    // another process drives pin 1, as an external tool would: the child shares the segment and
+    // only writes the pin (its copy of the configuration belongs to this process)
+    hal_gpio_config(HAL_GPIO_PIN_1, &in_cfg);
+
+    pid_t child = fork();
+    if(child == 0)
+    {
+        for(uint32_t n = 0; n < TEST_NUM_EDGES; n++)
+        {
+            usleep(TEST_EDGE_PERIOD_US);
+            hal_gpio_toggle(HAL_GPIO_PIN_1);
+        }
+        _exit(0);
+    }
+
+    waitpid(child, NULL, 0);
+    hal_cpu_sleep_ms(100);
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Edges from another process: %u rising, %u falling (expected %u %u)\n",
+                   rising_count, falling_count, TEST_NUM_EDGES / 2, TEST_NUM_EDGES / 2);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Max edge to interrupt latency: %u us\n", latency_max_us);
+
+    // pulses far shorter than the interrupt latency: both edges of each one are still seen
+    rising_count = 0;
+    falling_count = 0;
+    child = fork();
+    if(child == 0)
+    {
+        for(uint32_t n = 0; n < TEST_NUM_EDGES / 2; n++)
+        {
+            usleep(TEST_EDGE_PERIOD_US);
+            hal_gpio_set(HAL_GPIO_PIN_1, true);
+            hal_gpio_set(HAL_GPIO_PIN_1, false);
+        }
+        _exit(0);
+    }
+
+    waitpid(child, NULL, 0);
+    hal_cpu_sleep_ms(100);
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Short pulses: %u rising, %u falling (expected %u %u)\n", rising_count,
+                   falling_count, TEST_NUM_EDGES / 2, TEST_NUM_EDGES / 2);
+    // both edges of a pulse are merged into one wake up but keep their own time
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Falling edges stamped before their rising edge: %u (expected 0)\n",
+                   order_errors);
+
+    // only changes of watched pins are timestamped and signaled
+    toggle_ns = test_toggle_ns(HAL_GPIO_PIN_0);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Toggle, other pin watched: %u.%02u ns\n", toggle_ns / 100, toggle_ns % 100);
+    toggle_ns = test_toggle_ns(HAL_GPIO_PIN_1);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Toggle, watched pin: %u.%02u ns\n", toggle_ns / 100, toggle_ns % 100);
+
+    app_terminate_set();
+
+    return false;
+}
@@ -0,0 +1,188 @@
+#include "hal.h"
+#include "app.h"
+#include "test_check.h"
+
+#define TEST_PERIOD_US 500
+#define TEST_RUN_MS 1000
+#define TEST_ONE_SHOT_US 2000
+
+static volatile uint32_t updates = 0;
+static volatile uint32_t compares[HAL_TIMER_NUM_CHANNELS];
+static volatile uint32_t latency_max_ns = 0;
+static volatile uint64_t latency_total_ns = 0;
+static volatile uint32_t one_shots = 0;
+static volatile uint32_t protected_calls = 0;
+
+static void test_latency(uint32_t timestamp)
+{
+    uint32_t latency_ns =
+        (uint32_t) ((uint64_t) (hal_cpu_cycles_get() - timestamp) * 1000000000ULL / hal_cpu_cycles_freq_get());
+
+    latency_total_ns += latency_ns;
+    if(latency_ns > latency_max_ns)
+        latency_max_ns = latency_ns;
+}
+
+static void test_update(hal_timer_id_t tmr, uint32_t timestamp)
+{
+    test_latency(timestamp);
+    updates++;
+}
+
+static void test_compare(hal_timer_id_t tmr, uint32_t channel, uint32_t timestamp)
+{
+    test_latency(timestamp);
+    compares[channel]++;
+}
+
+static void test_one_shot(hal_timer_id_t tmr, uint32_t timestamp)
+{
+    one_shots++;
+}
+
+// legal in an interrupt handler of the target
+static void test_compare_protected(hal_timer_id_t tmr, uint32_t channel, uint32_t timestamp)
+{
+    uint32_t state = hal_cpu_critical_section_enter(HAL_CPU_CS_PROCESSOR_LEVEL);
+    protected_calls++;
+    hal_cpu_critical_section_leave(state);
+}
+
+static void test_periodic(void)
+{
+    hal_timer_config_t cfg = {
+        .mode = HAL_TIMER_MODE_PERIODIC,
+        .period_us = TEST_PERIOD_US,
+        .update_callback = test_update,
+        .compare_us = {100, 300},
+        .compare_callback = test_compare,
+    };
+    hal_timer_stats_t stats;
+    uint32_t wakeups = 0;
+
+    test_check(hal_timer_config(HAL_TIMER_0, &cfg), "Periodic config");
+
+    uint32_t start = hal_cpu_time_get_ms();
+    uint32_t start_cycles = hal_cpu_cycles_get();
+    hal_timer_start(HAL_TIMER_0);
+
+    // the main context sleeps until each timer event
+    while(hal_cpu_time_elapsed_get_ms(start) < TEST_RUN_MS)
+    {
+        hal_cpu_low_power_enter();
+        wakeups++;
+    }
+
+    hal_timer_stop(HAL_TIMER_0);
+    uint32_t elapsed_us = test_us_get(start_cycles);
+    hal_timer_stats_get(HAL_TIMER_0, &stats);
+
+    uint32_t events = updates + compares[0] + compares[1];
+    uint32_t expected = elapsed_us / TEST_PERIOD_US;
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "%u us period for %u us: %u updates, compares %u %u (expected %u each)\n",
+                   TEST_PERIOD_US, elapsed_us, updates, compares[0], compares[1], expected);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Merged by a late handler: updates %u, compares %u %u\n", stats.updates_merged,
+                   stats.compares_merged[0], stats.compares_merged[1]);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Latency: average %u ns, max %u ns, %u main loop wake ups\n",
+                   events ? (uint32_t) (latency_total_ns / events) : 0, latency_max_ns, wakeups);
+
+    test_check(stats.updates == updates && stats.compares[0] == compares[0] && stats.compares[1] == compares[1],
+               "Callback counts");
+    // every period is either delivered or merged; expirations still pending when the timer stops are
+    // dropped, those of the last period or two when the handler runs late
+    uint32_t total[3] = {updates + stats.updates_merged, compares[0] + stats.compares_merged[0],
+                         compares[1] + stats.compares_merged[1]};
+    for(uint32_t event = 0; event < 3; event++)
+    {
+        test_check(total[event] <= expected + 1 && total[event] + 2 >= expected,
+                   event == 0 ? "Update periods" : "Compare periods");
+    }
+
+    uint32_t stopped = updates;
+    hal_cpu_sleep_ms(5);
+    test_check(updates == stopped && hal_timer_count_get(HAL_TIMER_0) == 0, "Stopped");
+}
+
+static void test_one_shot_timer(void)
+{
+    hal_timer_config_t cfg = {
+        .mode = HAL_TIMER_MODE_ONE_SHOT,
+        .period_us = TEST_ONE_SHOT_US,
+        .update_callback = test_one_shot,
+    };
+
+    test_check(hal_timer_config(HAL_TIMER_1, &cfg), "One-shot config");
+
+    hal_timer_start(HAL_TIMER_1);
+    uint32_t count = hal_timer_count_get(HAL_TIMER_1);
+    hal_cpu_sleep_ms(10);
+
+    test_check(count < TEST_ONE_SHOT_US && one_shots == 1, "One-shot fired once");
+
+    // restarted from 0
+    hal_timer_start(HAL_TIMER_1);
+    hal_cpu_sleep_ms(10);
+    test_check(one_shots == 2, "One-shot restarted");
+}
+
+static void test_critical_section(void)
+{
+    hal_timer_config_t cfg = {
+        .mode = HAL_TIMER_MODE_ONE_SHOT,
+        .period_us = TEST_ONE_SHOT_US,
+        .compare_us = {TEST_ONE_SHOT_US / 2},
+        .compare_callback = test_compare_protected,
+    };
+
+    test_check(hal_timer_config(HAL_TIMER_2, &cfg), "Protected callback config");
+    hal_timer_start(HAL_TIMER_2);
+
+    // the callback waits for the critical section of the main loop, removing its channel waits for
+    // the callback: nothing may block
+    hal_cpu_sleep_ms(10);
+    cfg.compare_us[0] = 0;
+    test_check(hal_timer_config(HAL_TIMER_2, &cfg) && protected_calls == 1, "Callback in a critical section");
+}
+
+static void test_invalid(void)
+{
+    hal_timer_config_t cfg = {.mode = HAL_TIMER_MODE_PERIODIC, .period_us = 0};
+
+    test_check(!hal_timer_config(HAL_TIMER_2, &cfg), "Period 0 refused");
+
+    cfg.period_us = 1000;
+    cfg.compare_us[0] = 1000;
+    cfg.compare_callback = test_compare;
+    test_check(!hal_timer_config(HAL_TIMER_2, &cfg), "Compare outside the period refused");
+
+    cfg.compare_us[0] = 10;
+    cfg.compare_callback = 0;
+    test_check(!hal_timer_config(HAL_TIMER_2, &cfg), "Compare without callback refused");
+    test_check(!hal_timer_config(HAL_TIMER_NUM_TIMERS, &cfg), "Unknown timer refused");
+
+    // ignored, not an access past the port tables
+    hal_timer_start(HAL_TIMER_NUM_TIMERS);
+    hal_timer_stop(HAL_TIMER_NUM_TIMERS);
+    test_check(hal_timer_count_get(HAL_TIMER_NUM_TIMERS) == 0, "Unknown timer ignored");
+}
+
+void app_init(void)
+{
+    utl_dbg_mod_enable(UTL_DBG_MOD_APP);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Initalizing app...\n");
+}
+
+bool app_loop(void)
+{
+    test_periodic();
+    test_one_shot_timer();
+    test_critical_section();
+    test_invalid();
+
+    test_report();
+
+    app_terminate_set();
+
+    return false;
+}
@@ -28,6 +28,10 @@ void app_init(void)
         UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Failed to open UART port 0\n");
         app_terminate_set();
     }
+    else if(hal_uart_peer_name_get(uart_dev))
+    {
+        UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Connect to %s to talk with UART port 0\n", hal_uart_peer_name_get(uart_dev));
+    }
 }
 
 bool app_loop(void)
@@ -50,7 +54,11 @@ bool app_loop(void)
             }
         }
 
-        hal_cpu_sleep_ms(100);
+        else
+        {
+            // sleep until something is received (or CTRL+C), no polling delay on the echo
+            hal_cpu_low_power_enter();
+        }
     }
 
     hal_uart_close(uart_dev);
@@ -0,0 +1,332 @@
+#define _GNU_SOURCE
+#include <sched.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "hal.h"
+#include "app.h"
+
+// Throughput, round trip latency and CPU usage of hal_uart_read()/hal_uart_write() between PORT0 and PORT1.
+// The transport is selected at build time (BENCH_TRANSPORT) and the result is written as JSON to
+// BENCH_OUTPUT (default uart_bench_<transport>.json) and to stdout.
+//
+// Everything runs from app_loop(), so the numbers include the port RX path (threads, rings, syscalls)
+// but not the scheduling of a real application.
+
+#ifndef BENCH_TRANSPORT
+#define BENCH_TRANSPORT "loopback"
+#endif
+
+#define BENCH_TOTAL_BYTES (4 * 1024 * 1024)
+#define BENCH_CHUNK_SIZE 128
+// bytes in flight, must fit the smallest RX buffer of the ports (512 bytes on unix)
+#define BENCH_WINDOW_SIZE 384
+#define BENCH_ROUND_TRIPS 1000
+#define BENCH_MESSAGE_SIZE 16
+#define BENCH_TIMEOUT_NS 1000000000ULL
+#define BENCH_CONNECT_ATTEMPTS 2000
+
+typedef struct bench_throughput_s
+{
+    uint64_t bytes;
+    uint64_t lost;
+    uint64_t errors;
+    uint64_t elapsed_ns;
+    uint64_t cpu_ns;
+} bench_throughput_t;
+
+typedef struct bench_latency_s
+{
+    uint32_t round_trips;
+    uint32_t timeouts;
+    uint64_t rtt_ns[BENCH_ROUND_TRIPS];
+} bench_latency_t;
+
+static hal_uart_dev_t uart_a = 0;
+static hal_uart_dev_t uart_b = 0;
+static hal_uart_config_t uart_cfg = {
+    .baud_rate = HAL_UART_BAUD_RATE_115200,
+    .parity = HAL_UART_PARITY_NONE,
+    .stop_bits = HAL_UART_STOP_BITS_1,
+    .flow_control = HAL_UART_FLOW_CONTROL_NONE,
+    .interrupt_callback = 0,
+};
+
+static bench_throughput_t bench_tput;
+static bench_latency_t bench_lat;
+
+static uint64_t bench_time_get_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// user + system time of all threads, port RX/reactor threads included
+static uint64_t bench_cpu_get_ns(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+
+    return (uint64_t) (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000000ULL +
+           (uint64_t) (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000ULL;
+}
+
+static void bench_transport_setup(void)
+{
+    const char* name0 = 0;
+    const char* name1 = 0;
+
+    // both ports are the two ends of the same link, existing PORT_UARTn variables take precedence
+    if(strcmp(BENCH_TRANSPORT, "pty") == 0)
+    {
+        name0 = "pty:fwdev_bench";
+        name1 = "fwdev_bench";
+    }
+    else if(strcmp(BENCH_TRANSPORT, "socket") == 0)
+    {
+        name0 = "unix:/tmp/fwdev_bench.sock";
+        name1 = name0;
+    }
+    else if(strcmp(BENCH_TRANSPORT, "shm") == 0)
+    {
+        name0 = "/fwdev_bench";
+        name1 = name0;
+    }
+
+    if(name0)
+    {
+        setenv("PORT_UART0", name0, 0);
+        setenv("PORT_UART1", name1, 0);
+    }
+}
+
+// sockets are accepted in background, so wait until bytes go through before measuring
+static bool bench_link_wait(void)
+{
+    uint8_t probe = 0;
+
+    for(uint32_t attempt = 0; attempt < BENCH_CONNECT_ATTEMPTS; attempt++)
+    {
+        hal_uart_write(uart_a, &probe, 1);
+        usleep(1000);
+
+        if(hal_uart_bytes_available(uart_b) > 0)
+        {
+            usleep(10000);
+            hal_uart_flush(uart_a);
+            hal_uart_flush(uart_b);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void bench_throughput_run(bench_throughput_t* res)
+{
+    uint8_t tx[BENCH_CHUNK_SIZE];
+    uint8_t rx[BENCH_WINDOW_SIZE];
+    uint64_t sent = 0, received = 0;
+
+    memset(res, 0, sizeof(*res));
+
+    uint64_t cpu_start = bench_cpu_get_ns();
+    uint64_t start = bench_time_get_ns();
+    uint64_t last_rx = start;
+
+    while(received < BENCH_TOTAL_BYTES)
+    {
+        bool idle = true;
+
+        if(sent < BENCH_TOTAL_BYTES && sent - received + BENCH_CHUNK_SIZE <= BENCH_WINDOW_SIZE)
+        {
+            for(size_t pos = 0; pos < sizeof(tx); pos++)
+                tx[pos] = (uint8_t) (sent + pos);
+
+            ssize_t n = hal_uart_write(uart_a, tx, sizeof(tx));
+            if(n > 0)
+            {
+                sent += (uint64_t) n;
+                idle = false;
+            }
+        }
+
+        ssize_t n = hal_uart_read(uart_b, rx, sizeof(rx));
+        if(n > 0)
+        {
+            for(ssize_t pos = 0; pos < n; pos++)
+            {
+                if(rx[pos] != (uint8_t) (received + pos))
+                    res->errors++;
+            }
+
+            received += (uint64_t) n;
+            last_rx = bench_time_get_ns();
+            idle = false;
+        }
+
+        if(idle)
+        {
+            if(bench_time_get_ns() - last_rx > BENCH_TIMEOUT_NS)
+                break;
+
+            sched_yield();
+        }
+    }
+
+    res->elapsed_ns = last_rx - start;
+    res->cpu_ns = bench_cpu_get_ns() - cpu_start;
+    res->bytes = received;
+    res->lost = sent - received;
+}
+
+static bool bench_receive(hal_uart_dev_t dev, uint8_t* buffer, size_t size)
+{
+    return hal_uart_read_timeout(dev, buffer, size, size, BENCH_TIMEOUT_NS / 1000000ULL) == (ssize_t) size;
+}
+
+static void bench_latency_run(bench_latency_t* res)
+{
+    uint8_t msg[BENCH_MESSAGE_SIZE];
+    uint8_t echo[BENCH_MESSAGE_SIZE];
+
+    res->round_trips = 0;
+    res->timeouts = 0;
+
+    for(uint32_t trip = 0; trip < BENCH_ROUND_TRIPS; trip++)
+    {
+        for(size_t pos = 0; pos < sizeof(msg); pos++)
+            msg[pos] = (uint8_t) (trip + pos);
+
+        uint64_t start = bench_time_get_ns();
+
+        hal_uart_write(uart_a, msg, sizeof(msg));
+        bool ok = bench_receive(uart_b, echo, sizeof(echo));
+        if(ok)
+        {
+            hal_uart_write(uart_b, echo, sizeof(echo));
+            ok = bench_receive(uart_a, echo, sizeof(echo));
+        }
+
+        if(!ok || memcmp(msg, echo, sizeof(msg)) != 0)
+        {
+            res->timeouts++;
+            hal_uart_flush(uart_a);
+            hal_uart_flush(uart_b);
+            continue;
+        }
+
+        res->rtt_ns[res->round_trips++] = bench_time_get_ns() - start;
+    }
+}
+
+static int bench_u64_compare(const void* a, const void* b)
+{
+    uint64_t va = *(const uint64_t*) a;
+    uint64_t vb = *(const uint64_t*) b;
+
+    return (va > vb) - (va < vb);
+}
+
+static double bench_percentile_us(bench_latency_t* res, uint32_t percentile)
+{
+    if(res->round_trips == 0)
+        return 0.0;
+
+    uint32_t pos = (uint32_t) (((uint64_t) res->round_trips * percentile + 99) / 100);
+    pos = pos ? pos - 1 : 0;
+
+    return (double) res->rtt_ns[pos] / 1000.0;
+}
+
+static void bench_stats_report(FILE* out, hal_uart_stats_t* tx, hal_uart_stats_t* rx, bool supported)
+{
+    fprintf(out,
+            "\"stats\": {\"supported\": %s, \"tx_bytes\": %u, \"tx_retries\": %u, \"tx_partial_writes\": %u, "
+            "\"rx_bytes\": %u, \"rx_overflows\": %u, \"rx_peak_occupancy\": %u}, ",
+            supported ? "true" : "false", tx->tx_bytes, tx->tx_retries, tx->tx_partial_writes, rx->rx_bytes,
+            rx->rx_overflows, rx->rx_peak_occupancy);
+}
+
+static void bench_report(FILE* out, bench_throughput_t* tput, bench_latency_t* lat)
+{
+    hal_uart_stats_t tx, rx;
+    double seconds = (double) tput->elapsed_ns / 1e9;
+    double mbytes = (double) tput->bytes / (1024.0 * 1024.0);
+
+    qsort(lat->rtt_ns, lat->round_trips, sizeof(lat->rtt_ns[0]), bench_u64_compare);
+
+    // PORT0 sends the stream, PORT1 receives it
+    bool supported = hal_uart_stats_get(uart_a, &tx) && hal_uart_stats_get(uart_b, &rx);
+
+    fprintf(out, "{\"transport\": \"%s\", ", BENCH_TRANSPORT);
+    bench_stats_report(out, &tx, &rx, supported);
+    fprintf(out,
+            "\"throughput\": {\"bytes\": %" PRIu64 ", \"lost\": %" PRIu64 ", \"errors\": %" PRIu64
+            ", \"seconds\": %.6f, \"mb_per_s\": %.3f, \"cpu_ms_per_mb\": %.3f}, ",
+            tput->bytes, tput->lost, tput->errors, seconds, seconds > 0.0 ? mbytes / seconds : 0.0,
+            mbytes > 0.0 ? ((double) tput->cpu_ns / 1e6) / mbytes : 0.0);
+    fprintf(out,
+            "\"latency\": {\"message_size\": %u, \"round_trips\": %u, \"timeouts\": %u, \"min_us\": %.3f, "
+            "\"p50_us\": %.3f, \"p90_us\": %.3f, \"p99_us\": %.3f, \"max_us\": %.3f}}\n",
+            BENCH_MESSAGE_SIZE, lat->round_trips, lat->timeouts,
+            lat->round_trips ? (double) lat->rtt_ns[0] / 1000.0 : 0.0, bench_percentile_us(lat, 50),
+            bench_percentile_us(lat, 90), bench_percentile_us(lat, 99), bench_percentile_us(lat, 100));
+}
+
+void app_init(void)
+{
+    utl_dbg_mod_enable(UTL_DBG_MOD_APP);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Initalizing UART benchmark (%s)...\n", BENCH_TRANSPORT);
+
+    bench_transport_setup();
+
+    uart_a = hal_uart_open(HAL_UART_PORT0, &uart_cfg);
+    uart_b = hal_uart_open(HAL_UART_PORT1, &uart_cfg);
+
+    if(uart_a == 0 || uart_b == 0 || !bench_link_wait())
+    {
+        UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Failed to connect UART ports\n");
+        app_terminate_set();
+    }
+}
+
+bool app_loop(void)
+{
+    const char* file_name = getenv("BENCH_OUTPUT");
+    char default_name[64];
+
+    if(app_terminate_get())
+        return false;
+
+    bench_throughput_run(&bench_tput);
+    bench_latency_run(&bench_lat);
+
+    if(file_name == 0)
+    {
+        snprintf(default_name, sizeof(default_name), "uart_bench_%s.json", BENCH_TRANSPORT);
+        file_name = default_name;
+    }
+
+    FILE* out = fopen(file_name, "w");
+    if(out)
+    {
+        bench_report(out, &bench_tput, &bench_lat);
+        fclose(out);
+    }
+    else
+    {
+        UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Can not create %s\n", file_name);
+    }
+
+    bench_report(stdout, &bench_tput, &bench_lat);
+    fflush(stdout);
+
+    hal_uart_close(uart_a);
+    hal_uart_close(uart_b);
+    app_terminate_set();
+
+    return true;
+}
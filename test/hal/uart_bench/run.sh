@@ -0,0 +1,24 @@
+#!/bin/bash
+
+if [ ! -d "build" ]; then
+    mkdir build
+fi
+
+(cd build && cmake .. )
+
+if [ $? -ne 0 ]; then
+    echo "CMake configuration failed."
+    exit 1
+fi
+
+make -C build
+
+if [ $? -ne 0 ]; then
+    echo "Build failed."
+    exit 1
+fi
+
+# one JSON result per transport: uart_bench_<transport>.json
+for bench in build/bench_*; do
+    ./$bench
+done
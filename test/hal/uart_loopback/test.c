@@ -0,0 +1,136 @@
+#include "hal.h"
+#include "app.h"
+
+#define TEST_NUM_BLOCKS 1000
+#define TEST_BLOCK_SIZE 256
+
+static hal_uart_dev_t uart_tx = 0;
+static hal_uart_dev_t uart_rx = 0;
+static uint32_t data_ready_count = 0;
+static _Alignas(uint32_t) uint8_t rx_small[UTL_RING_AREA_SIZE(1024)];
+static hal_uart_config_t uart_cfg = {
+    .baud_rate = HAL_UART_BAUD_RATE_115200,
+    .parity = HAL_UART_PARITY_NONE,
+    .stop_bits = HAL_UART_STOP_BITS_1,
+    .flow_control = HAL_UART_FLOW_CONTROL_NONE,
+    .interrupt_callback = 0,
+};
+
+static void test_data_ready(hal_uart_dev_t dev)
+{
+    if(dev == uart_rx)
+        data_ready_count++;
+}
+
+void app_init(void)
+{
+    utl_dbg_mod_enable(UTL_DBG_MOD_APP);
+    utl_dbg_mod_enable(UTL_DBG_MOD_UART);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Initalizing app...\n");
+
+    uart_tx = hal_uart_open(HAL_UART_PORT0, &uart_cfg);
+    uart_rx = hal_uart_open(HAL_UART_PORT1, &uart_cfg);
+
+    if(uart_tx == 0 || uart_rx == 0)
+    {
+        UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Failed to open UART ports\n");
+        app_terminate_set();
+    }
+
+    // traffic can be replayed later with port_uart_replay.c
+    if(!hal_uart_capture_start("loopback.pcapng", (1 << HAL_UART_PORT0) | (1 << HAL_UART_PORT1)))
+        UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Failed to start capture\n");
+}
+
+bool app_loop(void)
+{
+    uint8_t tx[TEST_BLOCK_SIZE];
+    uint8_t rx[TEST_BLOCK_SIZE];
+    uint32_t errors = 0;
+
+    for(uint32_t block = 0; block < TEST_NUM_BLOCKS; block++)
+    {
+        for(size_t pos = 0; pos < sizeof(tx); pos++)
+            tx[pos] = (uint8_t) (block + pos);
+
+        hal_uart_write(uart_tx, tx, sizeof(tx));
+
+        if(hal_uart_bytes_available(uart_rx) != sizeof(rx) || hal_uart_read(uart_rx, rx, sizeof(rx)) != sizeof(rx) ||
+           memcmp(tx, rx, sizeof(tx)) != 0)
+        {
+            errors++;
+        }
+    }
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "%u blocks transferred, %u errors\n", TEST_NUM_BLOCKS, errors);
+
+    // blocking read: returns as soon as min bytes are there, or with what arrived at timeout
+    hal_uart_write(uart_tx, tx, 10);
+    ssize_t n = hal_uart_read_timeout(uart_rx, rx, 10, sizeof(rx), 1000);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Read with timeout: %d bytes (expected 10)\n", (int) n);
+
+    hal_uart_write(uart_tx, tx, 4);
+    n = hal_uart_read_timeout(uart_rx, rx, 10, sizeof(rx), 50);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Read with timeout: %d bytes (expected 4)\n", (int) n);
+
+    // gathered write: header, payload and trailer arrive as one contiguous block
+    hal_uart_iov_t iov[3] = {{(uint8_t*) "HDR", 3}, {tx, 16}, {(uint8_t*) "END", 3}};
+    n = hal_uart_writev(uart_tx, iov, 3);
+    ssize_t m = hal_uart_read_timeout(uart_rx, rx, 22, sizeof(rx), 1000);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Gathered write: %d/%d bytes, %s (expected 22/22, ok)\n", (int) n, (int) m,
+                   memcmp(rx, "HDR", 3) == 0 && memcmp(rx + 3, tx, 16) == 0 && memcmp(rx + 19, "END", 3) == 0 ? "ok"
+                                                                                                           : "error");
+
+    // receiver overrun: 20 blocks do not fit the 4096 bytes ring of the loopback port
+    hal_uart_stats_t stats;
+    for(uint32_t block = 0; block < 20; block++)
+        hal_uart_write(uart_tx, tx, sizeof(tx));
+
+    hal_uart_stats_get(uart_rx, &stats);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "RX overflows: %u bytes (expected %u), peak occupancy %u\n", stats.rx_overflows,
+                   20 * TEST_BLOCK_SIZE - 4096, stats.rx_peak_occupancy);
+
+    // caller supplied receive buffer: a 1024 bytes ring instead of the default one
+    hal_uart_close(uart_rx);
+    uart_cfg.rx_buffer = rx_small;
+    uart_cfg.rx_buffer_size = sizeof(rx_small);
+    uart_rx = hal_uart_open(HAL_UART_PORT1, &uart_cfg);
+
+    for(uint32_t block = 0; block < 20; block++)
+        hal_uart_write(uart_tx, tx, sizeof(tx));
+
+    hal_uart_stats_get(uart_rx, &stats);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "RX overflows with 1024 bytes buffer: %u bytes (expected %u)\n",
+                   stats.rx_overflows, 20 * TEST_BLOCK_SIZE - 1024);
+
+    // frame mode: the receiver gets whole frames split on 0x00, however bytes were written
+    static const uint8_t frames[] = {'a', 'b', 'c', 0, 0, 'd', 'e', 0, 'f'};
+    uint32_t frame_sizes[3] = {0};
+
+    hal_uart_close(uart_rx);
+    uart_cfg.frame.mode = UTL_FRAME_MODE_DELIMITER;
+    uart_cfg.frame.delimiter = 0;
+    uart_cfg.data_ready_callback = test_data_ready;
+    uart_rx = hal_uart_open(HAL_UART_PORT1, &uart_cfg);
+
+    for(size_t pos = 0; pos < sizeof(frames); pos++)
+        hal_uart_write(uart_tx, (uint8_t*) &frames[pos], 1);
+
+    // the writes above already woke the CPU up, so this returns at once
+    hal_cpu_low_power_enter();
+
+    for(size_t frame = 0; frame < 3; frame++)
+        frame_sizes[frame] = (uint32_t) hal_uart_frame_read(uart_rx, rx, sizeof(rx));
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Frames received: %u %u %u (expected 3 2 0)\n", frame_sizes[0], frame_sizes[1],
+                   frame_sizes[2]);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Data ready notifications: %u (expected %u)\n", data_ready_count,
+                   (uint32_t) sizeof(frames));
+
+    hal_uart_capture_stop();
+    hal_uart_close(uart_tx);
+    hal_uart_close(uart_rx);
+    app_terminate_set();
+
+    return true;
+}
@@ -0,0 +1,29 @@
+#!/bin/bash
+
+# the capture replayed comes from the loopback test
+(cd ../uart_loopback && ./run.sh > /dev/null)
+
+if [ $? -ne 0 ]; then
+    echo "Loopback capture failed."
+    exit 1
+fi
+
+if [ ! -d "build" ]; then
+    mkdir build
+fi
+
+(cd build && cmake .. )
+
+if [ $? -ne 0 ]; then
+    echo "CMake configuration failed."
+    exit 1
+fi
+
+make -C build
+
+if [ $? -ne 0 ]; then
+    echo "Build failed."
+    exit 1
+fi
+
+PORT_UART_REPLAY_FILE=../uart_loopback/loopback.pcapng ./build/app
@@ -0,0 +1,144 @@
+#include <time.h>
+
+#include "hal.h"
+#include "app.h"
+#include "test_check.h"
+#include "utl_pcapng.h"
+#include "utl_ring.h"
+
+// Replays the capture of the uart_loopback test (see run.sh): PORT1 must receive the bytes of the
+// inbound packets of interface 1, in the same order, first as fast as they are read, then with
+// the original timing.
+
+#define TEST_DEFAULT_FILE "uart.pcapng"
+#define TEST_MAX_BYTES (512 * 1024)
+#define TEST_CHUNK_SIZE 4096
+#define TEST_IDLE_TIMEOUT_MS 1000
+
+static uint8_t expected[TEST_MAX_BYTES];
+static uint8_t received[TEST_MAX_BYTES];
+// with the original timing a descheduled reader loses what does not fit the ring, so it holds all
+static _Alignas(uint32_t) uint8_t rx_ring[UTL_RING_AREA_SIZE(TEST_MAX_BYTES)];
+static uint32_t expected_size = 0;
+static uint64_t span_ns = 0;
+static hal_uart_config_t uart_cfg = {
+    .baud_rate = HAL_UART_BAUD_RATE_115200,
+    .parity = HAL_UART_PARITY_NONE,
+    .stop_bits = HAL_UART_STOP_BITS_1,
+    .flow_control = HAL_UART_FLOW_CONTROL_NONE,
+};
+
+static uint64_t test_time_get_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+// inbound bytes of PORT1 in the capture, which must be in time order
+static bool test_capture_load(const char* file_name)
+{
+    static uint8_t data[TEST_CHUNK_SIZE];
+    utl_pcapng_packet_t pkt;
+    utl_pcapng_t pc;
+    uint64_t first_ts = 0, last_ts = 0;
+    uint32_t packets = 0;
+    bool ordered = true;
+
+    if(!utl_pcapng_open(&pc, file_name))
+        return false;
+
+    while(utl_pcapng_packet_read(&pc, &pkt, data, sizeof(data)))
+    {
+        if(pkt.iface != HAL_UART_PORT1 || pkt.dir == UTL_PCAPNG_DIR_OUTBOUND)
+            continue;
+
+        if(packets++ == 0)
+            first_ts = pkt.ts_ns;
+
+        ordered &= pkt.ts_ns >= last_ts && expected_size + pkt.size <= sizeof(expected);
+        last_ts = pkt.ts_ns;
+
+        if(expected_size + pkt.size <= sizeof(expected))
+        {
+            memcpy(&expected[expected_size], data, pkt.size);
+            expected_size += pkt.size;
+        }
+    }
+
+    utl_pcapng_close(&pc);
+    span_ns = last_ts - first_ts;
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "%s: %u inbound packets, %u bytes over %u ms\n", file_name, packets,
+                   expected_size, (uint32_t) (span_ns / 1000000));
+
+    return ordered && packets > 0;
+}
+
+// reads until everything expected arrived or nothing came for a while
+static uint32_t test_replay(uint64_t* elapsed_ns)
+{
+    hal_uart_dev_t uart = hal_uart_open(HAL_UART_PORT1, &uart_cfg);
+    uint32_t size = 0;
+    uint64_t start = 0, last = test_time_get_ns();
+
+    if(uart == 0)
+        return 0;
+
+    while(size < expected_size && test_time_get_ns() - last < TEST_IDLE_TIMEOUT_MS * 1000000ULL)
+    {
+        ssize_t n = hal_uart_read(uart, &received[size], expected_size - size);
+
+        if(n > 0)
+        {
+            last = test_time_get_ns();
+            if(size == 0)
+                start = last;
+            size += (uint32_t) n;
+        }
+    }
+
+    *elapsed_ns = last - start;
+    hal_uart_close(uart);
+
+    return size;
+}
+
+void app_init(void)
+{
+    utl_dbg_mod_enable(UTL_DBG_MOD_APP);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Initalizing app...\n");
+}
+
+bool app_loop(void)
+{
+    const char* file_name = getenv("PORT_UART_REPLAY_FILE");
+    uint64_t elapsed_ns;
+
+    if(file_name == 0)
+        file_name = TEST_DEFAULT_FILE;
+
+    test_check(test_capture_load(file_name), "Capture in time order");
+
+    setenv("PORT_UART_REPLAY_MAX_SPEED", "1", 1);
+    uint32_t size = test_replay(&elapsed_ns);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "As fast as read: %u bytes in %u ms\n", size, (uint32_t) (elapsed_ns / 1000000));
+    test_check(size == expected_size && memcmp(received, expected, size) == 0, "Bytes and order");
+
+    unsetenv("PORT_UART_REPLAY_MAX_SPEED");
+    uart_cfg.rx_buffer = rx_ring;
+    uart_cfg.rx_buffer_size = sizeof(rx_ring);
+    size = test_replay(&elapsed_ns);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Original timing: %u bytes in %u ms\n", size, (uint32_t) (elapsed_ns / 1000000));
+    test_check(size == expected_size && memcmp(received, expected, size) == 0, "Bytes and order, original timing");
+    // the capture has the arrival times: the 50 ms read timeout of the loopback test is replayed
+    test_check(elapsed_ns >= span_ns * 9 / 10, "Original timing kept");
+
+    test_report();
+
+    app_terminate_set();
+
+    return false;
+}
@@ -0,0 +1,219 @@
+#include <unistd.h>
+
+#include "hal.h"
+#include "app.h"
+#include "utl_kvs.h"
+#include "test_check.h"
+
+#define BENCH_IMAGE "flash.bin"
+#define BENCH_PAGES 16
+#define BENCH_INDEX_SIZE 256
+#define BENCH_NUM_CONFIGS 64
+#define BENCH_CONFIG_SIZE 24
+#define BENCH_NUM_COUNTERS 16
+#define BENCH_NUM_UPDATES 20000
+
+static utl_kvs_t kvs;
+static utl_kvs_slot_t kvs_index[BENCH_INDEX_SIZE];
+static const utl_kvs_cfg_t kvs_cfg = {.first_page = 0, .num_pages = BENCH_PAGES};
+
+// what the store must hold
+static uint8_t configs[BENCH_NUM_CONFIGS][BENCH_CONFIG_SIZE];
+static uint32_t counters[BENCH_NUM_COUNTERS];
+static bool counter_deleted[BENCH_NUM_COUNTERS];
+
+static void bench_set(const char* key, const void* value, uint32_t size, uint32_t* max_us)
+{
+    uint32_t start = hal_cpu_cycles_get();
+    utl_kvs_status_t status = utl_kvs_set(&kvs, key, value, size);
+    uint32_t us = test_us_get(start);
+
+    test_check_silent(status == UTL_KVS_OK, key);
+    if(us > *max_us)
+        *max_us = us;
+}
+
+static void bench_verify(const char* when)
+{
+    char key[16];
+    uint8_t value[UTL_KVS_MAX_VALUE_SIZE];
+    uint32_t size;
+    uint32_t bad = 0;
+
+    for(uint32_t n = 0; n < BENCH_NUM_CONFIGS; n++)
+    {
+        snprintf(key, sizeof(key), "cfg.%02u", n);
+        size = sizeof(value);
+        bad += utl_kvs_get(&kvs, key, value, &size) != UTL_KVS_OK || size != BENCH_CONFIG_SIZE ||
+               memcmp(value, configs[n], size) != 0;
+    }
+
+    for(uint32_t n = 0; n < BENCH_NUM_COUNTERS; n++)
+    {
+        snprintf(key, sizeof(key), "cnt.%02u", n);
+        const uint8_t* ptr = utl_kvs_ptr_get(&kvs, key, &size);
+        if(counter_deleted[n])
+            bad += ptr != 0;
+        else
+            bad += ptr == 0 || size != 4 || memcmp(ptr, &counters[n], 4) != 0;
+    }
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Verify %s: %u bad keys\n", when, bad);
+    test_errors += bad;
+}
+
+static void bench_stats(const char* when)
+{
+    utl_kvs_stats_t stats;
+    uint32_t wear_min = UINT32_MAX, wear_max = 0;
+
+    utl_kvs_stats_get(&kvs, &stats);
+
+    for(uint32_t page = 0; page < BENCH_PAGES; page++)
+    {
+        uint32_t count = hal_flash_erase_count_get(page);
+        wear_min = count < wear_min ? count : wear_min;
+        wear_max = count > wear_max ? count : wear_max;
+    }
+
+    // write amplification in hundredths
+    uint32_t wa = stats.user_bytes ? (uint32_t) ((uint64_t) stats.flash_bytes * 100 / stats.user_bytes) : 0;
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "%s: %u keys, %u free sectors, user %u bytes, flash %u bytes (gc %u)\n", when,
+                   stats.keys, stats.free_sectors, stats.user_bytes, stats.flash_bytes, stats.gc_bytes);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "%s: write amplification %u.%02u, %u erases, page wear %u..%u\n", when, wa / 100,
+                   wa % 100, stats.erases, wear_min, wear_max);
+}
+
+static void bench_fill(void)
+{
+    char key[16];
+    uint32_t max_us = 0;
+
+    for(uint32_t n = 0; n < BENCH_NUM_CONFIGS; n++)
+    {
+        for(uint32_t pos = 0; pos < BENCH_CONFIG_SIZE; pos++)
+            configs[n][pos] = (uint8_t) rand();
+
+        snprintf(key, sizeof(key), "cfg.%02u", n);
+        bench_set(key, configs[n], BENCH_CONFIG_SIZE, &max_us);
+    }
+
+    for(uint32_t n = 0; n < BENCH_NUM_COUNTERS; n++)
+    {
+        snprintf(key, sizeof(key), "cnt.%02u", n);
+        bench_set(key, &counters[n], 4, &max_us);
+    }
+
+    bench_stats("Fill");
+}
+
+// counters updated all the time, configuration saved again every 100 updates (mostly unchanged),
+// a counter deleted and created again every 1000
+static void bench_updates(bool idle_gc)
+{
+    char key[16];
+    uint32_t max_us = 0;
+    uint32_t start = hal_cpu_cycles_get();
+
+    for(uint32_t update = 1; update <= BENCH_NUM_UPDATES; update++)
+    {
+        uint32_t n = (uint32_t) rand() % BENCH_NUM_COUNTERS;
+
+        snprintf(key, sizeof(key), "cnt.%02u", n);
+        counters[n]++;
+        counter_deleted[n] = false;
+        bench_set(key, &counters[n], 4, &max_us);
+
+        if(update % 100 == 0)
+        {
+            configs[update / 100 % BENCH_NUM_CONFIGS][0]++;
+
+            for(uint32_t cfg = 0; cfg < BENCH_NUM_CONFIGS; cfg++)
+            {
+                snprintf(key, sizeof(key), "cfg.%02u", cfg);
+                bench_set(key, configs[cfg], BENCH_CONFIG_SIZE, &max_us);
+            }
+        }
+
+        if(update % 1000 == 0)
+        {
+            n = (uint32_t) rand() % BENCH_NUM_COUNTERS;
+            snprintf(key, sizeof(key), "cnt.%02u", n);
+            test_check_silent(utl_kvs_delete(&kvs, key) == UTL_KVS_OK || counter_deleted[n], "delete");
+            counter_deleted[n] = true;
+            counters[n] = 0;
+        }
+
+        // main loop idle time
+        if(idle_gc)
+            utl_kvs_gc_step(&kvs);
+    }
+
+    uint32_t total_us = test_us_get(start);
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "%u updates, gc %s: %u us, %u ns per update, max set %u us\n",
+                   BENCH_NUM_UPDATES, idle_gc ? "at idle" : "in set", total_us,
+                   (uint32_t) ((uint64_t) total_us * 1000 / BENCH_NUM_UPDATES), max_us);
+}
+
+static void bench_reboot(void)
+{
+    hal_flash_deinit();
+    hal_flash_init();
+
+    uint32_t start = hal_cpu_cycles_get();
+    utl_kvs_status_t status = utl_kvs_init(&kvs, &kvs_cfg, kvs_index, BENCH_INDEX_SIZE);
+    uint32_t us = test_us_get(start);
+    utl_kvs_stats_t stats;
+
+    utl_kvs_stats_get(&kvs, &stats);
+    test_check_silent(status == UTL_KVS_OK, "mount");
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Boot: index of %u keys built from %u records in %u us\n", stats.keys,
+                   stats.scanned, us);
+}
+
+void app_init(void)
+{
+    utl_dbg_mod_enable(UTL_DBG_MOD_APP);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Initalizing app...\n");
+
+    // start from a new image
+    hal_flash_deinit();
+    unlink(BENCH_IMAGE);
+    hal_flash_init();
+    srand(1);
+}
+
+bool app_loop(void)
+{
+    hal_flash_info_t info;
+
+    hal_flash_info_get(&info);
+    test_check_silent(utl_kvs_init(&kvs, &kvs_cfg, kvs_index, BENCH_INDEX_SIZE) == UTL_KVS_OK, "init");
+
+    bench_fill();
+    bench_updates(false);
+    bench_stats("Updates");
+    bench_verify("after updates");
+
+    bench_reboot();
+    bench_verify("after reboot");
+
+    bench_updates(true);
+    bench_stats("Updates, idle gc");
+    bench_reboot();
+    bench_verify("after reboot");
+
+    // the same updates erasing and rewriting a whole page each time
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Page rewrite per update: write amplification %u, %u erases\n",
+                   info.page_size / (6 + 4), BENCH_NUM_UPDATES);
+
+    test_report();
+
+    hal_flash_deinit();
+    unlink(BENCH_IMAGE);
+    app_terminate_set();
+
+    return false;
+}
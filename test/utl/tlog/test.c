@@ -0,0 +1,198 @@
+#include <unistd.h>
+
+#include "hal.h"
+#include "app.h"
+#include "test_check.h"
+#include "utl_tlog.h"
+
+#define TEST_IMAGE "flash.bin"
+#define TEST_PAGES 32
+// a sample per minute for three weeks, the log keeps the last two days
+#define TEST_PERIOD 60
+#define TEST_NUM_SAMPLES (21 * 24 * 60)
+#define TEST_NUM_QUERIES 1000
+
+typedef struct test_sample_s
+{
+    uint32_t timestamp;
+    int32_t temperature;
+    uint32_t pressure;
+} test_sample_t;
+
+static utl_tlog_t tlog;
+static const utl_tlog_cfg_t tlog_cfg = {.first_page = 0, .num_pages = TEST_PAGES};
+static uint32_t t_next = 1000;
+
+static void test_sample_make(test_sample_t* sample, uint32_t timestamp)
+{
+    sample->timestamp = timestamp;
+    sample->temperature = (int32_t) (timestamp % 4000) - 1000;
+    sample->pressure = timestamp / 7;
+}
+
+static bool test_append(uint32_t count)
+{
+    test_sample_t sample;
+    bool ok = true;
+
+    for(uint32_t n = 0; n < count; n++, t_next += TEST_PERIOD)
+    {
+        test_sample_make(&sample, t_next);
+        ok &= utl_tlog_append(&tlog, t_next, &sample, sizeof(sample)) == UTL_TLOG_OK;
+    }
+
+    return ok;
+}
+
+// records in [t_start, t_end], all checked against their timestamp
+static uint32_t test_query(uint32_t t_start, uint32_t t_end, bool* ok)
+{
+    utl_tlog_iter_t iter;
+    utl_tlog_record_t rec;
+    test_sample_t sample;
+    uint32_t count = 0;
+    uint32_t t_prev = 0;
+
+    utl_tlog_find(&tlog, &iter, t_start, t_end);
+    while(utl_tlog_next(&tlog, &iter, &rec))
+    {
+        test_sample_make(&sample, rec.timestamp);
+        *ok &= rec.size == sizeof(sample) && memcmp(rec.data, &sample, sizeof(sample)) == 0;
+        *ok &= rec.timestamp >= t_start && rec.timestamp <= t_end && (count == 0 || rec.timestamp == t_prev + TEST_PERIOD);
+        t_prev = rec.timestamp;
+        count++;
+    }
+
+    return count;
+}
+
+static uint32_t test_expected(uint32_t t_first, uint32_t t_start, uint32_t t_end)
+{
+    // samples are at t_first + k * TEST_PERIOD
+    t_start = t_start < t_first ? t_first : t_start;
+    if(t_end < t_start)
+        return 0;
+
+    uint32_t first = (t_start - t_first + TEST_PERIOD - 1) / TEST_PERIOD;
+    uint32_t last = (t_end - t_first) / TEST_PERIOD;
+
+    return last >= first ? last - first + 1 : 0;
+}
+
+static void test_queries(const char* when)
+{
+    uint32_t t_first, t_last;
+    utl_tlog_stats_t stats;
+    bool ok = true;
+    uint32_t returned = 0;
+
+    if(!utl_tlog_range_get(&tlog, &t_first, &t_last))
+    {
+        test_check(false, "Range");
+        return;
+    }
+
+    utl_tlog_stats_get(&tlog, &stats);
+    uint32_t probes = stats.probes;
+    uint32_t start = hal_cpu_cycles_get();
+
+    // downloads of one hour somewhere in the log, some starting before it
+    for(uint32_t n = 0; n < TEST_NUM_QUERIES; n++)
+    {
+        uint32_t t_start = t_first - 3600 + (uint32_t) rand() % (t_last - t_first + 3600);
+        uint32_t t_end = t_start + 3600;
+        uint32_t count = test_query(t_start, t_end, &ok);
+
+        ok &= count == test_expected(t_first, t_start, t_end < t_last ? t_end : t_last);
+        returned += count;
+    }
+
+    uint32_t query_us = test_us_get(start);
+    utl_tlog_stats_get(&tlog, &stats);
+
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "%s: %u records in %u sectors, %u to %u\n", when, stats.records,
+                   stats.used_sectors, t_first, t_last);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "%s: %u queries, %u records, %u ns per query, %u header reads per query\n", when,
+                   TEST_NUM_QUERIES, returned, (uint32_t) ((uint64_t) query_us * 1000 / TEST_NUM_QUERIES),
+                   (stats.probes - probes) / TEST_NUM_QUERIES);
+    test_check(ok, "Query results");
+
+    // the same queries without the sector headers: every record before the range is read
+    start = hal_cpu_cycles_get();
+    uint32_t scanned = 0;
+    for(uint32_t n = 0; n < TEST_NUM_QUERIES; n++)
+    {
+        utl_tlog_iter_t iter;
+        utl_tlog_record_t rec;
+        uint32_t t_start = t_first - 3600 + (uint32_t) rand() % (t_last - t_first + 3600);
+
+        utl_tlog_find(&tlog, &iter, 0, t_start + 3600);
+        while(utl_tlog_next(&tlog, &iter, &rec))
+            scanned++;
+    }
+
+    query_us = test_us_get(start);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "%s: linear scan %u ns per query, %u records read per query\n", when,
+                   (uint32_t) ((uint64_t) query_us * 1000 / TEST_NUM_QUERIES), scanned / TEST_NUM_QUERIES);
+}
+
+void app_init(void)
+{
+    utl_dbg_mod_enable(UTL_DBG_MOD_APP);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Initalizing app...\n");
+
+    // start from a new image
+    hal_flash_deinit();
+    unlink(TEST_IMAGE);
+    hal_flash_init();
+    srand(1);
+}
+
+bool app_loop(void)
+{
+    uint32_t t_first, t_last;
+    utl_tlog_stats_t stats;
+    test_sample_t sample;
+
+    test_check(utl_tlog_init(&tlog, &tlog_cfg) == UTL_TLOG_OK, "Init");
+    test_check(!utl_tlog_range_get(&tlog, &t_first, &t_last), "Empty log");
+
+    uint32_t start = hal_cpu_cycles_get();
+    test_check(test_append(TEST_NUM_SAMPLES), "Three weeks of samples");
+    uint32_t append_us = test_us_get(start);
+
+    utl_tlog_stats_get(&tlog, &stats);
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "%u appends in %u us, %u erases\n", TEST_NUM_SAMPLES, append_us, stats.erases);
+
+    test_check(utl_tlog_append(&tlog, t_next - 2 * TEST_PERIOD, &sample, sizeof(sample)) == UTL_TLOG_INVALID,
+               "Older timestamp refused");
+    test_check(utl_tlog_range_get(&tlog, &t_first, &t_last) && t_last == t_next - TEST_PERIOD &&
+                   (t_last - t_first) / TEST_PERIOD + 1 == stats.records,
+               "Range");
+
+    test_queries("Running");
+
+    // a reset: the active sector is still open
+    hal_flash_deinit();
+    hal_flash_init();
+    start = hal_cpu_cycles_get();
+    test_check(utl_tlog_init(&tlog, &tlog_cfg) == UTL_TLOG_OK, "Mount");
+    UTL_DBG_PRINTF(UTL_DBG_MOD_APP, "Mount in %u us\n", test_us_get(start));
+
+    uint32_t t_first_mount, t_last_mount;
+    utl_tlog_stats_get(&tlog, &stats);
+    test_check(utl_tlog_range_get(&tlog, &t_first_mount, &t_last_mount) && t_first_mount == t_first &&
+                   t_last_mount == t_last && (t_last - t_first) / TEST_PERIOD + 1 == stats.records,
+               "Range after mount");
+    test_check(test_append(1000), "Appends after mount");
+
+    test_queries("Mounted");
+
+    test_report();
+
+    hal_flash_deinit();
+    unlink(TEST_IMAGE);
+    app_terminate_set();
+
+    return false;
+}